@@ -0,0 +1,93 @@
+#include "arunika.h"
+#include <time.h>
+
+// Microbenchmark for base64_encode() against the original scalar encoder.
+// Usage: bench_base64 [iterations]
+
+static const char reference_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Scalar reference: one triple per iteration, conditional loads, padding loop
+static int base64_encode_reference(const uint8_t *input, size_t input_len, char *output, size_t output_len) {
+    size_t encoded_len = 4 * ((input_len + 2) / 3);
+    if (output_len < encoded_len + 1) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+
+    size_t i, j;
+    for (i = 0, j = 0; i < input_len; ) {
+        uint32_t octet_a = i < input_len ? input[i++] : 0;
+        uint32_t octet_b = i < input_len ? input[i++] : 0;
+        uint32_t octet_c = i < input_len ? input[i++] : 0;
+
+        uint32_t triple = (octet_a << 0x10) + (octet_b << 0x08) + octet_c;
+
+        output[j++] = reference_table[(triple >> 3 * 6) & 0x3F];
+        output[j++] = reference_table[(triple >> 2 * 6) & 0x3F];
+        output[j++] = reference_table[(triple >> 1 * 6) & 0x3F];
+        output[j++] = reference_table[(triple >> 0 * 6) & 0x3F];
+    }
+
+    for (i = 0; i < (3 - input_len % 3) % 3; i++) {
+        output[encoded_len - 1 - i] = '=';
+    }
+
+    output[encoded_len] = '\0';
+    return encoded_len;
+}
+
+typedef int (*encode_fn_t)(const uint8_t *, size_t, char *, size_t);
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(encode_fn_t encode, const uint8_t *input, size_t len, char *output, size_t output_len, long iterations) {
+    volatile int sink = 0;
+    double start = now_seconds();
+    for (long i = 0; i < iterations; i++) {
+        sink += encode(input, len, output, output_len);
+    }
+    double elapsed = now_seconds() - start;
+    (void)sink;
+    return (double)len * iterations / elapsed / 1e6;
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 20000;
+    static const size_t sizes[] = { 16, AUDIO_CHUNK_SIZE, AUDIO_BUFFER_SIZE, 65536 };
+    static uint8_t input[65536];
+    static char expected[4 * (sizeof(input) / 3 + 1) + 1];
+    static char output[sizeof(expected)];
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(input); i++) {
+        input[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+
+    printf("%-8s %14s %14s %8s\n", "bytes", "reference MB/s", "base64 MB/s", "speedup");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t len = sizes[s];
+        long n = iterations * (long)(AUDIO_BUFFER_SIZE / len > 0 ? AUDIO_BUFFER_SIZE / len : 1);
+        if (len > AUDIO_BUFFER_SIZE) {
+            n = iterations / (long)(len / AUDIO_BUFFER_SIZE) + 1;
+        }
+
+        // Both encoders must agree before timing means anything
+        for (size_t tail = 0; tail < 3; tail++) {
+            base64_encode_reference(input, len - tail, expected, sizeof(expected));
+            base64_encode(input, len - tail, output, sizeof(output));
+            if (strcmp(expected, output) != 0) {
+                printf("MISMATCH at %zu bytes\n", len - tail);
+                failures++;
+            }
+        }
+
+        double reference = run(base64_encode_reference, input, len, output, sizeof(output), n);
+        double optimized = run(base64_encode, input, len, output, sizeof(output), n);
+        printf("%-8zu %14.1f %14.1f %7.2fx\n", len, reference, optimized, optimized / reference);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+#include "bench_common.h"
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_PI 3.14159265358979323846
+
+uint64_t bench_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int bench_url_host(const char *url, char *host, size_t size) {
+    const char *start = strstr(url, "://");
+    start = start ? start + 3 : url;
+    size_t len = strcspn(start, ":/");
+    if (len == 0 || len >= size) {
+        return -1;
+    }
+    memcpy(host, start, len);
+    host[len] = '\0';
+    return 0;
+}
+
+static uint32_t read_le(const uint8_t *p, int bytes) {
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = value << 8 | p[i];
+    }
+    return value;
+}
+
+long bench_load_wav(const char *path, int16_t *samples, size_t max_samples) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "bench: cannot open %s\n", path);
+        return -1;
+    }
+
+    uint8_t header[12];
+    uint8_t chunk[8];
+    bool format_ok = false;
+    size_t count = 0;
+    if (fread(header, 1, 12, f) != 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "bench: %s is not a WAV file\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    while (fread(chunk, 1, 8, f) == 8) {
+        uint32_t size = read_le(chunk + 4, 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < 16 || fread(fmt, 1, 16, f) != 16) {
+                break;
+            }
+            format_ok = read_le(fmt, 2) == 1 && read_le(fmt + 2, 2) == CHANNELS &&
+                        read_le(fmt + 4, 4) == SAMPLE_RATE && read_le(fmt + 14, 2) == BITS_PER_SAMPLE;
+            fseek(f, (long)(size - 16 + (size & 1)), SEEK_CUR);
+        } else if (memcmp(chunk, "data", 4) == 0 && format_ok) {
+            uint8_t pcm[2];
+            for (uint32_t i = 0; i < size / 2 && count < max_samples; i++) {
+                if (fread(pcm, 1, 2, f) != 2) {
+                    break;
+                }
+                samples[count++] = (int16_t)read_le(pcm, 2);
+            }
+            break;
+        } else {
+            fseek(f, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    fclose(f);
+
+    if (!format_ok || count == 0) {
+        fprintf(stderr, "bench: %s must be %d Hz mono 16-bit PCM\n", path, SAMPLE_RATE);
+        return -1;
+    }
+    return (long)count;
+}
+
+// A quiet lead-in, then two seconds of a voiced 140 Hz source with a
+// syllable-rate envelope
+size_t bench_synthesize_utterance(int16_t *samples, size_t max_samples) {
+    uint32_t seed = 12345;
+    size_t lead = SAMPLE_RATE * 3 / 10;
+    size_t count = lead + SAMPLE_RATE * 2;
+    if (count > max_samples) {
+        count = max_samples;
+    }
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        double noise = (double)((seed >> 16) & 0xFF) - 128;
+        double t = (double)i / SAMPLE_RATE;
+        double voiced = 0;
+        if (i >= lead) {
+            double envelope = 0.5 - 0.5 * cos(2 * BENCH_PI * 4 * (t - 0.3));
+            for (int h = 1; h <= 8; h++) {
+                voiced += sin(2 * BENCH_PI * 140 * h * t) / h;
+            }
+            voiced *= 6000 * envelope;
+        }
+        samples[i] = (int16_t)(voiced + noise / 4);
+    }
+    return count;
+}
+
+int bench_fetch_token(const char *host, uint16_t port, const char *credential, char *token, size_t token_size) {
+    const char *colon = strchr(credential, ':');
+    if (!colon) {
+        return -1;
+    }
+
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+    struct addrinfo hints;
+    struct addrinfo *info;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, service, &hints, &info) != 0) {
+        fprintf(stderr, "bench: cannot resolve %s\n", host);
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, info->ai_addr, info->ai_addrlen) != 0) {
+        fprintf(stderr, "bench: no server at %s:%s\n", host, service);
+        freeaddrinfo(info);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    freeaddrinfo(info);
+
+    static char request[1024];
+    static char response[4096];
+    char body[256];
+    int body_len = snprintf(body, sizeof(body), "{\"serial_number\":\"%.*s\",\"secret_key\":\"%s\"}",
+                            (int)(colon - credential), credential, colon + 1);
+    int len = snprintf(request, sizeof(request),
+                       "POST /api/v1/device/auth HTTP/1.0\r\nHost: %s\r\nContent-Type: application/json\r\n"
+                       "Content-Length: %d\r\n\r\n%s",
+                       host, body_len, body);
+    if (send(fd, request, (size_t)len, 0) != len) {
+        close(fd);
+        return -1;
+    }
+
+    // HTTP/1.0: the server closes when the body is complete
+    size_t got = 0;
+    ssize_t n;
+    while (got < sizeof(response) - 1 && (n = recv(fd, response + got, sizeof(response) - 1 - got, 0)) > 0) {
+        got += (size_t)n;
+    }
+    close(fd);
+    response[got] = '\0';
+
+    char *json = strstr(response, "\r\n\r\n");
+    json_span_t value;
+    if (strncmp(response, "HTTP/1.", 7) != 0 || strncmp(response + 8, " 200", 4) != 0 || !json ||
+        json_get_field(json + 4, strlen(json + 4), "token", &value) != ARUNIKA_OK || value.len >= token_size) {
+        fprintf(stderr, "bench: device auth failed for %.*s\n", (int)(colon - credential), credential);
+        return -1;
+    }
+    memcpy(token, value.ptr, value.len);
+    token[value.len] = '\0';
+    return 0;
+}
+
+static int compare_int32(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a;
+    int32_t y = *(const int32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+void bench_print_latency(FILE *out, const char *name, int32_t *values, int count) {
+    int valid = 0;
+    for (int i = 0; i < count; i++) {
+        if (values[i] >= 0) {
+            values[valid++] = values[i];
+        }
+    }
+    if (valid == 0) {
+        fprintf(out, "%-22s %8s\n", name, "n/a");
+        return;
+    }
+    qsort(values, valid, sizeof(values[0]), compare_int32);
+    fprintf(out, "%-22s %8.1f %8.1f %8.1f %8.1f %6d\n", name, values[0] / 1000.0, values[(valid - 1) / 2] / 1000.0,
+            values[(valid * 95 - 1) / 100] / 1000.0, values[valid - 1] / 1000.0, valid);
+}
@@ -0,0 +1,32 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include "arunika.h"
+
+// Helpers shared by the host harnesses that drive the firmware against a
+// running server (bench_e2e, bench_fleet)
+
+#define BENCH_WAV_MAX_SAMPLES (SAMPLE_RATE * 30)
+
+// Demo devices bootstrapped by the development server
+#define BENCH_DEMO_CREDENTIALS { "ARUNIKA001:secret123", "ARUNIKA002:secret456", "ARUNIKA003:secret789" }
+
+uint64_t bench_now_us(void);
+
+// Host part of ws://host[:port][/path]
+int bench_url_host(const char *url, char *host, size_t size);
+
+// 8 kHz mono 16-bit PCM only, what the capture path produces. Returns the
+// sample count, or -1 with the reason printed
+long bench_load_wav(const char *path, int16_t *samples, size_t max_samples);
+
+// Stand-in utterance when no fixture is given; returns the sample count
+size_t bench_synthesize_utterance(int16_t *samples, size_t max_samples);
+
+// POST /api/v1/device/auth with "serial:secret"; copies the JWT into token
+int bench_fetch_token(const char *host, uint16_t port, const char *credential, char *token, size_t token_size);
+
+// One row of min/p50/p95/max in ms over the values >= 0; sorts values
+void bench_print_latency(FILE *out, const char *name, int32_t *values, int count);
+
+#endif // BENCH_COMMON_H
@@ -0,0 +1,398 @@
+#include "bench_common.h"
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// End-to-end benchmark against a running server. Each simulated device is
+// a forked process running the real firmware pipeline over a real socket:
+// PCM from a WAV fixture enters at the I2S RX callback, goes through VAD,
+// encoding and the binary uplink, and the response is parsed, decoded and
+// played out by the TX callback ticking at DMA pace.
+// Usage: bench_e2e [--url ws://host] [--port n] [--path /ws] [--devices n]
+//                  [--turns n] [--wav file] [--fast] [--timeout-ms n] [--batch-ms n]
+//                  [--token jwt | --device serial:secret ... | --no-auth] [--verbose]
+
+#define BENCH_MAX_TURNS 64
+#define BENCH_MAX_DEVICES 256
+#define BENCH_MAX_CREDENTIALS 16
+#define BENCH_TAIL_MS 1500  // Silence after the fixture, so VAD can close the turn
+#define BENCH_PAUSE_MS 500  // Between turns
+
+static const char *const default_credentials[] = BENCH_DEMO_CREDENTIALS;
+
+typedef struct {
+    char url[MAX_URL_LENGTH];
+    char host[MAX_HOST_LENGTH];
+    uint16_t port;
+    const char *path;
+    int devices;
+    int turns;
+    const char *wav;
+    bool fast;
+    bool verbose;
+    bool auth;
+    const char *token;
+    const char *credentials[BENCH_MAX_CREDENTIALS];
+    int credential_count;
+    uint32_t timeout_ms;
+    uint32_t batch_ms;      // Fixed uplink batch target, adaptive by default
+} bench_options_t;
+
+// One conversational turn as seen by a device; times in microseconds from
+// the end of the utterance (listening_end sent), -1 when it never happened
+typedef struct {
+    int32_t device;
+    int32_t turn;
+    int32_t ttfb_us;        // First response message handled
+    int32_t first_sound_us; // First response sample handed to the DMA
+    uint32_t utterance_us;  // Button press to listening_end
+    uint32_t response_us;   // listening_end to playback finished
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint32_t frames_sent;   // Binary audio frames
+    uint32_t flushes;       // Socket writes that carried them
+} bench_turn_t;
+
+static bench_options_t options;
+static int16_t wav_samples[BENCH_WAV_MAX_SAMPLES];
+static size_t wav_count = 0;
+static uint64_t rx_bytes = 0;
+
+// Counts and forwards every data message to the firmware's handler
+static int bench_sink(uint8_t opcode, const uint8_t *data, size_t len, bool first, bool last, void *ctx) {
+    rx_bytes += len;
+    return device_process_incoming_fragment(opcode, data, len, first, last, ctx);
+}
+
+// Waits up to timeout_us for the socket, then drains it. False once the
+// connection is gone
+static bool pump_socket(uint8_t *read_buffer, int64_t timeout_us) {
+    struct pollfd pfd = { websocket_get_fd(), POLLIN, 0 };
+    if (pfd.fd < 0) {
+        return false;
+    }
+    poll(&pfd, 1, timeout_us > 0 ? (int)((timeout_us + 999) / 1000) : 0);
+
+    int result;
+    while ((result = websocket_receive(read_buffer, WS_RX_FRAME_SIZE, bench_sink, NULL)) > 0) {
+    }
+    return result == 0 && websocket_is_connected();
+}
+
+static int run_turn(int device, int turn, uint8_t *read_buffer, bench_turn_t *out) {
+    const size_t frame_samples = audio_capture_frame_samples();
+    const uint64_t frame_us = (uint64_t)frame_samples * 1000000 / SAMPLE_RATE;
+    const uint64_t dma_us = (uint64_t)PLAYBACK_DMA_SAMPLES * 1000000 / SAMPLE_RATE;
+    const size_t total = wav_count + (size_t)SAMPLE_RATE * BENCH_TAIL_MS / 1000;
+    static int16_t frame[AUDIO_BUFFER_SIZE / 2];
+    static int16_t dma_block[PLAYBACK_DMA_SAMPLES];
+
+    memset(out, 0, sizeof(*out));
+    out->device = device;
+    out->turn = turn;
+    out->ttfb_us = -1;
+    out->first_sound_us = -1;
+    uint64_t tx_start = websocket_get_tx_bytes();
+    websocket_link_stats_t link_start;
+    websocket_get_link_stats(&link_start);
+    uint64_t rx_start = rx_bytes;
+
+    // The keepalive ping carries telemetry, so the hub sees load too
+    uint8_t report[TELEMETRY_REPORT_SIZE];
+    int report_len = telemetry_build_report(report, sizeof(report));
+    websocket_send_ping(report, report_len > 0 ? (size_t)report_len : 0);
+
+    uint64_t start = bench_now_us();
+    uint64_t next_frame = start;
+    uint64_t next_dma = start;
+    uint64_t end = 0;
+    size_t position = 0;
+    bool response_started = false;
+    device_handle_button_press();
+
+    for (;;) {
+        uint64_t now = bench_now_us();
+
+        // Capture at the microphone's pace, or flat out with --fast
+        if (!end && (options.fast || now >= next_frame)) {
+            if (audio_is_recording() && position < total) {
+                for (size_t i = 0; i < frame_samples; i++, position++) {
+                    frame[i] = position < wav_count ? wav_samples[position] : (int16_t)((int)(position * 7919 % 64) - 32);
+                }
+                audio_i2s_rx_callback((const uint8_t *)frame, frame_samples * sizeof(frame[0]));
+            } else if (audio_is_recording()) {
+                device_handle_button_press(); // Fixture over and VAD still open
+            }
+            if (device_process_uplink() != ARUNIKA_OK) {
+                return -1;
+            }
+            if (!audio_is_recording() && device_get_state() != DEVICE_STATE_RECORDING) {
+                end = bench_now_us();
+                out->utterance_us = (uint32_t)(end - start);
+            }
+            next_frame += frame_us;
+        }
+
+        if (now >= next_dma) {
+            size_t played = playback_i2s_tx_callback(dma_block, PLAYBACK_DMA_SAMPLES);
+            device_process_playback();
+            if (end && played > 0 && out->first_sound_us < 0) {
+                out->first_sound_us = (int32_t)(bench_now_us() - end);
+            }
+            next_dma += dma_us;
+        }
+
+        if (end && !response_started && device_get_state() == DEVICE_STATE_PLAYING) {
+            response_started = true;
+            out->ttfb_us = (int32_t)(bench_now_us() - end);
+        }
+        if (end && response_started && device_get_state() == DEVICE_STATE_IDLE) {
+            out->response_us = (uint32_t)(bench_now_us() - end);
+            break;
+        }
+        if (end && bench_now_us() - end > (uint64_t)options.timeout_ms * 1000) {
+            fprintf(stderr, "bench: device %d turn %d timed out waiting for the response\n", device, turn);
+            playback_stop();
+            device_set_state(DEVICE_STATE_IDLE);
+            out->response_us = (uint32_t)(bench_now_us() - end);
+            break;
+        }
+
+        uint64_t wake = next_dma;
+        if (!end && !options.fast && next_frame < wake) {
+            wake = next_frame;
+        }
+        now = bench_now_us();
+        if (!pump_socket(read_buffer, (!end && options.fast) ? 0 : (int64_t)(wake - now))) {
+            fprintf(stderr, "bench: device %d lost the connection\n", device);
+            return -1;
+        }
+    }
+
+    out->tx_bytes = (uint32_t)(websocket_get_tx_bytes() - tx_start);
+    out->rx_bytes = (uint32_t)(rx_bytes - rx_start);
+    websocket_link_stats_t link;
+    websocket_get_link_stats(&link);
+    out->frames_sent = link.frames_sent - link_start.frames_sent;
+    out->flushes = link.flushes - link_start.flushes;
+    return 0;
+}
+
+// Child process: one device, results written to the pipe
+static int run_device(int device, int result_fd) {
+    if (!options.verbose) {
+        if (!freopen("/dev/null", "w", stdout)) { // Firmware console output
+            return 1;
+        }
+    }
+
+    char token[WS_MAX_AUTH_TOKEN + 1] = "";
+    if (options.token) {
+        snprintf(token, sizeof(token), "%s", options.token);
+    } else if (options.auth) {
+        const char *credential = options.credentials[device % options.credential_count];
+        if (bench_fetch_token(options.host, options.port, credential, token, sizeof(token)) != 0) {
+            return 1;
+        }
+    }
+
+    static uint8_t read_buffer[WS_RX_FRAME_SIZE];
+    if (device_init() != ARUNIKA_OK || websocket_set_auth_token(token) != ARUNIKA_OK ||
+        websocket_set_uplink_batch_ms(options.batch_ms) != ARUNIKA_OK ||
+        websocket_connect(options.url, options.port, options.path) != ARUNIKA_OK) {
+        fprintf(stderr, "bench: device %d could not connect\n", device);
+        return 1;
+    }
+    device_set_state(DEVICE_STATE_IDLE);
+    websocket_send_hello(audio_get_format(), SAMPLE_RATE, NULL);
+    pump_socket(read_buffer, 200000); // Negotiated encoding
+
+    for (int turn = 0; turn < options.turns; turn++) {
+        bench_turn_t result;
+        if (run_turn(device, turn, read_buffer, &result) != 0) {
+            return 1;
+        }
+        if (write(result_fd, &result, sizeof(result)) != (ssize_t)sizeof(result)) {
+            return 1;
+        }
+
+        uint64_t pause_end = bench_now_us() + BENCH_PAUSE_MS * 1000;
+        while (bench_now_us() < pause_end && pump_socket(read_buffer, (int64_t)(pause_end - bench_now_us()))) {
+        }
+    }
+
+    websocket_disconnect();
+    return 0;
+}
+
+static int usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--url ws://host] [--port n] [--path /ws] [--devices n] [--turns n] [--wav file]\n"
+            "          [--fast] [--timeout-ms n] [--batch-ms n] [--token jwt | --device serial:secret ... |\n"
+            "          --no-auth]"
+            " [--verbose]\n",
+            argv0);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    snprintf(options.url, sizeof(options.url), "ws://127.0.0.1");
+    options.port = 8080;
+    options.path = "/ws";
+    options.devices = 1;
+    options.turns = 3;
+    options.auth = true;
+    options.timeout_ms = 30000;
+    options.batch_ms = WS_UPLINK_BATCH_ADAPTIVE;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--fast") == 0) {
+            options.fast = true;
+            continue;
+        } else if (strcmp(arg, "--verbose") == 0) {
+            options.verbose = true;
+            continue;
+        } else if (strcmp(arg, "--no-auth") == 0) {
+            options.auth = false;
+            continue;
+        } else if (!value) {
+            return usage(argv[0]);
+        } else if (strcmp(arg, "--url") == 0) {
+            snprintf(options.url, sizeof(options.url), "%s", value);
+        } else if (strcmp(arg, "--port") == 0) {
+            options.port = (uint16_t)atoi(value);
+        } else if (strcmp(arg, "--path") == 0) {
+            options.path = value;
+        } else if (strcmp(arg, "--devices") == 0) {
+            options.devices = atoi(value);
+        } else if (strcmp(arg, "--turns") == 0) {
+            options.turns = atoi(value);
+        } else if (strcmp(arg, "--wav") == 0) {
+            options.wav = value[0] ? value : NULL;
+        } else if (strcmp(arg, "--timeout-ms") == 0) {
+            options.timeout_ms = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--batch-ms") == 0) {
+            options.batch_ms = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--token") == 0) {
+            options.token = value;
+        } else if (strcmp(arg, "--device") == 0 && options.credential_count < BENCH_MAX_CREDENTIALS) {
+            options.credentials[options.credential_count++] = value;
+        } else {
+            return usage(argv[0]);
+        }
+        i++;
+    }
+    if (options.devices < 1 || options.devices > BENCH_MAX_DEVICES || options.turns < 1 ||
+        options.turns > BENCH_MAX_TURNS) {
+        fprintf(stderr, "bench: 1-%d devices and 1-%d turns\n", BENCH_MAX_DEVICES, BENCH_MAX_TURNS);
+        return 2;
+    }
+    if (options.batch_ms != WS_UPLINK_BATCH_ADAPTIVE && options.batch_ms > WS_UPLINK_BATCH_MAX_MS) {
+        fprintf(stderr, "bench: --batch-ms is 0-%d\n", WS_UPLINK_BATCH_MAX_MS);
+        return 2;
+    }
+    if (options.credential_count == 0) {
+        for (size_t i = 0; i < sizeof(default_credentials) / sizeof(default_credentials[0]); i++) {
+            options.credentials[options.credential_count++] = default_credentials[i];
+        }
+    }
+
+    // The auth request goes to the same host
+    if (bench_url_host(options.url, options.host, sizeof(options.host)) != 0) {
+        return usage(argv[0]);
+    }
+
+    if (!options.wav) {
+        wav_count = bench_synthesize_utterance(wav_samples, BENCH_WAV_MAX_SAMPLES);
+    } else {
+        long count = bench_load_wav(options.wav, wav_samples, BENCH_WAV_MAX_SAMPLES);
+        if (count < 0) {
+            return 1;
+        }
+        wav_count = (size_t)count;
+    }
+    if (options.auth && !options.token && options.devices > options.credential_count) {
+        fprintf(stderr, "bench: %d devices share %d credentials; the hub keys clients by device ID\n",
+                options.devices, options.credential_count);
+    }
+
+    printf("End-to-end: %s:%u%s, %d device(s) x %d turn(s), %.1f s utterance (%s)%s\n", options.url,
+           (unsigned)options.port, options.path, options.devices, options.turns, (double)wav_count / SAMPLE_RATE,
+           options.wav ? options.wav : "synthetic", options.fast ? ", fast uplink" : "");
+    fflush(stdout);
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    uint64_t start = bench_now_us();
+    for (int d = 0; d < options.devices; d++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            _exit(run_device(d, fds[1]));
+        }
+        if (pid < 0) {
+            fprintf(stderr, "bench: fork failed\n");
+            options.devices = d;
+            break;
+        }
+    }
+    close(fds[1]);
+
+    static bench_turn_t turns[BENCH_MAX_DEVICES * BENCH_MAX_TURNS];
+    int count = 0;
+    ssize_t n;
+    while (count < BENCH_MAX_DEVICES * BENCH_MAX_TURNS &&
+           (n = read(fds[0], &turns[count], sizeof(turns[0]))) == (ssize_t)sizeof(turns[0])) {
+        count++;
+    }
+    close(fds[0]);
+
+    int failed = 0;
+    int status;
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed++;
+        }
+    }
+    double elapsed = (bench_now_us() - start) / 1e6;
+
+    static int32_t ttfb[BENCH_MAX_DEVICES * BENCH_MAX_TURNS];
+    static int32_t first_sound[BENCH_MAX_DEVICES * BENCH_MAX_TURNS];
+    uint64_t tx_total = 0;
+    uint64_t rx_total = 0;
+    uint64_t uplink_us = 0;
+    uint64_t response_us = 0;
+    uint64_t frames_sent = 0;
+    uint64_t flushes = 0;
+    int responded = 0;
+    for (int i = 0; i < count; i++) {
+        ttfb[i] = turns[i].ttfb_us;
+        first_sound[i] = turns[i].first_sound_us;
+        tx_total += turns[i].tx_bytes;
+        rx_total += turns[i].rx_bytes;
+        uplink_us += turns[i].utterance_us;
+        response_us += turns[i].response_us;
+        frames_sent += turns[i].frames_sent;
+        flushes += turns[i].flushes;
+        responded += turns[i].ttfb_us >= 0;
+    }
+
+    printf("\n%d/%d turns answered, %d device(s) failed, %.1f s wall\n", responded, count, failed, elapsed);
+    printf("%-22s %8s %8s %8s %8s %6s\n", "latency (ms)", "min", "p50", "p95", "max", "turns");
+    bench_print_latency(stdout, "first response byte", ttfb, count);
+    bench_print_latency(stdout, "first sound", first_sound, count);
+    printf("%-22s %8.1f kB/s per device, %.1f kB/s total\n", "uplink",
+           uplink_us ? tx_total * 1000.0 / uplink_us : 0.0, elapsed > 0 ? tx_total / 1000.0 / elapsed : 0.0);
+    printf("%-22s %8.2f audio frames per write (%llu frames)\n", "uplink batching",
+           flushes ? (double)frames_sent / flushes : 0.0, (unsigned long long)frames_sent);
+    printf("%-22s %8.1f kB/s per device, %.1f kB/s total\n", "downlink",
+           response_us ? rx_total * 1000.0 / response_us : 0.0, elapsed > 0 ? rx_total / 1000.0 / elapsed : 0.0);
+
+    return failed == 0 && responded == count && count == options.devices * options.turns ? 0 : 1;
+}
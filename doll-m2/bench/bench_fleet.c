@@ -0,0 +1,655 @@
+#include "bench_common.h"
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Fleet simulator: hundreds of dolls in one process against a running
+// server, for load tests of the hub. Every doll runs the firmware's own
+// application code (app.c) with its own config, state machine and
+// WebSocket connection. Firmware state is static, so the Makefile links
+// the firmware objects with all their writable data gathered into one
+// section, arunika_state. Each doll owns a copy of that section, which is
+// swapped in before any of its code runs. One epoll loop waits for the
+// whole fleet: socket data, each doll's event timers and its capture and
+// playback DMA cadence.
+// Usage: bench_fleet [--url ws://host] [--port n] [--devices n] [--ramp-ms n] [--duration-s n]
+//                    [--think-s n] [--storm-s n] [--drops-per-hour n] [--timeout-ms n]
+//                    [--serial-prefix SIM] [--wav file] [--no-auth] [--verbose]
+
+#define FLEET_MAX_DEVICES 4096
+#define FLEET_MAX_SAMPLES 65536 // Latency samples kept per metric, the latest win
+#define FLEET_MAX_EVENTS 256
+#define FLEET_STEP_ROUNDS 8     // Dispatch passes per wakeup before yielding
+#define FLEET_TAIL_MS 1500      // Silence after the utterance, so VAD can close the turn
+#define FLEET_RETRY_TALK_MS 1000 // A doll that cannot talk yet tries again after this
+#define FLEET_REPORT_MS 5000
+
+// Writable data of every firmware object, gathered by the Makefile
+extern uint8_t __start_arunika_state[];
+extern uint8_t __stop_arunika_state[];
+
+typedef struct {
+    char url[MAX_URL_LENGTH];
+    char host[MAX_HOST_LENGTH];
+    uint16_t port;
+    int devices;
+    uint32_t ramp_ms;
+    uint32_t duration_s;
+    uint32_t think_s;
+    uint32_t storm_s;
+    uint32_t drops_per_hour;
+    uint32_t timeout_ms;
+    const char *serial_prefix;
+    const char *wav;
+    bool auth;
+    bool verbose;
+} fleet_options_t;
+
+typedef struct {
+    char serial[MAX_DEVICE_ID_LENGTH];
+    uint8_t *state;       // This doll's copy of arunika_state
+    bool booted;
+    bool failed;          // Could not authenticate, never boots
+    uint64_t wake_us;     // Earliest time the doll has work
+    uint64_t boot_us;
+
+    // Socket registration: the fd this doll has in the epoll set
+    int fd;
+    uint32_t attempts;    // Connect attempts seen; a new socket may reuse the number
+    uint32_t ready;       // Socket events not handed to the firmware yet
+
+    // DMA cadence while recording or playing
+    bool recording;
+    bool playing;
+    uint64_t next_capture_us;
+    uint64_t next_dma_us;
+
+    // Current turn: button press, utterance, response
+    bool talking;
+    bool recorded;
+    bool response_started;
+    bool first_sound;
+    size_t position;
+    uint64_t turn_end_us; // listening_end sent, 0 before
+    uint64_t next_talk_us;
+
+    // Connection churn
+    bool connected;
+    bool drop_pending;
+    uint64_t lost_us;
+    uint64_t next_drop_us;
+} fleet_doll_t;
+
+typedef struct {
+    int32_t values[FLEET_MAX_SAMPLES];
+    uint64_t total;
+} fleet_samples_t;
+
+static fleet_options_t options;
+static fleet_doll_t *dolls;
+static fleet_doll_t *resident = NULL;
+static fleet_doll_t **fd_owner;
+static size_t fd_owner_size;
+static size_t state_size;
+static int epoll_fd = -1;
+static FILE *report;
+
+static int16_t utterance[BENCH_WAV_MAX_SAMPLES];
+static size_t utterance_count = 0;
+static uint64_t rng_state = 0;
+
+static struct {
+    uint32_t booted;
+    uint32_t auth_failures;
+    uint32_t connected;
+    uint32_t connects;
+    uint32_t drops;
+    uint32_t turns;
+    uint32_t answered;
+    uint32_t timeouts;
+    uint64_t steps;
+    uint64_t swaps;
+    uint32_t interval_lag_us;
+    fleet_samples_t ttfb;
+    fleet_samples_t first_sound;
+    fleet_samples_t reconnect;
+    fleet_samples_t lag;
+} stats;
+
+static void fleet_sample(fleet_samples_t *samples, uint64_t value_us) {
+    samples->values[samples->total % FLEET_MAX_SAMPLES] = value_us > INT32_MAX ? INT32_MAX : (int32_t)value_us;
+    samples->total++;
+}
+
+static void fleet_print_samples(const char *name, fleet_samples_t *samples) {
+    int count = samples->total < FLEET_MAX_SAMPLES ? (int)samples->total : FLEET_MAX_SAMPLES;
+    bench_print_latency(report, name, samples->values, count);
+}
+
+// xorshift64*, for think times and drops; [0, 1)
+static double fleet_random(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 2685821657736338717ull) >> 11) / 9007199254740992.0;
+}
+
+static uint64_t fleet_exponential_us(double mean_s) {
+    return (uint64_t)(-log(1.0 - fleet_random()) * mean_s * 1e6);
+}
+
+// Makes doll the one the firmware code sees. Pointers inside the state
+// stay valid because every copy runs at the same address
+static void fleet_switch(fleet_doll_t *doll) {
+    if (resident == doll) {
+        return;
+    }
+    if (resident) {
+        memcpy(resident->state, __start_arunika_state, state_size);
+    }
+    memcpy(__start_arunika_state, doll->state, state_size);
+    resident = doll;
+    stats.swaps++;
+}
+
+// Keeps the epoll set in line with the fd the firmware wants watched. A
+// closed fd leaves the set by itself and its number can come back for
+// another doll, or for this one on its next connect
+static void fleet_watch(fleet_doll_t *doll, int fd, bool reopened) {
+    if (fd == doll->fd && !reopened) {
+        return;
+    }
+
+    if (doll->fd >= 0 && fd_owner[doll->fd] == doll) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, doll->fd, NULL); // Fails when already closed
+        fd_owner[doll->fd] = NULL;
+    }
+    doll->fd = -1;
+    if (fd < 0 || (size_t)fd >= fd_owner_size) {
+        return;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = doll;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0 &&
+        (errno != EEXIST || epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) != 0)) {
+        return;
+    }
+    fd_owner[fd] = doll;
+    doll->fd = fd;
+}
+
+// Provisions the doll's flash like the factory would, then runs the
+// firmware's own startup
+static void fleet_boot(fleet_doll_t *doll, uint64_t now) {
+    doll->booted = true;
+
+    char token[WS_MAX_AUTH_TOKEN + 1] = "";
+    if (options.auth) {
+        char credential[2 * MAX_DEVICE_ID_LENGTH + 16];
+        snprintf(credential, sizeof(credential), "%s:%s-secret", doll->serial, doll->serial);
+        if (bench_fetch_token(options.host, options.port, credential, token, sizeof(token)) != 0) {
+            doll->failed = true;
+            stats.auth_failures++;
+            return;
+        }
+    }
+
+    device_config_t config;
+    config_load(&config);
+    snprintf(config.device_id, sizeof(config.device_id), "%s", doll->serial);
+    snprintf(config.server_url, sizeof(config.server_url), "%s", options.url);
+    config.server_port = options.port;
+    config_save(&config);
+
+    websocket_set_auth_token(token);
+    if (device_init() != ARUNIKA_OK || app_init() != ARUNIKA_OK) {
+        doll->failed = true;
+        return;
+    }
+    app_start();
+
+    stats.booted++;
+    doll->next_talk_us = now + fleet_exponential_us(options.think_s);
+    if (options.drops_per_hour > 0) {
+        doll->next_drop_us = now + fleet_exponential_us(3600.0 / options.drops_per_hour);
+    }
+}
+
+// Capture and playback at the I2S cadence; the callbacks post the same
+// events as the DMA interrupts on the device
+static void fleet_run_dma(fleet_doll_t *doll, uint64_t now) {
+    static int16_t frame[AUDIO_BUFFER_SIZE / 2];
+    static int16_t dma_block[PLAYBACK_DMA_SAMPLES];
+    const size_t frame_samples = audio_capture_frame_samples();
+    const uint64_t frame_us = (uint64_t)frame_samples * 1000000 / SAMPLE_RATE;
+    const uint64_t dma_us = (uint64_t)PLAYBACK_DMA_SAMPLES * 1000000 / SAMPLE_RATE;
+    const size_t total = utterance_count + (size_t)SAMPLE_RATE * FLEET_TAIL_MS / 1000;
+
+    // The microphone also stays open during a response for barge-in; only
+    // the doll's own turn hears the utterance, otherwise the room is quiet
+    if (doll->recording) {
+        bool speaking = doll->talking && !doll->turn_end_us && device_get_state() == DEVICE_STATE_RECORDING;
+        while (now >= doll->next_capture_us && audio_is_recording()) {
+            uint64_t lag = now - doll->next_capture_us;
+            fleet_sample(&stats.lag, lag);
+            if (lag > stats.interval_lag_us) {
+                stats.interval_lag_us = (uint32_t)lag;
+            }
+
+            if (speaking && doll->position >= total) {
+                events_post(EVENT_BUTTON); // Utterance over and VAD still open
+                break;
+            }
+            for (size_t i = 0; i < frame_samples; i++, doll->position++) {
+                size_t p = doll->position;
+                frame[i] = speaking && p < utterance_count ? utterance[p] : (int16_t)((int)(p * 7919 % 64) - 32);
+            }
+            audio_i2s_rx_callback((const uint8_t *)frame, frame_samples * sizeof(frame[0]));
+            doll->next_capture_us += frame_us;
+        }
+    }
+
+    if (doll->playing) {
+        while (now >= doll->next_dma_us) {
+            size_t played = playback_i2s_tx_callback(dma_block, PLAYBACK_DMA_SAMPLES);
+            if (played > 0 && doll->turn_end_us && !doll->first_sound) {
+                doll->first_sound = true;
+                fleet_sample(&stats.first_sound, bench_now_us() - doll->turn_end_us);
+            }
+            doll->next_dma_us += dma_us;
+        }
+    }
+}
+
+static void fleet_finish_turn(fleet_doll_t *doll, uint64_t now) {
+    doll->talking = false;
+    doll->next_talk_us = now + fleet_exponential_us(options.think_s);
+}
+
+// Follows the turn and the link from the outside, as a user would
+static void fleet_observe(fleet_doll_t *doll, uint64_t now) {
+    device_state_t state = device_get_state();
+    bool recording = audio_is_recording();
+
+    if (recording && !doll->recording) {
+        doll->next_capture_us = now + (uint64_t)audio_capture_frame_samples() * 1000000 / SAMPLE_RATE;
+    }
+    doll->recording = recording;
+    playback_state_t playback = playback_get_state();
+    bool playing = playback == PLAYBACK_STATE_PLAYING || playback == PLAYBACK_STATE_DRAINING;
+    if (playing && !doll->playing) {
+        doll->next_dma_us = now;
+    }
+    doll->playing = playing;
+
+    if (doll->talking) {
+        if (recording) {
+            doll->recorded = true;
+        } else if (!doll->recorded) {
+            fleet_finish_turn(doll, now); // The press did not start a recording
+            stats.turns--;
+        } else if (!doll->turn_end_us && state != DEVICE_STATE_RECORDING) {
+            doll->turn_end_us = now;
+        }
+    }
+
+    if (doll->talking && doll->turn_end_us) {
+        if (!doll->response_started && state == DEVICE_STATE_PLAYING) {
+            doll->response_started = true;
+            fleet_sample(&stats.ttfb, now - doll->turn_end_us);
+        }
+        if (doll->response_started && state == DEVICE_STATE_IDLE) {
+            stats.answered++;
+            fleet_finish_turn(doll, now);
+        } else if (now - doll->turn_end_us > (uint64_t)options.timeout_ms * 1000) {
+            // The firmware has no response timeout of its own yet
+            stats.timeouts++;
+            playback_stop();
+            device_set_state(DEVICE_STATE_IDLE);
+            fleet_finish_turn(doll, now);
+        }
+    }
+
+    bool connected = websocket_is_connected();
+    if (connected != doll->connected) {
+        if (connected) {
+            stats.connects++;
+            stats.connected++;
+            if (doll->lost_us) {
+                fleet_sample(&stats.reconnect, now - doll->lost_us);
+            }
+        } else {
+            stats.drops++;
+            stats.connected--;
+            doll->lost_us = now;
+        }
+        doll->connected = connected;
+    }
+}
+
+static uint64_t fleet_next_wake(fleet_doll_t *doll, uint64_t now) {
+    uint32_t timer_ms = events_next_timer_ms();
+    uint64_t wake = timer_ms == EVENT_WAIT_FOREVER ? UINT64_MAX : now + (uint64_t)timer_ms * 1000;
+
+    if (doll->recording && doll->next_capture_us < wake) {
+        wake = doll->next_capture_us;
+    }
+    if (doll->playing && doll->next_dma_us < wake) {
+        wake = doll->next_dma_us;
+    }
+    if (doll->talking && doll->turn_end_us && doll->turn_end_us + (uint64_t)options.timeout_ms * 1000 < wake) {
+        wake = doll->turn_end_us + (uint64_t)options.timeout_ms * 1000;
+    }
+    if (!doll->talking) {
+        if (doll->next_talk_us <= now) {
+            doll->next_talk_us = now + FLEET_RETRY_TALK_MS * 1000; // Not idle or not connected
+        }
+        if (doll->next_talk_us < wake) {
+            wake = doll->next_talk_us;
+        }
+    }
+    if (options.drops_per_hour > 0 && doll->next_drop_us < wake) {
+        wake = doll->next_drop_us;
+    }
+    return wake;
+}
+
+// One wakeup of one doll: what main.c's loop does between two waits
+static void fleet_step(fleet_doll_t *doll, uint64_t now) {
+    fleet_switch(doll);
+    stats.steps++;
+    if (!doll->booted) {
+        fleet_boot(doll, now);
+        if (doll->failed) {
+            doll->wake_us = UINT64_MAX;
+            return;
+        }
+    }
+
+    // Pull the link out from under the firmware, like a server restart
+    if (doll->drop_pending || (options.drops_per_hour > 0 && now >= doll->next_drop_us)) {
+        if (websocket_is_connected()) {
+            shutdown(websocket_get_fd(), SHUT_RDWR);
+        }
+        doll->drop_pending = false;
+        if (options.drops_per_hour > 0) {
+            doll->next_drop_us = now + fleet_exponential_us(3600.0 / options.drops_per_hour);
+        }
+    }
+
+    if (!doll->talking && now >= doll->next_talk_us && device_get_state() == DEVICE_STATE_IDLE &&
+        websocket_is_connected()) {
+        doll->talking = true;
+        doll->recorded = false;
+        doll->response_started = false;
+        doll->first_sound = false;
+        doll->position = 0;
+        doll->turn_end_us = 0;
+        stats.turns++;
+        events_post(EVENT_BUTTON);
+    }
+
+    fleet_run_dma(doll, now);
+
+    uint32_t events = doll->ready | events_wait(0);
+    doll->ready = 0;
+    for (int round = 0; round < FLEET_STEP_ROUNDS; round++) {
+        if (events) {
+            app_handle_events(events);
+        }
+        app_update_sources();
+        events = events_wait(0);
+        if (!events) {
+            break;
+        }
+    }
+
+    now = bench_now_us();
+    fleet_observe(doll, now);
+
+    websocket_conn_stats_t conn;
+    websocket_get_conn_stats(&conn);
+    fleet_watch(doll, events_get_watched_fd(), conn.attempts != doll->attempts);
+    doll->attempts = conn.attempts;
+
+    doll->wake_us = fleet_next_wake(doll, now);
+    if (events) {
+        events_post(events); // Still busy; picked up on the next pass
+        doll->wake_us = now;
+    }
+}
+
+static void fleet_print_status(uint64_t elapsed_us) {
+    fprintf(report, "%6.1f s  booted %4u  connected %4u  turns %5u  answered %5u  timeouts %3u  drops %4u  max lag %5.1f ms\n",
+            elapsed_us / 1e6, (unsigned)stats.booted, (unsigned)stats.connected, (unsigned)stats.turns,
+            (unsigned)stats.answered, (unsigned)stats.timeouts, (unsigned)stats.drops, stats.interval_lag_us / 1000.0);
+    fflush(report);
+    stats.interval_lag_us = 0;
+}
+
+static int usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--url ws://host] [--port n] [--devices n] [--ramp-ms n] [--duration-s n]\n"
+            "          [--think-s n] [--storm-s n] [--drops-per-hour n] [--timeout-ms n]\n"
+            "          [--serial-prefix SIM] [--wav file] [--no-auth] [--verbose]\n",
+            argv0);
+    return 2;
+}
+
+static int fleet_parse_options(int argc, char **argv) {
+    snprintf(options.url, sizeof(options.url), "ws://127.0.0.1");
+    options.port = 8080;
+    options.devices = 100;
+    options.ramp_ms = 20;
+    options.duration_s = 60;
+    options.think_s = 20;
+    options.timeout_ms = 30000;
+    options.serial_prefix = "SIM";
+    options.auth = true;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--no-auth") == 0) {
+            options.auth = false;
+            continue;
+        } else if (strcmp(arg, "--verbose") == 0) {
+            options.verbose = true;
+            continue;
+        } else if (!value) {
+            return usage(argv[0]);
+        } else if (strcmp(arg, "--url") == 0) {
+            snprintf(options.url, sizeof(options.url), "%s", value);
+        } else if (strcmp(arg, "--port") == 0) {
+            options.port = (uint16_t)atoi(value);
+        } else if (strcmp(arg, "--devices") == 0) {
+            options.devices = atoi(value);
+        } else if (strcmp(arg, "--ramp-ms") == 0) {
+            options.ramp_ms = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--duration-s") == 0) {
+            options.duration_s = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--think-s") == 0) {
+            options.think_s = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--storm-s") == 0) {
+            options.storm_s = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--drops-per-hour") == 0) {
+            options.drops_per_hour = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--timeout-ms") == 0) {
+            options.timeout_ms = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--serial-prefix") == 0) {
+            options.serial_prefix = value;
+        } else if (strcmp(arg, "--wav") == 0) {
+            options.wav = value[0] ? value : NULL;
+        } else {
+            return usage(argv[0]);
+        }
+        i++;
+    }
+
+    if (options.devices < 1 || options.devices > FLEET_MAX_DEVICES || options.duration_s == 0) {
+        fprintf(stderr, "bench: 1-%d devices and a duration of at least 1 s\n", FLEET_MAX_DEVICES);
+        return 2;
+    }
+    if (bench_url_host(options.url, options.host, sizeof(options.host)) != 0) {
+        return usage(argv[0]);
+    }
+    return 0;
+}
+
+// One socket per doll; the event loop itself needs a handful more
+static int fleet_raise_fd_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return -1;
+    }
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < (rlim_t)options.devices + 64) {
+        fprintf(stderr, "bench: %d devices need %d descriptors, the limit is %lu\n", options.devices,
+                options.devices + 64, (unsigned long)limit.rlim_cur);
+        return -1;
+    }
+    fd_owner_size = limit.rlim_cur > (rlim_t)FLEET_MAX_DEVICES * 4 ? (size_t)FLEET_MAX_DEVICES * 4 : (size_t)limit.rlim_cur;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int result = fleet_parse_options(argc, argv);
+    if (result != 0) {
+        return result;
+    }
+    if (fleet_raise_fd_limit() != 0) {
+        return 1;
+    }
+
+    if (!options.wav) {
+        utterance_count = bench_synthesize_utterance(utterance, BENCH_WAV_MAX_SAMPLES);
+    } else {
+        long count = bench_load_wav(options.wav, utterance, BENCH_WAV_MAX_SAMPLES);
+        if (count < 0) {
+            return 1;
+        }
+        utterance_count = (size_t)count;
+    }
+
+    // The firmware console goes to stdout; the report keeps its own copy
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report || (!options.verbose && !freopen("/dev/null", "w", stdout))) {
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // Every doll starts from the image the firmware had before it ran
+    state_size = (size_t)(__stop_arunika_state - __start_arunika_state);
+    dolls = calloc((size_t)options.devices, sizeof(*dolls));
+    fd_owner = calloc(fd_owner_size, sizeof(*fd_owner));
+    epoll_fd = epoll_create1(0);
+    if (!dolls || !fd_owner || epoll_fd < 0) {
+        fprintf(stderr, "bench: out of memory\n");
+        return 1;
+    }
+
+    uint64_t start = bench_now_us();
+    rng_state = start | 1;
+    for (int i = 0; i < options.devices; i++) {
+        fleet_doll_t *doll = &dolls[i];
+        doll->state = malloc(state_size);
+        if (!doll->state) {
+            fprintf(stderr, "bench: out of memory for %d dolls\n", options.devices);
+            return 1;
+        }
+        memcpy(doll->state, __start_arunika_state, state_size);
+        snprintf(doll->serial, sizeof(doll->serial), "%s%05d", options.serial_prefix, i + 1);
+        doll->fd = -1;
+        doll->boot_us = start + (uint64_t)i * options.ramp_ms * 1000;
+        doll->wake_us = doll->boot_us;
+    }
+
+    fprintf(report, "Fleet: %d dolls against %s:%u, %u s, one boot every %u ms, %.1f KB of firmware state each\n",
+            options.devices, options.url, (unsigned)options.port, (unsigned)options.duration_s,
+            (unsigned)options.ramp_ms, state_size / 1024.0);
+    fflush(report);
+
+    uint64_t end = start + (uint64_t)options.duration_s * 1000000;
+    uint64_t storm = options.storm_s > 0 ? start + (uint64_t)options.storm_s * 1000000 : UINT64_MAX;
+    uint64_t next_report = start + FLEET_REPORT_MS * 1000;
+    static struct epoll_event ready[FLEET_MAX_EVENTS];
+
+    for (;;) {
+        uint64_t now = bench_now_us();
+        if (now >= end) {
+            break;
+        }
+        if (now >= storm) {
+            fprintf(report, "%6.1f s  storm: dropping every connection\n", (now - start) / 1e6);
+            for (int i = 0; i < options.devices; i++) {
+                dolls[i].drop_pending = dolls[i].booted && !dolls[i].failed;
+                if (dolls[i].drop_pending) {
+                    dolls[i].wake_us = now;
+                }
+            }
+            storm = UINT64_MAX;
+        }
+        if (now >= next_report) {
+            fleet_print_status(now - start);
+            next_report += FLEET_REPORT_MS * 1000;
+        }
+
+        uint64_t wake = end < next_report ? end : next_report;
+        if (storm < wake) {
+            wake = storm;
+        }
+        for (int i = 0; i < options.devices; i++) {
+            if (dolls[i].wake_us < wake) {
+                wake = dolls[i].wake_us;
+            }
+        }
+
+        int timeout = wake > now ? (int)((wake - now + 999) / 1000) : 0;
+        int count = epoll_wait(epoll_fd, ready, FLEET_MAX_EVENTS, timeout);
+        for (int i = 0; i < count; i++) {
+            ((fleet_doll_t *)ready[i].data.ptr)->ready |= EVENT_SOCKET_READABLE;
+        }
+
+        for (int i = 0; i < options.devices; i++) {
+            fleet_doll_t *doll = &dolls[i];
+            now = bench_now_us();
+            if (doll->ready || doll->wake_us <= now) {
+                fleet_step(doll, now);
+            }
+        }
+    }
+
+    // Close cleanly so the hub sees ordinary disconnects
+    for (int i = 0; i < options.devices; i++) {
+        if (dolls[i].booted && !dolls[i].failed) {
+            fleet_switch(&dolls[i]);
+            websocket_disconnect();
+        }
+    }
+
+    double elapsed = (bench_now_us() - start) / 1e6;
+    fprintf(report, "\n%u/%d dolls booted (%u auth failures), %u connected at the end, %.1f s wall\n",
+            (unsigned)stats.booted, options.devices, (unsigned)stats.auth_failures, (unsigned)stats.connected,
+            elapsed);
+    fprintf(report, "%u connects, %u drops; %u turns, %u answered, %u timed out\n", (unsigned)stats.connects,
+            (unsigned)stats.drops, (unsigned)stats.turns, (unsigned)stats.answered, (unsigned)stats.timeouts);
+    fprintf(report, "%-22s %8s %8s %8s %8s %6s\n", "latency (ms)", "min", "p50", "p95", "max", "count");
+    fleet_print_samples("first response byte", &stats.ttfb);
+    fleet_print_samples("first sound", &stats.first_sound);
+    fleet_print_samples("reconnect", &stats.reconnect);
+    fleet_print_samples("capture lag", &stats.lag);
+    fprintf(report, "%llu doll steps, %llu state swaps\n", (unsigned long long)stats.steps,
+            (unsigned long long)stats.swaps);
+    fflush(report);
+
+    return stats.booted == (uint32_t)options.devices && stats.timeouts == 0 ? 0 : 1;
+}
@@ -6,24 +6,138 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+// Ring, jitter and pre-roll depths, DMA layout and optional paths per board
+#include "board.h"
+
+// Firmware release, reported in telemetry so the fleet can be split by rollout
+#define FIRMWARE_VERSION_MAJOR 0
+#define FIRMWARE_VERSION_MINOR 2
+#define FIRMWARE_VERSION_PATCH 0
 
 // Audio configuration
-#define SAMPLE_RATE 8000
+#define SAMPLE_RATE 8000        // I2S rate; the wire rate is negotiated per session
 #define BITS_PER_SAMPLE 16
 #define CHANNELS 1
 #define AUDIO_BUFFER_SIZE 1024
+#define AUDIO_CHUNK_SAMPLES 512 // Samples per captured frame (64 ms at 8 kHz)
+#define AUDIO_CHUNK_SIZE 512   // Bytes per frame on the wire (64 ms of G.711)
+
+// Playback jitter buffer
+#define PLAYBACK_DMA_SAMPLES I2S_DMA_FRAME_NUM // Samples per I2S TX DMA block (32 ms)
+#define PLAYBACK_PREBUFFER_MS_DEFAULT 96 // Buffered audio before the first sound
+#define PLAYBACK_PREBUFFER_MAX_MS 480    // Ceiling for the adaptive prebuffer
+#define PLAYBACK_PREBUFFER_STEP_MS 32    // Prebuffer growth per underrun
 
 // Network configuration
 #define MAX_SSID_LENGTH 32
 #define MAX_PASSWORD_LENGTH 64
 #define MAX_URL_LENGTH 256
 #define MAX_DEVICE_ID_LENGTH 32
+#define MAX_HOST_LENGTH 64
+
+// Connection reuse across reconnects and deep sleep
+#define NET_DNS_CACHE_ENTRIES 2
+#define NET_DNS_TTL_MS_DEFAULT 300000       // Resolved addresses are reused for 5 min
+#define TLS_SESSION_TICKET_MAX 512
+#define TLS_SESSION_LIFETIME_S_DEFAULT 7200 // Used when the server sends no lifetime hint
+#define WS_BACKOFF_BASE_MS 500              // Ceiling of the first retry delay
+#define WS_BACKOFF_MAX_MS 30000
+
+// Survives deep sleep in RTC slow memory on ESP32
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#define ARUNIKA_RTC_DATA RTC_DATA_ATTR
+#else
+#define ARUNIKA_RTC_DATA
+#endif
+
+// Console logging. Calls above ARUNIKA_LOG_LEVEL compile to nothing, so
+// per-frame messages cost no UART time in builds that leave them out
+#define ARUNIKA_LOG_LEVEL_NONE 0
+#define ARUNIKA_LOG_LEVEL_ERROR 1
+#define ARUNIKA_LOG_LEVEL_WARN 2
+#define ARUNIKA_LOG_LEVEL_INFO 3
+#define ARUNIKA_LOG_LEVEL_DEBUG 4
+#ifndef ARUNIKA_LOG_LEVEL
+#define ARUNIKA_LOG_LEVEL ARUNIKA_LOG_LEVEL_INFO
+#endif
+
+#define ARUNIKA_LOG(level, ...) do { if (ARUNIKA_LOG_LEVEL >= (level)) printf(__VA_ARGS__); } while (0)
+#define LOG_ERROR(...) ARUNIKA_LOG(ARUNIKA_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) ARUNIKA_LOG(ARUNIKA_LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) ARUNIKA_LOG(ARUNIKA_LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) ARUNIKA_LOG(ARUNIKA_LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+// Latency tracing (make TRACE=1). Hooks take raw cycle counter ticks and
+// compile to nothing otherwise; durations land in fixed histograms
+#ifdef ARUNIKA_TRACE
+#define TRACE_BEGIN(var) uint32_t var = trace_now()
+#define TRACE_END(stage, var) trace_record((stage), trace_now() - (var))
+#define TRACE_STAMP(lvalue) ((lvalue) = trace_now())
+#define TRACE_CALL(call) (call)
+#else
+#define TRACE_BEGIN(var) do { } while (0)
+#define TRACE_END(stage, var) do { } while (0)
+#define TRACE_STAMP(lvalue) do { } while (0)
+#define TRACE_CALL(call) do { } while (0)
+#endif
 
 // WebSocket message types
 #define MSG_TYPE_AUDIO_CHUNK "audio_chunk"
 #define MSG_TYPE_PING "ping"
 #define MSG_TYPE_PONG "pong"
 #define MSG_TYPE_AI_RESPONSE "ai_response"
+#define MSG_TYPE_LISTENING_START "listening_start"
+#define MSG_TYPE_LISTENING_END "listening_end"
+#define MSG_TYPE_DEVICE_HELLO "device_hello"
+#define MSG_TYPE_SPEAKING_START "speaking_start"
+#define MSG_TYPE_SPEAKING_END "speaking_end"
+#define MSG_TYPE_AUDIO_RESPONSE_ENDED "audio_response_ended"
+#define MSG_TYPE_RESPONSE_TEXT "response_text"
+#define MSG_TYPE_EMOTION "emotion"
+#define MSG_TYPE_RESPONSE_CANCEL "response_cancel"
+#define MSG_TYPE_AUDIO_CACHED "audio_cached"
+#define MSG_TYPE_AUDIO_CACHE_MISS "audio_cache_miss"
+
+// WebSocket framing (RFC 6455)
+#define WS_OPCODE_CONTINUATION 0x0
+#define WS_OPCODE_TEXT 0x1
+#define WS_OPCODE_BINARY 0x2
+#define WS_OPCODE_CLOSE 0x8
+#define WS_OPCODE_PING 0x9
+#define WS_OPCODE_PONG 0xA
+#define WS_MAX_HEADER_SIZE 14      // 2 + 8 byte length + 4 byte mask
+#define WS_MAX_TEXT_MESSAGE 2048
+#define WS_MAX_CONTROL_PAYLOAD 125 // RFC 6455: control frames are never fragmented
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+#define WS_MAX_AUTH_TOKEN 512      // Bearer token sent with the upgrade request
+
+// Uplink batching: audio frames are coalesced into one transport write
+// until the batch holds the target duration; the target follows the link
+#define WS_UPLINK_BATCH_MAX_MS 200       // Latency limit on the worst link
+#define WS_UPLINK_BATCH_ADAPTIVE UINT32_MAX
+#define WS_LINK_PING_TIMEOUT_MS 2000     // Unanswered probe is given up after this
+
+// Binary audio frame header, followed by the raw payload:
+// magic(1) version(1) codec(1) flags(1) sequence(4 LE) timestamp_ms(4 LE)
+#define AUDIO_FRAME_MAGIC 0xA5
+#define AUDIO_FRAME_VERSION 1
+#define AUDIO_FRAME_HEADER_SIZE 12
+#define AUDIO_FRAME_FLAG_FINAL 0x01
+
+// Telemetry report sent as keepalive ping data; layout in telemetry.c
+#define TELEMETRY_MAGIC 0xA7
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_REPORT_SIZE 71
+#define TELEMETRY_FLAG_CHARGING 0x01
+#define TELEMETRY_FLAG_TRACE 0x02        // Built with TRACE=1
+#define TELEMETRY_LATENCY_NONE 0xFF      // Stage without samples
+
+// Bytes reserved in front of every audio payload so the audio frame header
+// and WebSocket header can be written in place (rounded up to a word)
+#define AUDIO_FRAME_HEADROOM ((WS_MAX_HEADER_SIZE + AUDIO_FRAME_HEADER_SIZE + 3) & ~3)
 
 // Device states
 typedef enum {
@@ -34,6 +148,7 @@ typedef enum {
     DEVICE_STATE_PROCESSING,
     DEVICE_STATE_PLAYING,
     DEVICE_STATE_IDLE,
+    DEVICE_STATE_STANDBY, // Radio off, listening for the wake word
     DEVICE_STATE_ERROR
 } device_state_t;
 
@@ -41,28 +156,551 @@ typedef enum {
 typedef enum {
     AUDIO_FORMAT_PCM,
     AUDIO_FORMAT_MULAW,
-    AUDIO_FORMAT_ALAW
+    AUDIO_FORMAT_ALAW,
+    AUDIO_FORMAT_OPUS
 } audio_format_t;
 
+// Polyphase resampler between SAMPLE_RATE and the wire rates (8, 16, 24 kHz)
+#define RESAMPLE_MAX_TAPS 48     // Input samples per output, longest table
+
+typedef struct {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint8_t up;                  // Interpolation factor
+    uint8_t down;                // Decimation factor
+    uint8_t taps;                // Input samples per output sample
+    uint8_t phase;               // Filter phase of the next output
+    const int16_t *coeffs;       // up x taps, Q15; NULL when the rates match
+    int16_t history[RESAMPLE_MAX_TAPS - 1];
+} resampler_t;
+
+// Opus codec configuration
+#define OPUS_FRAME_MS_DEFAULT 20
+#define OPUS_COMPLEXITY_DEFAULT 5
+#define OPUS_BITRATE_DEFAULT 16000
+#define OPUS_MAX_PACKET_SIZE 256
+#define OPUS_MAX_FRAME_SAMPLES (AUDIO_BUFFER_SIZE / 2) // One PCM16 ring slot
+#ifndef OPUS_ENCODER_ARENA_SIZE
+#define OPUS_ENCODER_ARENA_SIZE (32 * 1024)
+#endif
+#ifndef OPUS_DECODER_ARENA_SIZE
+#define OPUS_DECODER_ARENA_SIZE (24 * 1024)
+#endif
+
+typedef struct {
+    uint8_t frame_ms;    // 10, 20, 40 or 60
+    uint8_t complexity;  // 0 (fastest) to 10 (best)
+    uint32_t bitrate;    // Bits per second
+} opus_codec_config_t;
+
+typedef struct {
+    uint32_t frames_encoded;
+    uint32_t frames_decoded;
+    uint32_t bytes_out;
+    uint32_t errors;
+    uint32_t last_encode_us;
+    uint32_t max_encode_us;
+    uint64_t total_encode_us;
+} opus_codec_stats_t;
+
+// Voice activity detection
+#define VAD_END_SILENCE_MS_DEFAULT 800        // Silence after speech that ends an utterance
+#define VAD_HANGOVER_MS_DEFAULT 256           // Frames still sent after speech stops
+#define VAD_NO_SPEECH_TIMEOUT_MS_DEFAULT 6000 // Give up when nothing is said
+#define VAD_MARGIN_Q4_DEFAULT 48              // log2 energy over the noise floor (Q4, ~9 dB)
+
+typedef struct {
+    bool enabled;
+    uint16_t end_silence_ms;
+    uint16_t hangover_ms;
+    uint16_t no_speech_timeout_ms; // 0 disables the timeout
+    uint8_t margin_q4;
+} vad_config_t;
+
+typedef enum {
+    VAD_SILENCE,  // Suppress the frame
+    VAD_SPEECH,
+    VAD_HANGOVER, // Quiet, but still inside the hangover window
+    VAD_END       // End of utterance detected on this frame
+} vad_result_t;
+
+// Per-utterance VAD statistics
+typedef struct {
+    uint32_t frames_total;
+    uint32_t frames_speech;
+    uint32_t frames_suppressed;
+    uint32_t speech_ms;
+    uint32_t utterance_ms;
+    int16_t noise_floor_q4; // log2 mean energy, Q4
+    int16_t peak_energy_q4;
+    bool speech_detected;
+    bool ended_by_vad;
+} vad_stats_t;
+
+// Acoustic echo cancellation: an NLMS filter models the speaker-to-mic
+// path from the samples handed to the speaker, so speech can be detected
+// while the doll is talking
+#define AEC_TAPS 128                    // Echo tail modelled (16 ms at 8 kHz)
+#define AEC_REFERENCE_SAMPLES 2048      // Speaker history, power of two
+#define AEC_DELAY_SAMPLES_DEFAULT 16    // Bulk speaker-to-mic delay ahead of the taps
+#define AEC_STEP_Q15 8192               // NLMS step size (0.25)
+#define BARGE_IN_FRAMES_DEFAULT 3       // Consecutive speech frames that interrupt playback
+
+typedef struct {
+    bool enabled;
+    bool barge_in;           // Speech during playback interrupts it; needs enabled
+    uint16_t delay_samples;  // Below AEC_REFERENCE_SAMPLES - AEC_TAPS
+    uint8_t barge_in_frames;
+} aec_config_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t adapted_frames;      // Frames the filter learned from
+    uint32_t double_talk_frames;  // Near-end speech froze adaptation
+    uint32_t reference_resyncs;   // Capture got ahead of the speaker stream
+    int16_t erle_q4;              // Echo removed from the last frame (log2 energy, Q4)
+} aec_stats_t;
+
+// Wake word standby
+#define KWS_BANDS 8                     // Goertzel bands per feature vector
+#define KWS_FRAME_SAMPLES 256           // Feature hop (32 ms at 8 kHz)
+#define KWS_MAX_TEMPLATE_FRAMES 48      // Longest enrolled keyword (~1.5 s)
+#define KWS_THRESHOLD_Q4_DEFAULT 24     // Mean per-band match distance (log2, Q4)
+#define WAKEWORD_LEAD_MS 320            // Audio kept from before the detection point
+#define WAKEWORD_STANDBY_AFTER_MS_DEFAULT 60000
+
+typedef struct {
+    bool enabled;
+    uint16_t threshold_q4;
+    uint32_t standby_after_ms; // Idle time before the radio is switched off
+} wakeword_config_t;
+
+// Battery monitoring: the ADC is read in a burst on the housekeeping timer
+// and smoothed; everything else reads the cached result
+#define BATTERY_ADC_BURST 8             // Readings averaged per sample
+#define BATTERY_FILTER_SHIFT 2          // Each sample moves the estimate 1/4 of the way
+#define BATTERY_SAVER_PERCENT 20
+#define BATTERY_CRITICAL_PERCENT 10
+#define BATTERY_HYSTERESIS_PERCENT 3    // Needed above a threshold to leave its mode
+#define BATTERY_DRAIN_WINDOW_MS 600000  // Span of the drain rate estimate
+
+typedef enum {
+    POWER_MODE_NORMAL,
+    POWER_MODE_SAVER,
+    POWER_MODE_CRITICAL
+} power_mode_t;
+
+// Pipeline limits per power mode; 0 keeps the configured value
+typedef struct {
+    uint32_t opus_bitrate;
+    uint8_t opus_complexity;
+    uint8_t vad_margin_q4_extra;  // Added to the configured margin
+    uint16_t vad_end_silence_ms;  // Ceiling for the configured value
+    uint32_t keepalive_ms;        // WebSocket ping interval
+    uint32_t idle_timeout_ms;     // Ceiling for standby_after_ms
+} power_profile_t;
+
+typedef struct {
+    uint16_t voltage_mv;          // Filtered
+    uint8_t percent;
+    bool charging;
+    power_mode_t mode;
+    uint32_t samples;
+    int16_t drain_mv_per_hour;    // Last full window, 0 until then or while charging
+} battery_status_t;
+
+typedef enum {
+    WAKEWORD_OFF,
+    WAKEWORD_ARMED,       // Capture feeds the keyword spotter and a rolling pre-roll
+    WAKEWORD_TRIGGERED,   // Detected; capture appends to the pre-roll for the uplink
+    WAKEWORD_HANDOFF,     // Uplink caught up; capture switches back to the ring
+    WAKEWORD_PASSTHROUGH  // Capture uses the ring, uplink drains the pre-roll remainder
+} wakeword_mode_t;
+
+typedef struct {
+    uint32_t frames_scored;
+    uint32_t detections;
+    uint16_t best_score_q4;     // Closest match since the last arm
+    uint32_t preroll_samples;   // Currently queued for the uplink
+    uint32_t preroll_overflows; // Samples dropped while the radio came up
+} wakeword_stats_t;
+
+typedef struct {
+    uint8_t addr[4]; // IPv4, network order
+} network_addr_t;
+
+// Last good association, so a reconnect can skip the scan (and DHCP too
+// when a static IP is configured)
+typedef struct {
+    bool valid;
+    uint8_t bssid[6];
+    uint8_t channel;
+    bool use_static_ip;
+    network_addr_t ip;
+    network_addr_t gateway;
+    network_addr_t netmask;
+    network_addr_t dns;
+} wifi_cache_t;
+
+typedef struct {
+    uint32_t fast_connects;   // Cached BSSID/channel accepted, no scan
+    uint32_t full_connects;   // Scan and associate
+    uint32_t fast_fallbacks;  // Cache was stale, fell back to a scan
+    uint32_t dhcp_skipped;
+    uint32_t last_connect_ms;
+} wifi_connect_stats_t;
+
+// Exported TLS session, e.g. for the config store to keep across power cycles
+typedef struct {
+    char host[MAX_HOST_LENGTH];
+    uint16_t port;
+    uint16_t ticket_len;
+    uint8_t ticket[TLS_SESSION_TICKET_MAX];
+    uint32_t expires_ms; // On the RTC clock (get_rtc_time_ms), so the stamp stays put
+} tls_session_t;
+
+// WebSocket connection phases
+typedef enum {
+    WS_CONN_IDLE,
+    WS_CONN_RESOLVING,
+    WS_CONN_TCP,
+    WS_CONN_TLS,
+    WS_CONN_UPGRADE,
+    WS_CONN_OPEN,
+    WS_CONN_BACKOFF  // Last attempt failed, waiting for the reconnect timer
+} websocket_conn_state_t;
+
+typedef struct {
+    uint32_t attempts;
+    uint32_t failures;
+    uint32_t consecutive_failures; // Drives the backoff, reset on success
+    uint32_t full_handshakes;
+    uint32_t resumed_handshakes;   // TLS session ticket accepted
+    uint32_t dns_cache_hits;
+    uint32_t last_connect_ms;      // Duration of the last successful connect
+    uint32_t last_backoff_ms;
+    uint32_t rx_messages;          // Complete data messages received
+    uint32_t rx_continuations;     // Continuation frames among them
+    uint32_t rx_protocol_errors;   // Connections failed on a bad frame
+} websocket_conn_stats_t;
+
+// Uplink link estimate: RTT from ping/pong round trips, stall from the
+// time audio writes wait for room in the socket
+typedef struct {
+    uint32_t srtt_ms;              // Smoothed RTT, 0 until the first sample
+    uint32_t rttvar_ms;
+    uint32_t rtt_samples;
+    uint32_t stall_ms;             // Smoothed write stall per audio flush
+    uint32_t batch_ms;             // Current coalescing target
+    uint32_t frames_sent;          // Binary audio frames
+    uint32_t flushes;              // Transport writes that carried them
+} websocket_link_stats_t;
+
+// Receives a data message piece by piece as frames arrive. opcode is the
+// message's (TEXT or BINARY) on every chunk, continuation frames included;
+// first and last bracket the message. A negative return drops the rest of
+// that message but keeps the connection
+typedef int (*websocket_sink_t)(uint8_t opcode, const uint8_t *data, size_t len, bool first, bool last,
+                                void *ctx);
+
+// Uplink audio encodings
+typedef enum {
+    WEBSOCKET_UPLINK_BINARY, // Binary frames with AUDIO_FRAME header
+    WEBSOCKET_UPLINK_JSON    // Legacy base64 audio_chunk JSON messages
+} websocket_uplink_mode_t;
+
 // Configuration structure
 typedef struct {
     char wifi_ssid[MAX_SSID_LENGTH];
     char wifi_password[MAX_PASSWORD_LENGTH];
+    wifi_cache_t wifi_cache;        // Updated after every successful association
     char server_url[MAX_URL_LENGTH];
     char device_id[MAX_DEVICE_ID_LENGTH];
     uint16_t server_port;
-    audio_format_t audio_format;
+    audio_format_t audio_format;   // Preferred format, negotiated at connect
+    uint32_t wire_sample_rate;     // Uplink rate offered at connect, 0 for SAMPLE_RATE
+    opus_codec_config_t opus;
+    uint16_t playback_prebuffer_ms; // Minimum audio buffered before playback starts
+    vad_config_t vad;
+    wakeword_config_t wakeword;
+    aec_config_t aec;
 } device_config_t;
 
+// Flash-backed config store: CONFIG_STORE_SLOTS sectors written in turn,
+// the valid record with the highest sequence wins
+#define FLASH_SECTOR_SIZE 4096
+#define CONFIG_STORE_SLOTS 2
+#define CONFIG_RECORD_MAGIC 0x4B4E5241 // "ARNK"
+#define CONFIG_RECORD_VERSION 4        // Bump whenever the record layout changes
+
+// State learned at runtime, persisted alongside the config
+typedef struct {
+    uint16_t playback_prebuffer_ms; // Tuned jitter buffer threshold, 0 if unknown
+    tls_session_t tls_session;      // ticket_len 0 if none
+} config_runtime_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;     // sizeof(config_record_t) of the writer
+    uint32_t sequence;
+    uint32_t crc32;    // Over everything after the header
+} config_header_t;
+
+// Binary record as stored in flash; read in place, never parsed
+typedef struct {
+    config_header_t header;
+    device_config_t config;
+    config_runtime_t runtime;
+} config_record_t;
+
+typedef struct {
+    uint32_t writes;
+    uint32_t writes_skipped; // Unchanged records are not rewritten
+    uint32_t sequence;
+    int8_t active_slot;      // -1 when running on defaults
+    uint32_t slot_erases[CONFIG_STORE_SLOTS];
+} config_store_stats_t;
+
+// Response audio cache: decoded responses the server keys by content hash,
+// kept in the flash partition after the config slots as G.711 mu-law at
+// SAMPLE_RATE. Each clip is one run of sectors, header first
+#define AUDIO_CACHE_FIRST_SECTOR CONFIG_STORE_SLOTS
+#define AUDIO_CACHE_MAGIC 0x50494C43      // "CLIP"; zeroed in place on eviction
+#define AUDIO_CACHE_KEY_MAX 32            // Key characters, [A-Za-z0-9_-]
+#define AUDIO_CACHE_TAG_MAX 16            // Tag characters, NUL included
+#define AUDIO_CACHE_MAX_ENTRIES 32
+#define AUDIO_CACHE_MAX_CLIP_MS 6000      // Longer responses play but are not kept
+#define AUDIO_CACHE_TAG_RECONNECTING "reconnecting" // Played when a question finds the link down
+#define AUDIO_CACHE_TAG_LOW_BATTERY "low_battery"   // Played on entering battery saver
+#define FLASH_PARTITION_SECTORS (CONFIG_STORE_SLOTS + AUDIO_CACHE_SECTORS)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;                // Store order, the LRU order after a reboot
+    uint32_t length;                  // mu-law bytes after the header
+    uint32_t crc32;                   // Over the audio
+    char key[AUDIO_CACHE_KEY_MAX];    // NUL padded; a full-length key has no NUL
+    char tag[AUDIO_CACHE_TAG_MAX];    // "" for none
+} audio_cache_header_t;
+
+typedef struct {
+    uint32_t entries;
+    uint32_t sectors_used;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t stores;
+    uint32_t store_failures;          // Too long, flash errors or cut short
+    uint32_t evictions;
+} audio_cache_stats_t;
+
+// Deep sleep snapshot, kept in RTC memory so a wake skips negotiation
+// and calibration. Only taken from idle, so resume always lands in idle
+#define RESUME_SNAPSHOT_MAGIC 0x4D534552 // "RESM"
+#define SESSION_ID_MAX_LENGTH 40
+
+typedef struct {
+    uint32_t magic;
+    uint32_t config_sequence;         // Config record the snapshot belongs to
+    char session_id[SESSION_ID_MAX_LENGTH]; // Conversation to resume, "" if none
+    audio_format_t wire_format;       // Negotiated in the last device_hello
+    uint32_t wire_sample_rate;        // Uplink rate from the same reply
+    int16_t vad_noise_floor_q4;       // -1 if not calibrated yet
+    uint16_t playback_prebuffer_ms;
+    wifi_cache_t wifi_cache;
+    uint32_t crc32;                   // Over everything before this field
+} resume_snapshot_t;
+
 // Audio buffer structure
 typedef struct {
     uint8_t *data;
     size_t size;
+    size_t headroom;     // Writable bytes available directly before data
     size_t capacity;
     uint32_t sample_rate;
     audio_format_t format;
+    uint32_t capture_ticks; // trace_now() at DMA completion, when tracing
 } audio_buffer_t;
 
+// Single-producer/single-consumer ring of preallocated audio frames
+typedef struct {
+    audio_buffer_t frames[AUDIO_RING_SLOTS];
+    uint8_t storage[AUDIO_RING_SLOTS][AUDIO_FRAME_HEADROOM + AUDIO_BUFFER_SIZE];
+    uint32_t head;           // Written only by the producer
+    uint32_t tail;           // Written only by the consumer
+    uint32_t high_watermark; // Peak occupancy since init
+    uint32_t overruns;       // Frames dropped because the ring was full
+} audio_ring_t;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t occupancy;
+    uint32_t high_watermark;
+    uint32_t overruns;
+} audio_ring_stats_t;
+
+// Static block pools for buffers held across calls; see pool.c
+#define POOL_AUDIO_FRAMES 2    // Pooled audio_buffer_t frames with ring-slot layout
+#define POOL_WS_FRAMES 2       // Received WebSocket frames
+#define WS_RX_FRAME_SIZE 1024  // Receive read buffer; larger messages stream through it
+
+typedef enum {
+    POOL_AUDIO_FRAME,
+    POOL_WS_FRAME,
+    POOL_COUNT
+} pool_id_t;
+
+typedef struct {
+    const char *name;
+    size_t block_size;
+    uint32_t blocks;
+    uint32_t in_use;
+    uint32_t high_watermark;
+    uint32_t acquires;
+    uint32_t exhausted;      // Acquires that found the pool empty
+} pool_stats_t;
+
+// Playback pipeline states
+typedef enum {
+    PLAYBACK_STATE_IDLE,
+    PLAYBACK_STATE_BUFFERING, // Waiting for the prebuffer threshold
+    PLAYBACK_STATE_PLAYING,
+    PLAYBACK_STATE_DRAINING   // speaking_end seen, playing out the tail
+} playback_state_t;
+
+typedef struct {
+    uint32_t buffered_samples;
+    uint32_t target_prebuffer_ms; // Current adaptive threshold
+    uint32_t first_sound_ms;      // speaking_start to first audible block, last response
+    uint32_t underruns;           // DMA blocks that ran dry mid-response
+    uint32_t overflows;           // Samples dropped because the buffer was full
+    uint32_t responses;
+} playback_stats_t;
+
+// Latency trace: bucket i counts durations in [2^i, 2^(i+1)) us, bucket 0 from 0
+#define TRACE_BUCKETS 24
+
+typedef enum {
+    TRACE_STAGE_ENCODE,       // PCM frame to wire format
+    TRACE_STAGE_SEND,         // Frame handed to the socket
+    TRACE_STAGE_UPLINK,       // DMA completion to sent
+    TRACE_STAGE_SERVER,       // Final frame sent to the response starting
+    TRACE_STAGE_DECODE,       // Response audio to PCM in the jitter buffer
+    TRACE_STAGE_PLAYOUT,      // Response start to its first sample played
+    TRACE_STAGE_MOUTH_TO_EAR, // Last captured frame to first sample played
+    TRACE_STAGE_COUNT
+} trace_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[TRACE_BUCKETS];
+} trace_histogram_t;
+
+// Event loop: sources post bits, the main loop blocks until any arrive.
+// Bits coalesce, so a handler must drain all pending work when woken.
+#define EVENT_BUTTON          (1u << 0) // Button GPIO interrupt
+#define EVENT_AUDIO_CAPTURED  (1u << 1) // I2S RX DMA block complete
+#define EVENT_AUDIO_PLAYBACK  (1u << 2) // I2S TX DMA block complete
+#define EVENT_SOCKET_READABLE (1u << 3) // WebSocket has incoming data
+#define EVENT_RECONNECT       (1u << 4) // Reconnect timer expired
+#define EVENT_HOUSEKEEPING    (1u << 5) // Periodic battery/keepalive checks
+#define EVENT_SHUTDOWN        (1u << 6) // tasks_stop() was called
+#define EVENT_WAKE_WORD       (1u << 7) // Keyword spotted during standby
+#define EVENT_STANDBY         (1u << 8) // Idle long enough to enter standby
+
+#define EVENT_WAIT_FOREVER UINT32_MAX
+#define EVENT_HOUSEKEEPING_MS 30000
+
+typedef enum {
+    EVENT_TIMER_RECONNECT,
+    EVENT_TIMER_HOUSEKEEPING,
+    EVENT_TIMER_STANDBY,
+    EVENT_TIMER_COUNT
+} event_timer_id_t;
+
+// Pipeline tasks; layout, stacks and priorities live in task_config.h
+typedef enum {
+    TASK_CAPTURE,  // I2S RX -> capture ring
+    TASK_NETWORK,  // Event loop: uplink, receive, control
+    TASK_PLAYBACK, // Jitter buffer -> I2S TX
+    TASK_COUNT
+} task_id_t;
+
+typedef struct {
+    const char *name;
+    uint32_t stack_size;
+    uint8_t priority;
+    int8_t core;          // -1 for no affinity
+    uint32_t wakeups;
+    uint64_t busy_us;     // Time spent between wakeup and the next block
+    uint32_t max_late_us; // Worst periodic wakeup lateness
+} task_stats_t;
+
+typedef void (*task_entry_t)(void);
+
+// Incremental base64 decoder, fed as text fragments arrive
+#define BASE64_DECODE_BLOCK 192 // Max bytes handed to the sink per call
+
+typedef int (*base64_sink_t)(const uint8_t *data, size_t len, void *ctx);
+
+typedef struct {
+    uint32_t accum;      // Sextets of the partial quad
+    uint8_t pending;     // Sextets in accum (0-3)
+    uint8_t padding;     // '=' count expected after the final quad
+    uint8_t pad_seen;    // '=' count consumed so far
+    bool error;
+    size_t total_out;
+} base64_decoder_t;
+
+// Streaming JSON tokenizer for flat control messages. Values are reported
+// as spans into the fed text; only a key or value split across fragments
+// is copied, into the bounded buffers below. String values a handler asks
+// to stream are passed through chunk by chunk instead, of any length
+#define JSON_KEY_MAX 32
+#define JSON_VALUE_MAX 256
+
+typedef struct {
+    const char *ptr;
+    size_t len;
+} json_span_t;
+
+typedef enum {
+    JSON_STRING,   // Span excludes the quotes; escapes are left as sent
+    JSON_NUMBER,
+    JSON_LITERAL,  // true, false or null
+    JSON_OBJECT,   // Nested values are reported raw, brackets included
+    JSON_ARRAY
+} json_type_t;
+
+typedef struct {
+    // Called once per top-level member with a complete value
+    int (*field)(const json_span_t *key, json_type_t type, const json_span_t *value, void *ctx);
+    // Optional: return true to receive this string value through chunk();
+    // a zero-length chunk ends it
+    bool (*stream)(const json_span_t *key, void *ctx);
+    int (*chunk)(const json_span_t *key, const char *data, size_t len, void *ctx);
+    void *ctx;
+} json_handler_t;
+
+typedef struct {
+    const json_handler_t *handler;
+    uint8_t state;
+    uint8_t depth;           // Brackets open inside a nested value
+    bool escape;
+    bool nested_string;
+    bool streaming;
+    json_type_t type;
+    char key[JSON_KEY_MAX];
+    size_t key_len;
+    char value[JSON_VALUE_MAX];
+    size_t value_len;        // Bytes carried over from earlier fragments
+    bool value_overflow;
+    int error;
+} json_stream_t;
+
 // Function declarations
 
 // Initialization
@@ -73,6 +711,33 @@ int network_init(void);
 // Configuration
 int config_load(device_config_t *config);
 int config_save(const device_config_t *config);
+int config_load_runtime(config_runtime_t *runtime);
+int config_save_runtime(const config_runtime_t *runtime);
+const device_config_t *config_get(void);
+int config_store_mount(void);
+void config_store_unmount(void);
+int config_reset(void);
+void config_store_get_stats(config_store_stats_t *stats);
+
+// Flash access (config and audio cache partition)
+int flash_init(void);
+int flash_erase_sector(uint32_t sector);
+int flash_write(uint32_t offset, const void *data, size_t len);
+const uint8_t *flash_map(uint32_t offset, size_t len);
+
+// Response audio cache functions
+int audio_cache_init(void);
+bool audio_cache_key_valid(const char *key, size_t len);
+int audio_cache_lookup(const char *key, size_t len, audio_buffer_t *clip);
+int audio_cache_lookup_tag(const char *tag, audio_buffer_t *clip);
+int audio_cache_store_begin(const char *key, size_t len, const char *tag, size_t tag_len);
+bool audio_cache_storing(void);
+void audio_cache_store_pcm(const int16_t *samples, size_t count);
+void audio_cache_store_g711(const uint8_t *codes, size_t count, audio_format_t format);
+int audio_cache_store_commit(char *key, size_t key_len);
+void audio_cache_store_abort(void);
+int audio_cache_list_keys(char *out, size_t len);
+void audio_cache_get_stats(audio_cache_stats_t *stats);
 
 // Audio functions
 int audio_start_recording(void);
@@ -80,37 +745,265 @@ int audio_stop_recording(void);
 int audio_read_buffer(audio_buffer_t *buffer);
 int audio_play_buffer(const audio_buffer_t *buffer);
 int audio_set_volume(uint8_t volume);
+bool audio_is_recording(void);
+int audio_set_format(audio_format_t format);
+audio_format_t audio_get_format(void);
+int audio_set_wire_rate(uint32_t sample_rate);
+uint32_t audio_get_wire_rate(void);
+int audio_i2s_rx_callback(const uint8_t *samples, size_t len);
+audio_buffer_t *audio_i2s_rx_begin(void);
+int audio_i2s_rx_end(size_t len);
+int audio_capture_poll(void);
+uint32_t audio_capture_frame_ms(void);
+size_t audio_capture_frame_samples(void);
+audio_buffer_t *audio_capture_peek(void);
+audio_buffer_t *audio_capture_peek_pcm(void);
+audio_buffer_t *audio_capture_peek_pcm_at(uint32_t index);
+int audio_capture_release(void);
+void audio_capture_get_stats(audio_ring_stats_t *stats);
+
+// Audio codec functions (G.711)
+const char *audio_format_name(audio_format_t format);
+int audio_format_from_name(const char *name, size_t len, audio_format_t *format);
+uint8_t g711_mulaw_encode(int16_t sample);
+int16_t g711_mulaw_decode(uint8_t code);
+uint8_t g711_alaw_encode(int16_t sample);
+int16_t g711_alaw_decode(uint8_t code);
+int audio_codec_encode(audio_buffer_t *buffer, audio_format_t format);
+int audio_codec_decode(audio_buffer_t *buffer);
+int audio_codec_decode_to(const uint8_t *codes, size_t count, audio_format_t format, int16_t *pcm);
+
+// Resampler functions
+bool resample_rate_supported(uint32_t rate);
+int resampler_init(resampler_t *rs, uint32_t in_rate, uint32_t out_rate);
+void resampler_reset(resampler_t *rs);
+bool resampler_active(const resampler_t *rs);
+size_t resampler_output_samples(const resampler_t *rs, size_t in_samples);
+int resampler_process(resampler_t *rs, const int16_t *in, size_t in_samples, int16_t *out, size_t out_capacity);
+int audio_resample_frame(resampler_t *rs, audio_buffer_t *frame);
+
+// Voice activity detection functions
+int vad_init(const vad_config_t *config);
+void vad_reset(void);
+bool vad_enabled(void);
+vad_result_t vad_process(const int16_t *pcm, size_t samples, uint32_t sample_rate);
+void vad_get_stats(vad_stats_t *stats);
+int16_t vad_get_noise_floor(void);
+void vad_set_noise_floor(int16_t floor_q4);
+
+// Echo cancellation functions
+int aec_init(const aec_config_t *aec_config);
+void aec_reset(void);
+bool aec_enabled(void);
+void aec_reference(const int16_t *pcm, size_t samples);
+void aec_process(int16_t *pcm, size_t samples);
+void aec_get_stats(aec_stats_t *stats);
+
+// Wake word functions
+int wakeword_init(uint16_t threshold_q4);
+int wakeword_enroll(const int16_t *pcm, size_t samples);
+bool wakeword_has_template(void);
+int wakeword_process(const int16_t *pcm, size_t samples);
+int wakeword_arm(void);
+int wakeword_hold(void);
+void wakeword_disarm(void);
+void wakeword_request_trigger(void);
+bool wakeword_capture(const int16_t *pcm, size_t samples);
+wakeword_mode_t wakeword_get_mode(void);
+bool wakeword_preroll_active(void);
+audio_buffer_t *wakeword_preroll_peek(size_t frame_samples, bool flush);
+int wakeword_preroll_release(void);
+size_t wakeword_preroll_available(void);
+void wakeword_get_stats(wakeword_stats_t *stats);
+
+// Opus codec functions
+bool audio_opus_available(void);
+int audio_opus_init(uint32_t sample_rate, const opus_codec_config_t *config);
+size_t audio_opus_frame_samples(void);
+int audio_opus_encode(const int16_t *pcm, size_t samples, uint8_t *packet, size_t packet_capacity);
+int audio_opus_decode(const uint8_t *packet, size_t len, int16_t *pcm, size_t max_samples);
+int audio_opus_set_rate(uint32_t bitrate, uint8_t complexity);
+void audio_opus_get_stats(opus_codec_stats_t *stats);
+
+// Audio ring buffer functions
+int audio_ring_init(audio_ring_t *ring, uint32_t sample_rate, audio_format_t format);
+audio_buffer_t *audio_ring_acquire(audio_ring_t *ring);
+audio_buffer_t *audio_ring_peek_write(audio_ring_t *ring);
+int audio_ring_commit(audio_ring_t *ring);
+audio_buffer_t *audio_ring_peek(audio_ring_t *ring);
+audio_buffer_t *audio_ring_peek_at(audio_ring_t *ring, uint32_t index);
+int audio_ring_release(audio_ring_t *ring);
+int audio_ring_flush(audio_ring_t *ring);
+uint32_t audio_ring_count(const audio_ring_t *ring);
+void audio_ring_get_stats(const audio_ring_t *ring, audio_ring_stats_t *stats);
+
+// Memory pools
+void *pool_acquire(pool_id_t pool);
+int pool_release(pool_id_t pool, void *block);
+int pool_get_stats(pool_id_t pool, pool_stats_t *stats);
+void pool_print_stats(void);
+audio_buffer_t *audio_buffer_acquire(uint32_t sample_rate, audio_format_t format);
+int audio_buffer_release(audio_buffer_t *buffer);
+
+// Playback pipeline functions
+int playback_init(uint16_t prebuffer_ms);
+int playback_start(audio_format_t format, uint32_t sample_rate);
+int playback_feed(const uint8_t *data, size_t len);
+int playback_end(void);
+void playback_stop(void);
+size_t playback_i2s_tx_callback(int16_t *out, size_t samples);
+int playback_poll(void);
+playback_state_t playback_get_state(void);
+audio_format_t playback_get_format(void);
+int playback_set_target_prebuffer(uint16_t prebuffer_ms);
+bool playback_is_congested(void);
+void playback_get_stats(playback_stats_t *stats);
+
+// Task functions
+int tasks_start(task_entry_t network_entry);
+void tasks_stop(void);
+void tasks_wait(void);
+bool tasks_running(void);
+void tasks_mark_block(task_id_t task);
+void tasks_mark_wake(task_id_t task);
+void tasks_notify(task_id_t task);
+int tasks_get_stats(task_id_t task, task_stats_t *stats);
+void tasks_print_stats(void);
+
+// Trace functions
+uint32_t trace_now(void);
+void trace_record(trace_stage_t stage, uint32_t ticks);
+void trace_utterance_sent(uint32_t capture_ticks);
+void trace_response_start(void);
+void trace_first_sample(void);
+int trace_get_histogram(trace_stage_t stage, trace_histogram_t *histogram);
+uint32_t trace_percentile_us(const trace_histogram_t *histogram, uint8_t percent);
+void trace_reset(void);
+void trace_print(void);
+
+// Telemetry functions
+int telemetry_build_report(uint8_t *out, size_t size);
+
+// Event loop functions
+int events_init(void);
+void events_post(uint32_t events);
+void events_post_from_isr(uint32_t events);
+uint32_t events_wait(uint32_t timeout_ms);
+int events_timer_start(event_timer_id_t timer, uint32_t delay_ms, uint32_t period_ms, uint32_t events);
+void events_timer_stop(event_timer_id_t timer);
+bool events_timer_active(event_timer_id_t timer);
+void events_watch_fd(int fd);
+int events_get_watched_fd(void);
+uint32_t events_next_timer_ms(void);
+
+// Application (network task body; main.c on the device, one per doll in
+// the host fleet simulator)
+int app_init(void);
+void app_start(void);
+void app_update_sources(void);
+void app_handle_events(uint32_t events);
 
 // Network functions
 int network_connect_wifi(const char *ssid, const char *password);
 int network_disconnect_wifi(void);
 bool network_is_connected(void);
+void network_set_wifi_cache(const wifi_cache_t *cache);
+void network_get_wifi_cache(wifi_cache_t *cache);
+void network_get_wifi_stats(wifi_connect_stats_t *stats);
+int network_resolve(const char *host, network_addr_t *addr, bool *cached);
+void network_forget_host(const char *host);
 
 // WebSocket functions
 int websocket_connect(const char *url, uint16_t port, const char *path);
 int websocket_disconnect(void);
-int websocket_send_audio_chunk(const audio_buffer_t *buffer, int sequence);
-int websocket_send_ping(void);
-int websocket_receive_message(char *buffer, size_t buffer_size);
+int websocket_send_audio_chunk(audio_buffer_t *buffer, int sequence, bool is_final);
+int websocket_send_text(const char *message);
+int websocket_send_listening_start(uint32_t sample_rate, audio_format_t format);
+int websocket_send_listening_end(void);
+int websocket_send_response_cancel(const char *session_id);
+int websocket_send_audio_cache_status(const char *type, const char *key);
+int websocket_send_hello(audio_format_t preferred, uint32_t sample_rate, const char *session_id);
+int websocket_send_ping(uint8_t *data, size_t len);
+int websocket_receive(uint8_t *buffer, size_t buffer_size, websocket_sink_t sink, void *ctx);
 bool websocket_is_connected(void);
+int websocket_get_fd(void);
+websocket_conn_state_t websocket_get_conn_state(void);
+uint32_t websocket_backoff_delay_ms(uint32_t failures);
+uint32_t websocket_reconnect_delay_ms(void);
+void websocket_get_conn_stats(websocket_conn_stats_t *stats);
+int websocket_get_tls_session(tls_session_t *session);
+int websocket_set_tls_session(const tls_session_t *session);
+int websocket_set_auth_token(const char *token);
+int websocket_set_uplink_mode(websocket_uplink_mode_t mode);
+websocket_uplink_mode_t websocket_get_uplink_mode(void);
+int websocket_set_uplink_batch_ms(uint32_t batch_ms);
+uint32_t websocket_uplink_batch_target_ms(uint32_t rtt_ms, uint32_t rttvar_ms, uint32_t stall_ms);
+int websocket_flush_audio(bool force);
+uint32_t websocket_uplink_frames_written(void);
+void websocket_get_link_stats(websocket_link_stats_t *stats);
+uint64_t websocket_get_tx_bytes(void);
+#ifndef ESP_PLATFORM
+int websocket_sim_receive(const uint8_t *data, size_t len);
+void websocket_sim_fail_write(void);
+#endif
+int websocket_build_frame_header(uint8_t *out, size_t out_len, uint8_t opcode,
+                                 size_t payload_len, const uint8_t mask[4]);
+void websocket_apply_mask(uint8_t *data, size_t len, const uint8_t mask[4], size_t offset);
+int audio_frame_header_encode(uint8_t *out, audio_format_t format, uint32_t sequence,
+                              uint32_t timestamp_ms, uint8_t flags);
 
 // Device control
 int device_set_state(device_state_t state);
 device_state_t device_get_state(void);
 int device_handle_button_press(void);
 int device_process_incoming_message(const char *message);
+int device_process_message_fragment(const char *data, size_t len, bool first, bool last);
+int device_process_incoming_audio(const uint8_t *data, size_t len);
+int device_process_incoming_fragment(uint8_t opcode, const uint8_t *data, size_t len, bool first, bool last,
+                                     void *ctx);
+int device_process_uplink(void);
+int device_process_playback(void);
+int device_enter_standby(void);
+int device_handle_wake_word(void);
+int device_enter_sleep(void);
+const char *device_get_session_id(void);
+int device_apply_power_mode(power_mode_t mode);
+int device_play_notice(const char *tag);
 
 // Power management
 int power_init(void);
 int power_enter_sleep_mode(void);
+int power_enter_listen_mode(void);
 int power_wake_up(void);
+int power_save_snapshot(const resume_snapshot_t *snapshot);
+int power_take_snapshot(resume_snapshot_t *snapshot);
+int power_sample_battery(void);
 uint8_t power_get_battery_level(void);
+void power_get_battery_status(battery_status_t *status);
+power_mode_t power_get_mode(void);
+const power_profile_t *power_get_profile(power_mode_t mode);
 bool power_is_charging(void);
+#ifndef ESP_PLATFORM
+void power_sim_set_battery_mv(uint16_t mv);
+#endif
 
 // Utility functions
 int base64_encode(const uint8_t *input, size_t input_len, char *output, size_t output_len);
 int base64_decode(const char *input, uint8_t *output, size_t output_len);
+void base64_decoder_init(base64_decoder_t *decoder);
+int base64_decoder_feed(base64_decoder_t *decoder, const char *input, size_t input_len,
+                        base64_sink_t sink, void *ctx);
+int base64_decoder_finish(base64_decoder_t *decoder, base64_sink_t sink, void *ctx);
+void json_stream_init(json_stream_t *stream, const json_handler_t *handler);
+int json_stream_feed(json_stream_t *stream, const char *data, size_t len);
+int json_stream_finish(json_stream_t *stream);
+bool json_span_equals(const json_span_t *span, const char *text);
+int json_span_to_u32(const json_span_t *span, uint32_t *value);
+int json_get_field(const char *json, size_t len, const char *key, json_span_t *value);
+uint32_t crc32_compute(const void *data, size_t len);
 uint32_t get_timestamp_ms(void);
+uint32_t get_rtc_time_ms(void);
+uint32_t get_timestamp_us(void);
 void delay_ms(uint32_t ms);
 
 // Error handling
@@ -0,0 +1,105 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+// Board profiles. One block per board picks the buffer depths, task stacks,
+// audio cache size, I2S DMA layout, default codec and the optional code
+// paths, all at compile time, so a smaller part carries no storage or code
+// it cannot use. Select with make BOARD=host|esp32|esp32s3; an ESP-IDF
+// build without a choice follows its target. `make check-ram` adds up what
+// each profile needs of internal RAM and fails the build past
+// BOARD_RAM_BUDGET.
+//
+// Optional paths are defined only where a board keeps them:
+//   ARUNIKA_JSON_UPLINK  legacy base64 audio_chunk messages
+//   ARUNIKA_PCM16        uncompressed LINEAR16 on the wire, either direction
+// Boards without PCM16 need a G.711 or Opus TTS output on the server.
+
+#if !defined(ARUNIKA_BOARD_HOST) && !defined(ARUNIKA_BOARD_ESP32) && !defined(ARUNIKA_BOARD_ESP32S3)
+#if defined(CONFIG_IDF_TARGET_ESP32S3)
+#define ARUNIKA_BOARD_ESP32S3
+#elif defined(CONFIG_IDF_TARGET_ESP32)
+#define ARUNIKA_BOARD_ESP32
+#else
+#define ARUNIKA_BOARD_HOST
+#endif
+#endif
+
+#if defined(ARUNIKA_BOARD_ESP32)
+// Smaller SKU: ESP32 without PSRAM. WiFi, lwIP and mbedTLS take most of
+// the DRAM, so the pipeline keeps half-size buffers and the lean paths
+#define BOARD_NAME "esp32"
+#define BOARD_RAM_BUDGET (96 * 1024)
+#define AUDIO_RING_SLOTS 4               // 256 ms of capture backlog
+#define PLAYBACK_JITTER_SAMPLES 4096     // ~0.5 s, still above PLAYBACK_PREBUFFER_MAX_MS
+#define WAKEWORD_PREROLL_SAMPLES 16384   // ~2 s, enough with a cached association
+#define WS_UPLINK_BATCH_SIZE 2048
+#define AUDIO_CACHE_SECTORS 64           // 256 KB, ~32 s of clips
+#define I2S_DMA_DESC_NUM 3
+#define I2S_DMA_FRAME_NUM 256
+#define BOARD_AUDIO_FORMAT_DEFAULT AUDIO_FORMAT_MULAW
+#ifndef TASK_CAPTURE_STACK_SIZE
+#define TASK_CAPTURE_STACK_SIZE 3072
+#endif
+#ifndef TASK_PLAYBACK_STACK_SIZE
+#define TASK_PLAYBACK_STACK_SIZE 3072
+#endif
+#ifndef ARUNIKA_LOG_LEVEL
+#define ARUNIKA_LOG_LEVEL ARUNIKA_LOG_LEVEL_WARN
+#endif
+
+#elif defined(ARUNIKA_BOARD_ESP32S3)
+// ESP32-S3 with PSRAM: buffers only touched from task context move out of
+// internal RAM, which leaves room for Opus and a longer wake word pre-roll
+#define BOARD_NAME "esp32s3"
+#define BOARD_RAM_BUDGET (160 * 1024)
+#define BOARD_HAS_PSRAM
+#define AUDIO_RING_SLOTS 8
+#define PLAYBACK_JITTER_SAMPLES 8192
+#define WAKEWORD_PREROLL_SAMPLES 65536   // ~8 s, in PSRAM
+#define WS_UPLINK_BATCH_SIZE 4096
+#define AUDIO_CACHE_SECTORS 256          // 1 MB, ~2 min of clips
+#define I2S_DMA_DESC_NUM 4
+#define I2S_DMA_FRAME_NUM 256
+#ifdef ARUNIKA_HAVE_OPUS
+#define BOARD_AUDIO_FORMAT_DEFAULT AUDIO_FORMAT_OPUS
+#else
+#define BOARD_AUDIO_FORMAT_DEFAULT AUDIO_FORMAT_MULAW
+#endif
+#define ARUNIKA_PCM16
+
+#else
+// Host emulation keeps every path for the tests and benches. Its budget
+// matches the ESP32-S3 so growth shows up before anything is flashed
+#define BOARD_NAME "host"
+#define BOARD_RAM_BUDGET (160 * 1024)
+#define AUDIO_RING_SLOTS 8
+#define PLAYBACK_JITTER_SAMPLES 8192
+#define WAKEWORD_PREROLL_SAMPLES 32768
+#define WS_UPLINK_BATCH_SIZE 4096
+#define AUDIO_CACHE_SECTORS 32           // Emulated in RAM, kept small
+#define I2S_DMA_DESC_NUM 4
+#define I2S_DMA_FRAME_NUM 256
+#define BOARD_AUDIO_FORMAT_DEFAULT AUDIO_FORMAT_MULAW
+#define ARUNIKA_JSON_UPLINK
+#define ARUNIKA_PCM16
+#endif
+
+// Large buffers never touched from DMA completion context. ESP-IDF places
+// them in PSRAM; the host gives them their own .bss section so check-ram
+// can leave them out of the internal total
+#if defined(BOARD_HAS_PSRAM) && defined(ESP_PLATFORM)
+#include "esp_attr.h"
+#define ARUNIKA_PSRAM_BSS EXT_RAM_BSS_ATTR
+#elif defined(BOARD_HAS_PSRAM)
+#define ARUNIKA_PSRAM_BSS __attribute__((section(".bss.psram")))
+#else
+#define ARUNIKA_PSRAM_BSS
+#endif
+
+// Internal RAM the profile needs beyond static data: the task stacks (see
+// task_config.h) and the I2S DMA buffers, one set per direction
+#define I2S_DMA_BUFFER_BYTES (I2S_DMA_FRAME_NUM * CHANNELS * (BITS_PER_SAMPLE / 8))
+#define BOARD_RAM_RESERVED (TASK_CAPTURE_STACK_SIZE + TASK_NETWORK_STACK_SIZE + TASK_PLAYBACK_STACK_SIZE + \
+                            2 * I2S_DMA_DESC_NUM * I2S_DMA_BUFFER_BYTES)
+
+#endif // BOARD_H
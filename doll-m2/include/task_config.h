@@ -0,0 +1,51 @@
+#ifndef TASK_CONFIG_H
+#define TASK_CONFIG_H
+
+// Task layout for the audio pipeline. WiFi and lwIP run on core 0 under
+// ESP-IDF, so the network task joins them there and the two audio tasks get
+// core 1 to themselves; a TLS handshake can then never delay DMA servicing.
+//
+// Stack sizes are in bytes (ESP-IDF convention). Priorities follow FreeRTOS:
+// higher runs first, configMAX_PRIORITIES is 25 on ESP-IDF. Every value can
+// be overridden from the build, e.g. CFLAGS += -DTASK_NETWORK_STACK_SIZE=12288
+
+// Capture: drains I2S RX DMA into the capture ring every frame
+#ifndef TASK_CAPTURE_STACK_SIZE
+#define TASK_CAPTURE_STACK_SIZE 4096
+#endif
+#ifndef TASK_CAPTURE_PRIORITY
+#define TASK_CAPTURE_PRIORITY 20
+#endif
+#ifndef TASK_CAPTURE_CORE
+#define TASK_CAPTURE_CORE 1
+#endif
+
+// Network: event loop, WebSocket I/O, JSON and state machine
+#ifndef TASK_NETWORK_STACK_SIZE
+#define TASK_NETWORK_STACK_SIZE 8192
+#endif
+#ifndef TASK_NETWORK_PRIORITY
+#define TASK_NETWORK_PRIORITY 10
+#endif
+#ifndef TASK_NETWORK_CORE
+#define TASK_NETWORK_CORE 0
+#endif
+
+// Playback: feeds I2S TX DMA from the jitter buffer; an underrun is audible
+// so it outranks capture
+#ifndef TASK_PLAYBACK_STACK_SIZE
+#define TASK_PLAYBACK_STACK_SIZE 4096
+#endif
+#ifndef TASK_PLAYBACK_PRIORITY
+#define TASK_PLAYBACK_PRIORITY 22
+#endif
+#ifndef TASK_PLAYBACK_CORE
+#define TASK_PLAYBACK_CORE 1
+#endif
+
+// Host emulation runs glibc printf on these stacks, so never go below this
+#ifndef TASK_HOST_STACK_MIN
+#define TASK_HOST_STACK_MIN (64 * 1024)
+#endif
+
+#endif // TASK_CONFIG_H
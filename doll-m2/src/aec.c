@@ -0,0 +1,178 @@
+#include "arunika.h"
+
+// Fixed-point acoustic echo canceller. The playback TX callback copies
+// every block it hands to the speaker into a reference ring; capture
+// frames take the same number of reference samples, delay_samples
+// behind, since both I2S directions run off one clock. An NLMS filter
+// over the last AEC_TAPS reference samples estimates the echo, which is
+// subtracted from the mic signal in place. Adaptation is frozen while
+// the near end is louder than the speaker could explain (Geigel
+// double-talk test), so the filter does not learn the user's voice.
+
+#define AEC_REFERENCE_MASK (AEC_REFERENCE_SAMPLES - 1)
+#define AEC_COEF_SHIFT 20        // Coefficients are Q20
+#define AEC_GAIN_SHIFT 16        // Keeps small steps on loud references from rounding to 0
+#define AEC_ENERGY_EPSILON (AEC_TAPS * 256) // Keeps the step bounded on quiet references
+#define AEC_DOUBLE_TALK_SHIFT 1  // Near end above half the far-end peak is double talk
+
+typedef char aec_reference_power_of_two[(AEC_REFERENCE_SAMPLES & AEC_REFERENCE_MASK) == 0 ? 1 : -1];
+typedef char aec_reference_holds_taps[AEC_REFERENCE_SAMPLES >= 4 * AEC_TAPS ? 1 : -1];
+
+static aec_config_t config = { true, true, AEC_DELAY_SAMPLES_DEFAULT, BARGE_IN_FRAMES_DEFAULT };
+
+// Written by the TX callback only
+static int16_t reference[AEC_REFERENCE_SAMPLES];
+static uint32_t reference_head = 0;
+
+// Capture side
+static uint32_t reference_read = 0;
+static uint32_t reference_seen = 0; // Head at the previous frame
+static bool reference_synced = false;
+static int32_t coefficients[AEC_TAPS];
+static aec_stats_t stats;
+
+static int32_t aec_log2_q4(uint64_t value) {
+    if (value == 0) {
+        return 0;
+    }
+    
+    int msb = 63 - __builtin_clzll(value);
+    uint64_t frac = msb >= 4 ? value >> (msb - 4) : value << (4 - msb);
+    return msb * 16 + (int32_t)(frac & 0xF);
+}
+
+int aec_init(const aec_config_t *aec_config) {
+    if (!aec_config || aec_config->delay_samples > AEC_REFERENCE_SAMPLES - 2 * AEC_TAPS ||
+        (aec_config->barge_in && aec_config->barge_in_frames == 0)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // Called before playback starts, so the producer index can be reset too
+    config = *aec_config;
+    reference_head = 0;
+    reference_seen = 0;
+    aec_reset();
+    memset(&stats, 0, sizeof(stats));
+    return ARUNIKA_OK;
+}
+
+void aec_reset(void) {
+    // The echo path changes whenever the doll is moved; relearn it
+    memset(coefficients, 0, sizeof(coefficients));
+    reference_synced = false;
+}
+
+bool aec_enabled(void) {
+    return config.enabled;
+}
+
+void aec_reference(const int16_t *pcm, size_t samples) {
+    // Runs in I2S DMA completion context: no printf, no blocking, no malloc
+    uint32_t h = __atomic_load_n(&reference_head, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < samples; i++) {
+        reference[(h + i) & AEC_REFERENCE_MASK] = pcm[i];
+    }
+    __atomic_store_n(&reference_head, h + (uint32_t)samples, __ATOMIC_RELEASE);
+}
+
+void aec_process(int16_t *pcm, size_t samples) {
+    if (!config.enabled || !pcm || samples == 0) {
+        return;
+    }
+    
+    // An idle speaker writes no reference, and what it played last is not
+    // the echo of anything now. Line the read position up again once the
+    // stream moves; the history must cover the frame plus the filter
+    uint32_t h = __atomic_load_n(&reference_head, __ATOMIC_ACQUIRE);
+    uint32_t behind = h - reference_read;
+    bool speaker_active = h != reference_seen;
+    reference_seen = h;
+    if (!reference_synced || behind < samples || behind > AEC_REFERENCE_SAMPLES - AEC_TAPS - samples) {
+        if (!speaker_active || h < samples + config.delay_samples + AEC_TAPS) {
+            reference_synced = false;
+            stats.erle_q4 = 0;
+            return;
+        }
+        if (reference_synced) {
+            stats.reference_resyncs++;
+        }
+        reference_read = h - (uint32_t)samples - config.delay_samples;
+        reference_synced = true;
+    }
+    
+    uint32_t base = reference_read;
+    reference_read += (uint32_t)samples;
+    stats.frames++;
+    
+    // Far-end energy over the filter window, plus the Geigel peaks
+    uint64_t energy = 0;
+    int32_t far_peak = 0;
+    int32_t near_peak = 0;
+    for (uint32_t k = 1; k <= AEC_TAPS; k++) {
+        int32_t x = reference[(base - k) & AEC_REFERENCE_MASK];
+        energy += (uint64_t)(x * x);
+    }
+    for (size_t n = 0; n < samples; n++) {
+        int32_t x = reference[(base + n) & AEC_REFERENCE_MASK];
+        int32_t far = x < 0 ? -x : x;
+        int32_t near = pcm[n] < 0 ? -pcm[n] : pcm[n];
+        far_peak = far > far_peak ? far : far_peak;
+        near_peak = near > near_peak ? near : near_peak;
+    }
+    if (far_peak == 0) {
+        stats.erle_q4 = 0;
+        return; // Silent speaker, nothing to cancel
+    }
+    
+    bool adapt = near_peak <= far_peak >> AEC_DOUBLE_TALK_SHIFT;
+    if (adapt) {
+        stats.adapted_frames++;
+    } else {
+        stats.double_talk_frames++;
+    }
+    
+    uint64_t near_energy = 0;
+    uint64_t error_energy = 0;
+    for (size_t n = 0; n < samples; n++) {
+        uint32_t pos = base + (uint32_t)n;
+        
+        // Slide the energy window to end at this sample
+        int32_t in = reference[pos & AEC_REFERENCE_MASK];
+        int32_t out = reference[(pos - AEC_TAPS) & AEC_REFERENCE_MASK];
+        energy += (uint64_t)(in * in);
+        energy -= (uint64_t)(out * out);
+        
+        int64_t estimate = 0;
+        for (uint32_t k = 0; k < AEC_TAPS; k++) {
+            estimate += (int64_t)coefficients[k] * reference[(pos - k) & AEC_REFERENCE_MASK];
+        }
+        int32_t near = pcm[n];
+        int32_t error = near - (int32_t)(estimate >> AEC_COEF_SHIFT);
+        if (error > INT16_MAX) {
+            error = INT16_MAX;
+        } else if (error < INT16_MIN) {
+            error = INT16_MIN;
+        }
+        pcm[n] = (int16_t)error;
+        near_energy += (uint64_t)(near * near);
+        error_energy += (uint64_t)(error * error);
+        
+        if (adapt) {
+            // mu * e / |x|^2 with AEC_GAIN_SHIFT extra bits, applied to every tap
+            int64_t gain = ((int64_t)AEC_STEP_Q15 * error * (1 << (AEC_COEF_SHIFT + AEC_GAIN_SHIFT - 15))) /
+                           (int64_t)(energy + AEC_ENERGY_EPSILON);
+            for (uint32_t k = 0; k < AEC_TAPS; k++) {
+                int64_t c = coefficients[k] + ((gain * reference[(pos - k) & AEC_REFERENCE_MASK]) >> AEC_GAIN_SHIFT);
+                coefficients[k] = c > INT32_MAX ? INT32_MAX : c < INT32_MIN ? INT32_MIN : (int32_t)c;
+            }
+        }
+    }
+    
+    stats.erle_q4 = (int16_t)(aec_log2_q4(near_energy) - aec_log2_q4(error_energy));
+}
+
+void aec_get_stats(aec_stats_t *out) {
+    if (out) {
+        *out = stats;
+    }
+}
@@ -0,0 +1,221 @@
+#include "arunika.h"
+
+// Application logic of the network task: connecting, housekeeping, standby
+// and the dispatch of every event. main.c runs it from the event loop on
+// the device; the host fleet simulator runs one copy per simulated doll.
+
+static device_config_t device_config;
+static power_mode_t applied_power_mode = POWER_MODE_NORMAL;
+static uint32_t last_keepalive_ms = 0;
+static bool link_was_up = false;
+
+static int app_connect_wifi(void) {
+    // Fast path through the cached BSSID/channel; persist what worked
+    network_set_wifi_cache(&device_config.wifi_cache);
+    int result = network_connect_wifi(device_config.wifi_ssid, device_config.wifi_password);
+    
+    wifi_cache_t cache;
+    network_get_wifi_cache(&cache);
+    if (memcmp(&cache, &device_config.wifi_cache, sizeof(cache)) != 0) {
+        device_config.wifi_cache = cache;
+        config_save(&device_config);
+    }
+    
+    return result;
+}
+
+static void app_try_connect(void) {
+    // The radio is off after wake word standby
+    if (!network_is_connected() && app_connect_wifi() != ARUNIKA_OK) {
+        printf("WiFi connection failed\n");
+        return;
+    }
+    
+    printf("Attempting WebSocket connection...\n");
+    char ws_path[128];
+    snprintf(ws_path, sizeof(ws_path), "/ws?device_id=%s", device_config.device_id);
+    if (websocket_connect(device_config.server_url, device_config.server_port, ws_path) == ARUNIKA_OK) {
+        // Offer the current wire format and the configured rate; the reply
+        // may switch either
+        uint32_t rate = device_config.wire_sample_rate ? device_config.wire_sample_rate : SAMPLE_RATE;
+        websocket_send_hello(audio_get_format(), rate, device_get_session_id());
+    }
+}
+
+static void app_receive(void) {
+    // Drain everything the socket has; stop while the jitter buffer is full
+    // so TCP flow control throttles the server. Messages of any length pass
+    // through this one block, fragment by fragment
+    uint8_t *read_buffer = pool_acquire(POOL_WS_FRAME);
+    if (!read_buffer) {
+        return; // Retried on the next readable event
+    }
+    
+    while (websocket_is_connected() && !playback_is_congested()) {
+        if (websocket_receive(read_buffer, WS_RX_FRAME_SIZE, device_process_incoming_fragment, NULL) <= 0) {
+            break;
+        }
+    }
+    
+    pool_release(POOL_WS_FRAME, read_buffer);
+}
+
+// Persist runtime caches, but only when one of them changed: this runs on
+// every housekeeping tick and each write costs a sector erase
+static void app_save_runtime(void) {
+    config_runtime_t runtime, saved;
+    memset(&runtime, 0, sizeof(runtime));
+    
+    playback_stats_t playback;
+    playback_get_stats(&playback);
+    runtime.playback_prebuffer_ms = (uint16_t)playback.target_prebuffer_ms;
+    websocket_get_tls_session(&runtime.tls_session);
+    
+    if (config_load_runtime(&saved) == ARUNIKA_OK && memcmp(&saved, &runtime, sizeof(runtime)) == 0) {
+        return;
+    }
+    config_save_runtime(&runtime);
+}
+
+static void app_idle_timeout(void) {
+    app_save_runtime();
+    if (device_config.wakeword.enabled && wakeword_has_template()) {
+        device_enter_standby();
+        return;
+    }
+    
+    // Only the button can start a conversation, so sleep deeply and
+    // resume from the RTC snapshot on the next press
+    if (device_enter_sleep() == ARUNIKA_OK) {
+        // Host: esp_deep_sleep_start() is not there to reset us, wake in place
+        device_init();
+    }
+}
+
+static void app_housekeeping(void) {
+    // The only place the ADC is read; everything else uses the cached level
+    power_sample_battery();
+    battery_status_t battery;
+    power_get_battery_status(&battery);
+    
+    // Applied between utterances; a busy device retries on the next tick
+    if (battery.mode != applied_power_mode && device_apply_power_mode(battery.mode) == ARUNIKA_OK) {
+        printf("Battery %u%% (%u mV): power mode %d -> %d\n", battery.percent, battery.voltage_mv,
+               applied_power_mode, battery.mode);
+        if (applied_power_mode == POWER_MODE_NORMAL && device_get_state() == DEVICE_STATE_IDLE) {
+            device_play_notice(AUDIO_CACHE_TAG_LOW_BATTERY);
+        }
+        applied_power_mode = battery.mode;
+    }
+    
+    // Half a tick of slack so timer jitter cannot skip a ping. The ping
+    // carries the telemetry report, so stats cost no wakeup of their own
+    uint32_t now = get_timestamp_ms();
+    if (websocket_is_connected() &&
+        now - last_keepalive_ms + EVENT_HOUSEKEEPING_MS / 2 >= power_get_profile(applied_power_mode)->keepalive_ms) {
+        uint8_t report[TELEMETRY_REPORT_SIZE];
+        int len = telemetry_build_report(report, sizeof(report));
+        websocket_send_ping(report, len > 0 ? (size_t)len : 0);
+        last_keepalive_ms = now;
+    }
+}
+
+// Low battery shortens the wait before standby or deep sleep
+static uint32_t app_idle_timeout_ms(void) {
+    uint32_t limit = power_get_profile(applied_power_mode)->idle_timeout_ms;
+    uint32_t timeout = device_config.wakeword.standby_after_ms;
+    return limit > 0 && limit < timeout ? limit : timeout;
+}
+
+void app_update_sources(void) {
+    // Wake the audio tasks when they have work; they park themselves again
+    // once recording stops or the response has been played out
+    if (audio_is_recording()) {
+        tasks_notify(TASK_CAPTURE);
+    }
+    
+    playback_state_t playback = playback_get_state();
+    if (playback == PLAYBACK_STATE_PLAYING || playback == PLAYBACK_STATE_DRAINING) {
+        tasks_notify(TASK_PLAYBACK);
+    }
+    
+    // A question that lost the link gets a notice from the audio cache
+    // instead of silence while the link comes back
+    device_state_t state = device_get_state();
+    bool link_up = websocket_is_connected();
+    if (link_was_up && !link_up && state == DEVICE_STATE_PROCESSING &&
+        device_play_notice(AUDIO_CACHE_TAG_RECONNECTING) == ARUNIKA_OK) {
+        state = device_get_state();
+    }
+    link_was_up = link_up;
+    
+    // Retry a dropped or failed connection on a one-shot timer, backing off
+    // with jitter. Standby keeps the radio off until the wake word or button
+    if (state != DEVICE_STATE_STANDBY && !websocket_is_connected() &&
+        !events_timer_active(EVENT_TIMER_RECONNECT)) {
+        events_timer_start(EVENT_TIMER_RECONNECT, websocket_reconnect_delay_ms(), 0, EVENT_RECONNECT);
+    }
+    
+    // Drop into standby or deep sleep after a quiet spell; a conversation
+    // restarts the wait
+    if (state == DEVICE_STATE_IDLE) {
+        if (!events_timer_active(EVENT_TIMER_STANDBY)) {
+            events_timer_start(EVENT_TIMER_STANDBY, app_idle_timeout_ms(), 0, EVENT_STANDBY);
+        }
+    } else {
+        events_timer_stop(EVENT_TIMER_STANDBY);
+    }
+    
+    events_watch_fd(playback_is_congested() ? -1 : websocket_get_fd());
+}
+
+int app_init(void) {
+    config_load(&device_config);
+    return app_connect_wifi();
+}
+
+void app_start(void) {
+    events_timer_start(EVENT_TIMER_HOUSEKEEPING, EVENT_HOUSEKEEPING_MS, EVENT_HOUSEKEEPING_MS, EVENT_HOUSEKEEPING);
+    app_try_connect();
+}
+
+// Everything one wakeup of the network task does with its events
+void app_handle_events(uint32_t events) {
+    if (events & EVENT_BUTTON) {
+        device_handle_button_press();
+    }
+    if (events & EVENT_WAKE_WORD) {
+        device_handle_wake_word();
+    }
+    
+    // A wake word or button press brings the link straight back instead of
+    // on the timer, so the session is up while the user is still talking
+    if (events & (EVENT_RECONNECT | EVENT_WAKE_WORD | EVENT_BUTTON) && device_get_state() != DEVICE_STATE_STANDBY &&
+        !websocket_is_connected()) {
+        app_try_connect();
+    }
+    
+    if (events & (EVENT_SOCKET_READABLE | EVENT_AUDIO_PLAYBACK)) {
+        app_receive();
+    }
+    
+    // Handle audio recording and response playback
+    if (events & (EVENT_AUDIO_CAPTURED | EVENT_BUTTON | EVENT_WAKE_WORD | EVENT_RECONNECT)) {
+        device_process_uplink();
+    }
+    if (events & (EVENT_AUDIO_PLAYBACK | EVENT_SOCKET_READABLE)) {
+        device_process_playback();
+    }
+    
+    if (events & EVENT_STANDBY && device_get_state() == DEVICE_STATE_IDLE) {
+        app_idle_timeout();
+    }
+    
+    if (events & EVENT_HOUSEKEEPING) {
+        app_housekeeping();
+        app_save_runtime();
+        tasks_print_stats();
+        pool_print_stats();
+        TRACE_CALL(trace_print());
+    }
+}
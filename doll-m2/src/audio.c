@@ -2,14 +2,36 @@
 
 // Global audio state
 static bool audio_initialized = false;
-static bool is_recording = false;
+static bool is_recording = false; // Read by the capture task, written by the network task
+
+// Captured frames waiting for the uplink. Filled from the I2S DMA callback
+// and drained by the main loop so a network stall does not drop samples.
+static audio_ring_t capture_ring;
+static uint32_t capture_next_frame_ms = 0;
+
+// Wire format; I2S always runs PCM16 at SAMPLE_RATE and frames are
+// converted at the edges. Opus needs capture frames that match its frame
+// duration; a higher wire rate needs shorter ones, so the resampled frame
+// still fits its ring slot.
+static audio_format_t wire_format = AUDIO_FORMAT_MULAW;
+static uint32_t wire_rate = SAMPLE_RATE;
+static size_t capture_frame_samples = AUDIO_CHUNK_SAMPLES;
+
+// ESP-IDF caps one I2S DMA buffer at 4092 bytes
+typedef char i2s_dma_buffer_fits[I2S_DMA_BUFFER_BYTES <= 4092 ? 1 : -1];
+
+// I2S output staging for decoded G.711/Opus playback
+static int16_t playback_pcm[AUDIO_CHUNK_SAMPLES];
 
 int audio_init(void) {
     printf("Initializing audio subsystem...\n");
     
-    // TODO: Initialize I2S interface for ESP32
+    // TODO: Initialize I2S interface for ESP32, I2S_DMA_DESC_NUM descriptors
+    // of I2S_DMA_FRAME_NUM frames per channel
     // TODO: Configure microphone and speaker
     
+    audio_ring_init(&capture_ring, SAMPLE_RATE, AUDIO_FORMAT_PCM);
+    
     audio_initialized = true;
     printf("Audio subsystem initialized\n");
     
@@ -21,12 +43,15 @@ int audio_start_recording(void) {
         return ARUNIKA_ERROR_AUDIO;
     }
     
-    printf("Starting audio recording...\n");
+    LOG_DEBUG("Starting audio recording...\n");
     
     // TODO: Start I2S recording
-    // TODO: Configure audio buffers
     
-    is_recording = true;
+    // Frames left over from a previous utterance must not leak into this one
+    audio_ring_flush(&capture_ring);
+    capture_next_frame_ms = get_timestamp_ms();
+    
+    __atomic_store_n(&is_recording, true, __ATOMIC_RELEASE);
     return ARUNIKA_OK;
 }
 
@@ -35,27 +60,209 @@ int audio_stop_recording(void) {
         return ARUNIKA_OK;
     }
     
-    printf("Stopping audio recording...\n");
+    LOG_DEBUG("Stopping audio recording...\n");
     
     // TODO: Stop I2S recording
-    // TODO: Flush audio buffers
     
-    is_recording = false;
+    // Already captured frames stay queued so the uplink can drain the tail
+    __atomic_store_n(&is_recording, false, __ATOMIC_RELEASE);
+    return ARUNIKA_OK;
+}
+
+bool audio_is_recording(void) {
+    return __atomic_load_n(&is_recording, __ATOMIC_ACQUIRE);
+}
+
+uint32_t audio_capture_frame_ms(void) {
+    return capture_frame_samples * 1000 / SAMPLE_RATE;
+}
+
+size_t audio_capture_frame_samples(void) {
+    return capture_frame_samples;
+}
+
+int audio_set_format(audio_format_t format) {
+    switch (format) {
+#ifdef ARUNIKA_PCM16
+        case AUDIO_FORMAT_PCM:
+#endif
+        case AUDIO_FORMAT_MULAW:
+        case AUDIO_FORMAT_ALAW:
+            capture_frame_samples = wire_rate > SAMPLE_RATE ? AUDIO_CHUNK_SAMPLES * SAMPLE_RATE / wire_rate
+                                                            : AUDIO_CHUNK_SAMPLES;
+            break;
+        
+        case AUDIO_FORMAT_OPUS:
+            // Requires a successful audio_opus_init() first
+            if (audio_opus_frame_samples() == 0) {
+                return ARUNIKA_ERROR_AUDIO;
+            }
+            capture_frame_samples = audio_opus_frame_samples();
+            break;
+        
+        default:
+            return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    wire_format = format;
+    printf("Audio wire format: %s at %u Hz (%zu samples per frame)\n", audio_format_name(format),
+           (unsigned)audio_get_wire_rate(), capture_frame_samples);
     return ARUNIKA_OK;
 }
 
+audio_format_t audio_get_format(void) {
+    return wire_format;
+}
+
+// Applies to G.711 and PCM uplinks; Opus always encodes at SAMPLE_RATE
+int audio_set_wire_rate(uint32_t sample_rate) {
+    if (!resample_rate_supported(sample_rate)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    wire_rate = sample_rate;
+    return audio_set_format(wire_format);
+}
+
+uint32_t audio_get_wire_rate(void) {
+    return wire_format == AUDIO_FORMAT_OPUS ? SAMPLE_RATE : wire_rate;
+}
+
+audio_buffer_t *audio_i2s_rx_begin(void) {
+    // Hands out the next free ring slot as the DMA target so samples land
+    // directly behind the reserved frame headroom without a copy
+    if (!audio_is_recording()) {
+        return NULL;
+    }
+    
+    return audio_ring_acquire(&capture_ring);
+}
+
+int audio_i2s_rx_end(size_t len) {
+    audio_buffer_t *frame = audio_ring_peek_write(&capture_ring);
+    if (!frame) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    frame->size = len > frame->capacity ? frame->capacity : len;
+    frame->sample_rate = SAMPLE_RATE;
+    frame->format = AUDIO_FORMAT_PCM;
+    TRACE_STAMP(frame->capture_ticks);
+    aec_process((int16_t *)frame->data, frame->size / 2);
+    
+    // Wake word standby takes the frame before the ring; the slot is reused
+    if (wakeword_capture((const int16_t *)frame->data, frame->size / 2)) {
+        return ARUNIKA_OK;
+    }
+    
+    int result = audio_ring_commit(&capture_ring);
+    events_post_from_isr(EVENT_AUDIO_CAPTURED);
+    return result;
+}
+
+int audio_i2s_rx_callback(const uint8_t *samples, size_t len) {
+    // For drivers that own their DMA buffers; costs one copy into the ring.
+    // Runs in I2S DMA completion context: no printf, no blocking, no malloc
+    if (!samples || !audio_is_recording()) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    if (wakeword_capture((const int16_t *)samples, len / 2)) {
+        return ARUNIKA_OK;
+    }
+    
+    audio_buffer_t *frame = audio_ring_acquire(&capture_ring);
+    if (!frame) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    if (len > frame->capacity) {
+        len = frame->capacity;
+    }
+    memcpy(frame->data, samples, len);
+    frame->size = len;
+    frame->sample_rate = SAMPLE_RATE;
+    frame->format = AUDIO_FORMAT_PCM;
+    TRACE_STAMP(frame->capture_ticks);
+    aec_process((int16_t *)frame->data, frame->size / 2);
+    
+    int result = audio_ring_commit(&capture_ring);
+    events_post_from_isr(EVENT_AUDIO_CAPTURED);
+    return result;
+}
+
+int audio_capture_poll(void) {
+    if (!audio_is_recording()) {
+        return 0;
+    }
+    
+    // TODO: On ESP32 the I2S driver targets audio_i2s_rx_begin() slots directly
+    // For now, simulate DMA completions at the real frame cadence
+    uint32_t frame_ms = audio_capture_frame_ms();
+    uint32_t now = get_timestamp_ms();
+    int frames = 0;
+    
+    while ((int32_t)(now - capture_next_frame_ms) >= 0) {
+        audio_buffer_t *frame = audio_i2s_rx_begin();
+        if (frame) {
+            memset(frame->data, 0, capture_frame_samples * 2); // PCM16 silence
+            audio_i2s_rx_end(capture_frame_samples * 2);
+        }
+        capture_next_frame_ms += frame_ms;
+        frames++;
+    }
+    
+    return frames;
+}
+
+audio_buffer_t *audio_capture_peek(void) {
+    audio_buffer_t *frame = audio_ring_peek(&capture_ring);
+    
+    // Encode to the wire format on the consumer side, once per frame
+    if (frame && frame->format != wire_format) {
+        audio_codec_encode(frame, wire_format);
+    }
+    
+    return frame;
+}
+
+audio_buffer_t *audio_capture_peek_pcm(void) {
+    // Same frame as audio_capture_peek(), before it is encoded
+    return audio_ring_peek(&capture_ring);
+}
+
+audio_buffer_t *audio_capture_peek_pcm_at(uint32_t index) {
+    return audio_ring_peek_at(&capture_ring, index);
+}
+
+int audio_capture_release(void) {
+    return audio_ring_release(&capture_ring);
+}
+
+void audio_capture_get_stats(audio_ring_stats_t *stats) {
+    audio_ring_get_stats(&capture_ring, stats);
+}
+
 int audio_read_buffer(audio_buffer_t *buffer) {
-    if (!buffer || !is_recording) {
+    if (!buffer || !buffer->data) {
         return ARUNIKA_ERROR_INVALID_PARAM;
     }
     
-    // TODO: Read actual audio data from I2S
-    // For now, simulate audio data
-    buffer->size = 512; // Simulate 512 bytes of audio
-    buffer->sample_rate = SAMPLE_RATE;
-    buffer->format = AUDIO_FORMAT_MULAW;
+    // Copy the oldest captured frame out of the ring
+    audio_buffer_t *frame = audio_capture_peek();
+    if (!frame) {
+        return ARUNIKA_ERROR_TIMEOUT;
+    }
+    if (frame->size > buffer->capacity) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    memcpy(buffer->data, frame->data, frame->size);
+    buffer->size = frame->size;
+    buffer->sample_rate = frame->sample_rate;
+    buffer->format = frame->format;
+    audio_ring_release(&capture_ring);
     
-    printf("Read %zu bytes of audio data\n", buffer->size);
     return ARUNIKA_OK;
 }
 
@@ -64,10 +271,35 @@ int audio_play_buffer(const audio_buffer_t *buffer) {
         return ARUNIKA_ERROR_INVALID_PARAM;
     }
     
-    printf("Playing audio buffer: %zu bytes\n", buffer->size);
+    LOG_DEBUG("Playing audio buffer: %zu bytes\n", buffer->size);
+    
+    if (buffer->format == AUDIO_FORMAT_PCM) {
+        // TODO: Play audio through I2S speaker
+        return ARUNIKA_OK;
+    }
+    
+    if (buffer->format == AUDIO_FORMAT_OPUS) {
+        // Each buffer carries exactly one Opus packet
+        if (audio_opus_decode(buffer->data, buffer->size, playback_pcm, AUDIO_CHUNK_SAMPLES) < 0) {
+            return ARUNIKA_ERROR_AUDIO;
+        }
+        
+        // TODO: Play playback_pcm through I2S speaker
+        return ARUNIKA_OK;
+    }
     
-    // TODO: Play audio through I2S speaker
-    // TODO: Handle audio format conversion if needed
+    // G.711 is expanded to PCM16 for I2S in staging-sized slices
+    for (size_t offset = 0; offset < buffer->size; offset += AUDIO_CHUNK_SAMPLES) {
+        size_t count = buffer->size - offset;
+        if (count > AUDIO_CHUNK_SAMPLES) {
+            count = AUDIO_CHUNK_SAMPLES;
+        }
+        if (audio_codec_decode_to(buffer->data + offset, count, buffer->format, playback_pcm) < 0) {
+            return ARUNIKA_ERROR_AUDIO;
+        }
+        
+        // TODO: Play playback_pcm through I2S speaker
+    }
     
     return ARUNIKA_OK;
 }
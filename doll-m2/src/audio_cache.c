@@ -0,0 +1,404 @@
+#include "arunika.h"
+
+// Response audio cache. The server names a response by a hash of its
+// content; the decoded audio is kept in flash after the config slots so a
+// repeat plays straight from the mapped partition without a TTS round
+// trip. Each clip is one run of whole sectors with its header in the
+// first bytes. A store reserves a run long enough for the longest clip,
+// evicting the least recently used clips until one is free, writes the
+// audio as it is played and commits the header last, magic after the
+// rest, so a clip cut short by a brownout never mounts. Only the part of
+// the run the clip used stays allocated.
+//
+// Recency is kept in RAM. After a reboot the clips start out in store
+// order, which the header sequence preserves.
+
+#define AUDIO_CACHE_CLIP_MAX_BYTES (AUDIO_CACHE_MAX_CLIP_MS * (SAMPLE_RATE / 1000))
+#define AUDIO_CACHE_RUN_SECTORS(bytes) \
+    ((uint32_t)((sizeof(audio_cache_header_t) + (bytes) + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE))
+#define AUDIO_CACHE_STAGING 256 // mu-law bytes gathered per flash write
+
+typedef char audio_cache_header_size[sizeof(audio_cache_header_t) == 64 ? 1 : -1];
+// The longest clip has to fit with the whole cache evicted
+typedef char audio_cache_holds_max_clip[AUDIO_CACHE_RUN_SECTORS(AUDIO_CACHE_CLIP_MAX_BYTES) <= AUDIO_CACHE_SECTORS ? 1 : -1];
+
+typedef struct {
+    const audio_cache_header_t *header; // Mapped
+    uint16_t first;                     // Sector within the cache
+    uint16_t sectors;
+    uint32_t last_used;
+} audio_cache_entry_t;
+
+static audio_cache_entry_t entries[AUDIO_CACHE_MAX_ENTRIES];
+static uint32_t entry_count = 0;
+static uint32_t use_clock = 0;
+static uint32_t store_sequence = 0;
+static bool cache_mounted = false;
+static audio_cache_stats_t cache_stats;
+
+// The clip being stored
+static struct {
+    bool active;
+    uint32_t first;        // Reserved run
+    uint32_t length;       // mu-law bytes written so far
+    uint32_t erased;       // Bytes of the run erased, header included
+    size_t staged;
+    uint8_t staging[AUDIO_CACHE_STAGING];
+    audio_cache_header_t header;
+} store;
+
+static uint32_t sector_offset(uint32_t sector) {
+    return (AUDIO_CACHE_FIRST_SECTOR + sector) * FLASH_SECTOR_SIZE;
+}
+
+bool audio_cache_key_valid(const char *key, size_t len) {
+    // Keys go back to the server unescaped in device_hello
+    if (!key || len == 0 || len > AUDIO_CACHE_KEY_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = key[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t header_key_len(const audio_cache_header_t *header) {
+    size_t len = 0;
+    while (len < AUDIO_CACHE_KEY_MAX && header->key[len] != '\0') {
+        len++;
+    }
+    return len;
+}
+
+static const audio_cache_header_t *audio_cache_clip_at(uint32_t sector) {
+    const audio_cache_header_t *header = (const audio_cache_header_t *)flash_map(sector_offset(sector),
+                                                                                 sizeof(audio_cache_header_t));
+    if (!header || header->magic != AUDIO_CACHE_MAGIC || header->length == 0 ||
+        header->length > AUDIO_CACHE_CLIP_MAX_BYTES ||
+        sector + AUDIO_CACHE_RUN_SECTORS(header->length) > AUDIO_CACHE_SECTORS ||
+        !audio_cache_key_valid(header->key, header_key_len(header)) ||
+        header->tag[AUDIO_CACHE_TAG_MAX - 1] != '\0') {
+        return NULL;
+    }
+    
+    const uint8_t *audio = flash_map(sector_offset(sector) + sizeof(audio_cache_header_t), header->length);
+    if (!audio || crc32_compute(audio, header->length) != header->crc32) {
+        return NULL;
+    }
+    return header;
+}
+
+int audio_cache_init(void) {
+    if (flash_init() != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_CONFIG;
+    }
+    
+    // One pass over the sector headers; a valid clip covers the sectors after it
+    entry_count = 0;
+    store_sequence = 0;
+    memset(&store, 0, sizeof(store));
+    memset(&cache_stats, 0, sizeof(cache_stats));
+    for (uint32_t sector = 0; sector < AUDIO_CACHE_SECTORS;) {
+        const audio_cache_header_t *header = audio_cache_clip_at(sector);
+        if (!header || entry_count == AUDIO_CACHE_MAX_ENTRIES) {
+            sector++;
+            continue;
+        }
+        
+        audio_cache_entry_t *entry = &entries[entry_count++];
+        entry->header = header;
+        entry->first = (uint16_t)sector;
+        entry->sectors = (uint16_t)AUDIO_CACHE_RUN_SECTORS(header->length);
+        entry->last_used = header->sequence;
+        if ((int32_t)(header->sequence - store_sequence) > 0) {
+            store_sequence = header->sequence;
+        }
+        cache_stats.sectors_used += entry->sectors;
+        sector += entry->sectors;
+    }
+    
+    use_clock = store_sequence;
+    cache_stats.entries = entry_count;
+    cache_mounted = true;
+    printf("Audio cache: %u clips in %u of %u sectors\n", (unsigned)entry_count,
+           (unsigned)cache_stats.sectors_used, (unsigned)AUDIO_CACHE_SECTORS);
+    return ARUNIKA_OK;
+}
+
+static void audio_cache_fill(const audio_cache_entry_t *entry, audio_buffer_t *clip) {
+    memset(clip, 0, sizeof(*clip));
+    clip->data = (uint8_t *)entry->header + sizeof(audio_cache_header_t);
+    clip->size = entry->header->length;
+    clip->capacity = entry->header->length;
+    clip->sample_rate = SAMPLE_RATE;
+    clip->format = AUDIO_FORMAT_MULAW;
+}
+
+static audio_cache_entry_t *audio_cache_find(const char *key, size_t len) {
+    for (uint32_t i = 0; i < entry_count; i++) {
+        const audio_cache_header_t *header = entries[i].header;
+        if (header_key_len(header) == len && memcmp(header->key, key, len) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+int audio_cache_lookup(const char *key, size_t len, audio_buffer_t *clip) {
+    if (!clip || !audio_cache_key_valid(key, len)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (!cache_mounted) {
+        audio_cache_init();
+    }
+    
+    // The clip is played from the mapped partition; its data is read-only
+    audio_cache_entry_t *entry = audio_cache_find(key, len);
+    if (!entry) {
+        cache_stats.misses++;
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    entry->last_used = ++use_clock;
+    cache_stats.hits++;
+    audio_cache_fill(entry, clip);
+    return ARUNIKA_OK;
+}
+
+int audio_cache_lookup_tag(const char *tag, audio_buffer_t *clip) {
+    if (!tag || !clip) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (!cache_mounted) {
+        audio_cache_init();
+    }
+    
+    // Several clips can carry a tag; the most recently stored one wins
+    audio_cache_entry_t *best = NULL;
+    for (uint32_t i = 0; i < entry_count; i++) {
+        if (strncmp(entries[i].header->tag, tag, AUDIO_CACHE_TAG_MAX) == 0 &&
+            (!best || (int32_t)(entries[i].header->sequence - best->header->sequence) > 0)) {
+            best = &entries[i];
+        }
+    }
+    if (!best) {
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    best->last_used = ++use_clock;
+    audio_cache_fill(best, clip);
+    return ARUNIKA_OK;
+}
+
+static void audio_cache_evict(uint32_t index) {
+    // Clearing bits needs no erase; the sectors are erased when reused
+    uint32_t magic = 0;
+    flash_write(sector_offset(entries[index].first), &magic, sizeof(magic));
+    
+    cache_stats.sectors_used -= entries[index].sectors;
+    cache_stats.evictions++;
+    entries[index] = entries[--entry_count];
+    cache_stats.entries = entry_count;
+}
+
+static uint32_t audio_cache_lru(void) {
+    uint32_t oldest = 0;
+    for (uint32_t i = 1; i < entry_count; i++) {
+        if ((int32_t)(entries[i].last_used - entries[oldest].last_used) < 0) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+// First run of sectors free of clips, or -1
+static int32_t audio_cache_free_run(uint32_t sectors) {
+    uint32_t start = 0;
+    while (start + sectors <= AUDIO_CACHE_SECTORS) {
+        uint32_t end = start + sectors;
+        for (uint32_t i = 0; i < entry_count; i++) {
+            if (entries[i].first < end && entries[i].first + entries[i].sectors > start) {
+                end = 0;
+                start = entries[i].first + entries[i].sectors;
+                break;
+            }
+        }
+        if (end != 0) {
+            return (int32_t)start;
+        }
+    }
+    return -1;
+}
+
+int audio_cache_store_begin(const char *key, size_t len, const char *tag, size_t tag_len) {
+    if (!audio_cache_key_valid(key, len) || (tag_len > 0 && !tag) || tag_len >= AUDIO_CACHE_TAG_MAX) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (!cache_mounted) {
+        audio_cache_init();
+    }
+    audio_cache_store_abort();
+    
+    int32_t first = audio_cache_free_run(AUDIO_CACHE_RUN_SECTORS(AUDIO_CACHE_CLIP_MAX_BYTES));
+    while (first < 0 || entry_count == AUDIO_CACHE_MAX_ENTRIES) {
+        audio_cache_evict(audio_cache_lru());
+        first = audio_cache_free_run(AUDIO_CACHE_RUN_SECTORS(AUDIO_CACHE_CLIP_MAX_BYTES));
+    }
+    
+    memset(&store.header, 0, sizeof(store.header));
+    memcpy(store.header.key, key, len);
+    memcpy(store.header.tag, tag, tag_len);
+    store.first = (uint32_t)first;
+    store.length = 0;
+    store.erased = 0;
+    store.staged = 0;
+    store.active = true;
+    return ARUNIKA_OK;
+}
+
+bool audio_cache_storing(void) {
+    return store.active;
+}
+
+void audio_cache_store_abort(void) {
+    // The reserved run was never committed, so it is free again as it is
+    if (store.active) {
+        store.active = false;
+        cache_stats.store_failures++;
+    }
+}
+
+static int audio_cache_store_flush(void) {
+    // Sectors are erased as the clip grows into them
+    // TODO: An erase stalls the network task for tens of ms on the real
+    // part; erase the reserved run ahead while the doll is idle
+    uint32_t offset = (uint32_t)sizeof(audio_cache_header_t) + store.length;
+    while (store.erased < offset + store.staged) {
+        if (flash_erase_sector(AUDIO_CACHE_FIRST_SECTOR + store.first + store.erased / FLASH_SECTOR_SIZE) != ARUNIKA_OK) {
+            return ARUNIKA_ERROR_CONFIG;
+        }
+        store.erased += FLASH_SECTOR_SIZE;
+    }
+    
+    if (store.staged > 0 && flash_write(sector_offset(store.first) + offset, store.staging, store.staged) != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_CONFIG;
+    }
+    store.length += (uint32_t)store.staged;
+    store.staged = 0;
+    return ARUNIKA_OK;
+}
+
+static void audio_cache_store_byte(uint8_t code) {
+    if (store.length + store.staged >= AUDIO_CACHE_CLIP_MAX_BYTES) {
+        LOG_INFO("Response too long for the audio cache\n");
+        audio_cache_store_abort();
+        return;
+    }
+    
+    store.staging[store.staged++] = code;
+    if (store.staged == sizeof(store.staging) && audio_cache_store_flush() != ARUNIKA_OK) {
+        audio_cache_store_abort();
+    }
+}
+
+void audio_cache_store_pcm(const int16_t *samples, size_t count) {
+    for (size_t i = 0; i < count && store.active; i++) {
+        audio_cache_store_byte(g711_mulaw_encode(samples[i]));
+    }
+}
+
+void audio_cache_store_g711(const uint8_t *codes, size_t count, audio_format_t format) {
+    for (size_t i = 0; i < count && store.active; i++) {
+        audio_cache_store_byte(format == AUDIO_FORMAT_MULAW ? codes[i] : g711_mulaw_encode(g711_alaw_decode(codes[i])));
+    }
+}
+
+int audio_cache_store_commit(char *key, size_t key_len) {
+    if (!store.active) {
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    
+    if (audio_cache_store_flush() != ARUNIKA_OK || store.length == 0) {
+        audio_cache_store_abort();
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    store.active = false;
+    
+    // Header after the audio, its magic last
+    uint32_t offset = sector_offset(store.first);
+    const uint8_t *audio = flash_map(offset + sizeof(audio_cache_header_t), store.length);
+    store.header.sequence = ++store_sequence;
+    store.header.length = store.length;
+    store.header.crc32 = audio ? crc32_compute(audio, store.length) : 0;
+    store.header.magic = AUDIO_CACHE_MAGIC;
+    const uint8_t *fields = (const uint8_t *)&store.header + sizeof(store.header.magic);
+    if (!audio || flash_write(offset + sizeof(store.header.magic), fields,
+                              sizeof(store.header) - sizeof(store.header.magic)) != ARUNIKA_OK ||
+        flash_write(offset, &store.header.magic, sizeof(store.header.magic)) != ARUNIKA_OK ||
+        !audio_cache_clip_at(store.first)) {
+        cache_stats.store_failures++;
+        return ARUNIKA_ERROR_CONFIG;
+    }
+    
+    // A key stored again replaces the old clip
+    audio_cache_entry_t *existing = audio_cache_find(store.header.key, header_key_len(&store.header));
+    if (existing) {
+        audio_cache_evict((uint32_t)(existing - entries));
+    }
+    
+    audio_cache_entry_t *entry = &entries[entry_count++];
+    entry->header = (const audio_cache_header_t *)flash_map(offset, sizeof(audio_cache_header_t));
+    entry->first = (uint16_t)store.first;
+    entry->sectors = (uint16_t)AUDIO_CACHE_RUN_SECTORS(store.length);
+    entry->last_used = ++use_clock;
+    cache_stats.entries = entry_count;
+    cache_stats.sectors_used += entry->sectors;
+    cache_stats.stores++;
+    
+    if (key && key_len > 0) {
+        snprintf(key, key_len, "%.*s", (int)header_key_len(entry->header), entry->header->key);
+    }
+    LOG_INFO("Cached response audio %.*s (%u ms)\n", (int)header_key_len(entry->header), entry->header->key,
+             (unsigned)(store.length / (SAMPLE_RATE / 1000)));
+    return ARUNIKA_OK;
+}
+
+int audio_cache_list_keys(char *out, size_t len) {
+    if (!out || len == 0) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (!cache_mounted) {
+        audio_cache_init();
+    }
+    
+    // Quoted and comma separated, most recently used first, as many as fit
+    bool listed[AUDIO_CACHE_MAX_ENTRIES] = { false };
+    size_t used = 0;
+    out[0] = '\0';
+    for (uint32_t n = 0; n < entry_count; n++) {
+        int32_t newest = -1;
+        for (uint32_t i = 0; i < entry_count; i++) {
+            if (!listed[i] && (newest < 0 || (int32_t)(entries[i].last_used - entries[newest].last_used) > 0)) {
+                newest = (int32_t)i;
+            }
+        }
+        listed[newest] = true;
+        
+        const audio_cache_header_t *header = entries[newest].header;
+        int written = snprintf(out + used, len - used, "%s\"%.*s\"", used > 0 ? "," : "",
+                               (int)header_key_len(header), header->key);
+        if (written < 0 || (size_t)written >= len - used) {
+            out[used] = '\0';
+            break;
+        }
+        used += (size_t)written;
+    }
+    return (int)used;
+}
+
+void audio_cache_get_stats(audio_cache_stats_t *stats) {
+    if (stats) {
+        *stats = cache_stats;
+    }
+}
@@ -0,0 +1,291 @@
+#include "arunika.h"
+
+// G.711 mu-law / A-law codec. Decoding is a single 256-entry table lookup;
+// encoding finds the segment with a lookup on the top bits of the magnitude.
+
+#define MULAW_BIAS 0x84
+#define MULAW_CLIP 32635
+#define ALAW_CLIP 32635
+
+// Segment (exponent) for mu-law, indexed by (biased magnitude >> 7)
+static const uint8_t mulaw_segment_table[256] = {
+    0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7
+};
+
+// Segment for A-law, indexed by (magnitude >> 8) for magnitudes >= 256
+static const uint8_t alaw_segment_table[128] = {
+    1, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7
+};
+
+static const int16_t mulaw_decode_table[256] = {
+    -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
+    -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
+    -15996, -15484, -14972, -14460, -13948, -13436, -12924, -12412,
+    -11900, -11388, -10876, -10364, -9852, -9340, -8828, -8316,
+    -7932, -7676, -7420, -7164, -6908, -6652, -6396, -6140,
+    -5884, -5628, -5372, -5116, -4860, -4604, -4348, -4092,
+    -3900, -3772, -3644, -3516, -3388, -3260, -3132, -3004,
+    -2876, -2748, -2620, -2492, -2364, -2236, -2108, -1980,
+    -1884, -1820, -1756, -1692, -1628, -1564, -1500, -1436,
+    -1372, -1308, -1244, -1180, -1116, -1052, -988, -924,
+    -876, -844, -812, -780, -748, -716, -684, -652,
+    -620, -588, -556, -524, -492, -460, -428, -396,
+    -372, -356, -340, -324, -308, -292, -276, -260,
+    -244, -228, -212, -196, -180, -164, -148, -132,
+    -120, -112, -104, -96, -88, -80, -72, -64,
+    -56, -48, -40, -32, -24, -16, -8, 0,
+    32124, 31100, 30076, 29052, 28028, 27004, 25980, 24956,
+    23932, 22908, 21884, 20860, 19836, 18812, 17788, 16764,
+    15996, 15484, 14972, 14460, 13948, 13436, 12924, 12412,
+    11900, 11388, 10876, 10364, 9852, 9340, 8828, 8316,
+    7932, 7676, 7420, 7164, 6908, 6652, 6396, 6140,
+    5884, 5628, 5372, 5116, 4860, 4604, 4348, 4092,
+    3900, 3772, 3644, 3516, 3388, 3260, 3132, 3004,
+    2876, 2748, 2620, 2492, 2364, 2236, 2108, 1980,
+    1884, 1820, 1756, 1692, 1628, 1564, 1500, 1436,
+    1372, 1308, 1244, 1180, 1116, 1052, 988, 924,
+    876, 844, 812, 780, 748, 716, 684, 652,
+    620, 588, 556, 524, 492, 460, 428, 396,
+    372, 356, 340, 324, 308, 292, 276, 260,
+    244, 228, 212, 196, 180, 164, 148, 132,
+    120, 112, 104, 96, 88, 80, 72, 64,
+    56, 48, 40, 32, 24, 16, 8, 0
+};
+
+static const int16_t alaw_decode_table[256] = {
+    -5504, -5248, -6016, -5760, -4480, -4224, -4992, -4736,
+    -7552, -7296, -8064, -7808, -6528, -6272, -7040, -6784,
+    -2752, -2624, -3008, -2880, -2240, -2112, -2496, -2368,
+    -3776, -3648, -4032, -3904, -3264, -3136, -3520, -3392,
+    -22016, -20992, -24064, -23040, -17920, -16896, -19968, -18944,
+    -30208, -29184, -32256, -31232, -26112, -25088, -28160, -27136,
+    -11008, -10496, -12032, -11520, -8960, -8448, -9984, -9472,
+    -15104, -14592, -16128, -15616, -13056, -12544, -14080, -13568,
+    -344, -328, -376, -360, -280, -264, -312, -296,
+    -472, -456, -504, -488, -408, -392, -440, -424,
+    -88, -72, -120, -104, -24, -8, -56, -40,
+    -216, -200, -248, -232, -152, -136, -184, -168,
+    -1376, -1312, -1504, -1440, -1120, -1056, -1248, -1184,
+    -1888, -1824, -2016, -1952, -1632, -1568, -1760, -1696,
+    -688, -656, -752, -720, -560, -528, -624, -592,
+    -944, -912, -1008, -976, -816, -784, -880, -848,
+    5504, 5248, 6016, 5760, 4480, 4224, 4992, 4736,
+    7552, 7296, 8064, 7808, 6528, 6272, 7040, 6784,
+    2752, 2624, 3008, 2880, 2240, 2112, 2496, 2368,
+    3776, 3648, 4032, 3904, 3264, 3136, 3520, 3392,
+    22016, 20992, 24064, 23040, 17920, 16896, 19968, 18944,
+    30208, 29184, 32256, 31232, 26112, 25088, 28160, 27136,
+    11008, 10496, 12032, 11520, 8960, 8448, 9984, 9472,
+    15104, 14592, 16128, 15616, 13056, 12544, 14080, 13568,
+    344, 328, 376, 360, 280, 264, 312, 296,
+    472, 456, 504, 488, 408, 392, 440, 424,
+    88, 72, 120, 104, 24, 8, 56, 40,
+    216, 200, 248, 232, 152, 136, 184, 168,
+    1376, 1312, 1504, 1440, 1120, 1056, 1248, 1184,
+    1888, 1824, 2016, 1952, 1632, 1568, 1760, 1696,
+    688, 656, 752, 720, 560, 528, 624, 592,
+    944, 912, 1008, 976, 816, 784, 880, 848
+};
+
+const char *audio_format_name(audio_format_t format) {
+    // Names match the encodings the server passes to its STT backend
+    switch (format) {
+        case AUDIO_FORMAT_PCM:
+            return "LINEAR16";
+        case AUDIO_FORMAT_MULAW:
+            return "MULAW";
+        case AUDIO_FORMAT_ALAW:
+            return "ALAW";
+        case AUDIO_FORMAT_OPUS:
+            return "OPUS";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+int audio_format_from_name(const char *name, size_t len, audio_format_t *format) {
+    if (!name || !format) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    static const audio_format_t formats[] = {
+        AUDIO_FORMAT_PCM, AUDIO_FORMAT_MULAW, AUDIO_FORMAT_ALAW, AUDIO_FORMAT_OPUS
+    };
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        const char *candidate = audio_format_name(formats[i]);
+        if (strlen(candidate) == len && strncmp(candidate, name, len) == 0) {
+            *format = formats[i];
+            return ARUNIKA_OK;
+        }
+    }
+    
+    return ARUNIKA_ERROR_INVALID_PARAM;
+}
+
+uint8_t g711_mulaw_encode(int16_t sample) {
+    int value = sample;
+    uint8_t sign = 0;
+    if (value < 0) {
+        value = -value;
+        sign = 0x80;
+    }
+    if (value > MULAW_CLIP) {
+        value = MULAW_CLIP;
+    }
+    value += MULAW_BIAS;
+    
+    uint8_t exponent = mulaw_segment_table[(value >> 7) & 0xFF];
+    uint8_t mantissa = (value >> (exponent + 3)) & 0x0F;
+    return (uint8_t)~(sign | (exponent << 4) | mantissa);
+}
+
+int16_t g711_mulaw_decode(uint8_t code) {
+    return mulaw_decode_table[code];
+}
+
+uint8_t g711_alaw_encode(int16_t sample) {
+    int value = sample;
+    uint8_t sign = 0x80; // A-law sets the sign bit for positive samples
+    if (value < 0) {
+        value = -value - 1;
+        sign = 0;
+    }
+    if (value > ALAW_CLIP) {
+        value = ALAW_CLIP;
+    }
+    
+    uint8_t code;
+    if (value >= 256) {
+        uint8_t exponent = alaw_segment_table[(value >> 8) & 0x7F];
+        uint8_t mantissa = (value >> (exponent + 3)) & 0x0F;
+        code = (uint8_t)((exponent << 4) | mantissa);
+    } else {
+        code = (uint8_t)(value >> 4);
+    }
+    
+    return code ^ (sign ^ 0x55);
+}
+
+int16_t g711_alaw_decode(uint8_t code) {
+    return alaw_decode_table[code];
+}
+
+static int audio_codec_encode_opus(audio_buffer_t *buffer) {
+    // One frame in, one packet out; the packet is always smaller than the
+    // PCM it replaces so it is copied back over the frame
+    static uint8_t packet[OPUS_MAX_PACKET_SIZE];
+    static int16_t pcm[OPUS_MAX_FRAME_SAMPLES];
+    size_t samples = buffer->size / 2;
+    if (samples > OPUS_MAX_FRAME_SAMPLES) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    memcpy(pcm, buffer->data, samples * 2);
+    int len = audio_opus_encode(pcm, samples, packet, sizeof(packet));
+    if (len < 0) {
+        return len;
+    }
+    
+    memcpy(buffer->data, packet, (size_t)len);
+    buffer->size = (size_t)len;
+    buffer->format = AUDIO_FORMAT_OPUS;
+    return ARUNIKA_OK;
+}
+
+int audio_codec_encode(audio_buffer_t *buffer, audio_format_t format) {
+    if (!buffer || !buffer->data || buffer->format != AUDIO_FORMAT_PCM) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (format == AUDIO_FORMAT_PCM) {
+        return ARUNIKA_OK;
+    }
+    if (format == AUDIO_FORMAT_OPUS) {
+        return audio_codec_encode_opus(buffer);
+    }
+    if (format != AUDIO_FORMAT_MULAW && format != AUDIO_FORMAT_ALAW) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // Narrowing in place front to back: output index i never passes input 2i
+    size_t samples = buffer->size / 2;
+    uint8_t *data = buffer->data;
+    for (size_t i = 0; i < samples; i++) {
+        int16_t sample;
+        memcpy(&sample, &data[2 * i], sizeof(sample));
+        data[i] = format == AUDIO_FORMAT_MULAW ? g711_mulaw_encode(sample) : g711_alaw_encode(sample);
+    }
+    
+    buffer->size = samples;
+    buffer->format = format;
+    return ARUNIKA_OK;
+}
+
+int audio_codec_decode(audio_buffer_t *buffer) {
+    if (!buffer || !buffer->data) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (buffer->format == AUDIO_FORMAT_PCM) {
+        return ARUNIKA_OK;
+    }
+    if (buffer->format != AUDIO_FORMAT_MULAW && buffer->format != AUDIO_FORMAT_ALAW) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (buffer->size * 2 > buffer->capacity) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    // Widening in place back to front so no code byte is overwritten early
+    const int16_t *table = buffer->format == AUDIO_FORMAT_MULAW ? mulaw_decode_table : alaw_decode_table;
+    uint8_t *data = buffer->data;
+    for (size_t i = buffer->size; i > 0; i--) {
+        int16_t sample = table[data[i - 1]];
+        memcpy(&data[2 * (i - 1)], &sample, sizeof(sample));
+    }
+    
+    buffer->size *= 2;
+    buffer->format = AUDIO_FORMAT_PCM;
+    return ARUNIKA_OK;
+}
+
+int audio_codec_decode_to(const uint8_t *codes, size_t count, audio_format_t format, int16_t *pcm) {
+    if (!codes || !pcm) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    const int16_t *table;
+    if (format == AUDIO_FORMAT_MULAW) {
+        table = mulaw_decode_table;
+    } else if (format == AUDIO_FORMAT_ALAW) {
+        table = alaw_decode_table;
+    } else {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        pcm[i] = table[codes[i]];
+    }
+    
+    return (int)count;
+}
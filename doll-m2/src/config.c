@@ -1,29 +1,185 @@
 #include "arunika.h"
 
-// Configuration storage (in real implementation, this would be in EEPROM/Flash)
-static device_config_t default_config = {
+// Configuration storage. The config and the runtime caches live in one
+// CRC-protected binary record (config_record_t). Writes go to the slot
+// after the active one, body first and header last, so a write torn by a
+// brownout leaves the previous record intact. Mounting checks each slot's
+// header and CRC once; after that reads come straight from the mapped
+// record, so a wake from deep sleep never parses anything.
+
+typedef char config_record_fits_sector[sizeof(config_record_t) <= FLASH_SECTOR_SIZE ? 1 : -1];
+
+// Factory defaults, used until the first save
+static const device_config_t default_config = {
     .wifi_ssid = "YourWiFiNetwork",
     .wifi_password = "YourWiFiPassword", 
+    .wifi_cache = {
+        .valid = false, // Learned on the first association
+        .use_static_ip = false
+    },
     .server_url = "wss://api.arunika.com",
     .device_id = "ARUN_DEV_001234",
     .server_port = 443,
-    .audio_format = AUDIO_FORMAT_MULAW
+    .audio_format = BOARD_AUDIO_FORMAT_DEFAULT,
+    .wire_sample_rate = 0, // Same as the I2S rate
+    .opus = {
+        .frame_ms = OPUS_FRAME_MS_DEFAULT,
+        .complexity = OPUS_COMPLEXITY_DEFAULT,
+        .bitrate = OPUS_BITRATE_DEFAULT
+    },
+    .playback_prebuffer_ms = PLAYBACK_PREBUFFER_MS_DEFAULT,
+    .vad = {
+        .enabled = true,
+        .end_silence_ms = VAD_END_SILENCE_MS_DEFAULT,
+        .hangover_ms = VAD_HANGOVER_MS_DEFAULT,
+        .no_speech_timeout_ms = VAD_NO_SPEECH_TIMEOUT_MS_DEFAULT,
+        .margin_q4 = VAD_MARGIN_Q4_DEFAULT
+    },
+    .wakeword = {
+        .enabled = true, // Needs an enrolled template as well
+        .threshold_q4 = KWS_THRESHOLD_Q4_DEFAULT,
+        .standby_after_ms = WAKEWORD_STANDBY_AFTER_MS_DEFAULT
+    },
+    .aec = {
+        .enabled = true,
+        .barge_in = true,
+        .delay_samples = AEC_DELAY_SAMPLES_DEFAULT,
+        .barge_in_frames = BARGE_IN_FRAMES_DEFAULT
+    }
 };
 
+static const config_record_t *active_record = NULL; // Mapped, NULL while on defaults
+static bool store_mounted = false;
+static config_store_stats_t store_stats = { 0, 0, 0, -1, { 0 } };
+
+static const config_record_t *config_slot_record(uint32_t slot) {
+    const config_record_t *record = (const config_record_t *)flash_map(slot * FLASH_SECTOR_SIZE,
+                                                                       sizeof(config_record_t));
+    
+    // TODO: Migrate records written by older layouts instead of ignoring them
+    if (!record || record->header.magic != CONFIG_RECORD_MAGIC ||
+        record->header.version != CONFIG_RECORD_VERSION || record->header.size != sizeof(config_record_t)) {
+        return NULL;
+    }
+    
+    const uint8_t *body = (const uint8_t *)record + sizeof(config_header_t);
+    if (crc32_compute(body, sizeof(config_record_t) - sizeof(config_header_t)) != record->header.crc32) {
+        return NULL;
+    }
+    return record;
+}
+
+int config_store_mount(void) {
+    if (flash_init() != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_CONFIG;
+    }
+    
+    // The valid record with the newest sequence wins
+    active_record = NULL;
+    store_stats.active_slot = -1;
+    for (uint32_t slot = 0; slot < CONFIG_STORE_SLOTS; slot++) {
+        const config_record_t *record = config_slot_record(slot);
+        if (record && (!active_record ||
+                       (int32_t)(record->header.sequence - active_record->header.sequence) > 0)) {
+            active_record = record;
+            store_stats.active_slot = (int8_t)slot;
+        }
+    }
+    
+    store_stats.sequence = active_record ? active_record->header.sequence : 0;
+    store_mounted = true;
+    return ARUNIKA_OK;
+}
+
+// Forget the mount the way a reset does; the next read maps the store again
+void config_store_unmount(void) {
+    active_record = NULL;
+    store_mounted = false;
+    store_stats.sequence = 0;
+    store_stats.active_slot = -1;
+}
+
+const device_config_t *config_get(void) {
+    // Fields can be read lazily through this pointer without a full load
+    if (!store_mounted) {
+        config_store_mount();
+    }
+    return active_record ? &active_record->config : &default_config;
+}
+
+static int config_store_write(const device_config_t *config, const config_runtime_t *runtime) {
+    // Staged here; the record is too large for a task stack
+    static config_record_t record;
+    
+    if (!store_mounted) {
+        config_store_mount();
+    }
+    
+    // Nothing changed: spare the flash an erase cycle
+    if (active_record && memcmp(&active_record->config, config, sizeof(*config)) == 0 &&
+        memcmp(&active_record->runtime, runtime, sizeof(*runtime)) == 0) {
+        store_stats.writes_skipped++;
+        return ARUNIKA_OK;
+    }
+    
+    memset(&record, 0, sizeof(record));
+    memcpy(&record.config, config, sizeof(*config));
+    memcpy(&record.runtime, runtime, sizeof(*runtime));
+    
+    const uint8_t *body = (const uint8_t *)&record + sizeof(config_header_t);
+    size_t body_len = sizeof(config_record_t) - sizeof(config_header_t);
+    record.header.magic = CONFIG_RECORD_MAGIC;
+    record.header.version = CONFIG_RECORD_VERSION;
+    record.header.size = sizeof(config_record_t);
+    record.header.sequence = store_stats.sequence + 1;
+    record.header.crc32 = crc32_compute(body, body_len);
+    
+    // Rotate through the slots so wear spreads evenly
+    uint32_t slot = active_record ? (uint32_t)(store_stats.active_slot + 1) % CONFIG_STORE_SLOTS : 0;
+    uint32_t offset = slot * FLASH_SECTOR_SIZE;
+    if (flash_erase_sector(slot) != ARUNIKA_OK ||
+        flash_write(offset + sizeof(config_header_t), body, body_len) != ARUNIKA_OK ||
+        flash_write(offset, &record.header, sizeof(config_header_t)) != ARUNIKA_OK) {
+        config_store_mount(); // Still on the previous record
+        return ARUNIKA_ERROR_CONFIG;
+    }
+    store_stats.slot_erases[slot]++;
+    
+    // Read back through the map before switching over
+    const config_record_t *written = config_slot_record(slot);
+    if (!written) {
+        config_store_mount();
+        return ARUNIKA_ERROR_CONFIG;
+    }
+    
+    active_record = written;
+    store_stats.active_slot = (int8_t)slot;
+    store_stats.sequence = record.header.sequence;
+    store_stats.writes++;
+    return ARUNIKA_OK;
+}
+
+static void config_active_runtime(config_runtime_t *runtime) {
+    if (active_record) {
+        *runtime = active_record->runtime;
+    } else {
+        memset(runtime, 0, sizeof(*runtime));
+    }
+}
+
 int config_load(device_config_t *config) {
     if (config == NULL) {
         return ARUNIKA_ERROR_INVALID_PARAM;
     }
     
-    // TODO: Load from persistent storage (EEPROM, Flash, etc.)
-    // For now, use default configuration
-    memcpy(config, &default_config, sizeof(device_config_t));
+    memcpy(config, config_get(), sizeof(device_config_t));
     
-    printf("Configuration loaded:\n");
-    printf("  WiFi SSID: %s\n", config->wifi_ssid);
-    printf("  Server URL: %s\n", config->server_url);
-    printf("  Device ID: %s\n", config->device_id);
-    printf("  Server Port: %d\n", config->server_port);
+    if (store_stats.active_slot >= 0) {
+        printf("Configuration loaded from slot %d (sequence %u)\n", store_stats.active_slot,
+               (unsigned)store_stats.sequence);
+    } else {
+        printf("Configuration defaults loaded\n");
+    }
     
     return ARUNIKA_OK;
 }
@@ -33,9 +189,51 @@ int config_save(const device_config_t *config) {
         return ARUNIKA_ERROR_INVALID_PARAM;
     }
     
-    // TODO: Save to persistent storage (EEPROM, Flash, etc.)
-    memcpy(&default_config, config, sizeof(device_config_t));
+    config_runtime_t runtime;
+    config_active_runtime(&runtime);
+    int result = config_store_write(config, &runtime);
+    if (result != ARUNIKA_OK) {
+        printf("Configuration save failed\n");
+    }
+    return result;
+}
+
+int config_load_runtime(config_runtime_t *runtime) {
+    if (runtime == NULL) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
     
-    printf("Configuration saved\n");
+    if (!store_mounted) {
+        config_store_mount();
+    }
+    config_active_runtime(runtime);
     return ARUNIKA_OK;
 }
+
+int config_save_runtime(const config_runtime_t *runtime) {
+    if (runtime == NULL) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // Rewrites the config unchanged next to the new caches
+    device_config_t config;
+    memcpy(&config, config_get(), sizeof(config));
+    return config_store_write(&config, runtime);
+}
+
+int config_reset(void) {
+    // Factory reset: back to defaults on the next read
+    for (uint32_t slot = 0; slot < CONFIG_STORE_SLOTS; slot++) {
+        if (flash_erase_sector(slot) != ARUNIKA_OK) {
+            return ARUNIKA_ERROR_CONFIG;
+        }
+        store_stats.slot_erases[slot]++;
+    }
+    return config_store_mount();
+}
+
+void config_store_get_stats(config_store_stats_t *stats) {
+    if (stats) {
+        *stats = store_stats;
+    }
+}
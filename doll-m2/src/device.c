@@ -3,8 +3,85 @@
 // Global device state
 static device_state_t current_state = DEVICE_STATE_INIT;
 
+// Uplink state for the current utterance
+static int uplink_sequence = 0;
+static bool uplink_active = false;
+static bool uplink_started = false; // listening_start sent; waits for the link after a wake word
+static bool uplink_final_sent = false;
+static resampler_t uplink_resampler; // SAMPLE_RATE to the wire rate the utterance started with
+static uint32_t uplink_connection = 0; // conn_stats.attempts of the link listening_start went out on
+
+// Frames handed to the websocket batch stay at the head of the capture
+// ring until websocket_uplink_frames_written() passes them, so a batch
+// lost with the link is sent again from the ring. The next frame to send
+// sits right behind them
+static uint32_t uplink_held = 0;
+static uint32_t uplink_written_mark = 0;
+
+// VAD has seen this many frames from the head of the queue; head_vad is
+// the last one's decision. Kept across calls because frames whose send
+// failed are retried already encoded
+static uint32_t uplink_classified = 0;
+static vad_result_t head_vad = VAD_SPEECH;
+
+// Capture runs during playback so the user can interrupt; frames that
+// look like speech stay queued until barge_in_run of them confirm it
+static bool barge_in_listening = false;
+static uint32_t barge_in_run = 0;
+
+// Server conversation handed out in device_hello, offered again after deep sleep
+static char session_id[SESSION_ID_MAX_LENGTH] = "";
+
+// Response played from the audio cache. The mapped clip is fed to the
+// jitter buffer as it drains, and audio the server streams anyway is dropped
+static audio_buffer_t cached_clip;
+static size_t cached_clip_fed = 0;
+static bool response_from_cache = false;
+
+// Wake from deep sleep: bring the drivers back and restore what the last
+// session negotiated and calibrated instead of starting from defaults
+static int device_resume(const resume_snapshot_t *snapshot) {
+    // A config saved after the snapshot wins; take the full path. The reset
+    // lost the mount, so map the store before reading its sequence
+    const device_config_t *config = config_get();
+    config_store_stats_t store;
+    config_store_get_stats(&store);
+    if (store.sequence != snapshot->config_sequence) {
+        return ARUNIKA_ERROR_CONFIG;
+    }
+    
+    // TODO: On ESP32 the I2S, WiFi and ADC drivers still need their
+    // install calls; only the host modules keep RAM across the sleep
+    if (audio_init() != ARUNIKA_OK ||
+        (snapshot->wire_format == AUDIO_FORMAT_OPUS && audio_opus_init(SAMPLE_RATE, &config->opus) != ARUNIKA_OK) ||
+        audio_set_format(snapshot->wire_format) != ARUNIKA_OK ||
+        audio_set_wire_rate(snapshot->wire_sample_rate) != ARUNIKA_OK ||
+        playback_init(config->playback_prebuffer_ms) != ARUNIKA_OK ||
+        vad_init(&config->vad) != ARUNIKA_OK || aec_init(&config->aec) != ARUNIKA_OK ||
+        wakeword_init(config->wakeword.threshold_q4) != ARUNIKA_OK || audio_cache_init() != ARUNIKA_OK ||
+        network_init() != ARUNIKA_OK || power_init() != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_INIT;
+    }
+    
+    playback_set_target_prebuffer(snapshot->playback_prebuffer_ms);
+    vad_set_noise_floor(snapshot->vad_noise_floor_q4);
+    network_set_wifi_cache(&snapshot->wifi_cache);
+    snprintf(session_id, sizeof(session_id), "%s", snapshot->session_id);
+    
+    device_set_state(DEVICE_STATE_IDLE);
+    printf("Resumed from deep sleep (%s, session %s)\n", audio_format_name(snapshot->wire_format),
+           session_id[0] ? session_id : "none");
+    return ARUNIKA_OK;
+}
+
 int device_init(void) {
+    resume_snapshot_t snapshot;
+    if (power_take_snapshot(&snapshot) == ARUNIKA_OK && device_resume(&snapshot) == ARUNIKA_OK) {
+        return ARUNIKA_OK;
+    }
+    
     printf("Initializing Arunika device...\n");
+    session_id[0] = '\0';
     
     // Load configuration
     device_config_t config;
@@ -19,6 +96,45 @@ int device_init(void) {
         return ARUNIKA_ERROR_AUDIO;
     }
     
+    // Opus is only a preference; G.711 always works and the server can
+    // still negotiate it down in its device_hello reply
+    if (config.audio_format == AUDIO_FORMAT_OPUS &&
+        audio_opus_init(SAMPLE_RATE, &config.opus) != ARUNIKA_OK) {
+        printf("Opus unavailable, falling back to MULAW\n");
+        config.audio_format = AUDIO_FORMAT_MULAW;
+    }
+#ifndef ARUNIKA_PCM16
+    if (config.audio_format == AUDIO_FORMAT_PCM) {
+        printf("LINEAR16 is not built for this board, falling back to MULAW\n");
+        config.audio_format = AUDIO_FORMAT_MULAW;
+    }
+#endif
+    if (audio_set_format(config.audio_format) != ARUNIKA_OK ||
+        playback_init(config.playback_prebuffer_ms) != ARUNIKA_OK ||
+        vad_init(&config.vad) != ARUNIKA_OK || aec_init(&config.aec) != ARUNIKA_OK ||
+        wakeword_init(config.wakeword.threshold_q4) != ARUNIKA_OK) {
+        printf("Failed to initialize audio\n");
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    
+    // A cache that cannot mount only costs the round trips it would save
+    if (audio_cache_init() != ARUNIKA_OK) {
+        printf("Audio cache unavailable\n");
+    }
+    
+    // Pick up what earlier sessions learned; the RTC copy of the TLS
+    // session is newer when waking from deep sleep
+    config_runtime_t runtime;
+    tls_session_t session;
+    if (config_load_runtime(&runtime) == ARUNIKA_OK) {
+        if (runtime.playback_prebuffer_ms > 0) {
+            playback_set_target_prebuffer(runtime.playback_prebuffer_ms);
+        }
+        if (runtime.tls_session.ticket_len > 0 && websocket_get_tls_session(&session) != ARUNIKA_OK) {
+            websocket_set_tls_session(&runtime.tls_session);
+        }
+    }
+    
     // Initialize network subsystem
     if (network_init() != ARUNIKA_OK) {
         printf("Failed to initialize network\n");
@@ -38,7 +154,7 @@ int device_init(void) {
 }
 
 int device_set_state(device_state_t state) {
-    printf("Device state transition: %d -> %d\n", current_state, state);
+    LOG_DEBUG("Device state transition: %d -> %d\n", current_state, state);
     current_state = state;
     return ARUNIKA_OK;
 }
@@ -47,23 +163,259 @@ device_state_t device_get_state(void) {
     return current_state;
 }
 
+static void device_begin_utterance(void) {
+    barge_in_listening = false;
+    vad_reset();
+    uplink_sequence = 0;
+    uplink_active = true;
+    uplink_started = false;
+    uplink_final_sent = false;
+    uplink_held = 0;
+    uplink_written_mark = websocket_uplink_frames_written();
+    uplink_classified = 0;
+    resampler_init(&uplink_resampler, SAMPLE_RATE, audio_get_wire_rate());
+    device_set_state(DEVICE_STATE_RECORDING);
+}
+
+static int device_start_playback(audio_format_t format, uint32_t sample_rate) {
+    // A new response ends whatever was still being played or cached
+    audio_cache_store_abort();
+    cached_clip.data = NULL;
+    response_from_cache = false;
+    if (playback_start(format, sample_rate) != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    device_set_state(DEVICE_STATE_PLAYING);
+    TRACE_CALL(trace_response_start());
+    
+    // Full duplex: keep the mic open behind the echo canceller
+    if (aec_enabled() && config_get()->aec.barge_in && !uplink_active && !barge_in_listening &&
+        audio_start_recording() == ARUNIKA_OK) {
+        vad_reset();
+        barge_in_listening = true;
+        barge_in_run = 0;
+    }
+    return ARUNIKA_OK;
+}
+
+// Tops the jitter buffer up from the clip; the clip ends the response
+// itself once fed, as speaking_end would
+static void device_feed_cached_clip(void) {
+    if (!cached_clip.data) {
+        return;
+    }
+    if (playback_get_state() == PLAYBACK_STATE_IDLE) {
+        cached_clip.data = NULL; // Stopped by a barge-in or a new response
+        return;
+    }
+    
+    playback_stats_t stats;
+    playback_get_stats(&stats);
+    size_t room = PLAYBACK_JITTER_SAMPLES - stats.buffered_samples;
+    size_t count = cached_clip.size - cached_clip_fed < room ? cached_clip.size - cached_clip_fed : room;
+    if (count > 0 && playback_feed(cached_clip.data + cached_clip_fed, count) == ARUNIKA_OK) {
+        cached_clip_fed += count;
+    }
+    if (cached_clip_fed == cached_clip.size) {
+        cached_clip.data = NULL;
+        playback_end();
+    }
+}
+
+static int device_play_cached(const audio_buffer_t *clip) {
+    if (device_start_playback(AUDIO_FORMAT_MULAW, SAMPLE_RATE) != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    cached_clip = *clip;
+    cached_clip_fed = 0;
+    response_from_cache = true;
+    device_feed_cached_clip();
+    return ARUNIKA_OK;
+}
+
+static void device_stop_listening(void) {
+    if (barge_in_listening) {
+        barge_in_listening = false;
+        audio_stop_recording();
+    }
+}
+
+// The user talks over the response: drop it, tell the server, and record
+static int device_barge_in(void) {
+    printf("Barge-in: interrupting the response\n");
+    playback_stop();
+    audio_cache_store_abort();
+    cached_clip.data = NULL;
+    if (websocket_is_connected()) {
+        websocket_send_response_cancel(session_id);
+    }
+    
+    // Frames that confirmed the barge-in are the start of the utterance
+    if (!audio_is_recording() && audio_start_recording() != ARUNIKA_OK) {
+        barge_in_listening = false;
+        device_set_state(DEVICE_STATE_IDLE);
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    device_begin_utterance();
+    return ARUNIKA_OK;
+}
+
+static int device_check_barge_in(void) {
+    uint8_t needed = config_get()->aec.barge_in_frames;
+    audio_buffer_t *frame;
+    while ((frame = audio_capture_peek_pcm_at(barge_in_run)) != NULL) {
+        if (vad_process((const int16_t *)frame->data, frame->size / 2, frame->sample_rate) == VAD_SPEECH) {
+            if (++barge_in_run >= needed) {
+                return device_barge_in();
+            }
+            continue;
+        }
+        
+        // A short burst (a clap, residual echo) is not worth interrupting for
+        for (uint32_t i = 0; i <= barge_in_run; i++) {
+            audio_capture_release();
+        }
+        barge_in_run = 0;
+    }
+    return ARUNIKA_OK;
+}
+
+int device_enter_standby(void) {
+    if (current_state != DEVICE_STATE_IDLE || !wakeword_has_template()) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    printf("Entering wake word standby\n");
+    websocket_disconnect();
+    network_disconnect_wifi();
+    
+    // Arm before capture starts so every frame goes to the spotter
+    if (wakeword_arm() != ARUNIKA_OK || audio_start_recording() != ARUNIKA_OK) {
+        wakeword_disarm();
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    
+    power_enter_listen_mode();
+    device_set_state(DEVICE_STATE_STANDBY);
+    return ARUNIKA_OK;
+}
+
+int device_enter_sleep(void) {
+    if (current_state != DEVICE_STATE_IDLE) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    resume_snapshot_t snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    
+    config_store_stats_t store;
+    config_store_get_stats(&store);
+    snapshot.config_sequence = store.sequence;
+    snprintf(snapshot.session_id, sizeof(snapshot.session_id), "%s", session_id);
+    snapshot.wire_format = audio_get_format();
+    snapshot.wire_sample_rate = audio_get_wire_rate();
+    snapshot.vad_noise_floor_q4 = vad_get_noise_floor();
+    
+    playback_stats_t playback;
+    playback_get_stats(&playback);
+    snapshot.playback_prebuffer_ms = (uint16_t)playback.target_prebuffer_ms;
+    network_get_wifi_cache(&snapshot.wifi_cache);
+    
+    // DNS and the TLS ticket are RTC data already; the link itself is lost
+    printf("Entering deep sleep\n");
+    websocket_disconnect();
+    network_disconnect_wifi();
+    power_save_snapshot(&snapshot);
+    return power_enter_sleep_mode();
+}
+
+const char *device_get_session_id(void) {
+    return session_id;
+}
+
+// Scales the pipeline to the battery. Limits are derived from the stored
+// config every time, so going back to normal restores it exactly
+int device_apply_power_mode(power_mode_t mode) {
+    // Reconfiguring the VAD would cut a running utterance short
+    if (uplink_active) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    const device_config_t *config = config_get();
+    const power_profile_t *profile = power_get_profile(mode);
+    
+    vad_config_t vad = config->vad;
+    vad.margin_q4 = (uint8_t)(vad.margin_q4 + profile->vad_margin_q4_extra);
+    if (profile->vad_end_silence_ms > 0 && vad.end_silence_ms > profile->vad_end_silence_ms) {
+        vad.end_silence_ms = profile->vad_end_silence_ms;
+    }
+    int16_t noise_floor = vad_get_noise_floor();
+    if (vad_init(&vad) != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    vad_set_noise_floor(noise_floor);
+    
+    if (audio_get_format() == AUDIO_FORMAT_OPUS) {
+        uint32_t bitrate = profile->opus_bitrate > 0 && profile->opus_bitrate < config->opus.bitrate
+                               ? profile->opus_bitrate : config->opus.bitrate;
+        uint8_t complexity = profile->opus_bitrate > 0 && profile->opus_complexity < config->opus.complexity
+                                 ? profile->opus_complexity : config->opus.complexity;
+        audio_opus_set_rate(bitrate, complexity);
+    }
+    
+    return ARUNIKA_OK;
+}
+
+int device_handle_wake_word(void) {
+    if (current_state != DEVICE_STATE_STANDBY || !wakeword_preroll_active()) {
+        return ARUNIKA_OK;
+    }
+    
+    wakeword_stats_t stats;
+    wakeword_get_stats(&stats);
+    printf("Wake word detected (score %u), %u ms pre-roll\n", (unsigned)stats.best_score_q4,
+           (unsigned)(stats.preroll_samples * 1000 / SAMPLE_RATE));
+    
+    // Capture keeps filling the pre-roll while the radio comes back up
+    power_wake_up();
+    device_begin_utterance();
+    return ARUNIKA_OK;
+}
+
 int device_handle_button_press(void) {
     printf("Button press detected\n");
     
     switch (current_state) {
         case DEVICE_STATE_IDLE:
-            // Start recording
+            // With the link down the capture ring would overflow before the
+            // reconnect, so the utterance queues in the pre-roll as after a
+            // wake word
+            if (!websocket_is_connected()) {
+                wakeword_hold();
+            }
             if (audio_start_recording() == ARUNIKA_OK) {
-                device_set_state(DEVICE_STATE_RECORDING);
+                device_begin_utterance();
+            } else if (wakeword_get_mode() == WAKEWORD_TRIGGERED) {
+                wakeword_disarm();
             }
             break;
-            
+        
+        case DEVICE_STATE_STANDBY:
+            // Same path as a detection, so the pre-roll is kept
+            wakeword_request_trigger();
+            break;
+        
         case DEVICE_STATE_RECORDING:
             // Stop recording and process
             audio_stop_recording();
             device_set_state(DEVICE_STATE_PROCESSING);
             break;
-            
+        
+        case DEVICE_STATE_PLAYING:
+            // Talking over the doll without waiting for it to finish
+            device_barge_in();
+            break;
+        
         default:
             printf("Button press ignored in current state: %d\n", current_state);
             break;
@@ -72,23 +424,610 @@ int device_handle_button_press(void) {
     return ARUNIKA_OK;
 }
 
-int device_process_incoming_message(const char *message) {
-    printf("Processing incoming message: %s\n", message);
+// Decoded response audio is queued in the jitter buffer block by block
+static int device_playback_sink(const uint8_t *data, size_t len, void *ctx) {
+    (void)ctx;
+    int result = playback_feed(data, len);
+    return result == ARUNIKA_ERROR_MEMORY ? ARUNIKA_OK : result; // Overflow is counted, not fatal
+}
+
+// Control messages are parsed as they arrive and dispatched on "type".
+// Fields a message needs are taken from the parser's spans as they come
+// by; audio_data is decoded straight into the jitter buffer, so "type"
+// must come before it (the server always sends it first)
+typedef struct {
+    const char *type;
+    bool streams_audio;
+    int (*field)(const json_span_t *key, const json_span_t *value);
+    int (*end)(void);
+} device_message_handler_t;
+
+static struct {
+    json_stream_t parser;
+    const device_message_handler_t *handler;
+    bool has_encoding;
+    bool bad_encoding;
+    audio_format_t encoding;
+    uint32_t sample_rate;      // 0 unless the message names one
+    bool audio_open;
+    bool audio_failed;
+    base64_decoder_t decoder;
+    char audio_key[AUDIO_CACHE_KEY_MAX + 1]; // "" unless the server keyed the response
+    char audio_tag[AUDIO_CACHE_TAG_MAX];
+    bool audio_key_only;       // "cached": true, no audio follows
+} message;
+
+static int device_message_encoding(const json_span_t *key, const json_span_t *value) {
+    if (json_span_equals(key, "encoding")) {
+        message.has_encoding = true;
+        message.bad_encoding = audio_format_from_name(value->ptr, value->len, &message.encoding) != ARUNIKA_OK;
+    }
+    return ARUNIKA_OK;
+}
+
+static int device_hello_field(const json_span_t *key, const json_span_t *value) {
+    // A resumed conversation keeps its ID; otherwise the server names a new one
+    if (json_span_equals(key, "session_id") && value->len < sizeof(session_id)) {
+        memcpy(session_id, value->ptr, value->len);
+        session_id[value->len] = '\0';
+    }
+    return device_message_encoding(key, value);
+}
+
+static int device_hello_end(void) {
+    // Server picked one of the encodings offered at connect
+    if (!message.has_encoding || message.bad_encoding || audio_set_format(message.encoding) != ARUNIKA_OK) {
+        printf("Unusable negotiated encoding, falling back to MULAW\n");
+        audio_set_format(AUDIO_FORMAT_MULAW);
+    }
+    
+    // and the uplink rate; a server that names none gets the I2S rate
+    uint32_t rate = message.sample_rate ? message.sample_rate : SAMPLE_RATE;
+    if (audio_set_wire_rate(rate) != ARUNIKA_OK) {
+        printf("Unsupported negotiated sample rate %u, using %u\n", (unsigned)rate, (unsigned)SAMPLE_RATE);
+        audio_set_wire_rate(SAMPLE_RATE);
+    }
+    return ARUNIKA_OK;
+}
+
+// A keyed response plays from the cache when the clip is there. Returns
+// 1 when it does, 0 when the response has to be streamed
+static int device_try_cache(void) {
+    audio_buffer_t clip;
+    if (message.audio_key[0] == '\0' ||
+        audio_cache_lookup(message.audio_key, strlen(message.audio_key), &clip) != ARUNIKA_OK) {
+        // Only the key came: ask for the audio instead
+        if (message.audio_key_only && websocket_is_connected()) {
+            websocket_send_audio_cache_status(MSG_TYPE_AUDIO_CACHE_MISS, message.audio_key);
+        }
+        return 0;
+    }
+    
+    LOG_INFO("Playing cached response %s\n", message.audio_key);
+    return device_play_cached(&clip) == ARUNIKA_OK ? 1 : ARUNIKA_ERROR_AUDIO;
+}
+
+// A keyed response not in the cache is stored while it plays
+static void device_begin_caching(void) {
+    if (message.audio_key[0] != '\0') {
+        audio_cache_store_begin(message.audio_key, strlen(message.audio_key),
+                                message.audio_tag, strlen(message.audio_tag));
+    }
+}
+
+static int device_end_response(void) {
+    char key[AUDIO_CACHE_KEY_MAX + 1];
+    if (audio_cache_storing() && audio_cache_store_commit(key, sizeof(key)) == ARUNIKA_OK &&
+        websocket_is_connected()) {
+        websocket_send_audio_cache_status(MSG_TYPE_AUDIO_CACHED, key);
+    }
+    
+    // A cached clip ends itself once it has all been fed
+    if (response_from_cache) {
+        response_from_cache = false;
+        return ARUNIKA_OK;
+    }
+    return playback_end();
+}
+
+static int device_speaking_start_end(void) {
+    int cached = device_try_cache();
+    if (cached != 0 || message.audio_key_only) {
+        return cached < 0 ? cached : ARUNIKA_OK;
+    }
+    
+    // Streamed response: binary audio frames follow until speaking_end.
+    // The server streams LINEAR16 TTS unless it names an encoding, at
+    // SAMPLE_RATE unless it names a rate; playback resamples the rest
+    uint32_t rate = message.sample_rate ? message.sample_rate : SAMPLE_RATE;
+    if (message.bad_encoding || !resample_rate_supported(rate)) {
+        printf("Unsupported response encoding or sample rate\n");
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    int result = device_start_playback(message.has_encoding ? message.encoding : AUDIO_FORMAT_PCM, rate);
+    if (result == ARUNIKA_OK) {
+        device_begin_caching();
+    }
+    return result;
+}
+
+static int device_speaking_end_end(void) {
+    return device_end_response();
+}
+
+static int device_listening_start_end(void) {
+    // The server wants a follow-up answer without a button press
+    if (current_state == DEVICE_STATE_IDLE && audio_start_recording() == ARUNIKA_OK) {
+        device_begin_utterance();
+    }
+    return ARUNIKA_OK;
+}
+
+static int device_response_text_field(const json_span_t *key, const json_span_t *value) {
+    // TODO: Show the transcript on the companion app
+    if (json_span_equals(key, "text")) {
+        printf("Response text: %.*s\n", (int)value->len, value->ptr);
+    }
+    return ARUNIKA_OK;
+}
+
+static int device_emotion_field(const json_span_t *key, const json_span_t *value) {
+    // TODO: Drive the face LEDs
+    if (json_span_equals(key, "emotion")) {
+        printf("Emotion: %.*s\n", (int)value->len, value->ptr);
+    }
+    return ARUNIKA_OK;
+}
+
+static int device_ai_response_field(const json_span_t *key, const json_span_t *value) {
+    if (json_span_equals(key, "response_text")) {
+        printf("Response text: %.*s\n", (int)value->len, value->ptr);
+    }
+    
+    // Playback is already open; the key has to come before audio_data
+    if (json_span_equals(key, "audio_key") && message.audio_key[0] != '\0') {
+        int cached = device_try_cache();
+        if (cached > 0) {
+            message.audio_open = false;
+        } else if (cached == 0 && !message.audio_key_only) {
+            device_begin_caching();
+        }
+    }
+    return device_emotion_field(key, value);
+}
+
+static int device_ai_response_end(void) {
+    // The whole response is here, so it drains without waiting for the prebuffer
+    if (message.audio_open &&
+        (message.audio_failed || base64_decoder_finish(&message.decoder, device_playback_sink, NULL) < 0)) {
+        printf("Failed to decode response audio\n");
+        audio_cache_store_abort();
+    }
+    return device_end_response();
+}
+
+static const device_message_handler_t message_handlers[] = {
+    { MSG_TYPE_DEVICE_HELLO, false, device_hello_field, device_hello_end },
+    { MSG_TYPE_SPEAKING_START, false, device_message_encoding, device_speaking_start_end },
+    { MSG_TYPE_SPEAKING_END, false, NULL, device_speaking_end_end },
+    { MSG_TYPE_AUDIO_RESPONSE_ENDED, false, NULL, device_speaking_end_end },
+    { MSG_TYPE_LISTENING_START, false, NULL, device_listening_start_end },
+    { MSG_TYPE_RESPONSE_TEXT, false, device_response_text_field, NULL },
+    { MSG_TYPE_EMOTION, false, device_emotion_field, NULL },
+    { MSG_TYPE_AI_RESPONSE, true, device_ai_response_field, device_ai_response_end }
+};
+
+static int device_message_open_audio(void) {
+    // Opus packets cannot be delimited inside one base64 blob, so
+    // embedded response audio stays G.711 when the uplink runs Opus
+    audio_format_t format = audio_get_format() == AUDIO_FORMAT_OPUS ? AUDIO_FORMAT_MULAW : audio_get_format();
+    // The blob is opened at "type", before any rate field could be seen
+    if (device_start_playback(format, SAMPLE_RATE) != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    base64_decoder_init(&message.decoder);
+    message.audio_open = true;
+    return ARUNIKA_OK;
+}
+
+static int device_message_field(const json_span_t *key, json_type_t type, const json_span_t *value, void *ctx) {
+    (void)ctx;
+    if (json_span_equals(key, "type") && type == JSON_STRING && !message.handler) {
+        for (size_t i = 0; i < sizeof(message_handlers) / sizeof(message_handlers[0]); i++) {
+            if (json_span_equals(value, message_handlers[i].type)) {
+                message.handler = &message_handlers[i];
+                break;
+            }
+        }
+        LOG_DEBUG("Processing incoming message: %.*s\n", (int)value->len, value->ptr);
+        return message.handler && message.handler->streams_audio ? device_message_open_audio() : ARUNIKA_OK;
+    }
+    
+    if (json_span_equals(key, "sample_rate") && type == JSON_NUMBER &&
+        json_span_to_u32(value, &message.sample_rate) != ARUNIKA_OK) {
+        message.sample_rate = UINT32_MAX; // Rejected by whoever uses it
+    }
+    
+    // Audio cache fields; a key that is not a valid cache key is ignored
+    if (json_span_equals(key, "audio_key") && type == JSON_STRING && audio_cache_key_valid(value->ptr, value->len)) {
+        memcpy(message.audio_key, value->ptr, value->len);
+        message.audio_key[value->len] = '\0';
+    }
+    if (json_span_equals(key, "audio_tag") && type == JSON_STRING && value->len < sizeof(message.audio_tag)) {
+        memcpy(message.audio_tag, value->ptr, value->len);
+        message.audio_tag[value->len] = '\0';
+    }
+    if (json_span_equals(key, "cached") && type == JSON_LITERAL) {
+        message.audio_key_only = json_span_equals(value, "true");
+    }
+    if (message.handler && message.handler->field && type == JSON_STRING) {
+        return message.handler->field(key, value);
+    }
+    return ARUNIKA_OK;
+}
+
+static bool device_message_stream(const json_span_t *key, void *ctx) {
+    (void)ctx;
+    // Audio of a response played from the cache is streamed past unread
+    return (message.audio_open || response_from_cache) && json_span_equals(key, "audio_data");
+}
+
+static int device_message_chunk(const json_span_t *key, const char *data, size_t len, void *ctx) {
+    (void)key;
+    (void)ctx;
+    // Decoding errors are reported once the message is complete
+    if (len > 0 && message.audio_open && !message.audio_failed &&
+        base64_decoder_feed(&message.decoder, data, len, device_playback_sink, NULL) != ARUNIKA_OK) {
+        message.audio_failed = true;
+    }
+    return ARUNIKA_OK;
+}
+
+static const json_handler_t message_parser = {
+    device_message_field, device_message_stream, device_message_chunk, NULL
+};
+
+int device_process_message_fragment(const char *data, size_t len, bool first, bool last) {
+    if (!data && len > 0) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    if (first) {
+        memset(&message, 0, sizeof(message));
+        json_stream_init(&message.parser, &message_parser);
+    }
+    
+    int result = json_stream_feed(&message.parser, data, len);
+    if (result == ARUNIKA_OK && last) {
+        result = json_stream_finish(&message.parser);
+    }
+    if (result != ARUNIKA_OK) {
+        // Whatever audio arrived still plays
+        printf("Malformed control message\n");
+        if (message.audio_open) {
+            playback_end();
+        }
+        return result;
+    }
+    if (!last) {
+        return ARUNIKA_OK;
+    }
+    
+    if (!message.handler) {
+        printf("Unhandled control message\n");
+        return ARUNIKA_OK;
+    }
+    return message.handler->end ? message.handler->end() : ARUNIKA_OK;
+}
+
+int device_process_incoming_message(const char *message_text) {
+    if (!message_text) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    return device_process_message_fragment(message_text, strlen(message_text), true, true);
+}
+
+int device_process_incoming_audio(const uint8_t *data, size_t len) {
+    if (!data) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    if (response_from_cache) {
+        return ARUNIKA_OK; // Already playing from flash
+    }
+    if (playback_get_state() == PLAYBACK_STATE_IDLE) {
+        LOG_WARN("Dropping response audio outside speaking_start/speaking_end\n");
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    
+    int result = playback_feed(data, len);
+    if (result == ARUNIKA_ERROR_MEMORY) {
+        LOG_WARN("Playback buffer overflow, dropped response audio\n");
+    }
+    return result;
+}
+
+// One Opus packet per binary message; a packet split by the frame reader
+// is put back together before it goes to the decoder
+static uint8_t opus_packet[OPUS_MAX_PACKET_SIZE];
+static size_t opus_packet_len = 0;
+
+int device_process_incoming_fragment(uint8_t opcode, const uint8_t *data, size_t len, bool first, bool last,
+                                     void *ctx) {
+    (void)ctx;
+    if (opcode == WS_OPCODE_TEXT) {
+        return device_process_message_fragment((const char *)data, len, first, last);
+    }
+    
+    // G.711 and PCM can be fed as the bytes arrive
+    if (playback_get_format() != AUDIO_FORMAT_OPUS || (first && last)) {
+        return len > 0 ? device_process_incoming_audio(data, len) : ARUNIKA_OK;
+    }
+    
+    if (first) {
+        opus_packet_len = 0;
+    }
+    if (len > sizeof(opus_packet) - opus_packet_len) {
+        printf("Oversized Opus packet, dropped\n");
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    memcpy(opus_packet + opus_packet_len, data, len);
+    opus_packet_len += len;
+    return last ? device_process_incoming_audio(opus_packet, opus_packet_len) : ARUNIKA_OK;
+}
+
+int device_process_playback(void) {
+    device_feed_cached_clip();
+    
+    // Back to idle once the response has been played out
+    if (playback_poll() > 0 && current_state == DEVICE_STATE_PLAYING) {
+        device_stop_listening();
+        device_set_state(DEVICE_STATE_IDLE);
+    }
+    
+    return ARUNIKA_OK;
+}
+
+// After a wake word the utterance starts with the pre-roll; live frames
+// come from the capture ring once it has been drained. The pre-roll hands
+// out one frame at a time, so its frames are never held
+static audio_buffer_t *device_uplink_peek(bool *from_preroll) {
+    *from_preroll = false;
+    if (uplink_held == 0 && wakeword_preroll_active()) {
+        audio_buffer_t *frame = wakeword_preroll_peek(audio_capture_frame_samples(), !audio_is_recording());
+        if (frame || wakeword_preroll_active()) {
+            *from_preroll = frame != NULL;
+            return frame;
+        }
+    }
+    return audio_capture_peek_pcm_at(uplink_held);
+}
+
+// Drops the oldest queued frame
+static void device_uplink_release(bool from_preroll) {
+    if (from_preroll) {
+        wakeword_preroll_release();
+    } else {
+        audio_capture_release();
+    }
+    if (uplink_classified > 0) {
+        uplink_classified--;
+    }
+}
+
+// Releases the held frames the transport has written since the last call
+static void device_uplink_settle(void) {
+    uint32_t written = websocket_uplink_frames_written();
+    uint32_t count = written - uplink_written_mark;
+    uplink_written_mark = written;
+    for (; count > 0 && uplink_held > 0; count--) {
+        device_uplink_release(false);
+        uplink_held--;
+    }
+}
+
+static int device_uplink_flush(bool force) {
+    int result = websocket_flush_audio(force);
+    device_uplink_settle();
+    return result;
+}
+
+// True when no frame can follow the current one
+static bool device_uplink_is_last(bool from_preroll) {
+    if (audio_is_recording()) {
+        return false;
+    }
     
-    // TODO: Parse JSON message and handle different types
-    // For now, assume it's an AI response with audio data
+    audio_ring_stats_t stats;
+    audio_capture_get_stats(&stats);
+    if (from_preroll) {
+        return stats.occupancy == 0 && wakeword_preroll_available() <= audio_capture_frame_samples();
+    }
+    return stats.occupancy == uplink_held + 1;
+}
+
+// A lost link takes the server's stream with it. Frames still queued open
+// a new one once the reconnect timer brings the link back; after is_final
+// went out the question is lost with the link, and the doll listens again
+static void device_uplink_lost(void) {
+    uplink_started = false;
+    uplink_sequence = 0;
+    uplink_held = 0;
+    uplink_written_mark = websocket_uplink_frames_written();
+    if (uplink_final_sent && !audio_is_recording()) {
+        audio_buffer_t *frame;
+        bool from_preroll;
+        while ((frame = device_uplink_peek(&from_preroll)) != NULL) {
+            device_uplink_release(from_preroll);
+        }
+        uplink_classified = 0;
+        uplink_active = false;
+        device_set_state(DEVICE_STATE_IDLE);
+    }
+}
+
+static int device_uplink_failed(void) {
+    if (!websocket_is_connected()) {
+        device_uplink_lost();
+    }
+    return ARUNIKA_ERROR_WEBSOCKET;
+}
+
+int device_process_uplink(void) {
+    if (!uplink_active) {
+        return barge_in_listening ? device_check_barge_in() : ARUNIKA_OK;
+    }
+    
+    // The link dropped and came back since the last call: the batch went
+    // with it, so the held frames open a stream on the new one
+    websocket_conn_stats_t conn;
+    websocket_get_conn_stats(&conn);
+    if (uplink_started && conn.attempts != uplink_connection) {
+        device_uplink_lost();
+        if (!uplink_active) {
+            return ARUNIKA_OK;
+        }
+    }
+    device_uplink_settle();
     
-    if (strstr(message, "ai_response") != NULL) {
-        // Extract audio data and play it
-        device_set_state(DEVICE_STATE_PLAYING);
+    // A wake word utterance is opened once the link is back; until then
+    // capture keeps queueing into the pre-roll
+    if (!uplink_started) {
+        if (!websocket_is_connected() ||
+            websocket_send_listening_start(uplink_resampler.out_rate, audio_get_format()) != ARUNIKA_OK) {
+            return ARUNIKA_OK;
+        }
+        uplink_started = true;
+        uplink_connection = conn.attempts;
+    }
+    
+    // Drain every queued frame; on a send failure the frame stays queued
+    // and is retried on the next call
+    audio_buffer_t *frame;
+    bool from_preroll;
+    while ((frame = device_uplink_peek(&from_preroll)) != NULL) {
+        // VAD runs on the PCM frame before it is encoded for the wire.
+        // Frames before the last one it saw were sent, so they were speech
+        if (uplink_held >= uplink_classified) {
+            head_vad = VAD_SPEECH;
+            if (vad_enabled() && frame->format == AUDIO_FORMAT_PCM) {
+                head_vad = vad_process((const int16_t *)frame->data, frame->size / 2, frame->sample_rate);
+            }
+            uplink_classified = uplink_held + 1;
+        }
+        vad_result_t frame_vad = uplink_held + 1 == uplink_classified ? head_vad : VAD_SPEECH;
         
-        // TODO: Parse JSON, extract base64 audio data, decode and play
+        vad_stats_t vad;
+        vad_get_stats(&vad);
+        bool end_of_speech = frame_vad == VAD_END;
+        if (end_of_speech && audio_is_recording()) {
+            // The user no longer has to press the button to finish
+            printf("VAD: end of utterance after %u ms\n", (unsigned)vad.utterance_ms);
+            audio_stop_recording();
+            device_set_state(DEVICE_STATE_PROCESSING);
+        }
         
-        // Simulate audio playback delay
-        delay_ms(2000);
+        // Silence, a no-speech timeout, or tail frames after is_final. Only
+        // the oldest frame can be dropped, so the held ones go out first
+        if (frame_vad == VAD_SILENCE || (end_of_speech && !vad.speech_detected) || uplink_final_sent) {
+            if (uplink_held > 0 && device_uplink_flush(true) != ARUNIKA_OK) {
+                return device_uplink_failed();
+            }
+            device_uplink_release(from_preroll);
+            continue;
+        }
         
-        device_set_state(DEVICE_STATE_IDLE);
+        // Resample and encode to the wire format once per frame
+        if (frame->format != audio_get_format() || frame->sample_rate != uplink_resampler.out_rate) {
+            TRACE_BEGIN(encode_start);
+            if (frame->sample_rate != uplink_resampler.out_rate) {
+                audio_resample_frame(&uplink_resampler, frame);
+            }
+            if (frame->format != audio_get_format()) {
+                audio_codec_encode(frame, audio_get_format());
+            }
+            TRACE_END(TRACE_STAGE_ENCODE, encode_start);
+        }
+        bool is_final = end_of_speech || device_uplink_is_last(from_preroll);
+        
+        TRACE_BEGIN(send_start);
+        if (websocket_send_audio_chunk(frame, uplink_sequence, is_final) != ARUNIKA_OK) {
+            return device_uplink_failed();
+        }
+        TRACE_END(TRACE_STAGE_SEND, send_start);
+        
+        // Pre-roll frames were captured before the detection; time from now
+        if (!from_preroll) {
+            TRACE_END(TRACE_STAGE_UPLINK, frame->capture_ticks);
+        }
+        if (is_final) {
+            TRACE_CALL(trace_utterance_sent(from_preroll ? trace_now() : frame->capture_ticks));
+        }
+        uplink_sequence++;
+        uplink_final_sent = is_final;
+        
+        // A pre-roll frame is released once written. Ring frames wait in the
+        // batch, but never in more than half the ring so capture keeps room
+        if (from_preroll) {
+            if (websocket_flush_audio(true) != ARUNIKA_OK) {
+                return device_uplink_failed();
+            }
+            device_uplink_release(true);
+            uplink_written_mark = websocket_uplink_frames_written();
+            continue;
+        }
+        uplink_held++;
+        if (device_uplink_flush(uplink_held >= AUDIO_RING_SLOTS / 2) != ARUNIKA_OK) {
+            return device_uplink_failed();
+        }
+    }
+    
+    // A partial batch goes out once it has waited its latency limit
+    if (device_uplink_flush(false) != ARUNIKA_OK) {
+        return device_uplink_failed();
+    }
+    
+    // Recording stopped and the tail is flushed: close the utterance
+    if (!audio_is_recording() && !wakeword_preroll_active()) {
+        if (websocket_send_listening_end() != ARUNIKA_OK) {
+            return device_uplink_failed();
+        }
+        device_uplink_settle();
+        uplink_active = false;
+        
+        vad_stats_t vad;
+        vad_get_stats(&vad);
+        if (vad_enabled()) {
+            printf("Utterance: %u ms, %u ms speech, %u/%u frames sent\n", (unsigned)vad.utterance_ms,
+                   (unsigned)vad.speech_ms, (unsigned)(vad.frames_total - vad.frames_suppressed),
+                   (unsigned)vad.frames_total);
+        }
     }
     
     return ARUNIKA_OK;
 }
+
+// Offline notices: a cached clip the server tagged plays without the link.
+// A question still waiting on the link is given up
+int device_play_notice(const char *tag) {
+    if (current_state != DEVICE_STATE_IDLE && current_state != DEVICE_STATE_PROCESSING) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    audio_buffer_t clip;
+    if (audio_cache_lookup_tag(tag, &clip) != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    
+    if (uplink_active) {
+        audio_buffer_t *frame;
+        bool from_preroll;
+        while ((frame = device_uplink_peek(&from_preroll)) != NULL) {
+            device_uplink_release(from_preroll);
+        }
+        uplink_active = false;
+    }
+    printf("Playing cached %s notice\n", tag);
+    return device_play_cached(&clip);
+}
@@ -0,0 +1,176 @@
+#include "arunika.h"
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+// Event dispatcher for the main loop. Interrupt handlers and timers OR
+// their bit into a pending mask and wake the core, which sleeps in poll()
+// until an event arrives or the nearest timer deadline passes. On ESP32 the
+// mask maps onto a FreeRTOS task notification.
+
+typedef struct {
+    bool active;
+    uint32_t deadline_ms;
+    uint32_t period_ms; // 0 for one-shot
+    uint32_t events;
+} event_timer_t;
+
+static uint32_t pending = 0;
+static event_timer_t timers[EVENT_TIMER_COUNT];
+static int wake_pipe[2] = { -1, -1 };
+static int watched_fd = -1;
+
+int events_init(void) {
+    // TODO: Use xTaskNotifyFromISR()/xTaskNotifyWait() on ESP32
+    if (wake_pipe[0] < 0) {
+        if (pipe(wake_pipe) != 0) {
+            return ARUNIKA_ERROR_INIT;
+        }
+        // A full pipe already guarantees a wakeup, so writes never block
+        fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+    }
+    
+    __atomic_store_n(&pending, 0, __ATOMIC_RELEASE);
+    memset(timers, 0, sizeof(timers));
+    watched_fd = -1;
+    
+    return ARUNIKA_OK;
+}
+
+void events_post(uint32_t events) {
+    __atomic_fetch_or(&pending, events, __ATOMIC_RELEASE);
+    if (wake_pipe[1] >= 0) {
+        uint8_t byte = 1;
+        ssize_t written = write(wake_pipe[1], &byte, 1);
+        (void)written;
+    }
+}
+
+void events_post_from_isr(uint32_t events) {
+    // write() is async-signal-safe, so the host path is shared
+    events_post(events);
+}
+
+int events_timer_start(event_timer_id_t timer, uint32_t delay_ms, uint32_t period_ms, uint32_t events) {
+    if (timer >= EVENT_TIMER_COUNT || events == 0) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    timers[timer].deadline_ms = get_timestamp_ms() + delay_ms;
+    timers[timer].period_ms = period_ms;
+    timers[timer].events = events;
+    timers[timer].active = true;
+    
+    return ARUNIKA_OK;
+}
+
+void events_timer_stop(event_timer_id_t timer) {
+    if (timer < EVENT_TIMER_COUNT) {
+        timers[timer].active = false;
+    }
+}
+
+bool events_timer_active(event_timer_id_t timer) {
+    return timer < EVENT_TIMER_COUNT && timers[timer].active;
+}
+
+void events_watch_fd(int fd) {
+    // -1 stops watching, e.g. while the playback buffer is congested
+    watched_fd = fd;
+}
+
+int events_get_watched_fd(void) {
+    return watched_fd;
+}
+
+// For a loop that waits on behalf of the core, like the host fleet
+// simulator: 0 when a timer is already due
+uint32_t events_next_timer_ms(void) {
+    uint32_t now = get_timestamp_ms();
+    uint32_t next = EVENT_WAIT_FOREVER;
+    
+    for (int i = 0; i < EVENT_TIMER_COUNT; i++) {
+        if (!timers[i].active) {
+            continue;
+        }
+        int32_t remaining = (int32_t)(timers[i].deadline_ms - now);
+        uint32_t wait = remaining > 0 ? (uint32_t)remaining : 0;
+        if (wait < next) {
+            next = wait;
+        }
+    }
+    
+    return next;
+}
+
+// Fires every expired timer and returns the time until the next deadline
+static uint32_t events_run_timers(uint32_t now) {
+    uint32_t next = EVENT_WAIT_FOREVER;
+    
+    for (int i = 0; i < EVENT_TIMER_COUNT; i++) {
+        event_timer_t *timer = &timers[i];
+        if (!timer->active) {
+            continue;
+        }
+        
+        if ((int32_t)(now - timer->deadline_ms) >= 0) {
+            __atomic_fetch_or(&pending, timer->events, __ATOMIC_RELEASE);
+            if (timer->period_ms == 0) {
+                timer->active = false;
+                continue;
+            }
+            // Stay on the original cadence; skip periods missed while busy
+            do {
+                timer->deadline_ms += timer->period_ms;
+            } while ((int32_t)(now - timer->deadline_ms) >= 0);
+        }
+        
+        uint32_t remaining = timer->deadline_ms - now;
+        if (remaining < next) {
+            next = remaining;
+        }
+    }
+    
+    return next;
+}
+
+uint32_t events_wait(uint32_t timeout_ms) {
+    uint32_t start = get_timestamp_ms();
+    
+    while (1) {
+        uint32_t now = get_timestamp_ms();
+        uint32_t next_timer = events_run_timers(now);
+        
+        uint32_t events = __atomic_exchange_n(&pending, 0, __ATOMIC_ACQUIRE);
+        if (events != 0) {
+            return events;
+        }
+        
+        uint32_t elapsed = now - start;
+        if (timeout_ms != EVENT_WAIT_FOREVER && elapsed >= timeout_ms) {
+            return 0;
+        }
+        
+        uint32_t wait = next_timer;
+        if (timeout_ms != EVENT_WAIT_FOREVER && timeout_ms - elapsed < wait) {
+            wait = timeout_ms - elapsed;
+        }
+        
+        struct pollfd fds[2] = {
+            { wake_pipe[0], POLLIN, 0 },
+            { watched_fd, POLLIN, 0 }
+        };
+        int nfds = watched_fd >= 0 ? 2 : 1;
+        int ready = poll(fds, nfds, wait == EVENT_WAIT_FOREVER ? -1 : (int)wait);
+        
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            uint8_t drain[16];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        if (ready > 0 && nfds == 2 && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            __atomic_fetch_or(&pending, EVENT_SOCKET_READABLE, __ATOMIC_RELEASE);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#include "arunika.h"
+
+// Config and audio cache partition access. On ESP32 this is a raw data
+// partition read through the MMU cache, so records and cached clips are
+// used in place without copying.
+// The host build emulates NOR flash in RAM: erase sets a sector to 0xFF
+// and programming can only clear bits.
+
+#define FLASH_PARTITION_SIZE (FLASH_PARTITION_SECTORS * FLASH_SECTOR_SIZE)
+
+// TODO: esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ..., "arunika_cfg")
+// Word storage keeps mapped records aligned like the real MMU window. Its
+// own section keeps the emulated part out of the check-ram total
+static uint32_t flash_words[FLASH_PARTITION_SIZE / 4] __attribute__((section(".bss.flash")));
+#define flash_partition ((uint8_t *)flash_words)
+static bool flash_initialized = false;
+
+int flash_init(void) {
+    if (!flash_initialized) {
+        // A blank part reads as erased
+        memset(flash_words, 0xFF, sizeof(flash_words));
+        flash_initialized = true;
+    }
+    return ARUNIKA_OK;
+}
+
+int flash_erase_sector(uint32_t sector) {
+    if (!flash_initialized || sector >= FLASH_PARTITION_SECTORS) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // TODO: esp_partition_erase_range()
+    memset(&flash_partition[sector * FLASH_SECTOR_SIZE], 0xFF, FLASH_SECTOR_SIZE);
+    return ARUNIKA_OK;
+}
+
+int flash_write(uint32_t offset, const void *data, size_t len) {
+    if (!flash_initialized || !data || offset > FLASH_PARTITION_SIZE || len > FLASH_PARTITION_SIZE - offset) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // TODO: esp_partition_write()
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        flash_partition[offset + i] &= bytes[i];
+    }
+    return ARUNIKA_OK;
+}
+
+const uint8_t *flash_map(uint32_t offset, size_t len) {
+    if (!flash_initialized || offset > FLASH_PARTITION_SIZE || len > FLASH_PARTITION_SIZE - offset) {
+        return NULL;
+    }
+    
+    // TODO: esp_partition_mmap() once at mount
+    return &flash_partition[offset];
+}
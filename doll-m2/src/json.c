@@ -0,0 +1,318 @@
+#include "arunika.h"
+
+// Streaming tokenizer for the server's control messages, which are flat
+// JSON objects. Text is fed in whatever fragments the WebSocket delivers.
+// A value that lies inside one fragment is reported as a span into that
+// fragment without copying; only values split across fragments are
+// carried over in stream->value. Keys are always short and are copied.
+// String values the handler chooses to stream (audio_data) go straight
+// to chunk() piece by piece, so their size is unbounded.
+
+enum {
+    JSON_ST_BEGIN,   // Before the opening brace
+    JSON_ST_FIRST,   // After '{': a key or '}'
+    JSON_ST_MEMBER,  // After ',': a key
+    JSON_ST_KEY,
+    JSON_ST_COLON,
+    JSON_ST_VALUE,
+    JSON_ST_STRING,
+    JSON_ST_SCALAR,
+    JSON_ST_NESTED,
+    JSON_ST_NEXT,    // After a value: ',' or '}'
+    JSON_ST_DONE,
+    JSON_ST_ERROR
+};
+
+static bool json_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+void json_stream_init(json_stream_t *stream, const json_handler_t *handler) {
+    memset(stream, 0, sizeof(*stream));
+    stream->handler = handler;
+    stream->state = JSON_ST_BEGIN;
+}
+
+bool json_span_equals(const json_span_t *span, const char *text) {
+    size_t len = strlen(text);
+    return span->len == len && memcmp(span->ptr, text, len) == 0;
+}
+
+// Plain non-negative integers only, as the protocol's rates and sizes are
+int json_span_to_u32(const json_span_t *span, uint32_t *value) {
+    if (!span || !value || span->len == 0 || span->len > 10) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    uint64_t result = 0;
+    for (size_t i = 0; i < span->len; i++) {
+        char c = span->ptr[i];
+        if (c < '0' || c > '9') {
+            return ARUNIKA_ERROR_INVALID_PARAM;
+        }
+        result = result * 10 + (uint64_t)(c - '0');
+    }
+    if (result > UINT32_MAX) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    *value = (uint32_t)result;
+    return ARUNIKA_OK;
+}
+
+static int json_fail(json_stream_t *stream, int error) {
+    stream->state = JSON_ST_ERROR;
+    stream->error = error;
+    return error;
+}
+
+// Keeps the part of a value that reached the end of a fragment
+static void json_carry(json_stream_t *stream, const char *data, size_t len) {
+    if (stream->value_overflow || stream->value_len + len > sizeof(stream->value)) {
+        stream->value_overflow = true;
+        return;
+    }
+    memcpy(stream->value + stream->value_len, data, len);
+    stream->value_len += len;
+}
+
+// Delivers a finished value; oversized ones are dropped
+static int json_emit(json_stream_t *stream, const char *data, size_t len) {
+    json_span_t value = { data, len };
+    if (stream->value_len > 0 || stream->value_overflow) {
+        json_carry(stream, data, len);
+        value.ptr = stream->value;
+        value.len = stream->value_len;
+    }
+    
+    bool dropped = stream->value_overflow || stream->key_len > sizeof(stream->key);
+    stream->value_len = 0;
+    stream->value_overflow = false;
+    stream->state = JSON_ST_NEXT;
+    if (dropped || !stream->handler->field) {
+        return ARUNIKA_OK;
+    }
+    
+    json_span_t key = { stream->key, stream->key_len };
+    return stream->handler->field(&key, stream->type, &value, stream->handler->ctx);
+}
+
+static int json_chunk(json_stream_t *stream, const char *data, size_t len) {
+    json_span_t key = { stream->key, stream->key_len };
+    return stream->handler->chunk(&key, data, len, stream->handler->ctx);
+}
+
+int json_stream_feed(json_stream_t *stream, const char *data, size_t len) {
+    if (!stream || (!data && len > 0)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (stream->state == JSON_ST_ERROR) {
+        return stream->error;
+    }
+    
+    // Start of the current value in this fragment; values carried over
+    // from the previous fragment continue at its first byte
+    size_t mark = 0;
+    int result = ARUNIKA_OK;
+    
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        
+        switch (stream->state) {
+            case JSON_ST_BEGIN:
+            case JSON_ST_DONE:
+                if (c == '{' && stream->state == JSON_ST_BEGIN) {
+                    stream->state = JSON_ST_FIRST;
+                } else if (!json_is_space(c)) {
+                    return json_fail(stream, ARUNIKA_ERROR_INVALID_PARAM);
+                }
+                break;
+            
+            case JSON_ST_FIRST:
+            case JSON_ST_MEMBER:
+                if (c == '"') {
+                    stream->key_len = 0;
+                    stream->escape = false;
+                    stream->state = JSON_ST_KEY;
+                } else if (c == '}' && stream->state == JSON_ST_FIRST) {
+                    stream->state = JSON_ST_DONE;
+                } else if (!json_is_space(c)) {
+                    return json_fail(stream, ARUNIKA_ERROR_INVALID_PARAM);
+                }
+                break;
+            
+            case JSON_ST_KEY:
+                if (c == '"' && !stream->escape) {
+                    stream->state = JSON_ST_COLON;
+                } else {
+                    // One past the buffer marks an oversized key; it is skipped
+                    stream->escape = !stream->escape && c == '\\';
+                    if (stream->key_len < sizeof(stream->key)) {
+                        stream->key[stream->key_len] = c;
+                    }
+                    if (stream->key_len <= sizeof(stream->key)) {
+                        stream->key_len++;
+                    }
+                }
+                break;
+            
+            case JSON_ST_COLON:
+                if (c == ':') {
+                    stream->state = JSON_ST_VALUE;
+                } else if (!json_is_space(c)) {
+                    return json_fail(stream, ARUNIKA_ERROR_INVALID_PARAM);
+                }
+                break;
+            
+            case JSON_ST_VALUE:
+                if (json_is_space(c)) {
+                    break;
+                }
+                stream->escape = false;
+                if (c == '"') {
+                    json_span_t key = { stream->key, stream->key_len };
+                    stream->type = JSON_STRING;
+                    stream->streaming = stream->key_len <= sizeof(stream->key) && stream->handler->stream &&
+                                        stream->handler->chunk &&
+                                        stream->handler->stream(&key, stream->handler->ctx);
+                    stream->state = JSON_ST_STRING;
+                    mark = i + 1;
+                } else if (c == '{' || c == '[') {
+                    stream->type = c == '{' ? JSON_OBJECT : JSON_ARRAY;
+                    stream->depth = 1;
+                    stream->nested_string = false;
+                    stream->state = JSON_ST_NESTED;
+                    mark = i;
+                } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+                    stream->type = c == 't' || c == 'f' || c == 'n' ? JSON_LITERAL : JSON_NUMBER;
+                    stream->state = JSON_ST_SCALAR;
+                    mark = i;
+                } else {
+                    return json_fail(stream, ARUNIKA_ERROR_INVALID_PARAM);
+                }
+                break;
+            
+            case JSON_ST_STRING:
+                if (c == '"' && !stream->escape) {
+                    if (stream->streaming) {
+                        // A zero-length chunk marks the end of the value
+                        if (i > mark) {
+                            result = json_chunk(stream, data + mark, i - mark);
+                        }
+                        if (result == ARUNIKA_OK) {
+                            result = json_chunk(stream, data + i, 0);
+                        }
+                        stream->streaming = false;
+                        stream->state = JSON_ST_NEXT;
+                    } else {
+                        result = json_emit(stream, data + mark, i - mark);
+                    }
+                } else {
+                    stream->escape = !stream->escape && c == '\\';
+                }
+                break;
+            
+            case JSON_ST_SCALAR:
+                if (json_is_space(c) || c == ',' || c == '}') {
+                    result = json_emit(stream, data + mark, i - mark);
+                    i--; // The terminator belongs to JSON_ST_NEXT
+                } else if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '.' || c == '-' ||
+                             c == '+' || c == 'E')) {
+                    return json_fail(stream, ARUNIKA_ERROR_INVALID_PARAM);
+                }
+                break;
+            
+            case JSON_ST_NESTED:
+                if (stream->nested_string) {
+                    if (c == '"' && !stream->escape) {
+                        stream->nested_string = false;
+                    }
+                    stream->escape = !stream->escape && c == '\\';
+                } else if (c == '"') {
+                    stream->nested_string = true;
+                } else if (c == '{' || c == '[') {
+                    if (++stream->depth == 0) {
+                        return json_fail(stream, ARUNIKA_ERROR_INVALID_PARAM);
+                    }
+                } else if ((c == '}' || c == ']') && --stream->depth == 0) {
+                    result = json_emit(stream, data + mark, i + 1 - mark);
+                }
+                break;
+            
+            case JSON_ST_NEXT:
+                if (c == ',') {
+                    stream->state = JSON_ST_MEMBER;
+                } else if (c == '}') {
+                    stream->state = JSON_ST_DONE;
+                } else if (!json_is_space(c)) {
+                    return json_fail(stream, ARUNIKA_ERROR_INVALID_PARAM);
+                }
+                break;
+            
+            default:
+                return json_fail(stream, ARUNIKA_ERROR_INVALID_PARAM);
+        }
+        
+        if (result != ARUNIKA_OK) {
+            return json_fail(stream, result);
+        }
+    }
+    
+    // Hand over the unfinished part of a value to the next fragment
+    if (stream->state == JSON_ST_STRING && stream->streaming) {
+        if (len > mark) {
+            result = json_chunk(stream, data + mark, len - mark);
+        }
+    } else if (stream->state == JSON_ST_STRING || stream->state == JSON_ST_SCALAR ||
+               stream->state == JSON_ST_NESTED) {
+        json_carry(stream, data + mark, len - mark);
+    }
+    
+    return result == ARUNIKA_OK ? ARUNIKA_OK : json_fail(stream, result);
+}
+
+int json_stream_finish(json_stream_t *stream) {
+    if (!stream) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (stream->state == JSON_ST_ERROR) {
+        return stream->error;
+    }
+    
+    // Anything short of the closing brace is a truncated message
+    return stream->state == JSON_ST_DONE ? ARUNIKA_OK : ARUNIKA_ERROR_INVALID_PARAM;
+}
+
+typedef struct {
+    const char *key;
+    json_span_t *value;
+    bool found;
+} json_lookup_t;
+
+static int json_lookup_field(const json_span_t *key, json_type_t type, const json_span_t *value, void *ctx) {
+    json_lookup_t *lookup = (json_lookup_t *)ctx;
+    (void)type;
+    if (!lookup->found && json_span_equals(key, lookup->key)) {
+        *lookup->value = *value;
+        lookup->found = true;
+    }
+    return ARUNIKA_OK;
+}
+
+int json_get_field(const char *json, size_t len, const char *key, json_span_t *value) {
+    if (!json || !key || !value) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // One fragment, so the span points into json itself
+    json_lookup_t lookup = { key, value, false };
+    json_handler_t handler = { json_lookup_field, NULL, NULL, &lookup };
+    json_stream_t stream;
+    json_stream_init(&stream, &handler);
+    
+    int result = json_stream_feed(&stream, json, len);
+    if (result != ARUNIKA_OK) {
+        return result;
+    }
+    return lookup.found ? ARUNIKA_OK : ARUNIKA_ERROR_INVALID_PARAM;
+}
@@ -1,9 +1,43 @@
 #include "arunika.h"
 
+// The socket-backed bench build runs on the host's network stack: names go
+// through the host resolver and there is no air time to simulate
+#if defined(ARUNIKA_WS_SOCKET) && !defined(ESP_PLATFORM)
+#define NETWORK_HOST_STACK
+#include <netdb.h>
+#include <netinet/in.h>
+#endif
+
 // Global network state
 static bool network_initialized = false;
 static bool wifi_connected = false;
 
+// Resolved server addresses, reused across reconnects and deep sleep
+typedef struct {
+    bool valid;
+    char host[MAX_HOST_LENGTH];
+    network_addr_t addr;
+    uint32_t expires_ms;
+} dns_cache_entry_t;
+
+static ARUNIKA_RTC_DATA dns_cache_entry_t dns_cache[NET_DNS_CACHE_ENTRIES];
+
+// Fast-connect state, seeded from the config and handed back after connect
+static wifi_cache_t wifi_cache;
+static wifi_connect_stats_t wifi_stats;
+
+// Simulated access point and air time for the host build
+#define WIFI_SIM_SCAN_MS 1200
+#define WIFI_SIM_ASSOCIATE_MS 150
+#define WIFI_SIM_DHCP_MS 250
+static const uint8_t wifi_sim_bssid[6] = { 0x02, 0x1A, 0x11, 0x00, 0x00, 0x01 };
+static const uint8_t wifi_sim_channel = 6;
+#ifdef NETWORK_HOST_STACK
+#define WIFI_SIM_AIRTIME(ms) do { } while (0)
+#else
+#define WIFI_SIM_AIRTIME(ms) delay_ms(ms)
+#endif
+
 int network_init(void) {
     printf("Initializing network subsystem...\n");
     
@@ -16,22 +50,87 @@ int network_init(void) {
     return ARUNIKA_OK;
 }
 
+// Scan with the cached BSSID and channel pinned. Fails when the AP moved
+// channel or was replaced, so the caller can fall back to a full scan.
+static int network_associate_cached(const char *ssid, const char *password) {
+    // TODO: wifi_config_t.sta with bssid_set, bssid, channel and
+    // scan_method = WIFI_FAST_SCAN, then esp_wifi_connect()
+    (void)ssid;
+    (void)password;
+    
+    // Simulate a single-channel probe plus the WPA2 4-way handshake
+    WIFI_SIM_AIRTIME(WIFI_SIM_ASSOCIATE_MS);
+    if (!wifi_cache.valid || wifi_cache.channel != wifi_sim_channel ||
+        memcmp(wifi_cache.bssid, wifi_sim_bssid, sizeof(wifi_sim_bssid)) != 0) {
+        return ARUNIKA_ERROR_NETWORK;
+    }
+    return ARUNIKA_OK;
+}
+
+static int network_associate_scan(const char *ssid, const char *password) {
+    // TODO: esp_wifi_scan_start() across all channels, pick the strongest
+    // BSSID for ssid and connect with WPA/WPA2 authentication
+    (void)password;
+    printf("Scanning for %s...\n", ssid);
+    
+    // Simulate a full active scan and association
+    WIFI_SIM_AIRTIME(WIFI_SIM_SCAN_MS + WIFI_SIM_ASSOCIATE_MS);
+    memcpy(wifi_cache.bssid, wifi_sim_bssid, sizeof(wifi_sim_bssid));
+    wifi_cache.channel = wifi_sim_channel;
+    return ARUNIKA_OK;
+}
+
+static int network_configure_ip(void) {
+    if (wifi_cache.use_static_ip) {
+        // TODO: esp_netif_dhcpc_stop(), esp_netif_set_ip_info() and esp_netif_set_dns_info()
+        wifi_stats.dhcp_skipped++;
+        return ARUNIKA_OK;
+    }
+    
+    // TODO: Wait for IP_EVENT_STA_GOT_IP
+    // Simulate a DHCP exchange
+    WIFI_SIM_AIRTIME(WIFI_SIM_DHCP_MS);
+    return ARUNIKA_OK;
+}
+
 int network_connect_wifi(const char *ssid, const char *password) {
     if (!network_initialized || !ssid || !password) {
         return ARUNIKA_ERROR_INVALID_PARAM;
     }
     
     printf("Connecting to WiFi: %s\n", ssid);
+    uint32_t start_ms = get_timestamp_ms();
     
-    // TODO: Actual WiFi connection implementation
-    // TODO: Handle WPA/WPA2 authentication
     // TODO: Implement connection timeout and retry logic
+    int result = ARUNIKA_ERROR_NETWORK;
+    if (wifi_cache.valid) {
+        result = network_associate_cached(ssid, password);
+        if (result == ARUNIKA_OK) {
+            wifi_stats.fast_connects++;
+        } else {
+            printf("Cached BSSID/channel stale, scanning\n");
+            wifi_stats.fast_fallbacks++;
+            wifi_cache.valid = false;
+        }
+    }
+    if (result != ARUNIKA_OK) {
+        result = network_associate_scan(ssid, password);
+        if (result != ARUNIKA_OK) {
+            return result;
+        }
+        wifi_stats.full_connects++;
+    }
     
-    // Simulate connection delay
-    delay_ms(2000);
+    result = network_configure_ip();
+    if (result != ARUNIKA_OK) {
+        return result;
+    }
     
+    wifi_cache.valid = true;
     wifi_connected = true;
-    printf("WiFi connected successfully\n");
+    wifi_stats.last_connect_ms = get_timestamp_ms() - start_ms;
+    printf("WiFi connected in %u ms (channel %u)\n", (unsigned)wifi_stats.last_connect_ms,
+           (unsigned)wifi_cache.channel);
     
     return ARUNIKA_OK;
 }
@@ -54,3 +153,115 @@ int network_disconnect_wifi(void) {
 bool network_is_connected(void) {
     return wifi_connected;
 }
+
+void network_set_wifi_cache(const wifi_cache_t *cache) {
+    if (cache) {
+        wifi_cache = *cache;
+    }
+}
+
+void network_get_wifi_cache(wifi_cache_t *cache) {
+    if (cache) {
+        *cache = wifi_cache;
+    }
+}
+
+void network_get_wifi_stats(wifi_connect_stats_t *stats) {
+    if (stats) {
+        *stats = wifi_stats;
+    }
+}
+
+static dns_cache_entry_t *network_find_host(const char *host) {
+    for (int i = 0; i < NET_DNS_CACHE_ENTRIES; i++) {
+        if (dns_cache[i].valid && strcmp(dns_cache[i].host, host) == 0) {
+            return &dns_cache[i];
+        }
+    }
+    return NULL;
+}
+
+int network_resolve(const char *host, network_addr_t *addr, bool *cached) {
+    if (!host || !addr || strlen(host) >= MAX_HOST_LENGTH) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // The cache lives in RTC memory, so it expires on the RTC clock
+    uint32_t now = get_rtc_time_ms();
+    dns_cache_entry_t *entry = network_find_host(host);
+    if (entry && (int32_t)(entry->expires_ms - now) > 0) {
+        *addr = entry->addr;
+        if (cached) {
+            *cached = true;
+        }
+        return ARUNIKA_OK;
+    }
+    
+    // Loopback needs neither the radio nor a resolver
+    if (strcmp(host, "localhost") == 0) {
+        network_addr_t loopback = { { 127, 0, 0, 1 } };
+        *addr = loopback;
+        if (cached) {
+            *cached = false;
+        }
+        return ARUNIKA_OK;
+    }
+#ifdef NETWORK_HOST_STACK
+    // make bench: the host's own resolver, and its network is always up
+    network_addr_t resolved;
+    struct addrinfo hints;
+    struct addrinfo *info;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, NULL, &hints, &info) != 0) {
+        return ARUNIKA_ERROR_NETWORK;
+    }
+    memcpy(resolved.addr, &((struct sockaddr_in *)info->ai_addr)->sin_addr, sizeof(resolved.addr));
+    freeaddrinfo(info);
+#else
+    if (!wifi_connected) {
+        return ARUNIKA_ERROR_NETWORK;
+    }
+    
+    printf("Resolving %s...\n", host);
+    
+    // TODO: lwip_getaddrinfo(), honouring the record TTL
+    // Simulate resolver round trip
+    delay_ms(100);
+    network_addr_t resolved = { { 127, 0, 0, 1 } };
+#endif
+    
+    // Reuse the host's slot, else a free one, else the one expiring first
+    if (!entry) {
+        entry = &dns_cache[0];
+        for (int i = 0; i < NET_DNS_CACHE_ENTRIES; i++) {
+            if (!dns_cache[i].valid) {
+                entry = &dns_cache[i];
+                break;
+            }
+            if ((int32_t)(dns_cache[i].expires_ms - entry->expires_ms) < 0) {
+                entry = &dns_cache[i];
+            }
+        }
+    }
+    
+    snprintf(entry->host, sizeof(entry->host), "%s", host);
+    entry->addr = resolved;
+    entry->expires_ms = now + NET_DNS_TTL_MS_DEFAULT;
+    entry->valid = true;
+    
+    *addr = resolved;
+    if (cached) {
+        *cached = false;
+    }
+    return ARUNIKA_OK;
+}
+
+void network_forget_host(const char *host) {
+    // A connect failure may mean the server moved, so resolve afresh
+    dns_cache_entry_t *entry = host ? network_find_host(host) : NULL;
+    if (entry) {
+        entry->valid = false;
+    }
+}
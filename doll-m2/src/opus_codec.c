@@ -0,0 +1,184 @@
+#include "arunika.h"
+
+// Opus wideband codec. Encoder and decoder state live in static arenas
+// sized at compile time, so there is no heap use per frame or per session.
+// Build with OPUS=1 to link libopus; otherwise the codec reports itself
+// unavailable and negotiation falls back to G.711.
+
+#ifdef ARUNIKA_HAVE_OPUS
+#include <opus/opus.h>
+
+static ARUNIKA_PSRAM_BSS union {
+    uint8_t bytes[OPUS_ENCODER_ARENA_SIZE];
+    uint64_t align;
+} encoder_arena;
+
+static ARUNIKA_PSRAM_BSS union {
+    uint8_t bytes[OPUS_DECODER_ARENA_SIZE];
+    uint64_t align;
+} decoder_arena;
+
+static OpusEncoder *encoder = NULL;
+static OpusDecoder *decoder = NULL;
+#endif
+
+static opus_codec_config_t active_config = {
+    OPUS_FRAME_MS_DEFAULT, OPUS_COMPLEXITY_DEFAULT, OPUS_BITRATE_DEFAULT
+};
+static uint32_t active_sample_rate = 0;
+static opus_codec_stats_t stats;
+
+bool audio_opus_available(void) {
+#ifdef ARUNIKA_HAVE_OPUS
+    return true;
+#else
+    return false;
+#endif
+}
+
+static bool opus_config_valid(uint32_t sample_rate, const opus_codec_config_t *config) {
+    if (sample_rate != 8000 && sample_rate != 12000 && sample_rate != 16000 &&
+        sample_rate != 24000 && sample_rate != 48000) {
+        return false;
+    }
+    if (config->frame_ms != 10 && config->frame_ms != 20 &&
+        config->frame_ms != 40 && config->frame_ms != 60) {
+        return false;
+    }
+    if (sample_rate * config->frame_ms / 1000 > OPUS_MAX_FRAME_SAMPLES) {
+        return false;
+    }
+    return config->complexity <= 10 && config->bitrate >= 6000 && config->bitrate <= 510000;
+}
+
+int audio_opus_init(uint32_t sample_rate, const opus_codec_config_t *config) {
+    if (!config || !opus_config_valid(sample_rate, config)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+
+#ifdef ARUNIKA_HAVE_OPUS
+    if (opus_encoder_get_size(CHANNELS) > (int)sizeof(encoder_arena.bytes) ||
+        opus_decoder_get_size(CHANNELS) > (int)sizeof(decoder_arena.bytes)) {
+        printf("Opus state does not fit the static arenas\n");
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    encoder = (OpusEncoder *)encoder_arena.bytes;
+    if (opus_encoder_init(encoder, (opus_int32)sample_rate, CHANNELS, OPUS_APPLICATION_VOIP) != OPUS_OK) {
+        encoder = NULL;
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE((opus_int32)config->bitrate));
+    opus_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(config->complexity));
+    opus_encoder_ctl(encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    
+    decoder = (OpusDecoder *)decoder_arena.bytes;
+    if (opus_decoder_init(decoder, (opus_int32)sample_rate, CHANNELS) != OPUS_OK) {
+        decoder = NULL;
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    
+    active_config = *config;
+    active_sample_rate = sample_rate;
+    memset(&stats, 0, sizeof(stats));
+    
+    printf("Opus codec initialized: %u Hz, %u ms frames, complexity %u, %u bps\n",
+           (unsigned)sample_rate, config->frame_ms, config->complexity, (unsigned)config->bitrate);
+    return ARUNIKA_OK;
+#else
+    (void)active_sample_rate;
+    return ARUNIKA_ERROR_AUDIO;
+#endif
+}
+
+size_t audio_opus_frame_samples(void) {
+    return active_sample_rate * active_config.frame_ms / 1000;
+}
+
+int audio_opus_encode(const int16_t *pcm, size_t samples, uint8_t *packet, size_t packet_capacity) {
+    if (!pcm || !packet || samples != audio_opus_frame_samples()) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+
+#ifdef ARUNIKA_HAVE_OPUS
+    if (!encoder) {
+        return ARUNIKA_ERROR_INIT;
+    }
+    
+    uint32_t start = get_timestamp_us();
+    int len = opus_encode(encoder, pcm, (int)samples, packet, (opus_int32)packet_capacity);
+    uint32_t elapsed = get_timestamp_us() - start;
+    
+    if (len < 0) {
+        stats.errors++;
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    
+    stats.frames_encoded++;
+    stats.bytes_out += (uint32_t)len;
+    stats.last_encode_us = elapsed;
+    stats.total_encode_us += elapsed;
+    if (elapsed > stats.max_encode_us) {
+        stats.max_encode_us = elapsed;
+    }
+    
+    return len;
+#else
+    (void)packet_capacity;
+    return ARUNIKA_ERROR_AUDIO;
+#endif
+}
+
+int audio_opus_decode(const uint8_t *packet, size_t len, int16_t *pcm, size_t max_samples) {
+    if (!pcm || (!packet && len > 0)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+
+#ifdef ARUNIKA_HAVE_OPUS
+    if (!decoder) {
+        return ARUNIKA_ERROR_INIT;
+    }
+    
+    // A NULL packet asks the decoder to conceal a lost frame
+    int samples = opus_decode(decoder, packet, (opus_int32)len, pcm, (int)max_samples, 0);
+    if (samples < 0) {
+        stats.errors++;
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    
+    stats.frames_decoded++;
+    return samples;
+#else
+    (void)max_samples;
+    return ARUNIKA_ERROR_AUDIO;
+#endif
+}
+
+// Retunes the running encoder; the frame size and decoder are unchanged
+int audio_opus_set_rate(uint32_t bitrate, uint8_t complexity) {
+    opus_codec_config_t config = active_config;
+    config.bitrate = bitrate;
+    config.complexity = complexity;
+    if (active_sample_rate == 0 || !opus_config_valid(active_sample_rate, &config)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+
+#ifdef ARUNIKA_HAVE_OPUS
+    if (!encoder) {
+        return ARUNIKA_ERROR_INIT;
+    }
+    
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE((opus_int32)bitrate));
+    opus_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(complexity));
+    active_config = config;
+    return ARUNIKA_OK;
+#else
+    return ARUNIKA_ERROR_AUDIO;
+#endif
+}
+
+void audio_opus_get_stats(opus_codec_stats_t *out) {
+    if (out) {
+        *out = stats;
+    }
+}
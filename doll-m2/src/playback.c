@@ -0,0 +1,433 @@
+#include "arunika.h"
+
+// Streaming playback: response audio is decoded to PCM16 as it arrives and
+// queued in a jitter buffer that the I2S TX DMA completion drains. Playback
+// starts once the adaptive prebuffer threshold is met instead of after the
+// whole response has been downloaded.
+//
+// The buffer is a single-producer/single-consumer sample ring. head and the
+// pipeline state are written only by the main loop, tail and the DMA-side
+// counters only by the TX callback. Flushing is requested through
+// discard_upto so the producer never writes tail.
+
+#define PLAYBACK_MASK (PLAYBACK_JITTER_SAMPLES - 1)
+
+#define PB_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define PB_LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define PB_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+// Capacity must be a power of two for the index mask to work
+typedef char playback_samples_power_of_two[(PLAYBACK_JITTER_SAMPLES & PLAYBACK_MASK) == 0 ? 1 : -1];
+// and hold the largest prebuffer with room to spare
+typedef char playback_samples_hold_prebuffer[PLAYBACK_JITTER_SAMPLES > PLAYBACK_PREBUFFER_MAX_MS * (SAMPLE_RATE / 1000) ? 1 : -1];
+
+static int16_t jitter[PLAYBACK_JITTER_SAMPLES];
+static uint32_t head = 0;         // Producer
+static uint32_t tail = 0;         // Consumer
+static uint32_t discard_upto = 0; // Producer; consumer skips tail forward to it
+static playback_state_t state = PLAYBACK_STATE_IDLE;
+
+static audio_format_t stream_format = AUDIO_FORMAT_PCM;
+#ifdef ARUNIKA_PCM16
+static uint8_t pcm_carry = 0; // Odd trailing byte of a PCM16 fragment
+#endif
+static bool has_carry = false;
+static int16_t decode_staging[AUDIO_CHUNK_SAMPLES];
+
+// Responses at another rate are converted to SAMPLE_RATE before the
+// jitter buffer, so the TX callback and the echo canceller never see it
+static resampler_t stream_resampler;
+static int16_t resample_staging[AUDIO_CHUNK_SAMPLES];
+
+// Adaptive prebuffer: grows on underruns, decays after clean responses
+static uint32_t min_prebuffer_ms = PLAYBACK_PREBUFFER_MS_DEFAULT;
+static uint32_t target_prebuffer_ms = PLAYBACK_PREBUFFER_MS_DEFAULT;
+
+// Written by the TX callback
+static uint32_t underruns = 0;
+static uint32_t first_sound_ms = 0;
+static uint32_t first_sound_pending = 0;
+
+// Main loop bookkeeping
+static uint32_t stream_start_ms = 0;
+static uint32_t underruns_seen = 0;
+static uint32_t underruns_at_start = 0;
+static uint32_t overflows = 0;
+static uint32_t responses = 0;
+
+static uint32_t playback_buffered(void) {
+    uint32_t h = PB_LOAD_RELAXED(&head);
+    uint32_t t = PB_LOAD_ACQUIRE(&tail);
+    uint32_t d = PB_LOAD_RELAXED(&discard_upto);
+    
+    // A pending discard hides everything before it
+    if ((int32_t)(t - d) < 0) {
+        t = d;
+    }
+    return h - t;
+}
+
+static uint32_t ms_to_samples(uint32_t ms) {
+    return ms * SAMPLE_RATE / 1000;
+}
+
+static void playback_discard(void) {
+    PB_STORE_RELEASE(&discard_upto, PB_LOAD_RELAXED(&head));
+    has_carry = false;
+}
+
+// Copies samples into the ring; returns how many fit. A response being
+// cached is stored as it arrives, at SAMPLE_RATE after any resampling
+static size_t playback_push(const int16_t *samples, size_t count) {
+    if (audio_cache_storing()) {
+        audio_cache_store_pcm(samples, count);
+    }
+    
+    uint32_t space = PLAYBACK_JITTER_SAMPLES - playback_buffered();
+    size_t accepted = count > space ? space : count;
+    uint32_t h = PB_LOAD_RELAXED(&head);
+    
+    size_t first = PLAYBACK_JITTER_SAMPLES - (h & PLAYBACK_MASK);
+    if (first > accepted) {
+        first = accepted;
+    }
+    memcpy(&jitter[h & PLAYBACK_MASK], samples, first * sizeof(int16_t));
+    memcpy(jitter, samples + first, (accepted - first) * sizeof(int16_t));
+    
+    PB_STORE_RELEASE(&head, h + (uint32_t)accepted);
+    return accepted;
+}
+
+// Pushes decoded samples through the stream's resampler. Returns how many
+// output samples fit; the rest are added to dropped
+static size_t playback_push_decoded(const int16_t *samples, size_t count, size_t *dropped) {
+    if (!resampler_active(&stream_resampler)) {
+        size_t accepted = playback_push(samples, count);
+        *dropped += count - accepted;
+        return accepted;
+    }
+    
+    // Input slices small enough that their output fits the staging block
+    size_t slice = AUDIO_CHUNK_SAMPLES * stream_resampler.down / stream_resampler.up - 1;
+    size_t pushed = 0;
+    while (count > 0) {
+        size_t n = count < slice ? count : slice;
+        int produced = resampler_process(&stream_resampler, samples, n, resample_staging, AUDIO_CHUNK_SAMPLES);
+        if (produced > 0) {
+            size_t accepted = playback_push(resample_staging, (size_t)produced);
+            pushed += accepted;
+            *dropped += (size_t)produced - accepted;
+        }
+        samples += n;
+        count -= n;
+    }
+    return pushed;
+}
+
+// Expands G.711 codes straight into the ring; returns how many fit
+static size_t playback_push_g711(const uint8_t *codes, size_t count) {
+    if (audio_cache_storing()) {
+        audio_cache_store_g711(codes, count, stream_format);
+    }
+    
+    uint32_t space = PLAYBACK_JITTER_SAMPLES - playback_buffered();
+    size_t accepted = count > space ? space : count;
+    uint32_t h = PB_LOAD_RELAXED(&head);
+    
+    size_t first = PLAYBACK_JITTER_SAMPLES - (h & PLAYBACK_MASK);
+    if (first > accepted) {
+        first = accepted;
+    }
+    audio_codec_decode_to(codes, first, stream_format, &jitter[h & PLAYBACK_MASK]);
+    audio_codec_decode_to(codes + first, accepted - first, stream_format, jitter);
+    
+    PB_STORE_RELEASE(&head, h + (uint32_t)accepted);
+    return accepted;
+}
+
+#ifdef ARUNIKA_PCM16
+// Copies little-endian PCM16 bytes, carrying an odd byte to the next call
+static size_t playback_push_pcm(const uint8_t *data, size_t len, size_t *dropped) {
+    size_t pushed = 0;
+    
+    if (has_carry && len > 0) {
+        uint8_t pair[2] = { pcm_carry, data[0] };
+        int16_t sample;
+        memcpy(&sample, pair, sizeof(sample));
+        pushed += playback_push_decoded(&sample, 1, dropped);
+        has_carry = false;
+        data++;
+        len--;
+    }
+    
+    while (len >= 2) {
+        size_t count = len / 2;
+        if (count > AUDIO_CHUNK_SAMPLES) {
+            count = AUDIO_CHUNK_SAMPLES;
+        }
+        memcpy(decode_staging, data, count * sizeof(int16_t));
+        pushed += playback_push_decoded(decode_staging, count, dropped);
+        data += count * 2;
+        len -= count * 2;
+    }
+    
+    if (len == 1) {
+        pcm_carry = data[0];
+        has_carry = true;
+    }
+    
+    return pushed;
+}
+#endif
+
+static void playback_check_prebuffer(void) {
+    if (state == PLAYBACK_STATE_BUFFERING && playback_buffered() >= ms_to_samples(target_prebuffer_ms)) {
+        PB_STORE_RELEASE(&state, PLAYBACK_STATE_PLAYING);
+    }
+}
+
+int playback_init(uint16_t prebuffer_ms) {
+    if (prebuffer_ms > PLAYBACK_PREBUFFER_MAX_MS) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    PB_STORE_RELEASE(&state, PLAYBACK_STATE_IDLE);
+    playback_discard();
+    
+    min_prebuffer_ms = prebuffer_ms;
+    target_prebuffer_ms = prebuffer_ms;
+    underruns_seen = PB_LOAD_RELAXED(&underruns);
+    overflows = 0;
+    responses = 0;
+    
+    return ARUNIKA_OK;
+}
+
+int playback_start(audio_format_t format, uint32_t sample_rate) {
+    if (format != AUDIO_FORMAT_PCM && format != AUDIO_FORMAT_MULAW &&
+        format != AUDIO_FORMAT_ALAW && format != AUDIO_FORMAT_OPUS) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+#ifndef ARUNIKA_PCM16
+    if (format == AUDIO_FORMAT_PCM) {
+        return ARUNIKA_ERROR_INVALID_PARAM; // Compiled out for this board
+    }
+#endif
+    if (format == AUDIO_FORMAT_OPUS && audio_opus_frame_samples() == 0) {
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    
+    // The Opus decoder already outputs SAMPLE_RATE, whatever was encoded
+    if (resampler_init(&stream_resampler, format == AUDIO_FORMAT_OPUS ? SAMPLE_RATE : sample_rate,
+                       SAMPLE_RATE) != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // A new response replaces whatever is still queued
+    PB_STORE_RELEASE(&state, PLAYBACK_STATE_IDLE);
+    playback_discard();
+    
+    stream_format = format;
+    stream_start_ms = get_timestamp_ms();
+    underruns_seen = PB_LOAD_RELAXED(&underruns);
+    underruns_at_start = underruns_seen;
+    PB_STORE_RELEASE(&first_sound_pending, 1);
+    
+    PB_STORE_RELEASE(&state, PLAYBACK_STATE_BUFFERING);
+    return ARUNIKA_OK;
+}
+
+int playback_feed(const uint8_t *data, size_t len) {
+    if (!data && len > 0) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (state == PLAYBACK_STATE_IDLE) {
+        return ARUNIKA_ERROR_AUDIO;
+    }
+    
+    TRACE_BEGIN(decode_start);
+    size_t dropped = 0;
+    switch (stream_format) {
+        case AUDIO_FORMAT_MULAW:
+        case AUDIO_FORMAT_ALAW:
+            if (!resampler_active(&stream_resampler)) {
+                dropped = len - playback_push_g711(data, len);
+                break;
+            }
+            for (size_t done = 0; done < len;) {
+                size_t count = len - done < AUDIO_CHUNK_SAMPLES ? len - done : AUDIO_CHUNK_SAMPLES;
+                audio_codec_decode_to(data + done, count, stream_format, decode_staging);
+                playback_push_decoded(decode_staging, count, &dropped);
+                done += count;
+            }
+            break;
+        
+        case AUDIO_FORMAT_OPUS: {
+            // Each fed fragment is exactly one packet
+            int samples = audio_opus_decode(data, len, decode_staging, AUDIO_CHUNK_SAMPLES);
+            if (samples < 0) {
+                return ARUNIKA_ERROR_AUDIO;
+            }
+            playback_push_decoded(decode_staging, (size_t)samples, &dropped);
+            break;
+        }
+
+#ifdef ARUNIKA_PCM16
+        default:
+            playback_push_pcm(data, len, &dropped);
+            break;
+#else
+        default:
+            return ARUNIKA_ERROR_AUDIO;
+#endif
+    }
+    
+    TRACE_END(TRACE_STAGE_DECODE, decode_start);
+    playback_check_prebuffer();
+    
+    if (dropped > 0) {
+        overflows += (uint32_t)dropped;
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    return ARUNIKA_OK;
+}
+
+int playback_end(void) {
+    if (state == PLAYBACK_STATE_IDLE) {
+        return ARUNIKA_OK;
+    }
+    
+    // No more audio is coming, so a short response plays without waiting
+    // for the prebuffer threshold
+    has_carry = false;
+    PB_STORE_RELEASE(&state, PLAYBACK_STATE_DRAINING);
+    return ARUNIKA_OK;
+}
+
+void playback_stop(void) {
+    PB_STORE_RELEASE(&state, PLAYBACK_STATE_IDLE);
+    playback_discard();
+}
+
+size_t playback_i2s_tx_callback(int16_t *out, size_t samples) {
+    // Runs in I2S DMA completion context: no printf, no blocking, no malloc
+    playback_state_t st = PB_LOAD_ACQUIRE(&state);
+    uint32_t t = PB_LOAD_RELAXED(&tail);
+    uint32_t d = PB_LOAD_ACQUIRE(&discard_upto);
+    if ((int32_t)(t - d) < 0) {
+        t = d;
+    }
+    
+    size_t take = 0;
+    uint32_t avail = 0;
+    if (st == PLAYBACK_STATE_PLAYING || st == PLAYBACK_STATE_DRAINING) {
+        avail = PB_LOAD_ACQUIRE(&head) - t;
+        take = samples > avail ? avail : samples;
+        
+        size_t first = PLAYBACK_JITTER_SAMPLES - (t & PLAYBACK_MASK);
+        if (first > take) {
+            first = take;
+        }
+        memcpy(out, &jitter[t & PLAYBACK_MASK], first * sizeof(int16_t));
+        memcpy(out + first, jitter, (take - first) * sizeof(int16_t));
+        t += (uint32_t)take;
+        
+        if (take > 0 && PB_LOAD_RELAXED(&first_sound_pending)) {
+            first_sound_ms = get_timestamp_ms() - stream_start_ms;
+            PB_STORE_RELEASE(&first_sound_pending, 0);
+            TRACE_CALL(trace_first_sample());
+        }
+        if (take < samples && st == PLAYBACK_STATE_PLAYING) {
+            PB_STORE_RELEASE(&underruns, underruns + 1);
+        }
+    }
+    
+    // Keep the DMA fed with silence when there is nothing to play; the
+    // echo canceller sees exactly what the speaker gets
+    memset(out + take, 0, (samples - take) * sizeof(int16_t));
+    PB_STORE_RELEASE(&tail, t);
+    aec_reference(out, samples);
+    
+    // Running dry needs the network task: rebuffer or finish the response.
+    // So does leaving congestion, since the socket is unwatched until then
+    bool was_congested = PLAYBACK_JITTER_SAMPLES - avail < PLAYBACK_JITTER_SAMPLES / 4;
+    bool congested = PLAYBACK_JITTER_SAMPLES - (avail - take) < PLAYBACK_JITTER_SAMPLES / 4;
+    if ((take < samples && st != PLAYBACK_STATE_IDLE) || (was_congested && !congested)) {
+        events_post_from_isr(EVENT_AUDIO_PLAYBACK);
+    }
+    return take;
+}
+
+int playback_poll(void) {
+    if (state == PLAYBACK_STATE_IDLE) {
+        return 0;
+    }
+    
+    // Ran dry mid-response: rebuffer with a deeper threshold
+    uint32_t seen = PB_LOAD_ACQUIRE(&underruns);
+    if (seen != underruns_seen) {
+        underruns_seen = seen;
+        if (state == PLAYBACK_STATE_PLAYING) {
+            target_prebuffer_ms += PLAYBACK_PREBUFFER_STEP_MS;
+            if (target_prebuffer_ms > PLAYBACK_PREBUFFER_MAX_MS) {
+                target_prebuffer_ms = PLAYBACK_PREBUFFER_MAX_MS;
+            }
+            PB_STORE_RELEASE(&state, PLAYBACK_STATE_BUFFERING);
+        }
+    }
+    playback_check_prebuffer();
+    
+    if (state != PLAYBACK_STATE_DRAINING || playback_buffered() > 0) {
+        return 0;
+    }
+    
+    // Response fully played; a clean one lets the prebuffer shrink again
+    uint32_t response_underruns = underruns_seen - underruns_at_start;
+    if (response_underruns == 0 && target_prebuffer_ms > min_prebuffer_ms) {
+        uint32_t decay = PLAYBACK_PREBUFFER_STEP_MS / 2;
+        target_prebuffer_ms = target_prebuffer_ms - min_prebuffer_ms > decay ?
+                              target_prebuffer_ms - decay : min_prebuffer_ms;
+    }
+    responses++;
+    PB_STORE_RELEASE(&state, PLAYBACK_STATE_IDLE);
+    
+    LOG_INFO("Playback finished: first sound after %u ms, %u underruns, prebuffer %u ms\n",
+           (unsigned)first_sound_ms, (unsigned)response_underruns, (unsigned)target_prebuffer_ms);
+    return 1;
+}
+
+playback_state_t playback_get_state(void) {
+    return state;
+}
+
+audio_format_t playback_get_format(void) {
+    return stream_format;
+}
+
+int playback_set_target_prebuffer(uint16_t prebuffer_ms) {
+    // Restores a threshold tuned in an earlier session; never below the floor
+    if (prebuffer_ms > PLAYBACK_PREBUFFER_MAX_MS) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    target_prebuffer_ms = prebuffer_ms < min_prebuffer_ms ? min_prebuffer_ms : prebuffer_ms;
+    return ARUNIKA_OK;
+}
+
+bool playback_is_congested(void) {
+    // Lets the receive path stop reading so TCP flow control pushes back
+    return PLAYBACK_JITTER_SAMPLES - playback_buffered() < PLAYBACK_JITTER_SAMPLES / 4;
+}
+
+void playback_get_stats(playback_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+    
+    stats->buffered_samples = playback_buffered();
+    stats->target_prebuffer_ms = target_prebuffer_ms;
+    stats->first_sound_ms = first_sound_ms;
+    stats->underruns = PB_LOAD_RELAXED(&underruns);
+    stats->overflows = overflows;
+    stats->responses = responses;
+}
@@ -0,0 +1,135 @@
+#include "arunika.h"
+
+// Fixed-block pools for buffers held across calls. All storage is static
+// and sized at compile time, so nothing on the pipeline touches the heap
+// and a long session cannot fragment it. Each pool keeps a bitmap of free
+// blocks updated with atomic compare-and-swap, so tasks and the capture
+// callback can acquire and release without a lock. An empty pool fails
+// the acquire and counts it; callers retry on their next pass.
+
+#define POOL_ALL_FREE(n) ((n) >= 32 ? 0xFFFFFFFFu : (1u << (n)) - 1)
+
+typedef char pool_audio_frames_fit_mask[POOL_AUDIO_FRAMES <= 32 ? 1 : -1];
+typedef char pool_ws_frames_fit_mask[POOL_WS_FRAMES <= 32 ? 1 : -1];
+
+// The buffer descriptor travels with its storage
+typedef struct {
+    audio_buffer_t buffer;
+    uint32_t storage[(AUDIO_FRAME_HEADROOM + AUDIO_BUFFER_SIZE + 3) / 4];
+} pool_audio_block_t;
+
+static pool_audio_block_t audio_blocks[POOL_AUDIO_FRAMES];
+static uint32_t ws_blocks[POOL_WS_FRAMES][(WS_RX_FRAME_SIZE + 3) / 4];
+
+typedef struct {
+    uint8_t *base;
+    uint32_t free_mask;
+    pool_stats_t stats;
+} pool_t;
+
+static pool_t pools[POOL_COUNT] = {
+    [POOL_AUDIO_FRAME] = {
+        (uint8_t *)audio_blocks, POOL_ALL_FREE(POOL_AUDIO_FRAMES),
+        { "audio", sizeof(pool_audio_block_t), POOL_AUDIO_FRAMES, 0, 0, 0, 0 }
+    },
+    [POOL_WS_FRAME] = {
+        (uint8_t *)ws_blocks, POOL_ALL_FREE(POOL_WS_FRAMES),
+        { "ws_frame", sizeof(ws_blocks[0]), POOL_WS_FRAMES, 0, 0, 0, 0 }
+    }
+};
+
+void *pool_acquire(pool_id_t id) {
+    if (id >= POOL_COUNT) {
+        return NULL;
+    }
+    
+    pool_t *pool = &pools[id];
+    uint32_t mask = __atomic_load_n(&pool->free_mask, __ATOMIC_ACQUIRE);
+    int index;
+    do {
+        if (mask == 0) {
+            __atomic_fetch_add(&pool->stats.exhausted, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        index = __builtin_ctz(mask);
+    } while (!__atomic_compare_exchange_n(&pool->free_mask, &mask, mask & ~(1u << index), true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    
+    __atomic_fetch_add(&pool->stats.acquires, 1, __ATOMIC_RELAXED);
+    uint32_t in_use = __atomic_add_fetch(&pool->stats.in_use, 1, __ATOMIC_RELAXED);
+    if (in_use > __atomic_load_n(&pool->stats.high_watermark, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&pool->stats.high_watermark, in_use, __ATOMIC_RELAXED);
+    }
+    
+    return pool->base + (size_t)index * pool->stats.block_size;
+}
+
+int pool_release(pool_id_t id, void *block) {
+    if (id >= POOL_COUNT || !block) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    pool_t *pool = &pools[id];
+    uint8_t *p = (uint8_t *)block;
+    if (p < pool->base || p >= pool->base + pool->stats.blocks * pool->stats.block_size ||
+        (size_t)(p - pool->base) % pool->stats.block_size != 0) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    size_t offset = (size_t)(p - pool->base);
+    
+    // A block that is already free means a double release
+    uint32_t bit = 1u << (offset / pool->stats.block_size);
+    if (__atomic_fetch_or(&pool->free_mask, bit, __ATOMIC_ACQ_REL) & bit) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    __atomic_fetch_sub(&pool->stats.in_use, 1, __ATOMIC_RELAXED);
+    return ARUNIKA_OK;
+}
+
+int pool_get_stats(pool_id_t id, pool_stats_t *stats) {
+    if (id >= POOL_COUNT || !stats) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    pool_t *pool = &pools[id];
+    *stats = pool->stats;
+    stats->in_use = __atomic_load_n(&pool->stats.in_use, __ATOMIC_RELAXED);
+    stats->high_watermark = __atomic_load_n(&pool->stats.high_watermark, __ATOMIC_RELAXED);
+    stats->acquires = __atomic_load_n(&pool->stats.acquires, __ATOMIC_RELAXED);
+    stats->exhausted = __atomic_load_n(&pool->stats.exhausted, __ATOMIC_RELAXED);
+    return ARUNIKA_OK;
+}
+
+void pool_print_stats(void) {
+    printf("%-10s %6s %6s %6s %6s %10s %10s\n", "pool", "block", "blocks", "in use", "peak", "acquires", "exhausted");
+    for (int i = 0; i < POOL_COUNT; i++) {
+        pool_stats_t stats;
+        pool_get_stats((pool_id_t)i, &stats);
+        printf("%-10s %6zu %6u %6u %6u %10u %10u\n", stats.name, stats.block_size, (unsigned)stats.blocks,
+               (unsigned)stats.in_use, (unsigned)stats.high_watermark, (unsigned)stats.acquires,
+               (unsigned)stats.exhausted);
+    }
+}
+
+audio_buffer_t *audio_buffer_acquire(uint32_t sample_rate, audio_format_t format) {
+    pool_audio_block_t *block = (pool_audio_block_t *)pool_acquire(POOL_AUDIO_FRAME);
+    if (!block) {
+        return NULL;
+    }
+    
+    // Same layout as a capture ring slot, headroom included
+    audio_buffer_t *buffer = &block->buffer;
+    buffer->data = (uint8_t *)block->storage + AUDIO_FRAME_HEADROOM;
+    buffer->size = 0;
+    buffer->headroom = AUDIO_FRAME_HEADROOM;
+    buffer->capacity = AUDIO_BUFFER_SIZE;
+    buffer->sample_rate = sample_rate;
+    buffer->format = format;
+    return buffer;
+}
+
+int audio_buffer_release(audio_buffer_t *buffer) {
+    // The descriptor is the first member of its block
+    return pool_release(POOL_AUDIO_FRAME, buffer);
+}
@@ -2,16 +2,27 @@
 
 // Global power state
 static bool power_initialized = false;
-static uint8_t battery_level = 85; // Simulated battery level
+static battery_status_t battery = { 0, 0, false, POWER_MODE_NORMAL, 0, 0 };
+static uint16_t drain_start_mv = 0;
+static uint32_t drain_start_ms = 0;
+static int32_t battery_mv_q4 = 0;
+static uint32_t battery_sim_mv = 3870; // Simulated cell, ~60%
+
+// Written right before deep sleep and consumed by the next boot; a cold
+// boot finds random RTC contents, which the magic and CRC reject
+static ARUNIKA_RTC_DATA resume_snapshot_t resume_snapshot;
 
 int power_init(void) {
     printf("Initializing power management...\n");
     
-    // TODO: Initialize battery monitoring
+    // TODO: adc_oneshot_new_unit() and calibration for the battery divider
     // TODO: Set up charging detection
     // TODO: Configure sleep/wake functionality
     
     power_initialized = true;
+    if (battery.samples == 0) {
+        power_sample_battery(); // Valid from the start; then on housekeeping
+    }
     printf("Power management initialized\n");
     
     return ARUNIKA_OK;
@@ -22,11 +33,24 @@ int power_enter_sleep_mode(void) {
         return ARUNIKA_ERROR_INIT;
     }
     
-    printf("Entering sleep mode...\n");
+    printf("Entering sleep mode%s...\n", resume_snapshot.magic == RESUME_SNAPSHOT_MAGIC ? " (snapshot saved)" : "");
     
     // TODO: Configure wake-up sources (button, timer)
-    // TODO: Save state before sleep
-    // TODO: Enter deep sleep mode
+    // TODO: esp_deep_sleep_start(); the wake is a reset into device_init()
+    
+    return ARUNIKA_OK;
+}
+
+int power_enter_listen_mode(void) {
+    if (!power_initialized) {
+        return ARUNIKA_ERROR_INIT;
+    }
+    
+    printf("Entering low-power listening mode...\n");
+    
+    // TODO: esp_wifi_stop() and drop the CPU clock via esp_pm_configure()
+    // TODO: Enable automatic light sleep between I2S RX DMA interrupts
+    // TODO: Move the keyword spotter onto the ULP coprocessor where supported
     
     return ARUNIKA_OK;
 }
@@ -34,33 +58,169 @@ int power_enter_sleep_mode(void) {
 int power_wake_up(void) {
     printf("Waking up from sleep mode...\n");
     
-    // TODO: Restore system state
-    // TODO: Re-initialize peripherals if needed
+    // From listen mode nothing was lost; after deep sleep device_init()
+    // restores the state through power_take_snapshot()
+    // TODO: Restore the CPU clock and WiFi stopped by power_enter_listen_mode()
     
     return ARUNIKA_OK;
 }
 
-uint8_t power_get_battery_level(void) {
-    if (!power_initialized) {
+int power_save_snapshot(const resume_snapshot_t *snapshot) {
+    if (!snapshot) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    resume_snapshot = *snapshot;
+    resume_snapshot.magic = RESUME_SNAPSHOT_MAGIC;
+    resume_snapshot.crc32 = crc32_compute(&resume_snapshot, offsetof(resume_snapshot_t, crc32));
+    return ARUNIKA_OK;
+}
+
+int power_take_snapshot(resume_snapshot_t *snapshot) {
+    if (!snapshot) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    bool valid = resume_snapshot.magic == RESUME_SNAPSHOT_MAGIC &&
+                 resume_snapshot.crc32 == crc32_compute(&resume_snapshot, offsetof(resume_snapshot_t, crc32));
+    
+    // Single use: a crash after resuming must not resume again
+    resume_snapshot.magic = 0;
+    if (!valid) {
+        return ARUNIKA_ERROR_INIT;
+    }
+    
+    *snapshot = resume_snapshot;
+    return ARUNIKA_OK;
+}
+
+// 1S LiPo open-circuit voltage against state of charge, under light load
+static const struct {
+    uint16_t mv;
+    uint8_t percent;
+} battery_curve[] = {
+    { 3300, 0 }, { 3550, 5 }, { 3650, 10 }, { 3700, 20 }, { 3750, 30 }, { 3790, 40 },
+    { 3830, 50 }, { 3870, 60 }, { 3920, 70 }, { 3980, 80 }, { 4060, 90 }, { 4150, 100 }
+};
+
+static const power_profile_t power_profiles[] = {
+    [POWER_MODE_NORMAL] = { 0, 0, 0, 0, 30000, 0 },
+    // Lower Opus bitrate and complexity, end utterances sooner, ping less
+    [POWER_MODE_SAVER] = { 12000, 3, 8, 600, 60000, 30000 },
+    [POWER_MODE_CRITICAL] = { 8000, 1, 16, 400, 120000, 10000 }
+};
+
+static uint8_t battery_percent_from_mv(uint32_t mv) {
+    size_t last = sizeof(battery_curve) / sizeof(battery_curve[0]) - 1;
+    if (mv <= battery_curve[0].mv) {
         return 0;
     }
+    if (mv >= battery_curve[last].mv) {
+        return 100;
+    }
     
-    // TODO: Read actual battery voltage via ADC
-    // TODO: Convert voltage to percentage
+    size_t i = 1;
+    while (mv > battery_curve[i].mv) {
+        i++;
+    }
+    uint32_t span_mv = battery_curve[i].mv - battery_curve[i - 1].mv;
+    uint32_t span_percent = battery_curve[i].percent - battery_curve[i - 1].percent;
+    return (uint8_t)(battery_curve[i - 1].percent + (mv - battery_curve[i - 1].mv) * span_percent / span_mv);
+}
+
+// Thresholds only apply on the way down; leaving a mode needs some headroom
+// so a sagging cell under load does not flip the pipeline back and forth
+static power_mode_t battery_next_mode(power_mode_t mode, uint8_t percent, bool charging) {
+    if (charging || percent > BATTERY_SAVER_PERCENT + BATTERY_HYSTERESIS_PERCENT) {
+        return POWER_MODE_NORMAL;
+    }
+    if (percent <= BATTERY_CRITICAL_PERCENT) {
+        return POWER_MODE_CRITICAL;
+    }
+    if (percent <= BATTERY_SAVER_PERCENT) {
+        return mode == POWER_MODE_CRITICAL && percent <= BATTERY_CRITICAL_PERCENT + BATTERY_HYSTERESIS_PERCENT
+                   ? POWER_MODE_CRITICAL : POWER_MODE_SAVER;
+    }
+    return mode == POWER_MODE_NORMAL ? POWER_MODE_NORMAL : POWER_MODE_SAVER;
+}
+
+static uint16_t battery_adc_read_mv(void) {
+    // TODO: adc_oneshot_read() on the divider channel, then
+    // adc_cali_raw_to_voltage() and undo the 1:2 divider
     
-    // Simulate battery drain
-    static uint32_t last_check = 0;
-    uint32_t current_time = get_timestamp_ms();
+    // Simulate a slowly draining cell with a few mV of ADC noise
+    static uint32_t seed = 1;
+    seed = seed * 1103515245 + 12345;
+    return (uint16_t)(battery_sim_mv + (int32_t)(seed >> 16 & 0xF) - 8);
+}
+
+int power_sample_battery(void) {
+    if (!power_initialized) {
+        return ARUNIKA_ERROR_INIT;
+    }
+    
+    uint32_t sum = 0;
+    for (int i = 0; i < BATTERY_ADC_BURST; i++) {
+        sum += battery_adc_read_mv();
+    }
+    int32_t sample_q4 = (int32_t)(sum * 16 / BATTERY_ADC_BURST);
+    if (battery_sim_mv > 3000) {
+        battery_sim_mv--; // Simulated drain, 1 mV per sample
+    }
     
-    if (current_time - last_check > 10000) { // Every 10 seconds
-        if (battery_level > 0) {
-            battery_level--; // Simulate battery drain
-        }
-        last_check = current_time;
+    // Exponential average in Q4; the first sample seeds it
+    if (battery.samples == 0) {
+        battery_mv_q4 = sample_q4;
+    } else {
+        battery_mv_q4 += (sample_q4 - battery_mv_q4) / (1 << BATTERY_FILTER_SHIFT);
     }
     
-    return battery_level;
+    battery.samples++;
+    battery.voltage_mv = (uint16_t)(battery_mv_q4 / 16);
+    battery.percent = battery_percent_from_mv(battery.voltage_mv);
+    battery.charging = power_is_charging();
+    battery.mode = battery_next_mode(battery.mode, battery.percent, battery.charging);
+    
+    // Drain over whole windows; the filter lag cancels out between the ends.
+    // Charging restarts the window
+    uint32_t now = get_timestamp_ms();
+    if (battery.charging || drain_start_mv == 0) {
+        battery.drain_mv_per_hour = 0;
+        drain_start_mv = battery.charging ? 0 : battery.voltage_mv;
+        drain_start_ms = now;
+    } else if (now - drain_start_ms >= BATTERY_DRAIN_WINDOW_MS) {
+        int32_t rate = (int32_t)(((int64_t)drain_start_mv - battery.voltage_mv) * 3600000 / (now - drain_start_ms));
+        battery.drain_mv_per_hour = (int16_t)(rate > INT16_MAX ? INT16_MAX : rate < INT16_MIN ? INT16_MIN : rate);
+        drain_start_mv = battery.voltage_mv;
+        drain_start_ms = now;
+    }
+    return ARUNIKA_OK;
+}
+
+uint8_t power_get_battery_level(void) {
+    // Cached by power_sample_battery(); cheap enough for any caller
+    return power_initialized ? battery.percent : 0;
+}
+
+void power_get_battery_status(battery_status_t *status) {
+    if (status) {
+        *status = battery;
+    }
+}
+
+power_mode_t power_get_mode(void) {
+    return battery.mode;
+}
+
+const power_profile_t *power_get_profile(power_mode_t mode) {
+    return mode <= POWER_MODE_CRITICAL ? &power_profiles[mode] : &power_profiles[POWER_MODE_NORMAL];
+}
+
+#ifndef ESP_PLATFORM
+void power_sim_set_battery_mv(uint16_t mv) {
+    battery_sim_mv = mv;
 }
+#endif
 
 bool power_is_charging(void) {
     // TODO: Check charging status via GPIO or charge controller
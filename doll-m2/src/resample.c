@@ -0,0 +1,230 @@
+#include "arunika.h"
+
+// Polyphase fixed-point resampler between the I2S rate and the rates
+// negotiated on the wire. A conversion by up/down runs the prototype
+// low-pass at in_rate * up; only every down-th output of that is needed,
+// so each output is one dot product of `taps` input samples with one of
+// the `up` filter phases. Conversions run on whole frames, with the last
+// taps - 1 input samples kept as history so frame edges are seamless.
+//
+// The tables are Kaiser-windowed sincs (beta 5) with the cutoff at 85% of
+// the lower rate's Nyquist frequency, quantized to Q15. Each phase sums to
+// exactly 1.0 so DC passes unchanged, and the sum of magnitudes stays
+// below 2.0, which keeps the 32-bit accumulator from overflowing. Taps are
+// stored oldest input first so the inner loop walks both arrays forward.
+
+static const int16_t resample_8k_to_16k[2 * 16] = {
+    50, -240, 621, -1118, 1447, -1039, -1535, 25767,
+    12366, -5307, 2477, -889, 103, 150, -133, 48,
+    48, -133, 150, 103, -889, 2477, -5307, 12366,
+    25767, -1535, -1039, 1447, -1118, 621, -240, 50,
+};
+
+static const int16_t resample_16k_to_8k[1 * 32] = {
+    24, 25, -66, -120, 75, 311, 51, -559,
+    -444, 723, 1239, -519, -2653, -768, 6183, 12881,
+    12883, 6183, -768, -2653, -519, 1239, 723, -444,
+    -559, 51, 311, 75, -120, -66, 25, 24,
+};
+
+static const int16_t resample_8k_to_24k[3 * 16] = {
+    35, -223, 641, -1261, 1858, -1930, 223, 26915,
+    9680, -4942, 2612, -1120, 282, 55, -100, 43,
+    75, -242, 461, -544, 147, 1265, -4868, 20083,
+    20097, -4868, 1265, 147, -544, 461, -242, 75,
+    43, -100, 55, 282, -1120, 2612, -4942, 9680,
+    26915, 223, -1930, 1858, -1261, 641, -223, 35,
+};
+
+static const int16_t resample_24k_to_8k[1 * 48] = {
+    14, 25, 12, -33, -81, -74, 18, 154,
+    214, 94, -181, -420, -373, 49, 619, 871,
+    422, -643, -1647, -1623, 74, 3227, 6699, 8964,
+    8970, 6699, 3227, 74, -1623, -1647, -643, 422,
+    871, 619, 49, -373, -420, -181, 94, 214,
+    154, 18, -74, -81, -33, 12, 25, 14,
+};
+
+static const int16_t resample_16k_to_24k[3 * 32] = {
+    13, 10, -67, 159, -263, 333, -307, 124,
+    256, -820, 1492, -2121, 2481, -2203, 231, 26934,
+    9869, -5429, 3284, -1729, 582, 171, -560, 656,
+    -557, 370, -180, 37, 39, -60, 47, -24,
+    -16, 52, -101, 146, -151, 77, 106, -400,
+    757, -1082, 1226, -1008, 209, 1510, -5182, 20243,
+    20239, -5182, 1510, 209, -1008, 1226, -1082, 757,
+    -400, 106, 77, -151, 146, -101, 52, -16,
+    -24, 47, -60, 39, 37, -180, 370, -557,
+    656, -560, 171, 582, -1729, 3284, -5429, 9869,
+    26934, 231, -2203, 2481, -2121, 1492, -820, 256,
+    124, -307, 333, -263, 159, -67, 10, 13,
+};
+
+static const int16_t resample_24k_to_16k[2 * 48] = {
+    -11, 31, 6, -68, 26, 106, -101, -120,
+    222, 71, -372, 82, 505, -373, -547, 817,
+    388, -1414, 140, 2190, -1468, -3455, 6579, 17959,
+    13493, 154, -3619, 1006, 1654, -1152, -672, 994,
+    114, -721, 171, 437, -266, -205, 247, 51,
+    -175, 25, 97, -45, -40, 34, 9, -16,
+    -16, 9, 34, -40, -45, 97, 25, -175,
+    51, 247, -205, -266, 437, 171, -721, 114,
+    994, -672, -1152, 1654, 1006, -3619, 154, 13493,
+    17959, 6579, -3455, -1468, 2190, 140, -1414, 388,
+    817, -547, -373, 505, 82, -372, 71, 222,
+    -120, -101, 106, 26, -68, 6, 31, -11,
+};
+typedef struct {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint8_t up;
+    uint8_t down;
+    uint8_t taps;
+    const int16_t *coeffs;
+} resample_table_t;
+
+static const resample_table_t resample_tables[] = {
+    { 8000, 16000, 2, 1, 16, resample_8k_to_16k },
+    { 16000, 8000, 1, 2, 32, resample_16k_to_8k },
+    { 8000, 24000, 3, 1, 16, resample_8k_to_24k },
+    { 24000, 8000, 1, 3, 48, resample_24k_to_8k },
+    { 16000, 24000, 3, 2, 32, resample_16k_to_24k },
+    { 24000, 16000, 2, 3, 48, resample_24k_to_16k }
+};
+
+// Staging for in-place frame conversion; network task only
+static int16_t frame_staging[AUDIO_BUFFER_SIZE / 2];
+
+bool resample_rate_supported(uint32_t rate) {
+    return rate == 8000 || rate == 16000 || rate == 24000;
+}
+
+int resampler_init(resampler_t *rs, uint32_t in_rate, uint32_t out_rate) {
+    if (!rs || !resample_rate_supported(in_rate) || !resample_rate_supported(out_rate)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    memset(rs, 0, sizeof(*rs));
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->up = 1;
+    rs->down = 1;
+    if (in_rate == out_rate) {
+        return ARUNIKA_OK; // Pass-through
+    }
+    
+    for (size_t i = 0; i < sizeof(resample_tables) / sizeof(resample_tables[0]); i++) {
+        const resample_table_t *table = &resample_tables[i];
+        if (table->in_rate == in_rate && table->out_rate == out_rate) {
+            rs->up = table->up;
+            rs->down = table->down;
+            rs->taps = table->taps;
+            rs->coeffs = table->coeffs;
+            return ARUNIKA_OK;
+        }
+    }
+    return ARUNIKA_ERROR_INVALID_PARAM;
+}
+
+void resampler_reset(resampler_t *rs) {
+    if (rs) {
+        rs->phase = 0;
+        memset(rs->history, 0, sizeof(rs->history));
+    }
+}
+
+bool resampler_active(const resampler_t *rs) {
+    return rs && rs->coeffs != NULL;
+}
+
+// Exact, given the phase the previous frame left behind
+size_t resampler_output_samples(const resampler_t *rs, size_t in_samples) {
+    if (!resampler_active(rs)) {
+        return in_samples;
+    }
+    size_t span = in_samples * rs->up;
+    return span > rs->phase ? (span - rs->phase + rs->down - 1) / rs->down : 0;
+}
+
+static int16_t resample_dot(const int16_t *x, const int16_t *h, uint8_t taps) {
+    int32_t acc = 1 << 14;
+    for (uint8_t j = 0; j < taps; j++) {
+        acc += (int32_t)x[j] * h[j];
+    }
+    acc >>= 15;
+    if (acc > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (acc < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)acc;
+}
+
+int resampler_process(resampler_t *rs, const int16_t *in, size_t in_samples, int16_t *out, size_t out_capacity) {
+    if (!rs || (!in && in_samples > 0) || (!out && out_capacity > 0)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (resampler_output_samples(rs, in_samples) > out_capacity) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    if (!resampler_active(rs)) {
+        memmove(out, in, in_samples * sizeof(int16_t));
+        return (int)in_samples;
+    }
+    
+    // Outputs whose window still reaches into the history are built from
+    // a copy of the window; the rest read the frame directly
+    size_t history_len = rs->taps - 1;
+    size_t produced = 0;
+    unsigned phase = rs->phase;
+    for (size_t i = 0; i < in_samples; i++) {
+        for (; phase < rs->up; phase += rs->down) {
+            const int16_t *h = rs->coeffs + phase * rs->taps;
+            if (i >= history_len) {
+                out[produced++] = resample_dot(in + i - history_len, h, rs->taps);
+            } else {
+                int16_t window[RESAMPLE_MAX_TAPS];
+                size_t from_history = history_len - i;
+                memcpy(window, rs->history + i, from_history * sizeof(int16_t));
+                memcpy(window + from_history, in, (i + 1) * sizeof(int16_t));
+                out[produced++] = resample_dot(window, h, rs->taps);
+            }
+        }
+        phase -= rs->up;
+    }
+    rs->phase = (uint8_t)phase;
+    
+    // Keep the newest taps - 1 input samples for the next frame
+    if (in_samples >= history_len) {
+        memcpy(rs->history, in + in_samples - history_len, history_len * sizeof(int16_t));
+    } else {
+        memmove(rs->history, rs->history + in_samples, (history_len - in_samples) * sizeof(int16_t));
+        memcpy(rs->history + history_len - in_samples, in, in_samples * sizeof(int16_t));
+    }
+    return (int)produced;
+}
+
+int audio_resample_frame(resampler_t *rs, audio_buffer_t *frame) {
+    if (!rs || !frame || frame->format != AUDIO_FORMAT_PCM || frame->sample_rate != rs->in_rate) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (!resampler_active(rs)) {
+        return ARUNIKA_OK;
+    }
+    
+    size_t samples = frame->size / 2;
+    if (samples > sizeof(frame_staging) / sizeof(frame_staging[0])) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    memcpy(frame_staging, frame->data, samples * sizeof(int16_t));
+    
+    int produced = resampler_process(rs, frame_staging, samples, (int16_t *)frame->data, frame->capacity / 2);
+    if (produced < 0) {
+        return produced;
+    }
+    frame->size = (size_t)produced * 2;
+    frame->sample_rate = rs->out_rate;
+    return ARUNIKA_OK;
+}
@@ -0,0 +1,132 @@
+#include "arunika.h"
+
+// Lock-free single-producer/single-consumer ring of audio frames.
+// head is only written by the producer and tail only by the consumer, both
+// increase monotonically and are wrapped with AUDIO_RING_MASK on access.
+// The acquire/release pairs make a committed frame's payload visible to the
+// consumer before it observes the new head (and vice versa for tail).
+
+#define AUDIO_RING_MASK (AUDIO_RING_SLOTS - 1)
+
+#define RING_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define RING_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+// Capacity must be a power of two for the index mask to work
+typedef char audio_ring_slots_power_of_two[(AUDIO_RING_SLOTS & AUDIO_RING_MASK) == 0 ? 1 : -1];
+
+int audio_ring_init(audio_ring_t *ring, uint32_t sample_rate, audio_format_t format) {
+    if (!ring) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    for (uint32_t i = 0; i < AUDIO_RING_SLOTS; i++) {
+        audio_buffer_t *frame = &ring->frames[i];
+        frame->data = ring->storage[i] + AUDIO_FRAME_HEADROOM;
+        frame->headroom = AUDIO_FRAME_HEADROOM;
+        frame->size = 0;
+        frame->capacity = AUDIO_BUFFER_SIZE;
+        frame->sample_rate = sample_rate;
+        frame->format = format;
+    }
+    
+    ring->head = 0;
+    ring->tail = 0;
+    ring->high_watermark = 0;
+    ring->overruns = 0;
+    
+    return ARUNIKA_OK;
+}
+
+audio_buffer_t *audio_ring_acquire(audio_ring_t *ring) {
+    uint32_t head = RING_LOAD_RELAXED(&ring->head);
+    uint32_t tail = RING_LOAD_ACQUIRE(&ring->tail);
+    
+    if (head - tail >= AUDIO_RING_SLOTS) {
+        // Consumer is behind; drop the new frame rather than block the ISR
+        ring->overruns++;
+        return NULL;
+    }
+    
+    return &ring->frames[head & AUDIO_RING_MASK];
+}
+
+audio_buffer_t *audio_ring_peek_write(audio_ring_t *ring) {
+    // Same slot as audio_ring_acquire() but without counting an overrun
+    uint32_t head = RING_LOAD_RELAXED(&ring->head);
+    uint32_t tail = RING_LOAD_ACQUIRE(&ring->tail);
+    
+    if (head - tail >= AUDIO_RING_SLOTS) {
+        return NULL;
+    }
+    
+    return &ring->frames[head & AUDIO_RING_MASK];
+}
+
+int audio_ring_commit(audio_ring_t *ring) {
+    uint32_t head = RING_LOAD_RELAXED(&ring->head);
+    uint32_t tail = RING_LOAD_ACQUIRE(&ring->tail);
+    
+    if (head - tail >= AUDIO_RING_SLOTS) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    uint32_t occupancy = head + 1 - tail;
+    if (occupancy > ring->high_watermark) {
+        ring->high_watermark = occupancy;
+    }
+    
+    RING_STORE_RELEASE(&ring->head, head + 1);
+    return ARUNIKA_OK;
+}
+
+audio_buffer_t *audio_ring_peek(audio_ring_t *ring) {
+    return audio_ring_peek_at(ring, 0);
+}
+
+// Looks ahead without consuming; index 0 is the oldest frame
+audio_buffer_t *audio_ring_peek_at(audio_ring_t *ring, uint32_t index) {
+    uint32_t tail = RING_LOAD_RELAXED(&ring->tail);
+    uint32_t head = RING_LOAD_ACQUIRE(&ring->head);
+    
+    if (head - tail <= index) {
+        return NULL;
+    }
+    
+    return &ring->frames[(tail + index) & AUDIO_RING_MASK];
+}
+
+int audio_ring_release(audio_ring_t *ring) {
+    uint32_t tail = RING_LOAD_RELAXED(&ring->tail);
+    uint32_t head = RING_LOAD_ACQUIRE(&ring->head);
+    
+    if (head == tail) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    RING_STORE_RELEASE(&ring->tail, tail + 1);
+    return ARUNIKA_OK;
+}
+
+int audio_ring_flush(audio_ring_t *ring) {
+    // Consumer-side drop of everything committed so far
+    RING_STORE_RELEASE(&ring->tail, RING_LOAD_ACQUIRE(&ring->head));
+    return ARUNIKA_OK;
+}
+
+uint32_t audio_ring_count(const audio_ring_t *ring) {
+    uint32_t tail = RING_LOAD_ACQUIRE(&ring->tail);
+    uint32_t head = RING_LOAD_ACQUIRE(&ring->head);
+    return head - tail;
+}
+
+void audio_ring_get_stats(const audio_ring_t *ring, audio_ring_stats_t *stats) {
+    if (!ring || !stats) {
+        return;
+    }
+    
+    stats->capacity = AUDIO_RING_SLOTS;
+    stats->occupancy = audio_ring_count(ring);
+    stats->high_watermark = ring->high_watermark;
+    stats->overruns = ring->overruns;
+}
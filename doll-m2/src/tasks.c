@@ -0,0 +1,316 @@
+#ifdef __linux__
+#define _GNU_SOURCE // pthread_setaffinity_np() for host core pinning
+#endif
+#include "arunika.h"
+#include "task_config.h"
+
+// Pipeline task model. Capture, network and playback run as separate tasks
+// connected only through the SPSC capture ring and the playback jitter
+// buffer. On ESP32 they are FreeRTOS tasks pinned per task_config.h; the
+// host build emulates them with pthreads so scheduling can be profiled
+// before flashing. Host threads keep the default scheduling policy, the
+// configured priorities are only reported.
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    task_stats_t stats;
+    task_entry_t entry;
+    uint32_t busy_since_us;
+    bool started;
+#ifdef ESP_PLATFORM
+    TaskHandle_t handle;
+#else
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool notified;
+#endif
+} task_t;
+
+static void capture_task(void);
+static void playback_task(void);
+
+static task_t tasks[TASK_COUNT] = {
+    [TASK_CAPTURE] = {
+        .stats = { "capture", TASK_CAPTURE_STACK_SIZE, TASK_CAPTURE_PRIORITY, TASK_CAPTURE_CORE, 0, 0, 0 },
+        .entry = capture_task
+    },
+    [TASK_NETWORK] = {
+        .stats = { "network", TASK_NETWORK_STACK_SIZE, TASK_NETWORK_PRIORITY, TASK_NETWORK_CORE, 0, 0, 0 }
+    },
+    [TASK_PLAYBACK] = {
+        .stats = { "playback", TASK_PLAYBACK_STACK_SIZE, TASK_PLAYBACK_PRIORITY, TASK_PLAYBACK_CORE, 0, 0, 0 },
+        .entry = playback_task
+    }
+};
+
+static bool running = false;
+
+// Busy time runs from a wakeup to the next blocking call
+static void task_block_begin(task_t *task) {
+    uint32_t now = get_timestamp_us();
+    __atomic_fetch_add(&task->stats.busy_us, now - task->busy_since_us, __ATOMIC_RELAXED);
+}
+
+static void task_block_end(task_t *task) {
+    task->busy_since_us = get_timestamp_us();
+    __atomic_fetch_add(&task->stats.wakeups, 1, __ATOMIC_RELAXED);
+}
+
+// Blocks until tasks_notify() or tasks_stop()
+static void task_wait_notify(task_t *task) {
+    task_block_begin(task);
+#ifdef ESP_PLATFORM
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#else
+    pthread_mutex_lock(&task->lock);
+    while (!task->notified && tasks_running()) {
+        pthread_cond_wait(&task->cond, &task->lock);
+    }
+    task->notified = false;
+    pthread_mutex_unlock(&task->lock);
+#endif
+    task_block_end(task);
+}
+
+// Sleeps until an absolute deadline and records how late the wakeup was
+static void task_sleep_until(task_t *task, uint32_t deadline_us) {
+    task_block_begin(task);
+    int32_t remaining = (int32_t)(deadline_us - get_timestamp_us());
+    if (remaining > 0) {
+#ifdef ESP_PLATFORM
+        vTaskDelay(pdMS_TO_TICKS((remaining + 999) / 1000));
+#else
+        struct timespec ts = { remaining / 1000000, (remaining % 1000000) * 1000 };
+        nanosleep(&ts, NULL);
+#endif
+    }
+    task_block_end(task);
+    
+    int32_t late = (int32_t)(get_timestamp_us() - deadline_us);
+    if (late > 0 && (uint32_t)late > task->stats.max_late_us) {
+        __atomic_store_n(&task->stats.max_late_us, (uint32_t)late, __ATOMIC_RELAXED);
+    }
+}
+
+static void capture_task(void) {
+    task_t *task = &tasks[TASK_CAPTURE];
+    uint32_t deadline_us = get_timestamp_us(); // Recording may already be on at the first pass
+    
+    while (tasks_running()) {
+        if (!audio_is_recording()) {
+            task_wait_notify(task);
+            deadline_us = get_timestamp_us();
+            continue;
+        }
+        
+        // TODO: On ESP32 block in i2s_channel_read() on an audio_i2s_rx_begin() slot
+        // For now, wake at the frame cadence and let the DMA simulation run
+        deadline_us += audio_capture_frame_ms() * 1000;
+        task_sleep_until(task, deadline_us);
+        audio_capture_poll();
+    }
+}
+
+static void playback_task(void) {
+    static int16_t block[PLAYBACK_DMA_SAMPLES];
+    static const uint32_t block_us = (uint32_t)((uint64_t)PLAYBACK_DMA_SAMPLES * 1000000 / SAMPLE_RATE);
+    task_t *task = &tasks[TASK_PLAYBACK];
+    uint32_t deadline_us = get_timestamp_us();
+    
+    while (tasks_running()) {
+        playback_state_t state = playback_get_state();
+        if (state != PLAYBACK_STATE_PLAYING && state != PLAYBACK_STATE_DRAINING) {
+            task_wait_notify(task);
+            deadline_us = get_timestamp_us();
+            continue;
+        }
+        
+        // TODO: On ESP32 i2s_channel_write() blocks until the TX DMA has room
+        playback_i2s_tx_callback(block, PLAYBACK_DMA_SAMPLES);
+        deadline_us += block_us;
+        task_sleep_until(task, deadline_us);
+    }
+}
+
+#ifdef ESP_PLATFORM
+static void task_main(void *arg) {
+    task_t *task = (task_t *)arg;
+    task->busy_since_us = get_timestamp_us();
+    task->entry();
+    vTaskDelete(NULL);
+}
+
+static int task_create(task_t *task) {
+    BaseType_t core = task->stats.core < 0 ? tskNO_AFFINITY : task->stats.core;
+    if (xTaskCreatePinnedToCore(task_main, task->stats.name, task->stats.stack_size, task,
+                                task->stats.priority, &task->handle, core) != pdPASS) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    return ARUNIKA_OK;
+}
+#else
+static void *task_main(void *arg) {
+    task_t *task = (task_t *)arg;
+    task->busy_since_us = get_timestamp_us();
+    task->entry();
+    return NULL;
+}
+
+static int task_create(task_t *task) {
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    task->notified = false;
+    
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    size_t stack_size = task->stats.stack_size < TASK_HOST_STACK_MIN ? TASK_HOST_STACK_MIN : task->stats.stack_size;
+    pthread_attr_setstacksize(&attr, stack_size);
+    int result = pthread_create(&task->thread, &attr, task_main, task);
+    pthread_attr_destroy(&attr);
+    if (result != 0) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+
+#ifdef __linux__
+    // Pin like the target so cross-core handoffs show up when profiling
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (task->stats.core >= 0 && task->stats.core < cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(task->stats.core, &set);
+        pthread_setaffinity_np(task->thread, sizeof(set), &set);
+    }
+#endif
+    
+    return ARUNIKA_OK;
+}
+#endif
+
+int tasks_start(task_entry_t network_entry) {
+    if (!network_entry || tasks_running()) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    tasks[TASK_NETWORK].entry = network_entry;
+    __atomic_store_n(&running, true, __ATOMIC_RELEASE);
+    
+    for (int i = 0; i < TASK_COUNT; i++) {
+        task_t *task = &tasks[i];
+        task->stats.wakeups = 0;
+        task->stats.busy_us = 0;
+        task->stats.max_late_us = 0;
+        if (task_create(task) != ARUNIKA_OK) {
+            printf("Failed to start %s task\n", task->stats.name);
+            tasks_stop();
+            return ARUNIKA_ERROR_INIT;
+        }
+        task->started = true;
+        printf("Started %s task (stack %u, priority %u, core %d)\n", task->stats.name,
+               (unsigned)task->stats.stack_size, task->stats.priority, task->stats.core);
+    }
+    
+    return ARUNIKA_OK;
+}
+
+void tasks_stop(void) {
+    // Must be called from outside the pipeline tasks
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+    events_post(EVENT_SHUTDOWN);
+    
+    for (int i = 0; i < TASK_COUNT; i++) {
+        task_t *task = &tasks[i];
+        if (!task->started) {
+            continue;
+        }
+        tasks_notify((task_id_t)i);
+#ifndef ESP_PLATFORM
+        pthread_join(task->thread, NULL);
+        pthread_cond_destroy(&task->cond);
+        pthread_mutex_destroy(&task->lock);
+#endif
+        task->started = false;
+    }
+}
+
+void tasks_wait(void) {
+    // Returns once the network task's entry does, then stops the rest
+    task_t *network = &tasks[TASK_NETWORK];
+    if (!network->started) {
+        return;
+    }
+#ifdef ESP_PLATFORM
+    while (tasks_running()) {
+        vTaskDelay(portMAX_DELAY);
+    }
+#else
+    pthread_join(network->thread, NULL);
+    pthread_cond_destroy(&network->cond);
+    pthread_mutex_destroy(&network->lock);
+    network->started = false;
+#endif
+    tasks_stop();
+}
+
+void tasks_mark_block(task_id_t task) {
+    if (task < TASK_COUNT) {
+        task_block_begin(&tasks[task]);
+    }
+}
+
+void tasks_mark_wake(task_id_t task) {
+    if (task < TASK_COUNT) {
+        task_block_end(&tasks[task]);
+    }
+}
+
+bool tasks_running(void) {
+    return __atomic_load_n(&running, __ATOMIC_ACQUIRE);
+}
+
+void tasks_notify(task_id_t task) {
+    if (task >= TASK_COUNT || !tasks[task].started) {
+        return;
+    }
+
+#ifdef ESP_PLATFORM
+    xTaskNotifyGive(tasks[task].handle);
+#else
+    pthread_mutex_lock(&tasks[task].lock);
+    tasks[task].notified = true;
+    pthread_cond_signal(&tasks[task].cond);
+    pthread_mutex_unlock(&tasks[task].lock);
+#endif
+}
+
+int tasks_get_stats(task_id_t task, task_stats_t *stats) {
+    if (task >= TASK_COUNT || !stats) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    *stats = tasks[task].stats;
+    stats->wakeups = __atomic_load_n(&tasks[task].stats.wakeups, __ATOMIC_RELAXED);
+    stats->busy_us = __atomic_load_n(&tasks[task].stats.busy_us, __ATOMIC_RELAXED);
+    stats->max_late_us = __atomic_load_n(&tasks[task].stats.max_late_us, __ATOMIC_RELAXED);
+    return ARUNIKA_OK;
+}
+
+void tasks_print_stats(void) {
+    printf("%-10s %6s %4s %5s %10s %12s %12s\n", "task", "stack", "prio", "core", "wakeups", "busy us", "max late us");
+    for (int i = 0; i < TASK_COUNT; i++) {
+        task_stats_t stats;
+        tasks_get_stats((task_id_t)i, &stats);
+        printf("%-10s %6u %4u %5d %10u %12llu %12u\n", stats.name, (unsigned)stats.stack_size,
+               stats.priority, stats.core, (unsigned)stats.wakeups,
+               (unsigned long long)stats.busy_us, (unsigned)stats.max_late_us);
+    }
+}
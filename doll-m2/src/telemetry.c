@@ -0,0 +1,113 @@
+#include "arunika.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#endif
+
+// Device health report for fleet monitoring. It travels as the application
+// data of the keepalive ping, so it costs no extra wakeup or frame and the
+// hub sees it at the ping interval of the current power mode. Counters are
+// cumulative since boot; the hub takes deltas and uses the uptime to spot
+// reboots. Little-endian, fixed layout shared with the server hub:
+//
+//   0  magic(1) version(1) fw_major(1) fw_minor(1) fw_patch(2) flags(1) power_mode(1)
+//   8  uptime_s(4) ring_overruns(4) jitter_underruns(4) jitter_overflows(4)
+//  24  connect_attempts(4) connect_failures(4) last_connect_ms(4)
+//  36  battery_mv(2) drain_mv_per_hour(2, signed) pool_exhausted(4) heap_min_free(4)
+//  48  pool_min_free(1 per pool) latency(p50, p95, p99 per trace stage)
+//
+// Latencies are log2 bucket indexes: code c means at most 2^(c+1) - 1 us,
+// which is all the precision the trace histograms keep.
+
+typedef char telemetry_layout_fits[48 + POOL_COUNT + TRACE_STAGE_COUNT * 3 == TELEMETRY_REPORT_SIZE &&
+                                   TELEMETRY_REPORT_SIZE <= WS_MAX_CONTROL_PAYLOAD ? 1 : -1];
+
+static const uint8_t telemetry_percentiles[3] = { 50, 95, 99 };
+
+static void telemetry_put_u16(uint8_t *out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void telemetry_put_u32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint8_t telemetry_latency_code(const trace_histogram_t *histogram, uint8_t percent) {
+    if (histogram->count == 0) {
+        return TELEMETRY_LATENCY_NONE;
+    }
+    
+    uint32_t us = trace_percentile_us(histogram, percent);
+    return us == 0 ? 0 : (uint8_t)(31 - __builtin_clz(us));
+}
+
+int telemetry_build_report(uint8_t *out, size_t size) {
+    if (!out) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (size < TELEMETRY_REPORT_SIZE) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    audio_ring_stats_t ring;
+    playback_stats_t playback;
+    websocket_conn_stats_t conn;
+    battery_status_t battery;
+    audio_capture_get_stats(&ring);
+    playback_get_stats(&playback);
+    websocket_get_conn_stats(&conn);
+    power_get_battery_status(&battery);
+    
+    uint8_t flags = battery.charging ? TELEMETRY_FLAG_CHARGING : 0;
+#ifdef ARUNIKA_TRACE
+    flags |= TELEMETRY_FLAG_TRACE;
+#endif
+    out[0] = TELEMETRY_MAGIC;
+    out[1] = TELEMETRY_VERSION;
+    out[2] = FIRMWARE_VERSION_MAJOR;
+    out[3] = FIRMWARE_VERSION_MINOR;
+    telemetry_put_u16(&out[4], FIRMWARE_VERSION_PATCH);
+    out[6] = flags;
+    out[7] = (uint8_t)battery.mode;
+    
+    telemetry_put_u32(&out[8], get_timestamp_ms() / 1000);
+    telemetry_put_u32(&out[12], ring.overruns);
+    telemetry_put_u32(&out[16], playback.underruns);
+    telemetry_put_u32(&out[20], playback.overflows);
+    telemetry_put_u32(&out[24], conn.attempts);
+    telemetry_put_u32(&out[28], conn.failures);
+    telemetry_put_u32(&out[32], conn.last_connect_ms);
+    telemetry_put_u16(&out[36], battery.voltage_mv);
+    telemetry_put_u16(&out[38], (uint16_t)battery.drain_mv_per_hour);
+    
+    // The firmware never allocates; the pools are its heap, and the low-water
+    // mark of the system heap covers the radio and IDF components
+    uint32_t exhausted = 0;
+    for (int i = 0; i < POOL_COUNT; i++) {
+        pool_stats_t pool;
+        pool_get_stats((pool_id_t)i, &pool);
+        exhausted += pool.exhausted;
+        out[48 + i] = (uint8_t)(pool.blocks - pool.high_watermark);
+    }
+    telemetry_put_u32(&out[40], exhausted);
+#ifdef ESP_PLATFORM
+    telemetry_put_u32(&out[44], (uint32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+#else
+    telemetry_put_u32(&out[44], 0); // Not tracked on the host
+#endif
+    
+    // Empty unless built with TRACE=1
+    uint8_t *latency = &out[48 + POOL_COUNT];
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        trace_histogram_t histogram;
+        trace_get_histogram((trace_stage_t)stage, &histogram);
+        for (int i = 0; i < 3; i++) {
+            *latency++ = telemetry_latency_code(&histogram, telemetry_percentiles[i]);
+        }
+    }
+    
+    return TELEMETRY_REPORT_SIZE;
+}
@@ -0,0 +1,143 @@
+#include "arunika.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#define TRACE_TICKS_PER_US CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#else
+#define TRACE_TICKS_PER_US 1
+#endif
+
+// Latency histograms for the conversation pipeline. Hooks read the raw
+// cycle counter and hand tick differences to trace_record(), so a trace
+// point costs a register read and a few increments. Each stage is
+// recorded from one context only (the network task, or the TX callback
+// for the playout stages), so the histograms need no lock; a report may
+// see one sample half-applied.
+
+static trace_histogram_t histograms[TRACE_STAGE_COUNT];
+static const char *const stage_names[TRACE_STAGE_COUNT] = {
+    "encode", "send", "uplink", "server", "decode", "playout", "mouth-ear"
+};
+
+// Milestones of the current turn. The utterance one is written by the
+// network task; the response one is claimed by the TX callback
+static uint32_t utterance_capture_ticks = 0;
+static uint32_t utterance_sent_ticks = 0;
+static bool utterance_pending = false;
+static uint32_t response_start_ticks = 0;
+static uint32_t response_capture_ticks = 0;
+static bool response_has_utterance = false;
+static bool response_pending = false;
+
+uint32_t trace_now(void) {
+#ifdef ESP_PLATFORM
+    // Wraps every ~17 s at 240 MHz, far above any traced stage
+    return (uint32_t)esp_cpu_get_cycle_count();
+#else
+    return get_timestamp_us();
+#endif
+}
+
+void trace_record(trace_stage_t stage, uint32_t ticks) {
+    // May run in I2S DMA completion context: no printf, no blocking
+    if (stage >= TRACE_STAGE_COUNT) {
+        return;
+    }
+    
+    uint32_t us = ticks / TRACE_TICKS_PER_US;
+    int bucket = us == 0 ? 0 : 31 - __builtin_clz(us);
+    if (bucket >= TRACE_BUCKETS) {
+        bucket = TRACE_BUCKETS - 1;
+    }
+    
+    trace_histogram_t *h = &histograms[stage];
+    if (h->count == 0 || us < h->min_us) {
+        h->min_us = us;
+    }
+    if (us > h->max_us) {
+        h->max_us = us;
+    }
+    h->total_us += us;
+    h->buckets[bucket]++;
+    h->count++;
+}
+
+void trace_utterance_sent(uint32_t capture_ticks) {
+    utterance_capture_ticks = capture_ticks;
+    utterance_sent_ticks = trace_now();
+    utterance_pending = true;
+}
+
+void trace_response_start(void) {
+    uint32_t now = trace_now();
+    if (utterance_pending) {
+        trace_record(TRACE_STAGE_SERVER, now - utterance_sent_ticks);
+    }
+    
+    // A response nobody asked for (or a second one) has no mouth-to-ear time
+    response_start_ticks = now;
+    response_capture_ticks = utterance_capture_ticks;
+    response_has_utterance = utterance_pending;
+    utterance_pending = false;
+    __atomic_store_n(&response_pending, true, __ATOMIC_RELEASE);
+}
+
+void trace_first_sample(void) {
+    // Runs in I2S DMA completion context
+    if (!__atomic_exchange_n(&response_pending, false, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    
+    uint32_t now = trace_now();
+    trace_record(TRACE_STAGE_PLAYOUT, now - response_start_ticks);
+    if (response_has_utterance) {
+        trace_record(TRACE_STAGE_MOUTH_TO_EAR, now - response_capture_ticks);
+    }
+}
+
+int trace_get_histogram(trace_stage_t stage, trace_histogram_t *histogram) {
+    if (stage >= TRACE_STAGE_COUNT || !histogram) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    *histogram = histograms[stage];
+    return ARUNIKA_OK;
+}
+
+// Upper edge of the bucket holding the percentile, capped at the maximum
+uint32_t trace_percentile_us(const trace_histogram_t *histogram, uint8_t percent) {
+    if (!histogram || histogram->count == 0) {
+        return 0;
+    }
+    
+    uint64_t rank = ((uint64_t)histogram->count * (percent > 100 ? 100 : percent) + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < TRACE_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank && seen > 0) {
+            uint32_t edge = i == TRACE_BUCKETS - 1 ? UINT32_MAX : (2u << i) - 1;
+            return edge < histogram->max_us ? edge : histogram->max_us;
+        }
+    }
+    return histogram->max_us;
+}
+
+void trace_reset(void) {
+    memset(histograms, 0, sizeof(histograms));
+    utterance_pending = false;
+    __atomic_store_n(&response_pending, false, __ATOMIC_RELEASE);
+}
+
+void trace_print(void) {
+    printf("%-10s %8s %10s %10s %10s %10s %10s\n", "stage", "count", "min us", "p50 us", "p95 us", "p99 us",
+           "max us");
+    for (int i = 0; i < TRACE_STAGE_COUNT; i++) {
+        trace_histogram_t h = histograms[i];
+        if (h.count == 0) {
+            continue;
+        }
+        printf("%-10s %8u %10u %10u %10u %10u %10u\n", stage_names[i], (unsigned)h.count, (unsigned)h.min_us,
+               (unsigned)trace_percentile_us(&h, 50), (unsigned)trace_percentile_us(&h, 95),
+               (unsigned)trace_percentile_us(&h, 99), (unsigned)h.max_us);
+    }
+}
@@ -1,9 +1,53 @@
 #include "arunika.h"
 #include <time.h>
+#ifdef ESP_PLATFORM
+#include "esp_rtc_time.h"
+#endif
 
 // Base64 encoding table
 static const char base64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+// Packs four output characters into one word so each group is a single store
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define BASE64_PACK(a, b, c, d) (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+#else
+#define BASE64_PACK(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+#endif
+
+#ifndef ARUNIKA_BASE64_COMPACT
+// 4096-entry table mapping 12 input bits to two output characters (8 KB of
+// rodata), halving the lookups per group. Define ARUNIKA_BASE64_COMPACT to
+// fall back to the 64-entry table on flash-constrained builds.
+#define B64C(i) ((i) < 26 ? 'A' + (i) : (i) < 52 ? 'a' + (i) - 26 : (i) < 62 ? '0' + (i) - 52 : (i) == 62 ? '+' : '/')
+#define B64P(h, l) { (char)B64C(h), (char)B64C(l) }
+#define B64P8(h, l) B64P(h, l), B64P(h, l + 1), B64P(h, l + 2), B64P(h, l + 3), \
+                    B64P(h, l + 4), B64P(h, l + 5), B64P(h, l + 6), B64P(h, l + 7)
+#define B64ROW(h) B64P8(h, 0), B64P8(h, 8), B64P8(h, 16), B64P8(h, 24), \
+                  B64P8(h, 32), B64P8(h, 40), B64P8(h, 48), B64P8(h, 56)
+#define B64ROW8(h) B64ROW(h), B64ROW(h + 1), B64ROW(h + 2), B64ROW(h + 3), \
+                   B64ROW(h + 4), B64ROW(h + 5), B64ROW(h + 6), B64ROW(h + 7)
+
+static const char base64_pair_table[4096][2] = {
+    B64ROW8(0), B64ROW8(8), B64ROW8(16), B64ROW8(24),
+    B64ROW8(32), B64ROW8(40), B64ROW8(48), B64ROW8(56)
+};
+
+static inline void base64_encode_group(const uint8_t *in, char *out) {
+    uint32_t triple = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+    memcpy(out, base64_pair_table[triple >> 12], 2);
+    memcpy(out + 2, base64_pair_table[triple & 0xFFF], 2);
+}
+#else
+static inline void base64_encode_group(const uint8_t *in, char *out) {
+    uint32_t triple = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+    uint32_t chars = BASE64_PACK(base64_table[(triple >> 18) & 0x3F],
+                                 base64_table[(triple >> 12) & 0x3F],
+                                 base64_table[(triple >> 6) & 0x3F],
+                                 base64_table[triple & 0x3F]);
+    memcpy(out, &chars, 4);
+}
+#endif
+
 int base64_encode(const uint8_t *input, size_t input_len, char *output, size_t output_len) {
     if (!input || !output || input_len == 0) {
         return ARUNIKA_ERROR_INVALID_PARAM;
@@ -14,37 +58,261 @@ int base64_encode(const uint8_t *input, size_t input_len, char *output, size_t o
         return ARUNIKA_ERROR_MEMORY;
     }
     
-    size_t i, j;
-    for (i = 0, j = 0; i < input_len; ) {
-        uint32_t octet_a = i < input_len ? input[i++] : 0;
-        uint32_t octet_b = i < input_len ? input[i++] : 0;
-        uint32_t octet_c = i < input_len ? input[i++] : 0;
-        
-        uint32_t triple = (octet_a << 0x10) + (octet_b << 0x08) + octet_c;
-        
-        output[j++] = base64_table[(triple >> 3 * 6) & 0x3F];
-        output[j++] = base64_table[(triple >> 2 * 6) & 0x3F];
-        output[j++] = base64_table[(triple >> 1 * 6) & 0x3F];
-        output[j++] = base64_table[(triple >> 0 * 6) & 0x3F];
+    const uint8_t *in = input;
+    char *out = output;
+    size_t groups = input_len / 3;
+    
+    // Branch-free main loop, four groups (12 bytes in, 16 chars out) per pass
+    for (; groups >= 4; groups -= 4) {
+        base64_encode_group(in, out);
+        base64_encode_group(in + 3, out + 4);
+        base64_encode_group(in + 6, out + 8);
+        base64_encode_group(in + 9, out + 12);
+        in += 12;
+        out += 16;
+    }
+    for (; groups > 0; groups--) {
+        base64_encode_group(in, out);
+        in += 3;
+        out += 4;
     }
     
-    // Add padding
-    for (i = 0; i < (3 - input_len % 3) % 3; i++) {
-        output[encoded_len - 1 - i] = '=';
+    // Tail: one or two leftover bytes plus padding
+    size_t tail = input_len % 3;
+    if (tail > 0) {
+        uint32_t triple = (uint32_t)in[0] << 16;
+        if (tail == 2) {
+            triple |= (uint32_t)in[1] << 8;
+        }
+        out[0] = base64_table[(triple >> 18) & 0x3F];
+        out[1] = base64_table[(triple >> 12) & 0x3F];
+        out[2] = tail == 2 ? base64_table[(triple >> 6) & 0x3F] : '=';
+        out[3] = '=';
     }
     
     output[encoded_len] = '\0';
     return encoded_len;
 }
 
+// Base64 reverse lookup: sextet value, or one of the B64_* markers
+#define B64_INVALID 0xFF
+#define B64_PAD 0xFE
+#define B64_SPACE 0xFD
+
+static const uint8_t base64_reverse_table[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFD, 0xFD, 0xFF, 0xFF, 0xFD, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFD, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFE, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+void base64_decoder_init(base64_decoder_t *decoder) {
+    if (!decoder) {
+        return;
+    }
+    
+    memset(decoder, 0, sizeof(*decoder));
+}
+
+static int base64_flush(base64_decoder_t *decoder, const uint8_t *block, size_t len,
+                        base64_sink_t sink, void *ctx) {
+    if (len == 0) {
+        return ARUNIKA_OK;
+    }
+    
+    decoder->total_out += len;
+    return sink(block, len, ctx);
+}
+
+int base64_decoder_feed(base64_decoder_t *decoder, const char *input, size_t input_len,
+                        base64_sink_t sink, void *ctx) {
+    if (!decoder || !sink || (!input && input_len > 0)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    if (decoder->error) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    const uint8_t *in = (const uint8_t *)input;
+    const uint8_t *end = in + input_len;
+    uint8_t block[BASE64_DECODE_BLOCK];
+    size_t out = 0;
+    int result;
+    
+    while (in < end) {
+        // Fast path: whole quads on a quad boundary, one validity check for
+        // all four lookups (any marker or invalid byte has bit 7 set)
+        if (decoder->pending == 0 && !decoder->padding) {
+            while (end - in >= 4 && out + 3 <= sizeof(block)) {
+                uint32_t a = base64_reverse_table[in[0]];
+                uint32_t b = base64_reverse_table[in[1]];
+                uint32_t c = base64_reverse_table[in[2]];
+                uint32_t d = base64_reverse_table[in[3]];
+                if ((a | b | c | d) & 0x80) {
+                    break;
+                }
+                
+                uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+                block[out++] = (uint8_t)(triple >> 16);
+                block[out++] = (uint8_t)(triple >> 8);
+                block[out++] = (uint8_t)triple;
+                in += 4;
+            }
+        }
+        
+        if (out + 3 > sizeof(block)) {
+            if ((result = base64_flush(decoder, block, out, sink, ctx)) != ARUNIKA_OK) {
+                return result;
+            }
+            out = 0;
+        }
+        if (in >= end) {
+            break;
+        }
+        
+        // Slow path: one character, handles fragments, whitespace and padding
+        uint8_t value = base64_reverse_table[*in++];
+        if (value == B64_SPACE) {
+            continue;
+        }
+        
+        if (value == B64_PAD) {
+            if (decoder->padding == 0) {
+                // First '=' closes the quad; emit what the sextets carry
+                if (decoder->pending == 2) {
+                    block[out++] = (uint8_t)(decoder->accum >> 4);
+                    decoder->padding = 2;
+                } else if (decoder->pending == 3) {
+                    block[out++] = (uint8_t)(decoder->accum >> 10);
+                    block[out++] = (uint8_t)(decoder->accum >> 2);
+                    decoder->padding = 1;
+                } else {
+                    decoder->error = true;
+                    return ARUNIKA_ERROR_INVALID_PARAM;
+                }
+                decoder->pending = 0;
+                decoder->pad_seen = 1;
+            } else if (decoder->pad_seen < decoder->padding) {
+                decoder->pad_seen++;
+            } else {
+                decoder->error = true;
+                return ARUNIKA_ERROR_INVALID_PARAM;
+            }
+            continue;
+        }
+        
+        if (value == B64_INVALID || decoder->padding) {
+            // Unknown character, or data after the final padding
+            decoder->error = true;
+            return ARUNIKA_ERROR_INVALID_PARAM;
+        }
+        
+        decoder->accum = (decoder->accum << 6) | value;
+        if (++decoder->pending == 4) {
+            block[out++] = (uint8_t)(decoder->accum >> 16);
+            block[out++] = (uint8_t)(decoder->accum >> 8);
+            block[out++] = (uint8_t)decoder->accum;
+            decoder->pending = 0;
+        }
+    }
+    
+    // Hand everything decoded so far to the sink; nothing is held back
+    return base64_flush(decoder, block, out, sink, ctx);
+}
+
+int base64_decoder_finish(base64_decoder_t *decoder, base64_sink_t sink, void *ctx) {
+    if (!decoder || !sink || decoder->error) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // Accept unpadded input: a trailing 2 or 3 sextet group is still valid
+    uint8_t block[2];
+    size_t out = 0;
+    switch (decoder->pending) {
+        case 0:
+            break;
+        case 2:
+            block[out++] = (uint8_t)(decoder->accum >> 4);
+            break;
+        case 3:
+            block[out++] = (uint8_t)(decoder->accum >> 10);
+            block[out++] = (uint8_t)(decoder->accum >> 2);
+            break;
+        default:
+            decoder->error = true;
+            return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    decoder->pending = 0;
+    
+    int result = base64_flush(decoder, block, out, sink, ctx);
+    if (result != ARUNIKA_OK) {
+        return result;
+    }
+    
+    return (int)decoder->total_out;
+}
+
+// Sink for base64_decode(): bounded copy into a flat buffer
+typedef struct {
+    uint8_t *output;
+    size_t capacity;
+    size_t used;
+} base64_buffer_sink_t;
+
+static int base64_buffer_sink(const uint8_t *data, size_t len, void *ctx) {
+    base64_buffer_sink_t *buffer = (base64_buffer_sink_t *)ctx;
+    if (buffer->used + len > buffer->capacity) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    memcpy(buffer->output + buffer->used, data, len);
+    buffer->used += len;
+    return ARUNIKA_OK;
+}
+
 int base64_decode(const char *input, uint8_t *output, size_t output_len) {
     if (!input || !output) {
         return ARUNIKA_ERROR_INVALID_PARAM;
     }
     
-    // TODO: Implement base64 decoding
-    // For now, return error as not implemented
-    return ARUNIKA_ERROR_INIT;
+    base64_decoder_t decoder;
+    base64_buffer_sink_t buffer = { output, output_len, 0 };
+    base64_decoder_init(&decoder);
+    
+    int result = base64_decoder_feed(&decoder, input, strlen(input), base64_buffer_sink, &buffer);
+    if (result != ARUNIKA_OK) {
+        return result;
+    }
+    
+    return base64_decoder_finish(&decoder, base64_buffer_sink, &buffer);
+}
+
+// Nibble-table CRC-32 (IEEE 802.3), small enough for the boot path
+uint32_t crc32_compute(const void *data, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xF] ^ (crc >> 4);
+        crc = table[(crc ^ (bytes[i] >> 4)) & 0xF] ^ (crc >> 4);
+    }
+    return ~crc;
 }
 
 uint32_t get_timestamp_ms(void) {
@@ -56,6 +324,25 @@ uint32_t get_timestamp_ms(void) {
     return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
 }
 
+uint32_t get_rtc_time_ms(void) {
+    // Keeps counting through deep sleep, so expiry stamps kept in RTC
+    // memory still compare correctly after a wake, which restarts the
+    // timestamp clock
+#ifdef ESP_PLATFORM
+    return (uint32_t)(esp_rtc_get_time_us() / 1000);
+#else
+    return get_timestamp_ms(); // The host wakes in place
+#endif
+}
+
+uint32_t get_timestamp_us(void) {
+    // TODO: Use esp_timer_get_time() on ESP32
+    
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
 void delay_ms(uint32_t ms) {
     // TODO: Use proper ESP32 delay function
     // For now, use standard library
@@ -0,0 +1,149 @@
+#include "arunika.h"
+
+// Fixed-point voice activity detector. Each PCM16 frame is reduced to its
+// log2 mean energy (Q4) and zero-crossing rate (Q8). A frame is speech when
+// its energy clears an adaptive noise floor by the configured margin; noisy
+// frames with a high zero-crossing rate need one extra log2 unit (3 dB).
+// A hangover keeps trailing consonants, and a long enough silence after
+// speech marks the end of the utterance.
+
+#define VAD_ZCR_NOISE_Q8 102     // ~0.4 crossings per sample: hiss or fricative
+#define VAD_ZCR_PENALTY_Q4 16    // Extra margin for high-ZCR frames
+#define VAD_ENERGY_FLOOR_Q4 192  // log2(64^2): below this is never speech
+
+static vad_config_t config = {
+    true, VAD_END_SILENCE_MS_DEFAULT, VAD_HANGOVER_MS_DEFAULT,
+    VAD_NO_SPEECH_TIMEOUT_MS_DEFAULT, VAD_MARGIN_Q4_DEFAULT
+};
+
+// Noise floor survives across utterances; everything else is per utterance
+static int32_t noise_floor_q4 = -1;
+static uint32_t hangover_left_ms = 0;
+static uint32_t silence_run_ms = 0;
+static vad_stats_t stats;
+
+static int32_t vad_log2_q4(uint32_t value) {
+    if (value == 0) {
+        return 0;
+    }
+    
+    int msb = 31 - __builtin_clz(value);
+    uint32_t frac = msb >= 4 ? value >> (msb - 4) : value << (4 - msb);
+    return msb * 16 + (int32_t)(frac & 0xF);
+}
+
+int vad_init(const vad_config_t *vad_config) {
+    if (!vad_config || vad_config->end_silence_ms == 0) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    config = *vad_config;
+    noise_floor_q4 = -1;
+    vad_reset();
+    
+    return ARUNIKA_OK;
+}
+
+void vad_reset(void) {
+    hangover_left_ms = 0;
+    silence_run_ms = 0;
+    memset(&stats, 0, sizeof(stats));
+    stats.noise_floor_q4 = noise_floor_q4 < 0 ? 0 : (int16_t)noise_floor_q4;
+}
+
+bool vad_enabled(void) {
+    return config.enabled;
+}
+
+vad_result_t vad_process(const int16_t *pcm, size_t samples, uint32_t sample_rate) {
+    if (!pcm || samples < 2 || sample_rate == 0) {
+        return VAD_SILENCE;
+    }
+    
+    uint64_t sum = 0;
+    uint32_t crossings = 0;
+    for (size_t i = 0; i < samples; i++) {
+        int32_t x = pcm[i];
+        sum += (uint64_t)(x * x);
+        if (i > 0 && (pcm[i - 1] ^ pcm[i]) < 0) {
+            crossings++;
+        }
+    }
+    
+    int32_t energy_q4 = vad_log2_q4((uint32_t)(sum / samples));
+    uint32_t zcr_q8 = crossings * 256 / (uint32_t)samples;
+    uint32_t frame_ms = (uint32_t)(samples * 1000 / sample_rate);
+    
+    if (noise_floor_q4 < 0) {
+        noise_floor_q4 = energy_q4;
+    }
+    
+    int32_t margin = config.margin_q4 + (zcr_q8 > VAD_ZCR_NOISE_Q8 ? VAD_ZCR_PENALTY_Q4 : 0);
+    bool active = energy_q4 >= VAD_ENERGY_FLOOR_Q4 && energy_q4 >= noise_floor_q4 + margin;
+    
+    // Track the floor quickly downwards and slowly upwards, and barely at
+    // all during speech so a long utterance cannot raise it into itself
+    int32_t delta = energy_q4 - noise_floor_q4;
+    if (delta < 0) {
+        noise_floor_q4 += delta / 2;
+    } else {
+        noise_floor_q4 += active ? delta / 128 : delta / 16;
+    }
+    
+    stats.frames_total++;
+    stats.utterance_ms += frame_ms;
+    stats.noise_floor_q4 = (int16_t)noise_floor_q4;
+    if (energy_q4 > stats.peak_energy_q4) {
+        stats.peak_energy_q4 = (int16_t)energy_q4;
+    }
+    
+    vad_result_t result;
+    if (active) {
+        stats.frames_speech++;
+        stats.speech_ms += frame_ms;
+        stats.speech_detected = true;
+        hangover_left_ms = config.hangover_ms;
+        silence_run_ms = 0;
+        result = VAD_SPEECH;
+    } else if (hangover_left_ms > 0) {
+        hangover_left_ms = hangover_left_ms > frame_ms ? hangover_left_ms - frame_ms : 0;
+        silence_run_ms += frame_ms;
+        result = VAD_HANGOVER;
+    } else {
+        silence_run_ms += frame_ms;
+        result = VAD_SILENCE;
+    }
+    
+    // End of utterance: enough silence after speech, or no speech at all
+    if (stats.speech_detected && result != VAD_SPEECH && silence_run_ms >= config.end_silence_ms) {
+        result = VAD_END;
+    } else if (!stats.speech_detected && config.no_speech_timeout_ms > 0 &&
+               stats.utterance_ms >= config.no_speech_timeout_ms) {
+        result = VAD_END;
+    }
+    
+    if (result == VAD_SILENCE || (result == VAD_END && !stats.speech_detected)) {
+        stats.frames_suppressed++;
+    }
+    if (result == VAD_END) {
+        stats.ended_by_vad = true;
+    }
+    
+    return result;
+}
+
+void vad_get_stats(vad_stats_t *out) {
+    if (out) {
+        *out = stats;
+    }
+}
+
+int16_t vad_get_noise_floor(void) {
+    return (int16_t)noise_floor_q4;
+}
+
+// Restores a floor calibrated before deep sleep; negative starts over
+void vad_set_noise_floor(int16_t floor_q4) {
+    noise_floor_q4 = floor_q4 < 0 ? -1 : floor_q4;
+    stats.noise_floor_q4 = floor_q4 < 0 ? 0 : floor_q4;
+}
@@ -0,0 +1,434 @@
+#include "arunika.h"
+
+// Wake word standby. While the radio is off the capture path feeds a small
+// keyword spotter: every 32 ms block is reduced to KWS_BANDS Goertzel band
+// energies (log2, Q4, mean removed so loudness does not matter) and matched
+// against an enrolled template with streaming subsequence DTW. Meanwhile
+// the last few seconds are kept as G.711 in a pre-roll ring, so the words
+// spoken while WiFi and the WebSocket come back up are not lost.
+//
+// The pre-roll is SPSC like the capture ring: the capture path produces and
+// the uplink consumes. Mode changes are split the same way; capture moves
+// ARMED->TRIGGERED and HANDOFF->PASSTHROUGH, the uplink does the rest.
+
+#define KWS_ENERGY_FLOOR_Q4 192 // log2(64^2): quieter blocks break a match
+#define KWS_MIN_TEMPLATE_FRAMES 4
+#define KWS_COST_MAX (UINT32_MAX / 2)
+#define PREROLL_MASK (WAKEWORD_PREROLL_SAMPLES - 1)
+
+typedef char wakeword_preroll_power_of_two[(WAKEWORD_PREROLL_SAMPLES & PREROLL_MASK) == 0 ? 1 : -1];
+
+// 2*cos(2*pi*f/8000) in Q14 for 300, 500, 750, 1000, 1400, 1900, 2500 and 3200 Hz
+static const int32_t kws_coeff_q14[KWS_BANDS] = {
+    31863, 30274, 27246, 23170, 14876, 2571, -12540, -26510
+};
+
+static uint16_t threshold_q4 = KWS_THRESHOLD_Q4_DEFAULT;
+static int16_t template_features[KWS_MAX_TEMPLATE_FRAMES][KWS_BANDS];
+static uint32_t template_frames = 0;
+
+// Streaming DTW column: best path cost into each template frame and the
+// number of blocks on that path
+static uint32_t dtw_cost[KWS_MAX_TEMPLATE_FRAMES];
+static uint16_t dtw_blocks[KWS_MAX_TEMPLATE_FRAMES];
+
+// Samples carried over until a full feature block is available
+static int16_t block_pcm[KWS_FRAME_SAMPLES];
+static size_t block_fill = 0;
+
+static wakeword_mode_t mode = WAKEWORD_OFF;
+static bool trigger_requested = false;
+
+static ARUNIKA_PSRAM_BSS uint8_t preroll[WAKEWORD_PREROLL_SAMPLES]; // mu-law
+static uint32_t preroll_head = 0; // Written only by the capture path
+static uint32_t preroll_tail = 0; // Written by the uplink, or by capture while ARMED
+
+// Uplink frame rebuilt from the pre-roll, with headroom for in-place
+// framing; pooled only while a frame is waiting to be sent
+static audio_buffer_t *frame = NULL;
+static size_t frame_consumed = 0;
+
+static wakeword_stats_t stats;
+
+static int32_t kws_log2_q4(uint64_t value) {
+    if (value == 0) {
+        return 0;
+    }
+    
+    int msb = 63 - __builtin_clzll(value);
+    uint64_t frac = msb >= 4 ? value >> (msb - 4) : value << (4 - msb);
+    return msb * 16 + (int32_t)(frac & 0xF);
+}
+
+// Returns false for blocks too quiet to carry a keyword
+static bool kws_features(const int16_t *pcm, int16_t out[KWS_BANDS]) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < KWS_FRAME_SAMPLES; i++) {
+        int32_t x = pcm[i];
+        sum += (uint64_t)(x * x);
+    }
+    if (kws_log2_q4(sum / KWS_FRAME_SAMPLES) < KWS_ENERGY_FLOOR_Q4) {
+        return false;
+    }
+    
+    // Goertzel resonators stay below N * 32768, so the products fit in 64 bits
+    int32_t band_q4[KWS_BANDS];
+    int32_t mean = 0;
+    for (int b = 0; b < KWS_BANDS; b++) {
+        int64_t coeff = kws_coeff_q14[b];
+        int32_t s1 = 0;
+        int32_t s2 = 0;
+        for (size_t i = 0; i < KWS_FRAME_SAMPLES; i++) {
+            int32_t s0 = pcm[i] + (int32_t)((coeff * s1) >> 14) - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        
+        int64_t power = (int64_t)s1 * s1 + (int64_t)s2 * s2 - ((coeff * s1) >> 14) * s2;
+        band_q4[b] = kws_log2_q4(power > 0 ? (uint64_t)power : 0);
+        mean += band_q4[b];
+    }
+    
+    mean /= KWS_BANDS;
+    for (int b = 0; b < KWS_BANDS; b++) {
+        out[b] = (int16_t)(band_q4[b] - mean);
+    }
+    return true;
+}
+
+static void kws_reset_path(void) {
+    for (uint32_t j = 0; j < KWS_MAX_TEMPLATE_FRAMES; j++) {
+        dtw_cost[j] = KWS_COST_MAX;
+        dtw_blocks[j] = 0;
+    }
+}
+
+// Advances the DTW column by one block; true when the whole template matched.
+// Every block advances the path by zero, one or two template frames, so a
+// match spans between half and all of the template per block and each
+// block adds exactly one distance. Runs backwards to read the old column.
+static bool kws_step(const int16_t features[KWS_BANDS]) {
+    for (int32_t j = (int32_t)template_frames - 1; j >= 0; j--) {
+        uint32_t distance = 0;
+        for (int b = 0; b < KWS_BANDS; b++) {
+            distance += (uint32_t)abs(template_features[j][b] - features[b]);
+        }
+        
+        // A path may start at any block on the first template frame
+        uint32_t cost = 0;
+        uint16_t blocks = 0;
+        if (j > 0) {
+            int32_t from = j;
+            for (int32_t k = j - 1; k >= 0 && k >= j - 2; k--) {
+                if (dtw_cost[k] < dtw_cost[from]) {
+                    from = k;
+                }
+            }
+            cost = dtw_cost[from];
+            blocks = dtw_blocks[from];
+        }
+        
+        dtw_cost[j] = cost >= KWS_COST_MAX ? KWS_COST_MAX : cost + distance;
+        dtw_blocks[j] = blocks + 1;
+    }
+    
+    uint32_t last = template_frames - 1;
+    if (dtw_cost[last] >= KWS_COST_MAX) {
+        return false;
+    }
+    
+    uint32_t score = dtw_cost[last] / ((uint32_t)dtw_blocks[last] * KWS_BANDS);
+    if (score < stats.best_score_q4) {
+        stats.best_score_q4 = (uint16_t)score;
+    }
+    
+    // Also reject matches spoken at less than half the enrolled speed
+    if (score > threshold_q4 || dtw_blocks[last] > template_frames * 2) {
+        return false;
+    }
+    
+    kws_reset_path();
+    return true;
+}
+
+// Uplink side: gives back an unsent frame, its samples stay in the pre-roll
+static void preroll_drop_frame(void) {
+    if (frame) {
+        audio_buffer_release(frame);
+        frame = NULL;
+    }
+}
+
+int wakeword_init(uint16_t threshold) {
+    threshold_q4 = threshold;
+    template_frames = 0;
+    kws_reset_path();
+    
+    preroll_drop_frame();
+    
+    memset(&stats, 0, sizeof(stats));
+    __atomic_store_n(&mode, WAKEWORD_OFF, __ATOMIC_RELEASE);
+    
+    return ARUNIKA_OK;
+}
+
+int wakeword_enroll(const int16_t *pcm, size_t samples) {
+    // The spotter reads the template, so only enroll while disarmed
+    if (!pcm || wakeword_get_mode() != WAKEWORD_OFF) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // Leading silence is skipped; the keyword ends at the first quiet block
+    uint32_t frames = 0;
+    for (size_t offset = 0; offset + KWS_FRAME_SAMPLES <= samples && frames < KWS_MAX_TEMPLATE_FRAMES;
+         offset += KWS_FRAME_SAMPLES) {
+        if (kws_features(pcm + offset, template_features[frames])) {
+            frames++;
+        } else if (frames > 0) {
+            break;
+        }
+    }
+    
+    if (frames < KWS_MIN_TEMPLATE_FRAMES) {
+        template_frames = 0;
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    template_frames = frames;
+    kws_reset_path();
+    printf("Wake word enrolled: %u frames (%u ms)\n", (unsigned)frames,
+           (unsigned)(frames * KWS_FRAME_SAMPLES * 1000 / SAMPLE_RATE));
+    return ARUNIKA_OK;
+}
+
+bool wakeword_has_template(void) {
+    return template_frames > 0;
+}
+
+int wakeword_process(const int16_t *pcm, size_t samples) {
+    if (!pcm || template_frames == 0) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    int detected = 0;
+    while (samples > 0) {
+        size_t n = KWS_FRAME_SAMPLES - block_fill;
+        if (n > samples) {
+            n = samples;
+        }
+        memcpy(block_pcm + block_fill, pcm, n * sizeof(int16_t));
+        block_fill += n;
+        pcm += n;
+        samples -= n;
+        if (block_fill < KWS_FRAME_SAMPLES) {
+            break;
+        }
+        block_fill = 0;
+        
+        int16_t features[KWS_BANDS];
+        stats.frames_scored++;
+        if (!kws_features(block_pcm, features)) {
+            kws_reset_path();
+            continue;
+        }
+        if (kws_step(features)) {
+            detected = 1;
+        }
+    }
+    
+    return detected;
+}
+
+int wakeword_arm(void) {
+    if (template_frames == 0) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // Called with capture stopped, so the pre-roll has no producer yet
+    kws_reset_path();
+    block_fill = 0;
+    preroll_drop_frame();
+    stats.best_score_q4 = UINT16_MAX;
+    stats.preroll_overflows = 0;
+    __atomic_store_n(&preroll_tail, __atomic_load_n(&preroll_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    __atomic_store_n(&trigger_requested, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&mode, WAKEWORD_ARMED, __ATOMIC_RELEASE);
+    
+    return ARUNIKA_OK;
+}
+
+int wakeword_hold(void) {
+    // An utterance started without the keyword, e.g. by the button while the
+    // link is down: capture goes straight to the pre-roll until it is back
+    if (wakeword_get_mode() != WAKEWORD_OFF) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // Called with capture stopped, as for wakeword_arm()
+    preroll_drop_frame();
+    stats.preroll_overflows = 0;
+    __atomic_store_n(&preroll_tail, __atomic_load_n(&preroll_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    __atomic_store_n(&mode, WAKEWORD_TRIGGERED, __ATOMIC_RELEASE);
+    
+    return ARUNIKA_OK;
+}
+
+void wakeword_disarm(void) {
+    __atomic_store_n(&mode, WAKEWORD_OFF, __ATOMIC_RELEASE);
+    preroll_drop_frame();
+}
+
+void wakeword_request_trigger(void) {
+    // Handled by the capture path on its next frame, as if the keyword matched
+    if (wakeword_get_mode() == WAKEWORD_ARMED) {
+        __atomic_store_n(&trigger_requested, true, __ATOMIC_RELEASE);
+    }
+}
+
+wakeword_mode_t wakeword_get_mode(void) {
+    return __atomic_load_n(&mode, __ATOMIC_ACQUIRE);
+}
+
+static void wakeword_preroll_push(const int16_t *pcm, size_t samples, bool rolling) {
+    uint32_t head = __atomic_load_n(&preroll_head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&preroll_tail, __ATOMIC_ACQUIRE);
+    
+    // Before a detection the oldest audio is history; after it, the uplink
+    // owns every queued sample and a frame that does not fit is dropped
+    // whole, which keeps the queue in whole frames
+    if (!rolling && head - tail + samples > WAKEWORD_PREROLL_SAMPLES) {
+        stats.preroll_overflows += (uint32_t)samples;
+        return;
+    }
+    
+    for (size_t i = 0; i < samples; i++) {
+        if (head - tail >= WAKEWORD_PREROLL_SAMPLES) {
+            tail++;
+        }
+        preroll[head & PREROLL_MASK] = g711_mulaw_encode(pcm[i]);
+        head++;
+    }
+    
+    if (rolling) {
+        __atomic_store_n(&preroll_tail, tail, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&preroll_head, head, __ATOMIC_RELEASE);
+}
+
+bool wakeword_capture(const int16_t *pcm, size_t samples) {
+    // Capture path, ahead of the ring. True when the frame was taken
+    wakeword_mode_t current = wakeword_get_mode();
+    if (current == WAKEWORD_HANDOFF) {
+        // The uplink caught up with the pre-roll; live frames use the ring again
+        __atomic_store_n(&mode, WAKEWORD_PASSTHROUGH, __ATOMIC_RELEASE);
+        return false;
+    }
+    if (!pcm || (current != WAKEWORD_ARMED && current != WAKEWORD_TRIGGERED)) {
+        return false;
+    }
+    
+    wakeword_preroll_push(pcm, samples, current == WAKEWORD_ARMED);
+    if (current == WAKEWORD_TRIGGERED) {
+        events_post_from_isr(EVENT_AUDIO_CAPTURED);
+        return true;
+    }
+    
+    bool manual = __atomic_exchange_n(&trigger_requested, false, __ATOMIC_ACQ_REL);
+    if (wakeword_process(pcm, samples) > 0 || manual) {
+        // Keep a little audio from before the detection point, in whole
+        // capture frames: the uplink then drains the pre-roll to exactly
+        // empty while capture pushes frame by frame, and the handoff to
+        // the ring needs no padding in the middle of the utterance
+        uint32_t head = __atomic_load_n(&preroll_head, __ATOMIC_RELAXED);
+        uint32_t tail = __atomic_load_n(&preroll_tail, __ATOMIC_RELAXED);
+        uint32_t frame_samples = (uint32_t)audio_capture_frame_samples();
+        uint32_t lead = (WAKEWORD_LEAD_MS * SAMPLE_RATE / 1000 + frame_samples - 1) / frame_samples * frame_samples;
+        uint32_t keep = head - tail < lead ? (head - tail) / frame_samples * frame_samples : lead;
+        __atomic_store_n(&preroll_tail, head - keep, __ATOMIC_RELEASE);
+        
+        stats.detections++;
+        __atomic_store_n(&mode, WAKEWORD_TRIGGERED, __ATOMIC_RELEASE);
+        events_post_from_isr(EVENT_WAKE_WORD);
+    }
+    
+    return true;
+}
+
+bool wakeword_preroll_active(void) {
+    wakeword_mode_t current = wakeword_get_mode();
+    return current == WAKEWORD_TRIGGERED || current == WAKEWORD_HANDOFF || current == WAKEWORD_PASSTHROUGH;
+}
+
+size_t wakeword_preroll_available(void) {
+    uint32_t tail = __atomic_load_n(&preroll_tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&preroll_head, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+audio_buffer_t *wakeword_preroll_peek(size_t frame_samples, bool flush) {
+    // Uplink side. flush means capture has stopped, so the remainder is final
+    if (!wakeword_preroll_active() || frame_samples == 0 || frame_samples * 2 > AUDIO_BUFFER_SIZE) {
+        return NULL;
+    }
+    
+    // Retried after a failed send, possibly already encoded
+    if (frame) {
+        return frame;
+    }
+    
+    wakeword_mode_t current = wakeword_get_mode();
+    bool last = flush || current == WAKEWORD_PASSTHROUGH;
+    size_t available = wakeword_preroll_available();
+    if (available < frame_samples && !(last && available > 0)) {
+        if (last) {
+            // Drained: the capture ring takes over
+            __atomic_store_n(&mode, WAKEWORD_OFF, __ATOMIC_RELEASE);
+        } else if (current == WAKEWORD_TRIGGERED) {
+            wakeword_mode_t expected = WAKEWORD_TRIGGERED;
+            __atomic_compare_exchange_n(&mode, &expected, WAKEWORD_HANDOFF, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        }
+        return NULL;
+    }
+    
+    frame = audio_buffer_acquire(SAMPLE_RATE, AUDIO_FORMAT_PCM);
+    if (!frame) {
+        return NULL;
+    }
+    
+    uint32_t tail = __atomic_load_n(&preroll_tail, __ATOMIC_RELAXED);
+    size_t n = available < frame_samples ? available : frame_samples;
+    int16_t *pcm = (int16_t *)frame->data;
+    for (size_t i = 0; i < n; i++) {
+        pcm[i] = g711_mulaw_decode(preroll[(tail + i) & PREROLL_MASK]);
+    }
+    // Fixed frame size codecs get the final partial frame padded with
+    // silence. Only the end of the utterance has one when capture delivers
+    // whole frames
+    for (size_t i = n; i < frame_samples; i++) {
+        pcm[i] = 0;
+    }
+    
+    frame->size = frame_samples * 2;
+    frame_consumed = n;
+    return frame;
+}
+
+int wakeword_preroll_release(void) {
+    if (!frame) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t tail = __atomic_load_n(&preroll_tail, __ATOMIC_RELAXED);
+    __atomic_store_n(&preroll_tail, tail + (uint32_t)frame_consumed, __ATOMIC_RELEASE);
+    audio_buffer_release(frame);
+    frame = NULL;
+    return ARUNIKA_OK;
+}
+
+void wakeword_get_stats(wakeword_stats_t *out) {
+    if (out) {
+        *out = stats;
+        out->preroll_samples = (uint32_t)wakeword_preroll_available();
+    }
+}
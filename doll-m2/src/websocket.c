@@ -1,25 +1,768 @@
 #include "arunika.h"
 
+// make bench builds the host firmware against a real server: plain TCP
+// sockets instead of the simulated link, same framing on top
+#if defined(ARUNIKA_WS_SOCKET) && !defined(ESP_PLATFORM)
+#define WS_SOCKET_TRANSPORT
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define WS_SOCKET_TIMEOUT_MS 5000
+#endif
+
 // Global WebSocket state
 static bool websocket_connected = false;
+static websocket_uplink_mode_t uplink_mode = WEBSOCKET_UPLINK_BINARY;
+static uint32_t mask_seed = 0;
+static uint64_t tx_bytes = 0;
+static char auth_token[WS_MAX_AUTH_TOKEN + 1];
+#ifdef WS_SOCKET_TRANSPORT
+static int ws_fd = -1;
+#endif
+
+// Connection state machine: resolve (cached) -> TCP -> TLS (resumed when a
+// session ticket is cached) -> HTTP upgrade
+static websocket_conn_state_t conn_state = WS_CONN_IDLE;
+static websocket_conn_stats_t conn_stats;
+
+// Simulated phase costs on a ~100 ms RTT link; a full TLS 1.2 handshake
+// takes two round trips plus the certificate check, a resumed one only one
+#define WS_SIM_TCP_MS 100
+#define WS_SIM_TLS_FULL_MS 400
+#define WS_SIM_TLS_RESUMED_MS 100
+#define WS_SIM_UPGRADE_MS 100
+
+// Last TLS session, kept in RTC memory so the first connect after deep
+// sleep is still an abbreviated handshake
+typedef struct {
+    bool valid;
+    char host[MAX_HOST_LENGTH];
+    uint16_t port;
+    uint16_t ticket_len;
+    uint8_t ticket[TLS_SESSION_TICKET_MAX];
+    uint32_t expires_ms;
+} tls_session_cache_t;
+
+static ARUNIKA_RTC_DATA tls_session_cache_t tls_session;
+
+// Outgoing text frames are formatted after WS_MAX_HEADER_SIZE bytes of
+// headroom so the frame header can be prepended in place
+static uint8_t text_frame[WS_MAX_HEADER_SIZE + WS_MAX_TEXT_MESSAGE];
+#define TEXT_MESSAGE ((char *)text_frame + WS_MAX_HEADER_SIZE)
+
+// Uplink batching: on a slow link several audio frames go out in one
+// transport write (one TLS record) instead of one each. Every frame keeps
+// its own WebSocket and audio header, so the server sees the same messages
+static uint8_t uplink_batch[WS_UPLINK_BATCH_SIZE];
+static size_t uplink_batch_len = 0;
+static uint32_t uplink_batch_audio_ms = 0;    // Audio queued in the batch
+static uint32_t uplink_batch_start_ms = 0;    // When its first frame was queued
+static uint32_t uplink_batch_frames = 0;
+static uint32_t uplink_frames_written = 0;    // Audio frames the transport accepted, batched or not
+static uint32_t uplink_batch_fixed_ms = WS_UPLINK_BATCH_ADAPTIVE;
+
+// The link estimate outlives reconnects; it describes the WiFi, not the
+// connection. One ping at a time is timed, later ones until its pong are not
+static websocket_link_stats_t link_stats;
+static bool ping_outstanding = false;
+static uint32_t ping_sent_ms = 0;
+
+// Receive side: frames are parsed incrementally from whatever the
+// transport returns, so a message of any length passes through the
+// caller's fixed read buffer. Data frame payload goes to the sink as it
+// arrives. Control frames may sit between the fragments of a message;
+// they are at most 125 bytes, so they are collected whole and answered here
+static struct {
+    uint8_t header[WS_MAX_HEADER_SIZE];
+    size_t header_len;
+    size_t header_need;        // 2 until the length byte has been seen
+    bool in_payload;
+    bool fin;
+    uint8_t opcode;            // Of the current frame
+    uint64_t frame_len;
+    uint64_t remaining;
+    uint8_t message_opcode;    // 0 while no data message is open
+    bool message_started;      // First chunk delivered
+    bool message_dropped;      // Sink rejected it; skip to the end
+    uint8_t control[WS_MAX_CONTROL_PAYLOAD];
+    size_t control_len;
+} rx;
+
+#ifndef ESP_PLATFORM
+// Bytes the simulated server has sent, or that arrived on the socket along
+// with the upgrade response, and the transport has not yet read
+#define WS_SIM_RX_SIZE 4096
+static uint8_t sim_rx[WS_SIM_RX_SIZE];
+static size_t sim_rx_head = 0;
+static size_t sim_rx_len = 0;
+static bool sim_fail_write = false; // The next transport write fails like a reset
+#endif
+
+// Gather list entry for header + payload sends
+typedef struct {
+    const uint8_t *base;
+    size_t len;
+} ws_iovec_t;
+
+#ifdef WS_SOCKET_TRANSPORT
+static bool ws_socket_wait(short events) {
+    struct pollfd pfd = { ws_fd, events, 0 };
+    return poll(&pfd, 1, WS_SOCKET_TIMEOUT_MS) > 0 && (pfd.revents & (events | POLLHUP | POLLERR));
+}
+
+static void ws_socket_close(void) {
+    if (ws_fd >= 0) {
+        close(ws_fd);
+        ws_fd = -1;
+    }
+}
+
+// Non-blocking so the event loop can watch it; writes wait for room
+static int ws_socket_open(const network_addr_t *addr, uint16_t port) {
+    ws_socket_close();
+    sim_rx_len = 0;
+    
+    ws_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (ws_fd < 0) {
+        return ARUNIKA_ERROR_NETWORK;
+    }
+    
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    memcpy(&sa.sin_addr, addr->addr, sizeof(addr->addr));
+    
+    int one = 1;
+    setsockopt(ws_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Frames are already whole
+    fcntl(ws_fd, F_SETFL, fcntl(ws_fd, F_GETFL) | O_NONBLOCK);
+    if (connect(ws_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        if (errno != EINPROGRESS || !ws_socket_wait(POLLOUT) ||
+            getsockopt(ws_fd, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0 || error != 0) {
+            ws_socket_close();
+            return ARUNIKA_ERROR_NETWORK;
+        }
+    }
+    return ARUNIKA_OK;
+}
+#endif
+
+static void ws_rx_reset(void) {
+    memset(&rx, 0, sizeof(rx));
+    rx.header_need = 2;
+}
+
+// The peer is gone or broke the protocol; the reconnect timer takes over
+static void ws_connection_lost(void) {
+    websocket_connected = false;
+    conn_state = WS_CONN_IDLE;
+    ws_rx_reset();
+    uplink_batch_len = 0;
+    uplink_batch_audio_ms = 0;
+    uplink_batch_frames = 0;
+    ping_outstanding = false;
+#ifdef WS_SOCKET_TRANSPORT
+    ws_socket_close();
+#endif
+}
+
+static int ws_transport_writev(const ws_iovec_t *iov, int iovcnt) {
+#ifndef ESP_PLATFORM
+    if (sim_fail_write) {
+        sim_fail_write = false;
+        ws_connection_lost();
+        return ARUNIKA_ERROR_WEBSOCKET;
+    }
+#endif
+    // TODO: Write to the TLS socket (one record on mbedTLS)
+    for (int i = 0; i < iovcnt; i++) {
+        tx_bytes += iov[i].len;
+    }
+#ifdef WS_SOCKET_TRANSPORT
+    struct iovec vec[2];
+    if (ws_fd < 0 || iovcnt > 2) {
+        return ARUNIKA_ERROR_WEBSOCKET;
+    }
+    for (int i = 0; i < iovcnt; i++) {
+        vec[i].iov_base = (void *)iov[i].base;
+        vec[i].iov_len = iov[i].len;
+    }
+    
+    // Whole frames only: a partial write resumes where the socket stopped
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = vec;
+    msg.msg_iovlen = iovcnt;
+    while (msg.msg_iovlen > 0) {
+        ssize_t n = sendmsg(ws_fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && ws_socket_wait(POLLOUT)) {
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            ws_connection_lost(); // Reset or timed out
+            return ARUNIKA_ERROR_WEBSOCKET;
+        }
+        while (msg.msg_iovlen > 0 && (size_t)n >= msg.msg_iov->iov_len) {
+            n -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (uint8_t *)msg.msg_iov->iov_base + n;
+            msg.msg_iov->iov_len -= n;
+        }
+    }
+#endif
+    return ARUNIKA_OK;
+}
+
+static int ws_transport_write(const uint8_t *data, size_t len) {
+    ws_iovec_t iov = { data, len };
+    return ws_transport_writev(&iov, 1);
+}
+
+// Returns the number of bytes read, 0 when nothing is pending
+static int ws_transport_read(uint8_t *buffer, size_t len) {
+    // TODO: mbedtls_ssl_read() on the non-blocking socket (MBEDTLS_ERR_SSL_WANT_READ -> 0)
+#ifndef ESP_PLATFORM
+    size_t n = len < sim_rx_len ? len : sim_rx_len;
+    for (size_t i = 0; i < n; i++) {
+        buffer[i] = sim_rx[(sim_rx_head + i) % WS_SIM_RX_SIZE];
+    }
+    sim_rx_head = (sim_rx_head + n) % WS_SIM_RX_SIZE;
+    sim_rx_len -= n;
+#ifdef WS_SOCKET_TRANSPORT
+    if (n == 0 && ws_fd >= 0) {
+        ssize_t got = recv(ws_fd, buffer, len, 0);
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return 0;
+        }
+        if (got <= 0) {
+            return ARUNIKA_ERROR_WEBSOCKET; // Closed by the server or reset
+        }
+        return (int)got;
+    }
+#endif
+    return (int)n;
+#else
+    (void)buffer;
+    (void)len;
+    return 0;
+#endif
+}
+
+static uint32_t ws_next_mask(void) {
+    // TODO: Use the hardware RNG (esp_random) on ESP32
+    if (mask_seed == 0) {
+        mask_seed = get_timestamp_ms() | 1;
+    }
+    // xorshift32
+    mask_seed ^= mask_seed << 13;
+    mask_seed ^= mask_seed >> 17;
+    mask_seed ^= mask_seed << 5;
+    return mask_seed;
+}
+
+int websocket_build_frame_header(uint8_t *out, size_t out_len, uint8_t opcode,
+                                 size_t payload_len, const uint8_t mask[4]) {
+    if (!out || !mask || out_len < WS_MAX_HEADER_SIZE) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    size_t n = 0;
+    out[n++] = 0x80 | (opcode & 0x0F); // FIN, no fragmentation
+    
+    // Client-to-server frames are always masked
+    if (payload_len < 126) {
+        out[n++] = 0x80 | (uint8_t)payload_len;
+    } else if (payload_len <= 0xFFFF) {
+        out[n++] = 0x80 | 126;
+        out[n++] = (uint8_t)(payload_len >> 8);
+        out[n++] = (uint8_t)payload_len;
+    } else {
+        out[n++] = 0x80 | 127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out[n++] = (uint8_t)((uint64_t)payload_len >> shift);
+        }
+    }
+    
+    memcpy(&out[n], mask, 4);
+    n += 4;
+    
+    return (int)n;
+}
+
+void websocket_apply_mask(uint8_t *data, size_t len, const uint8_t mask[4], size_t offset) {
+    size_t i = 0;
+    
+    // Byte-wise until the mask phase lines up with a word boundary
+    while (i < len && ((offset + i) & 3) != 0) {
+        data[i] ^= mask[(offset + i) & 3];
+        i++;
+    }
+    
+    // Then a word at a time; the phase is 0 so the mask bytes are in order
+    uint32_t mask_word;
+    memcpy(&mask_word, mask, 4);
+    for (; i + 4 <= len; i += 4) {
+        uint32_t word;
+        memcpy(&word, &data[i], 4);
+        word ^= mask_word;
+        memcpy(&data[i], &word, 4);
+    }
+    
+    for (; i < len; i++) {
+        data[i] ^= mask[(offset + i) & 3];
+    }
+}
+
+int audio_frame_header_encode(uint8_t *out, audio_format_t format, uint32_t sequence,
+                              uint32_t timestamp_ms, uint8_t flags) {
+    if (!out) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // Little-endian, fixed layout shared with the server hub
+    out[0] = AUDIO_FRAME_MAGIC;
+    out[1] = AUDIO_FRAME_VERSION;
+    out[2] = (uint8_t)format;
+    out[3] = flags;
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = (uint8_t)(sequence >> (8 * i));
+        out[8 + i] = (uint8_t)(timestamp_ms >> (8 * i));
+    }
+    
+    return AUDIO_FRAME_HEADER_SIZE;
+}
+
+static void ws_make_mask(uint8_t mask[4]) {
+    uint32_t mask_word = ws_next_mask();
+    mask[0] = (uint8_t)(mask_word >> 24);
+    mask[1] = (uint8_t)(mask_word >> 16);
+    mask[2] = (uint8_t)(mask_word >> 8);
+    mask[3] = (uint8_t)mask_word;
+}
+
+// Sends body[0..body_len) as one frame. The frame header is written into
+// the headroom directly in front of body and the payload is masked in
+// place, so the socket gets a single contiguous buffer with no copies.
+// On failure the payload is unmasked again so the caller can retry.
+static int ws_send_in_place(uint8_t opcode, uint8_t *body, size_t body_len, size_t headroom) {
+    uint8_t mask[4];
+    uint8_t header[WS_MAX_HEADER_SIZE];
+    ws_make_mask(mask);
+    
+    int header_len = websocket_build_frame_header(header, sizeof(header), opcode, body_len, mask);
+    if (header_len < 0) {
+        return header_len;
+    }
+    if ((size_t)header_len > headroom) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    uint8_t *frame = body - header_len;
+    memcpy(frame, header, header_len);
+    websocket_apply_mask(body, body_len, mask, 0);
+    
+    int result = ws_transport_write(frame, header_len + body_len);
+    if (result != ARUNIKA_OK) {
+        websocket_apply_mask(body, body_len, mask, 0);
+    }
+    
+    return result;
+}
+
+// Scatter/gather variant for payloads without headroom: header and prefix
+// go out from a small stack buffer, the payload is masked in place.
+static int ws_send_gather(uint8_t opcode, const uint8_t *prefix, size_t prefix_len,
+                          uint8_t *payload, size_t payload_len) {
+    uint8_t mask[4];
+    uint8_t header[WS_MAX_HEADER_SIZE + AUDIO_FRAME_HEADER_SIZE];
+    if (prefix_len > AUDIO_FRAME_HEADER_SIZE) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    ws_make_mask(mask);
+    
+    int header_len = websocket_build_frame_header(header, sizeof(header), opcode,
+                                                  prefix_len + payload_len, mask);
+    if (header_len < 0) {
+        return header_len;
+    }
+    
+    if (prefix_len > 0) {
+        memcpy(header + header_len, prefix, prefix_len);
+        websocket_apply_mask(header + header_len, prefix_len, mask, 0);
+    }
+    websocket_apply_mask(payload, payload_len, mask, prefix_len);
+    
+    ws_iovec_t iov[2] = {
+        { header, header_len + prefix_len },
+        { payload, payload_len }
+    };
+    int result = ws_transport_writev(iov, payload_len > 0 ? 2 : 1);
+    if (result != ARUNIKA_OK) {
+        websocket_apply_mask(payload, payload_len, mask, prefix_len);
+    }
+    
+    return result;
+}
+
+// TCP-style smoothing: gain 1/8 on the RTT, 1/4 on its deviation
+static void ws_link_sample_rtt(uint32_t rtt_ms) {
+    if (link_stats.rtt_samples == 0) {
+        link_stats.srtt_ms = rtt_ms;
+        link_stats.rttvar_ms = rtt_ms / 2;
+    } else {
+        uint32_t error = rtt_ms > link_stats.srtt_ms ? rtt_ms - link_stats.srtt_ms : link_stats.srtt_ms - rtt_ms;
+        link_stats.rttvar_ms = (3 * link_stats.rttvar_ms + error) / 4;
+        link_stats.srtt_ms = (7 * link_stats.srtt_ms + rtt_ms) / 8;
+    }
+    link_stats.rtt_samples++;
+}
+
+// A write that waited for socket room means the link is not keeping up
+// with the audio; that wait is paid again by every frame sent on its own
+static void ws_link_note_flush(uint32_t start_ms) {
+    uint32_t stall = get_timestamp_ms() - start_ms;
+    link_stats.stall_ms = (3 * link_stats.stall_ms + stall) / 4;
+    link_stats.flushes++;
+}
+
+uint32_t websocket_uplink_batch_target_ms(uint32_t rtt_ms, uint32_t rttvar_ms, uint32_t stall_ms) {
+    // Half an RTT of extra delay is hidden behind the response anyway; a
+    // jittery or stalling link gets more on top. A good link ends up below
+    // one capture frame, which means every frame is sent at once
+    uint32_t target = rtt_ms / 2 + rttvar_ms + stall_ms;
+    return target < WS_UPLINK_BATCH_MAX_MS ? target : WS_UPLINK_BATCH_MAX_MS;
+}
+
+static uint32_t ws_uplink_batch_ms(void) {
+    if (uplink_batch_fixed_ms != WS_UPLINK_BATCH_ADAPTIVE) {
+        return uplink_batch_fixed_ms;
+    }
+    
+    // A probe still unanswered already bounds the RTT from below
+    uint32_t rtt = link_stats.srtt_ms;
+    if (ping_outstanding) {
+        uint32_t waiting = get_timestamp_ms() - ping_sent_ms;
+        if (waiting >= WS_LINK_PING_TIMEOUT_MS) {
+            ping_outstanding = false;
+        } else if (waiting > rtt) {
+            rtt = waiting;
+        }
+    }
+    return websocket_uplink_batch_target_ms(rtt, link_stats.rttvar_ms, link_stats.stall_ms);
+}
+
+// A failed write drops the connection and the batch with it. The uplink
+// still holds those frames, as only written ones count, and sends them
+// again on the next connection
+static int ws_uplink_flush(void) {
+    if (uplink_batch_len == 0) {
+        return ARUNIKA_OK;
+    }
+    
+    uint32_t start = get_timestamp_ms();
+    int result = ws_transport_write(uplink_batch, uplink_batch_len);
+    ws_link_note_flush(start);
+    if (result == ARUNIKA_OK) {
+        uplink_frames_written += uplink_batch_frames;
+    }
+    uplink_batch_len = 0;
+    uplink_batch_audio_ms = 0;
+    uplink_batch_frames = 0;
+    return result;
+}
+
+// Appends one whole masked frame; the caller has checked that it fits
+static void ws_uplink_append(const audio_buffer_t *buffer, uint32_t sequence, uint32_t timestamp, uint8_t flags) {
+    uint8_t mask[4];
+    ws_make_mask(mask);
+    
+    uint8_t *out = uplink_batch + uplink_batch_len;
+    size_t body_len = AUDIO_FRAME_HEADER_SIZE + buffer->size;
+    int header_len = websocket_build_frame_header(out, WS_UPLINK_BATCH_SIZE - uplink_batch_len, WS_OPCODE_BINARY,
+                                                  body_len, mask);
+    uint8_t *body = out + header_len;
+    audio_frame_header_encode(body, buffer->format, sequence, timestamp, flags);
+    memcpy(body + AUDIO_FRAME_HEADER_SIZE, buffer->data, buffer->size);
+    websocket_apply_mask(body, body_len, mask, 0);
+    
+    if (uplink_batch_len == 0) {
+        uplink_batch_start_ms = get_timestamp_ms();
+    }
+    uplink_batch_len += header_len + body_len;
+    uplink_batch_audio_ms += audio_capture_frame_ms();
+    uplink_batch_frames++;
+}
+
+static int ws_send_text_frame(size_t len) {
+    // Queued audio has to reach the server before e.g. listening_end
+    int result = ws_uplink_flush();
+    if (result != ARUNIKA_OK) {
+        return result;
+    }
+    
+    return ws_send_in_place(WS_OPCODE_TEXT, (uint8_t *)TEXT_MESSAGE, len, WS_MAX_HEADER_SIZE);
+}
+
+// Splits ws[s]://host[:port][/path] down to the host
+static int ws_parse_url(const char *url, char *host, size_t host_size, bool *secure) {
+    const char *p = url;
+    if (strncmp(p, "wss://", 6) == 0) {
+        *secure = true;
+        p += 6;
+    } else if (strncmp(p, "ws://", 5) == 0) {
+        *secure = false;
+        p += 5;
+    } else {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    size_t len = strcspn(p, ":/");
+    if (len == 0 || len >= host_size) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    memcpy(host, p, len);
+    host[len] = '\0';
+    return ARUNIKA_OK;
+}
+
+static bool ws_tls_session_usable(const char *host, uint16_t port) {
+    return tls_session.valid && tls_session.port == port && strcmp(tls_session.host, host) == 0 &&
+           (int32_t)(tls_session.expires_ms - get_rtc_time_ms()) > 0;
+}
+
+static void ws_tls_session_store(const char *host, uint16_t port, const uint8_t *ticket, size_t len,
+                                 uint32_t expires_ms) {
+    if (len == 0 || len > TLS_SESSION_TICKET_MAX || strlen(host) >= MAX_HOST_LENGTH) {
+        tls_session.valid = false;
+        return;
+    }
+    
+    snprintf(tls_session.host, sizeof(tls_session.host), "%s", host);
+    tls_session.port = port;
+    memcpy(tls_session.ticket, ticket, len);
+    tls_session.ticket_len = (uint16_t)len;
+    tls_session.expires_ms = expires_ms;
+    tls_session.valid = true;
+}
+
+static int ws_tls_handshake(const char *host, uint16_t port, bool *resumed) {
+    bool resume = ws_tls_session_usable(host, port);
+    *resumed = resume;
+    
+    // TODO: mbedtls_ssl_set_session() with the cached ticket, then mbedtls_ssl_handshake()
+    delay_ms(resume ? WS_SIM_TLS_RESUMED_MS : WS_SIM_TLS_FULL_MS);
+    if (resume) {
+        conn_stats.resumed_handshakes++;
+    } else {
+        conn_stats.full_handshakes++;
+    }
+    
+    // TODO: mbedtls_ssl_get_session() for the NewSessionTicket and its lifetime hint
+    // For now, a simulated 32-byte session ID
+    uint8_t ticket[32];
+    for (size_t i = 0; i < sizeof(ticket); i += 4) {
+        uint32_t word = ws_next_mask();
+        memcpy(&ticket[i], &word, 4);
+    }
+    ws_tls_session_store(host, port, ticket, sizeof(ticket),
+                         get_rtc_time_ms() + TLS_SESSION_LIFETIME_S_DEFAULT * 1000);
+    
+    return ARUNIKA_OK;
+}
+
+int websocket_get_tls_session(tls_session_t *session) {
+    if (!session) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    memset(session, 0, sizeof(*session));
+    if (!ws_tls_session_usable(tls_session.host, tls_session.port)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    memcpy(session->host, tls_session.host, sizeof(session->host));
+    session->port = tls_session.port;
+    session->ticket_len = tls_session.ticket_len;
+    memcpy(session->ticket, tls_session.ticket, tls_session.ticket_len);
+    session->expires_ms = tls_session.expires_ms;
+    return ARUNIKA_OK;
+}
+
+int websocket_set_tls_session(const tls_session_t *session) {
+    // The RTC clock restarts after a power cycle, so an old stamp can look
+    // valid; a ticket the server has since expired just costs a full handshake
+    if (!session || session->ticket_len == 0 || (int32_t)(session->expires_ms - get_rtc_time_ms()) <= 0 ||
+        !memchr(session->host, '\0', sizeof(session->host))) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    ws_tls_session_store(session->host, session->port, session->ticket, session->ticket_len,
+                         session->expires_ms);
+    return tls_session.valid ? ARUNIKA_OK : ARUNIKA_ERROR_INVALID_PARAM;
+}
+
+static int ws_upgrade(const char *host, uint16_t port, const char *path) {
+#ifdef WS_SOCKET_TRANSPORT
+    uint8_t nonce[16];
+    for (size_t i = 0; i < sizeof(nonce); i += 4) {
+        uint32_t word = ws_next_mask();
+        memcpy(&nonce[i], &word, 4);
+    }
+    char key[32];
+    base64_encode(nonce, sizeof(nonce), key, sizeof(key));
+    
+    int len = snprintf(TEXT_MESSAGE, WS_MAX_TEXT_MESSAGE,
+                       "GET %s HTTP/1.1\r\nHost: %s:%u\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                       "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n%s%s%s\r\n",
+                       path, host, (unsigned)port, key, auth_token[0] ? "Authorization: Bearer " : "", auth_token,
+                       auth_token[0] ? "\r\n" : "");
+    if (len < 0 || len >= WS_MAX_TEXT_MESSAGE) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    if (ws_transport_write((const uint8_t *)TEXT_MESSAGE, (size_t)len) != ARUNIKA_OK) {
+        return ARUNIKA_ERROR_WEBSOCKET;
+    }
+    
+    // The response head is read into the text buffer; frames the server
+    // sends right behind it go back to the transport
+    size_t got = 0;
+    char *end = NULL;
+    while (!end) {
+        if (got == WS_MAX_TEXT_MESSAGE - 1 || !ws_socket_wait(POLLIN)) {
+            return ARUNIKA_ERROR_TIMEOUT;
+        }
+        ssize_t n = recv(ws_fd, TEXT_MESSAGE + got, WS_MAX_TEXT_MESSAGE - 1 - got, 0);
+        if (n <= 0) {
+            if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+                continue;
+            }
+            return ARUNIKA_ERROR_WEBSOCKET;
+        }
+        got += (size_t)n;
+        TEXT_MESSAGE[got] = '\0';
+        end = strstr(TEXT_MESSAGE, "\r\n\r\n");
+    }
+    
+    // TODO: Check Sec-WebSocket-Accept (SHA-1 of the key) with mbedtls_sha1()
+    if (strncmp(TEXT_MESSAGE, "HTTP/1.1 101", 12) != 0) {
+        printf("WebSocket upgrade refused: %.*s\n", (int)strcspn(TEXT_MESSAGE, "\r\n"), TEXT_MESSAGE);
+        return ARUNIKA_ERROR_WEBSOCKET;
+    }
+    size_t head_len = (size_t)(end + 4 - TEXT_MESSAGE);
+    websocket_sim_receive((const uint8_t *)TEXT_MESSAGE + head_len, got - head_len);
+    return ARUNIKA_OK;
+#else
+    // TODO: Send the HTTP Upgrade request (with the bearer token) and
+    // validate Sec-WebSocket-Accept
+    (void)host;
+    (void)port;
+    (void)path;
+    delay_ms(WS_SIM_UPGRADE_MS);
+    return ARUNIKA_OK;
+#endif
+}
+
+int websocket_set_auth_token(const char *token) {
+    if (!token || strlen(token) > WS_MAX_AUTH_TOKEN) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    // Sent with every upgrade until replaced; an empty token clears it
+    snprintf(auth_token, sizeof(auth_token), "%s", token);
+    return ARUNIKA_OK;
+}
+
+static int ws_connect_failed(const char *host, websocket_conn_state_t phase, int error) {
+    printf("WebSocket connect failed in phase %d\n", phase);
+    
+    // Stale state is a likely cause, so the next attempt starts clean
+    if (phase == WS_CONN_TCP) {
+        network_forget_host(host);
+    } else if (phase == WS_CONN_TLS) {
+        tls_session.valid = false;
+    }
+    
+    conn_stats.failures++;
+    conn_stats.consecutive_failures++;
+    conn_state = WS_CONN_BACKOFF;
+    return error;
+}
 
 int websocket_connect(const char *url, uint16_t port, const char *path) {
-    if (!url || !path) {
+    char host[MAX_HOST_LENGTH];
+    bool secure = false;
+    if (!url || !path || ws_parse_url(url, host, sizeof(host), &secure) != ARUNIKA_OK) {
         return ARUNIKA_ERROR_INVALID_PARAM;
     }
     
     printf("Connecting to WebSocket: %s:%d%s\n", url, port, path);
+    uint32_t start_ms = get_timestamp_ms();
+    bool resumed = false;
+    conn_stats.attempts++;
+    
+    conn_state = WS_CONN_RESOLVING;
+    network_addr_t addr;
+    bool cached = false;
+    int result = network_resolve(host, &addr, &cached);
+    if (result != ARUNIKA_OK) {
+        return ws_connect_failed(host, WS_CONN_RESOLVING, result);
+    }
+    if (cached) {
+        conn_stats.dns_cache_hits++;
+    }
+    
+    // TODO: Non-blocking connect() to addr, completion via the event loop
+    conn_state = WS_CONN_TCP;
+#ifdef WS_SOCKET_TRANSPORT
+    result = ws_socket_open(&addr, port);
+    if (result != ARUNIKA_OK) {
+        return ws_connect_failed(host, WS_CONN_TCP, result);
+    }
+    if (secure) {
+        printf("wss:// needs mbedTLS; host sockets are plain TCP\n");
+        ws_socket_close();
+        return ws_connect_failed(host, WS_CONN_TLS, ARUNIKA_ERROR_WEBSOCKET);
+    }
+#else
+    delay_ms(WS_SIM_TCP_MS);
+#endif
     
-    // TODO: Implement actual WebSocket connection
-    // TODO: Handle SSL/TLS for wss:// URLs
-    // TODO: Implement WebSocket handshake
-    // TODO: Set up message queues
+    if (secure) {
+        conn_state = WS_CONN_TLS;
+        result = ws_tls_handshake(host, port, &resumed);
+        if (result != ARUNIKA_OK) {
+            return ws_connect_failed(host, WS_CONN_TLS, result);
+        }
+    }
     
-    // Simulate connection delay
-    delay_ms(1000);
+    conn_state = WS_CONN_UPGRADE;
+    result = ws_upgrade(host, port, path);
+    if (result != ARUNIKA_OK) {
+#ifdef WS_SOCKET_TRANSPORT
+        ws_socket_close();
+#endif
+        return ws_connect_failed(host, WS_CONN_UPGRADE, result);
+    }
     
+    conn_state = WS_CONN_OPEN;
+    ws_rx_reset();
+    conn_stats.consecutive_failures = 0;
+    conn_stats.last_connect_ms = get_timestamp_ms() - start_ms;
     websocket_connected = true;
-    printf("WebSocket connected successfully\n");
+    printf("WebSocket connected in %u ms%s\n", (unsigned)conn_stats.last_connect_ms,
+           resumed ? " (TLS session resumed)" : "");
     
     return ARUNIKA_OK;
 }
@@ -31,54 +774,521 @@ int websocket_disconnect(void) {
     
     printf("Disconnecting WebSocket...\n");
     
-    // TODO: Send close frame
+    ws_uplink_flush();
+    ws_send_gather(WS_OPCODE_CLOSE, NULL, 0, NULL, 0);
     // TODO: Clean up connection resources
     
-    websocket_connected = false;
+    // The DNS entry and TLS session stay cached for the next connect
+    ws_connection_lost();
+#ifndef ESP_PLATFORM
+    sim_rx_len = 0;
+#endif
     printf("WebSocket disconnected\n");
     
     return ARUNIKA_OK;
 }
 
-int websocket_send_audio_chunk(const audio_buffer_t *buffer, int sequence) {
+int websocket_set_uplink_mode(websocket_uplink_mode_t mode) {
+    if (mode != WEBSOCKET_UPLINK_BINARY && mode != WEBSOCKET_UPLINK_JSON) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+#ifndef ARUNIKA_JSON_UPLINK
+    if (mode == WEBSOCKET_UPLINK_JSON) {
+        return ARUNIKA_ERROR_INVALID_PARAM; // Compiled out for this board
+    }
+#endif
+    
+    uplink_mode = mode;
+    return ARUNIKA_OK;
+}
+
+websocket_uplink_mode_t websocket_get_uplink_mode(void) {
+    return uplink_mode;
+}
+
+#ifdef ARUNIKA_JSON_UPLINK
+static int ws_send_audio_json(const audio_buffer_t *buffer, int sequence, bool is_final) {
+    // Format the JSON around the base64 field so the encoder writes
+    // straight into the outgoing frame
+    char *message = TEXT_MESSAGE;
+    size_t capacity = WS_MAX_TEXT_MESSAGE;
+    
+    int len = snprintf(message, capacity, "{\"type\":\"%s\",\"audio_data\":\"", MSG_TYPE_AUDIO_CHUNK);
+    if (len < 0 || (size_t)len >= capacity) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    int encoded = base64_encode(buffer->data, buffer->size, message + len, capacity - len);
+    if (encoded < 0) {
+        return encoded;
+    }
+    len += encoded;
+    
+    int tail = snprintf(message + len, capacity - len,
+                        "\",\"sample_rate\":%u,\"encoding\":\"%s\",\"timestamp\":%u,"
+                        "\"chunk_sequence\":%d,\"is_final\":%s}",
+                        (unsigned)buffer->sample_rate, audio_format_name(buffer->format),
+                        (unsigned)get_timestamp_ms(), sequence, is_final ? "true" : "false");
+    if (tail < 0 || (size_t)tail >= capacity - len) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    int result = ws_send_text_frame(len + tail);
+    if (result == ARUNIKA_OK) {
+        uplink_frames_written++;
+    }
+    return result;
+}
+#endif
+
+int websocket_send_audio_chunk(audio_buffer_t *buffer, int sequence, bool is_final) {
     if (!buffer || !websocket_connected) {
         return ARUNIKA_ERROR_INVALID_PARAM;
     }
     
-    printf("Sending audio chunk #%d (%zu bytes)\n", sequence, buffer->size);
+    LOG_DEBUG("Sending audio chunk #%d (%zu bytes)\n", sequence, buffer->size);
     
-    // TODO: Encode audio data to base64
-    // TODO: Create JSON message
-    // TODO: Send WebSocket frame
+#ifdef ARUNIKA_JSON_UPLINK
+    if (uplink_mode == WEBSOCKET_UPLINK_JSON) {
+        return ws_send_audio_json(buffer, sequence, is_final);
+    }
+#endif
     
+    uint8_t flags = is_final ? AUDIO_FRAME_FLAG_FINAL : 0;
+    uint32_t timestamp = get_timestamp_ms();
+    uint32_t target_ms = ws_uplink_batch_ms();
+    link_stats.batch_ms = target_ms;
+    
+    // Coalesce while the batch is short of the target. A frame that would
+    // not fit pushes the batch out first and is then queued on its own
+    size_t frame_len = WS_MAX_HEADER_SIZE + AUDIO_FRAME_HEADER_SIZE + buffer->size;
+    bool batch = uplink_batch_len > 0 || (!is_final && target_ms > audio_capture_frame_ms());
+    if (batch && uplink_batch_len + frame_len > WS_UPLINK_BATCH_SIZE) {
+        int result = ws_uplink_flush();
+        if (result != ARUNIKA_OK) {
+            return result;
+        }
+    }
+    if (batch && frame_len <= WS_UPLINK_BATCH_SIZE) {
+        ws_uplink_append(buffer, (uint32_t)sequence, timestamp, flags);
+        link_stats.frames_sent++;
+        return is_final ? ws_uplink_flush() : websocket_flush_audio(false);
+    }
+    
+    int result;
+    uint32_t start = get_timestamp_ms();
+    if (buffer->headroom >= AUDIO_FRAME_HEADROOM) {
+        // Zero-copy: audio header and frame header go into the headroom
+        uint8_t *body = buffer->data - AUDIO_FRAME_HEADER_SIZE;
+        audio_frame_header_encode(body, buffer->format, (uint32_t)sequence, timestamp, flags);
+        result = ws_send_in_place(WS_OPCODE_BINARY, body, AUDIO_FRAME_HEADER_SIZE + buffer->size,
+                                  buffer->headroom - AUDIO_FRAME_HEADER_SIZE);
+    } else {
+        uint8_t header[AUDIO_FRAME_HEADER_SIZE];
+        audio_frame_header_encode(header, buffer->format, (uint32_t)sequence, timestamp, flags);
+        result = ws_send_gather(WS_OPCODE_BINARY, header, sizeof(header), buffer->data, buffer->size);
+    }
+    if (result == ARUNIKA_OK) {
+        ws_link_note_flush(start);
+        link_stats.frames_sent++;
+        uplink_frames_written++;
+    }
+    
+    return result;
+}
+
+// Called after the uplink has drained the capture ring, so a batch never
+// waits longer than its target even while VAD is holding frames back
+int websocket_flush_audio(bool force) {
+    if (uplink_batch_len == 0) {
+        return ARUNIKA_OK;
+    }
+    
+    uint32_t target_ms = ws_uplink_batch_ms();
+    if (force || uplink_batch_audio_ms >= target_ms || get_timestamp_ms() - uplink_batch_start_ms >= target_ms) {
+        return ws_uplink_flush();
+    }
     return ARUNIKA_OK;
 }
 
-int websocket_send_ping(void) {
+// A frame handed to websocket_send_audio_chunk() may wait in the batch;
+// the caller keeps it until this count says it went out
+uint32_t websocket_uplink_frames_written(void) {
+    return uplink_frames_written;
+}
+
+int websocket_set_uplink_batch_ms(uint32_t batch_ms) {
+    if (batch_ms != WS_UPLINK_BATCH_ADAPTIVE && batch_ms > WS_UPLINK_BATCH_MAX_MS) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    uplink_batch_fixed_ms = batch_ms;
+    return ARUNIKA_OK;
+}
+
+void websocket_get_link_stats(websocket_link_stats_t *stats) {
+    if (stats) {
+        *stats = link_stats;
+    }
+}
+
+int websocket_send_text(const char *message) {
+    if (!message || !websocket_connected) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    
+    size_t len = strlen(message);
+    if (len >= WS_MAX_TEXT_MESSAGE) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    // Caller's string is const and masking is destructive, so copy it once
+    if (message != TEXT_MESSAGE) {
+        memcpy(TEXT_MESSAGE, message, len);
+    }
+    
+    return ws_send_text_frame(len);
+}
+
+int websocket_send_listening_start(uint32_t sample_rate, audio_format_t format) {
+    int len = snprintf(TEXT_MESSAGE, WS_MAX_TEXT_MESSAGE,
+                       "{\"type\":\"%s\",\"sample_rate\":%u,\"encoding\":\"%s\"}",
+                       MSG_TYPE_LISTENING_START, (unsigned)sample_rate, audio_format_name(format));
+    if (len < 0 || len >= WS_MAX_TEXT_MESSAGE) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    int result = websocket_send_text(TEXT_MESSAGE);
+    if (result != ARUNIKA_OK) {
+        return result;
+    }
+    
+    // An empty ping times the link as it is now, the keepalive RTT may be
+    // minutes old. The pong is usually back before the second frame
+    if (!ping_outstanding) {
+        websocket_send_ping(NULL, 0);
+    }
+    return ARUNIKA_OK;
+}
+
+int websocket_send_listening_end(void) {
+    return websocket_send_text("{\"type\":\"" MSG_TYPE_LISTENING_END "\"}");
+}
+
+int websocket_send_response_cancel(const char *session_id) {
+    // Barge-in: the server stops generating and streaming the response
+    bool named = session_id && session_id[0] != '\0';
+    int len = snprintf(TEXT_MESSAGE, WS_MAX_TEXT_MESSAGE, "{\"type\":\"%s\"%s%s%s}", MSG_TYPE_RESPONSE_CANCEL,
+                       named ? ",\"session_id\":\"" : "", named ? session_id : "", named ? "\"" : "");
+    if (len < 0 || len >= WS_MAX_TEXT_MESSAGE) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    return websocket_send_text(TEXT_MESSAGE);
+}
+
+int websocket_send_audio_cache_status(const char *type, const char *key) {
+    // audio_cached after a response was stored, audio_cache_miss when the
+    // server sent only the key of a clip this doll no longer has
+    if (!type || !audio_cache_key_valid(key, key ? strlen(key) : 0)) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
+    int len = snprintf(TEXT_MESSAGE, WS_MAX_TEXT_MESSAGE, "{\"type\":\"%s\",\"audio_key\":\"%s\"}", type, key);
+    if (len < 0 || len >= WS_MAX_TEXT_MESSAGE) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    return websocket_send_text(TEXT_MESSAGE);
+}
+
+int websocket_send_hello(audio_format_t preferred, uint32_t sample_rate, const char *session_id) {
+    // Offer the preferred format first, then MULAW which every build supports.
+    // A session ID from before deep sleep asks the server to resume it
+    bool fallback = preferred != AUDIO_FORMAT_MULAW;
+    bool resume = session_id && session_id[0] != '\0';
+    int len = snprintf(TEXT_MESSAGE, WS_MAX_TEXT_MESSAGE,
+                       "{\"type\":\"%s\",\"encodings\":[\"%s\"%s],\"sample_rate\":%u%s%s%s,\"cached_audio\":[",
+                       MSG_TYPE_DEVICE_HELLO, audio_format_name(preferred),
+                       fallback ? ",\"MULAW\"" : "", (unsigned)sample_rate,
+                       resume ? ",\"session_id\":\"" : "", resume ? session_id : "", resume ? "\"" : "");
+    if (len < 0 || len >= WS_MAX_TEXT_MESSAGE - 3) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    // Keys of the clips in flash, so the server can send just the key.
+    // Whatever does not fit is simply streamed in full again
+    int keys = audio_cache_list_keys(TEXT_MESSAGE + len, (size_t)(WS_MAX_TEXT_MESSAGE - len) - 2);
+    len += keys > 0 ? keys : 0;
+    memcpy(TEXT_MESSAGE + len, "]}", 3);
+    len += 2;
+    
+    return websocket_send_text(TEXT_MESSAGE);
+}
+
+// The ping's application data carries the telemetry report, so the
+// keepalive doubles as the stats uplink. The data is masked in place
+int websocket_send_ping(uint8_t *data, size_t len) {
+    if ((!data && len > 0) || len > WS_MAX_CONTROL_PAYLOAD) {
+        return ARUNIKA_ERROR_INVALID_PARAM;
+    }
     if (!websocket_connected) {
         return ARUNIKA_ERROR_WEBSOCKET;
     }
     
-    printf("Sending WebSocket ping\n");
+    LOG_DEBUG("Sending WebSocket ping (%zu bytes of telemetry)\n", len);
+    
+    int result = ws_send_gather(WS_OPCODE_PING, NULL, 0, data, len);
+    if (result == ARUNIKA_OK && !ping_outstanding) {
+        ping_outstanding = true;
+        ping_sent_ms = get_timestamp_ms();
+    }
+    return result;
+}
+
+static int ws_rx_fail(const char *reason) {
+    printf("WebSocket protocol error: %s\n", reason);
+    conn_stats.rx_protocol_errors++;
+    
+    uint8_t status[2] = { WS_CLOSE_PROTOCOL_ERROR >> 8, WS_CLOSE_PROTOCOL_ERROR & 0xFF };
+    ws_send_gather(WS_OPCODE_CLOSE, NULL, 0, status, sizeof(status));
+    ws_connection_lost();
+    return ARUNIKA_ERROR_WEBSOCKET;
+}
+
+// Checks a complete header against RFC 6455 and opens the frame
+static int ws_rx_begin_frame(void) {
+    const uint8_t *h = rx.header;
+    rx.fin = (h[0] & 0x80) != 0;
+    rx.opcode = h[0] & 0x0F;
+    
+    uint64_t len = h[1] & 0x7F;
+    if (len == 126) {
+        len = ((uint64_t)h[2] << 8) | h[3];
+    } else if (len == 127) {
+        len = 0;
+        for (int i = 2; i < 10; i++) {
+            len = (len << 8) | h[i];
+        }
+    }
+    rx.frame_len = len;
+    rx.remaining = len;
+    
+    if (h[0] & 0x70) {
+        return ws_rx_fail("reserved bits set");
+    }
+    if (h[1] & 0x80) {
+        return ws_rx_fail("masked server frame");
+    }
+    if (len >> 63) {
+        return ws_rx_fail("bad length");
+    }
+    
+    if (rx.opcode & 0x08) {
+        if (rx.opcode != WS_OPCODE_CLOSE && rx.opcode != WS_OPCODE_PING && rx.opcode != WS_OPCODE_PONG) {
+            return ws_rx_fail("unknown control opcode");
+        }
+        if (!rx.fin || len > WS_MAX_CONTROL_PAYLOAD) {
+            return ws_rx_fail("fragmented or oversized control frame");
+        }
+        rx.control_len = 0;
+    } else if (rx.opcode == WS_OPCODE_CONTINUATION) {
+        if (rx.message_opcode == 0) {
+            return ws_rx_fail("continuation without a message");
+        }
+        conn_stats.rx_continuations++;
+    } else if (rx.opcode == WS_OPCODE_TEXT || rx.opcode == WS_OPCODE_BINARY) {
+        if (rx.message_opcode != 0) {
+            return ws_rx_fail("new message inside a fragmented one");
+        }
+        rx.message_opcode = rx.opcode;
+        rx.message_started = false;
+        rx.message_dropped = false;
+    } else {
+        return ws_rx_fail("unknown data opcode");
+    }
+    
+    rx.in_payload = true;
+    return ARUNIKA_OK;
+}
+
+static void ws_rx_deliver(const uint8_t *data, size_t len, bool last, websocket_sink_t sink, void *ctx) {
+    if (!rx.message_dropped && sink(rx.message_opcode, data, len, !rx.message_started, last, ctx) < 0) {
+        rx.message_dropped = true;
+    }
+    rx.message_started = true;
+}
+
+static int ws_rx_end_frame(websocket_sink_t sink, void *ctx) {
+    int result = ARUNIKA_OK;
+    rx.in_payload = false;
+    rx.header_len = 0;
+    rx.header_need = 2;
     
-    // TODO: Send ping frame
+    switch (rx.opcode) {
+        case WS_OPCODE_PING:
+            // Answered between fragments too; the payload is echoed
+            result = ws_send_gather(WS_OPCODE_PONG, NULL, 0, rx.control, rx.control_len);
+            break;
+        
+        case WS_OPCODE_PONG:
+            if (ping_outstanding) {
+                ws_link_sample_rtt(get_timestamp_ms() - ping_sent_ms);
+                ping_outstanding = false;
+            }
+            break;
+        
+        case WS_OPCODE_CLOSE:
+            // Echo the status code and drop the link
+            printf("WebSocket closed by server\n");
+            ws_send_gather(WS_OPCODE_CLOSE, NULL, 0, rx.control, rx.control_len < 2 ? rx.control_len : 2);
+            ws_connection_lost();
+            return ARUNIKA_ERROR_WEBSOCKET;
+        
+        default:
+            if (!rx.fin) {
+                break;
+            }
+            // An empty final frame still has to close the message
+            if (rx.frame_len == 0) {
+                ws_rx_deliver(rx.control, 0, true, sink, ctx);
+            }
+            conn_stats.rx_messages++;
+            rx.message_opcode = 0;
+            break;
+    }
+    
+    return result;
+}
+
+static int ws_rx_parse(const uint8_t *data, size_t len, websocket_sink_t sink, void *ctx) {
+    size_t pos = 0;
+    
+    while (pos < len) {
+        if (!rx.in_payload) {
+            rx.header[rx.header_len++] = data[pos++];
+            if (rx.header_len == 2) {
+                uint8_t len7 = rx.header[1] & 0x7F;
+                rx.header_need = 2 + (len7 == 126 ? 2 : len7 == 127 ? 8 : 0);
+            }
+            if (rx.header_len < rx.header_need) {
+                continue;
+            }
+            
+            int result = ws_rx_begin_frame();
+            if (result == ARUNIKA_OK && rx.remaining == 0) {
+                result = ws_rx_end_frame(sink, ctx);
+            }
+            if (result != ARUNIKA_OK) {
+                return result;
+            }
+            continue;
+        }
+        
+        size_t take = len - pos;
+        if (rx.remaining < take) {
+            take = (size_t)rx.remaining;
+        }
+        if (rx.opcode & 0x08) {
+            memcpy(rx.control + rx.control_len, data + pos, take);
+            rx.control_len += take;
+        } else {
+            ws_rx_deliver(data + pos, take, rx.fin && take == rx.remaining, sink, ctx);
+        }
+        rx.remaining -= take;
+        pos += take;
+        
+        if (rx.remaining == 0) {
+            int result = ws_rx_end_frame(sink, ctx);
+            if (result != ARUNIKA_OK) {
+                return result;
+            }
+        }
+    }
     
     return ARUNIKA_OK;
 }
 
-int websocket_receive_message(char *buffer, size_t buffer_size) {
-    if (!buffer || buffer_size == 0 || !websocket_connected) {
+int websocket_receive(uint8_t *buffer, size_t buffer_size, websocket_sink_t sink, void *ctx) {
+    if (!buffer || buffer_size == 0 || !sink) {
         return ARUNIKA_ERROR_INVALID_PARAM;
     }
+    if (!websocket_connected) {
+        return ARUNIKA_ERROR_WEBSOCKET;
+    }
     
-    // TODO: Check for incoming WebSocket frames
-    // TODO: Parse and validate messages
-    // TODO: Handle different message types
+    // Payload chunks point into buffer, so the read buffer is the only
+    // receive memory no matter how long the message is
+    int len = ws_transport_read(buffer, buffer_size);
+    if (len < 0) {
+        ws_connection_lost();
+    }
+    if (len <= 0) {
+        return len;
+    }
     
-    // Simulate no message available
-    return 0;
+    int result = ws_rx_parse(buffer, (size_t)len, sink, ctx);
+    return result != ARUNIKA_OK ? result : len;
 }
 
+#ifndef ESP_PLATFORM
+int websocket_sim_receive(const uint8_t *data, size_t len) {
+    if (!data || len > WS_SIM_RX_SIZE - sim_rx_len) {
+        return ARUNIKA_ERROR_MEMORY;
+    }
+    
+    for (size_t i = 0; i < len; i++) {
+        sim_rx[(sim_rx_head + sim_rx_len + i) % WS_SIM_RX_SIZE] = data[i];
+    }
+    sim_rx_len += len;
+    return ARUNIKA_OK;
+}
+
+void websocket_sim_fail_write(void) {
+    sim_fail_write = true;
+}
+#endif
+
 bool websocket_is_connected(void) {
     return websocket_connected;
 }
+
+int websocket_get_fd(void) {
+    // TODO: Return the TLS socket descriptor on ESP32
+#ifdef WS_SOCKET_TRANSPORT
+    return websocket_connected ? ws_fd : -1;
+#else
+    return -1;
+#endif
+}
+
+websocket_conn_state_t websocket_get_conn_state(void) {
+    return conn_state;
+}
+
+uint32_t websocket_backoff_delay_ms(uint32_t failures) {
+    // Equal jitter: half the exponential ceiling plus a random share of the
+    // rest, so dolls dropped by the same server restart spread out. The
+    // first retry, after a drop or one failed attempt, has the base ceiling
+    uint32_t doublings = failures > 0 ? failures - 1 : 0;
+    uint32_t ceiling = WS_BACKOFF_MAX_MS;
+    if (doublings < 16 && (WS_BACKOFF_BASE_MS << doublings) < WS_BACKOFF_MAX_MS) {
+        ceiling = WS_BACKOFF_BASE_MS << doublings;
+    }
+    
+    return ceiling / 2 + ws_next_mask() % (ceiling / 2 + 1);
+}
+
+uint32_t websocket_reconnect_delay_ms(void) {
+    conn_stats.last_backoff_ms = websocket_backoff_delay_ms(conn_stats.consecutive_failures);
+    return conn_stats.last_backoff_ms;
+}
+
+void websocket_get_conn_stats(websocket_conn_stats_t *stats) {
+    if (stats) {
+        *stats = conn_stats;
+    }
+}
+
+uint64_t websocket_get_tx_bytes(void) {
+    return tx_bytes;
+}
@@ -76,6 +76,1849 @@ void test_base64_encoding() {
     printf("✅ Base64 encoding test passed\n");
 }
 
+typedef struct {
+    uint8_t data[64];
+    size_t len;
+} test_sink_t;
+
+static int test_collect_sink(const uint8_t *data, size_t len, void *ctx) {
+    test_sink_t *sink = (test_sink_t *)ctx;
+    assert(sink->len + len <= sizeof(sink->data));
+    memcpy(sink->data + sink->len, data, len);
+    sink->len += len;
+    return ARUNIKA_OK;
+}
+
+void test_base64_decoding() {
+    uint8_t output[64];
+    
+    int result = base64_decode("SGVsbG8gV29ybGQ=", output, sizeof(output));
+    assert(result == 11);
+    assert(memcmp(output, "Hello World", 11) == 0);
+    
+    assert(base64_decode("SGk=", output, sizeof(output)) == 2);
+    assert(base64_decode("SGk", output, sizeof(output)) == 2);
+    assert(base64_decode("SG*k", output, sizeof(output)) == ARUNIKA_ERROR_INVALID_PARAM);
+    assert(base64_decode("SGVsbG8=", output, 2) == ARUNIKA_ERROR_MEMORY);
+    
+    // Any fragmentation of the input decodes to the same bytes
+    const char *encoded = "QXJ1bmlrYSBkb2xsIHNwZWFraW5nIQ==";
+    size_t encoded_len = strlen(encoded);
+    for (size_t step = 1; step <= encoded_len; step++) {
+        base64_decoder_t decoder;
+        test_sink_t sink = { {0}, 0 };
+        base64_decoder_init(&decoder);
+        for (size_t i = 0; i < encoded_len; i += step) {
+            size_t n = encoded_len - i < step ? encoded_len - i : step;
+            assert(base64_decoder_feed(&decoder, encoded + i, n, test_collect_sink, &sink) == ARUNIKA_OK);
+        }
+        assert(base64_decoder_finish(&decoder, test_collect_sink, &sink) == 22);
+        assert(sink.len == 22);
+        assert(memcmp(sink.data, "Arunika doll speaking!", 22) == 0);
+    }
+    
+    // Round trip larger than one sink block exercises the fast path flush
+    uint8_t raw[500];
+    char text[4 * ((sizeof(raw) + 2) / 3) + 1];
+    uint8_t decoded[sizeof(raw)];
+    for (size_t i = 0; i < sizeof(raw); i++) {
+        raw[i] = (uint8_t)(i * 31 + 7);
+    }
+    assert(base64_encode(raw, sizeof(raw), text, sizeof(text)) > 0);
+    assert(base64_decode(text, decoded, sizeof(decoded)) == (int)sizeof(raw));
+    assert(memcmp(raw, decoded, sizeof(raw)) == 0);
+    
+    printf("✅ Base64 decoding test passed\n");
+}
+
+void test_audio_ring_buffer() {
+    static audio_ring_t ring;
+    int result = audio_ring_init(&ring, SAMPLE_RATE, AUDIO_FORMAT_MULAW);
+    assert(result == ARUNIKA_OK);
+    assert(audio_ring_peek(&ring) == NULL);
+    
+    // Fill every slot, the next acquire must count an overrun
+    for (uint32_t i = 0; i < AUDIO_RING_SLOTS; i++) {
+        audio_buffer_t *frame = audio_ring_acquire(&ring);
+        assert(frame != NULL);
+        frame->data[0] = (uint8_t)i;
+        frame->size = 1;
+        assert(audio_ring_commit(&ring) == ARUNIKA_OK);
+    }
+    assert(audio_ring_acquire(&ring) == NULL);
+    
+    audio_ring_stats_t stats;
+    audio_ring_get_stats(&ring, &stats);
+    assert(stats.occupancy == AUDIO_RING_SLOTS);
+    assert(stats.high_watermark == AUDIO_RING_SLOTS);
+    assert(stats.overruns == 1);
+    
+    // Frames come out in FIFO order
+    for (uint32_t i = 0; i < AUDIO_RING_SLOTS; i++) {
+        audio_buffer_t *frame = audio_ring_peek(&ring);
+        assert(frame != NULL);
+        assert(frame->data[0] == (uint8_t)i);
+        assert(audio_ring_release(&ring) == ARUNIKA_OK);
+    }
+    assert(audio_ring_peek(&ring) == NULL);
+    assert(audio_ring_release(&ring) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    printf("✅ Audio ring buffer test passed\n");
+}
+
+void test_websocket_binary_framing() {
+    const uint8_t mask[4] = {0x11, 0x22, 0x33, 0x44};
+    uint8_t header[WS_MAX_HEADER_SIZE];
+    
+    // 512 byte chunk plus audio header needs the 16-bit extended length
+    size_t payload_len = AUDIO_CHUNK_SIZE + AUDIO_FRAME_HEADER_SIZE;
+    int len = websocket_build_frame_header(header, sizeof(header), WS_OPCODE_BINARY, payload_len, mask);
+    assert(len == 8);
+    assert(header[0] == (0x80 | WS_OPCODE_BINARY));
+    assert(header[1] == (0x80 | 126));
+    assert(((header[2] << 8) | header[3]) == (int)payload_len);
+    assert(memcmp(&header[4], mask, 4) == 0);
+    
+    len = websocket_build_frame_header(header, sizeof(header), WS_OPCODE_PING, 0, mask);
+    assert(len == 6);
+    assert(header[1] == 0x80);
+    
+    uint8_t audio_header[AUDIO_FRAME_HEADER_SIZE];
+    len = audio_frame_header_encode(audio_header, AUDIO_FORMAT_MULAW, 0x01020304, 0xA0B0C0D0, AUDIO_FRAME_FLAG_FINAL);
+    assert(len == AUDIO_FRAME_HEADER_SIZE);
+    assert(audio_header[0] == AUDIO_FRAME_MAGIC);
+    assert(audio_header[2] == AUDIO_FORMAT_MULAW);
+    assert(audio_header[3] == AUDIO_FRAME_FLAG_FINAL);
+    assert(audio_header[4] == 0x04 && audio_header[7] == 0x01);
+    assert(audio_header[8] == 0xD0 && audio_header[11] == 0xA0);
+    
+    printf("✅ WebSocket binary framing test passed\n");
+}
+
+void test_websocket_zero_copy_send() {
+    // Masking is an involution at any phase offset
+    uint8_t data[37];
+    uint8_t original[37];
+    const uint8_t mask[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = original[i] = (uint8_t)(i * 7);
+    }
+    websocket_apply_mask(data, sizeof(data), mask, 3);
+    assert(data[0] == (original[0] ^ mask[3]));
+    assert(data[1] == (original[1] ^ mask[0]));
+    websocket_apply_mask(data, sizeof(data), mask, 3);
+    assert(memcmp(data, original, sizeof(data)) == 0);
+    
+    // Ring frames carry enough headroom for the in-place frame header
+    static audio_ring_t ring;
+    audio_ring_init(&ring, SAMPLE_RATE, AUDIO_FORMAT_MULAW);
+    audio_buffer_t *frame = audio_ring_acquire(&ring);
+    assert(frame != NULL);
+    assert(frame->headroom >= WS_MAX_HEADER_SIZE + AUDIO_FRAME_HEADER_SIZE);
+    assert(frame->data == ring.storage[0] + frame->headroom);
+    
+    // Headroom and gather paths both put a whole frame on the wire
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    memset(frame->data, 0x55, AUDIO_CHUNK_SIZE);
+    frame->size = AUDIO_CHUNK_SIZE;
+    uint64_t before = websocket_get_tx_bytes();
+    assert(websocket_send_audio_chunk(frame, 0, false) == ARUNIKA_OK);
+    assert(websocket_get_tx_bytes() - before == 8 + AUDIO_FRAME_HEADER_SIZE + AUDIO_CHUNK_SIZE);
+    
+    uint8_t payload[AUDIO_CHUNK_SIZE];
+    audio_buffer_t plain = { payload, sizeof(payload), 0, sizeof(payload), SAMPLE_RATE, AUDIO_FORMAT_MULAW, 0 };
+    before = websocket_get_tx_bytes();
+    assert(websocket_send_audio_chunk(&plain, 1, true) == ARUNIKA_OK);
+    assert(websocket_get_tx_bytes() - before == 8 + AUDIO_FRAME_HEADER_SIZE + AUDIO_CHUNK_SIZE);
+    websocket_disconnect();
+    
+    printf("✅ WebSocket zero-copy send test passed\n");
+}
+
+void test_g711_codec() {
+    // Reference points from ITU-T G.711
+    assert(g711_mulaw_encode(0) == 0xFF);
+    assert(g711_mulaw_decode(0xFF) == 0);
+    assert(g711_mulaw_decode(0x80) == 32124);
+    assert(g711_alaw_encode(0) == 0xD5);
+    assert(g711_alaw_decode(0xD5) == 8);
+    assert(g711_alaw_decode(0xAA) == 32256);
+    
+    // Every code survives decode -> encode unchanged (except mu-law -0)
+    for (int code = 0; code < 256; code++) {
+        if (code != 0x7F) {
+            assert(g711_mulaw_encode(g711_mulaw_decode((uint8_t)code)) == code);
+        }
+        assert(g711_alaw_encode(g711_alaw_decode((uint8_t)code)) == code);
+    }
+    
+    // Quantization error stays within the segment step
+    for (int sample = -32768; sample < 32768; sample += 97) {
+        int mu = g711_mulaw_decode(g711_mulaw_encode((int16_t)sample));
+        int a = g711_alaw_decode(g711_alaw_encode((int16_t)sample));
+        int limit = abs(sample) / 16 + 16;
+        assert(abs(mu - sample) <= limit + 32);
+        assert(abs(a - sample) <= limit + 32);
+    }
+    
+    // Whole frames convert in place
+    uint8_t storage[2 * 64];
+    audio_buffer_t frame = { storage, sizeof(storage), 0, sizeof(storage), SAMPLE_RATE, AUDIO_FORMAT_PCM, 0 };
+    for (int i = 0; i < 64; i++) {
+        int16_t sample = (int16_t)(i * 500 - 16000);
+        memcpy(&storage[2 * i], &sample, 2);
+    }
+    assert(audio_codec_encode(&frame, AUDIO_FORMAT_MULAW) == ARUNIKA_OK);
+    assert(frame.size == 64 && frame.format == AUDIO_FORMAT_MULAW);
+    assert(storage[0] == g711_mulaw_encode(-16000));
+    assert(audio_codec_decode(&frame) == ARUNIKA_OK);
+    assert(frame.size == 128 && frame.format == AUDIO_FORMAT_PCM);
+    int16_t last;
+    memcpy(&last, &storage[2 * 63], 2);
+    assert(last == g711_mulaw_decode(g711_mulaw_encode(63 * 500 - 16000)));
+    
+    printf("✅ G.711 codec test passed\n");
+}
+
+void test_opus_negotiation() {
+    // Encoding names round-trip through the negotiation helpers
+    audio_format_t format;
+    assert(audio_format_from_name("OPUS", 4, &format) == ARUNIKA_OK && format == AUDIO_FORMAT_OPUS);
+    assert(audio_format_from_name("MULAW", 5, &format) == ARUNIKA_OK && format == AUDIO_FORMAT_MULAW);
+    assert(audio_format_from_name("MULAWX", 6, &format) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    // Invalid configurations are rejected whether or not libopus is linked
+    opus_codec_config_t config = { 25, OPUS_COMPLEXITY_DEFAULT, OPUS_BITRATE_DEFAULT };
+    assert(audio_opus_init(SAMPLE_RATE, &config) == ARUNIKA_ERROR_INVALID_PARAM);
+    config.frame_ms = OPUS_FRAME_MS_DEFAULT;
+    assert(audio_opus_init(44100, &config) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    if (!audio_opus_available()) {
+        // Without libopus the wire format must stay on G.711
+        assert(audio_set_format(AUDIO_FORMAT_MULAW) == ARUNIKA_OK);
+        assert(audio_opus_init(SAMPLE_RATE, &config) == ARUNIKA_ERROR_AUDIO);
+        assert(audio_set_format(AUDIO_FORMAT_OPUS) == ARUNIKA_ERROR_AUDIO);
+        assert(audio_get_format() == AUDIO_FORMAT_MULAW);
+    } else {
+        assert(audio_opus_init(SAMPLE_RATE, &config) == ARUNIKA_OK);
+        assert(audio_opus_frame_samples() == SAMPLE_RATE * OPUS_FRAME_MS_DEFAULT / 1000);
+        assert(audio_set_format(AUDIO_FORMAT_OPUS) == ARUNIKA_OK);
+        assert(audio_set_format(AUDIO_FORMAT_MULAW) == ARUNIKA_OK);
+    }
+    
+    printf("✅ Opus negotiation test passed\n");
+}
+
+void test_playback_jitter_buffer() {
+    static uint8_t codes[9000];
+    int16_t out[PLAYBACK_DMA_SAMPLES];
+    playback_stats_t stats;
+    memset(codes, 0x80, sizeof(codes));
+    
+    // Playback starts once the prebuffer threshold (64 ms = 512 samples) is met
+    assert(playback_init(64) == ARUNIKA_OK);
+    assert(playback_feed(codes, 256) == ARUNIKA_ERROR_AUDIO);
+    assert(playback_start(AUDIO_FORMAT_MULAW, SAMPLE_RATE) == ARUNIKA_OK);
+    assert(playback_feed(codes, 256) == ARUNIKA_OK);
+    assert(playback_get_state() == PLAYBACK_STATE_BUFFERING);
+    assert(playback_feed(codes, 256) == ARUNIKA_OK);
+    assert(playback_get_state() == PLAYBACK_STATE_PLAYING);
+    
+    // The DMA consumer drains decoded PCM, then sees an underrun
+    assert(playback_i2s_tx_callback(out, PLAYBACK_DMA_SAMPLES) == PLAYBACK_DMA_SAMPLES);
+    assert(out[0] == g711_mulaw_decode(0x80));
+    assert(playback_i2s_tx_callback(out, PLAYBACK_DMA_SAMPLES) == PLAYBACK_DMA_SAMPLES);
+    assert(playback_i2s_tx_callback(out, PLAYBACK_DMA_SAMPLES) == 0 && out[0] == 0);
+    
+    // An underrun rebuffers with a deeper threshold
+    playback_poll();
+    playback_get_stats(&stats);
+    assert(stats.underruns == 1);
+    assert(stats.target_prebuffer_ms == 64 + PLAYBACK_PREBUFFER_STEP_MS);
+    assert(playback_get_state() == PLAYBACK_STATE_BUFFERING);
+    
+#ifdef ARUNIKA_PCM16
+    // PCM16 fragments may split a sample; speaking_end plays the tail at once
+    const uint8_t first[] = { 0x34, 0x12, 0x78 };
+    const uint8_t second[] = { 0x56 };
+    assert(playback_start(AUDIO_FORMAT_PCM, SAMPLE_RATE) == ARUNIKA_OK);
+    assert(playback_feed(first, sizeof(first)) == ARUNIKA_OK);
+    assert(playback_feed(second, sizeof(second)) == ARUNIKA_OK);
+    assert(playback_end() == ARUNIKA_OK);
+    assert(playback_i2s_tx_callback(out, PLAYBACK_DMA_SAMPLES) == 2);
+    assert(out[0] == 0x1234 && out[1] == 0x5678);
+    assert(playback_poll() == 1);
+    assert(playback_get_state() == PLAYBACK_STATE_IDLE);
+    playback_get_stats(&stats);
+    assert(stats.responses == 1);
+    assert(stats.target_prebuffer_ms == 64 + PLAYBACK_PREBUFFER_STEP_MS / 2);
+#endif
+    
+    // Overflow drops the excess instead of blocking the receive path
+    assert(playback_start(AUDIO_FORMAT_MULAW, SAMPLE_RATE) == ARUNIKA_OK);
+    assert(playback_feed(codes, sizeof(codes)) == ARUNIKA_ERROR_MEMORY);
+    assert(playback_is_congested());
+    playback_get_stats(&stats);
+    assert(stats.overflows == sizeof(codes) - PLAYBACK_JITTER_SAMPLES);
+    playback_stop();
+    playback_get_stats(&stats);
+    assert(stats.buffered_samples == 0);
+    
+    printf("✅ Playback jitter buffer test passed\n");
+}
+
+void test_event_loop() {
+    assert(events_init() == ARUNIKA_OK);
+    
+    // Nothing pending: the wait times out instead of spinning
+    uint32_t start = get_timestamp_ms();
+    assert(events_wait(20) == 0);
+    assert(get_timestamp_ms() - start >= 20);
+    
+    // Posted bits coalesce and are consumed by one wait
+    events_post(EVENT_BUTTON);
+    events_post_from_isr(EVENT_AUDIO_CAPTURED);
+    events_post(EVENT_BUTTON);
+    assert(events_wait(0) == (EVENT_BUTTON | EVENT_AUDIO_CAPTURED));
+    assert(events_wait(0) == 0);
+    
+    // A one-shot timer wakes the wait at its deadline and then disarms
+    assert(events_timer_start(EVENT_TIMER_RECONNECT, 10, 0, EVENT_RECONNECT) == ARUNIKA_OK);
+    assert(events_wait(1000) == EVENT_RECONNECT);
+    assert(!events_timer_active(EVENT_TIMER_RECONNECT));
+    
+    // Periodic timers keep firing until stopped
+    assert(events_timer_start(EVENT_TIMER_HOUSEKEEPING, 5, 5, EVENT_HOUSEKEEPING) == ARUNIKA_OK);
+    assert(events_wait(1000) == EVENT_HOUSEKEEPING);
+    assert(events_wait(1000) == EVENT_HOUSEKEEPING);
+    events_timer_stop(EVENT_TIMER_HOUSEKEEPING);
+    assert(events_wait(20) == 0);
+    assert(events_timer_start(EVENT_TIMER_COUNT, 5, 0, EVENT_RECONNECT) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    // An outside loop can wait on the core's behalf: nearest deadline and fd
+    assert(events_next_timer_ms() == EVENT_WAIT_FOREVER);
+    assert(events_timer_start(EVENT_TIMER_RECONNECT, 500, 0, EVENT_RECONNECT) == ARUNIKA_OK);
+    assert(events_timer_start(EVENT_TIMER_STANDBY, 50, 0, EVENT_STANDBY) == ARUNIKA_OK);
+    assert(events_next_timer_ms() <= 50 && events_next_timer_ms() >= 40);
+    events_timer_stop(EVENT_TIMER_RECONNECT);
+    events_timer_stop(EVENT_TIMER_STANDBY);
+    events_watch_fd(7);
+    assert(events_get_watched_fd() == 7);
+    events_watch_fd(-1);
+    
+    printf("✅ Event loop test passed\n");
+}
+
+static uint32_t task_test_frames = 0;
+
+static void task_test_network_entry(void) {
+    // Consumer side of the capture ring, woken by the capture task
+    while (tasks_running()) {
+        uint32_t events = events_wait(EVENT_WAIT_FOREVER);
+        while ((events & EVENT_AUDIO_CAPTURED) && audio_capture_peek() != NULL) {
+            audio_capture_release();
+            __atomic_fetch_add(&task_test_frames, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void test_pipeline_tasks() {
+    assert(events_init() == ARUNIKA_OK);
+    assert(audio_set_format(AUDIO_FORMAT_MULAW) == ARUNIKA_OK);
+    assert(tasks_start(task_test_network_entry) == ARUNIKA_OK);
+    assert(tasks_start(task_test_network_entry) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    // Capture frames cross from the capture task to the network task
+    assert(audio_start_recording() == ARUNIKA_OK);
+    tasks_notify(TASK_CAPTURE);
+    
+    // The playback task drains the jitter buffer at the DMA cadence
+    static uint8_t codes[512];
+    memset(codes, 0xFF, sizeof(codes));
+    assert(playback_init(32) == ARUNIKA_OK);
+    assert(playback_start(AUDIO_FORMAT_MULAW, SAMPLE_RATE) == ARUNIKA_OK);
+    assert(playback_feed(codes, sizeof(codes)) == ARUNIKA_OK);
+    tasks_notify(TASK_PLAYBACK);
+    
+    delay_ms(300);
+    audio_stop_recording();
+    tasks_stop();
+    assert(!tasks_running());
+    
+    task_stats_t capture, playback;
+    assert(tasks_get_stats(TASK_CAPTURE, &capture) == ARUNIKA_OK);
+    assert(tasks_get_stats(TASK_PLAYBACK, &playback) == ARUNIKA_OK);
+    assert(strcmp(capture.name, "capture") == 0 && capture.wakeups >= 2);
+    assert(playback.priority > capture.priority && playback.wakeups >= 2);
+    assert(__atomic_load_n(&task_test_frames, __ATOMIC_RELAXED) >= 2);
+    
+    playback_stats_t stats;
+    playback_get_stats(&stats);
+    assert(stats.buffered_samples == 0);
+    playback_stop();
+    
+    printf("✅ Pipeline tasks test passed\n");
+}
+
+void test_voice_activity_detection() {
+    static int16_t noise[AUDIO_CHUNK_SAMPLES];
+    static int16_t tone[AUDIO_CHUNK_SAMPLES];
+    uint32_t seed = 12345;
+    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; i++) {
+        seed = seed * 1103515245 + 12345;
+        noise[i] = (int16_t)((int32_t)(seed >> 16 & 0x1FF) - 256); // +-256 hiss
+        // 500 Hz square-ish tone at 8 kHz
+        tone[i] = (i / 8) % 2 ? 8000 : -8000;
+    }
+    
+    vad_config_t config = { true, 512, 256, 640, VAD_MARGIN_Q4_DEFAULT };
+    assert(vad_init(&config) == ARUNIKA_OK);
+    
+    // Background noise is suppressed and trains the noise floor
+    for (int i = 0; i < 5; i++) {
+        assert(vad_process(noise, AUDIO_CHUNK_SAMPLES, SAMPLE_RATE) == VAD_SILENCE);
+    }
+    
+    // Speech, then the hangover window, then end of utterance
+    assert(vad_process(tone, AUDIO_CHUNK_SAMPLES, SAMPLE_RATE) == VAD_SPEECH);
+    assert(vad_process(tone, AUDIO_CHUNK_SAMPLES, SAMPLE_RATE) == VAD_SPEECH);
+    for (int i = 0; i < 4; i++) {
+        assert(vad_process(noise, AUDIO_CHUNK_SAMPLES, SAMPLE_RATE) == VAD_HANGOVER);
+    }
+    for (int i = 0; i < 3; i++) {
+        assert(vad_process(noise, AUDIO_CHUNK_SAMPLES, SAMPLE_RATE) == VAD_SILENCE);
+    }
+    assert(vad_process(noise, AUDIO_CHUNK_SAMPLES, SAMPLE_RATE) == VAD_END);
+    
+    vad_stats_t stats;
+    vad_get_stats(&stats);
+    assert(stats.speech_detected && stats.ended_by_vad);
+    assert(stats.frames_total == 15 && stats.frames_speech == 2 && stats.speech_ms == 128);
+    assert(stats.frames_suppressed == 8);
+    
+    // Nothing said: the no-speech timeout closes the utterance
+    vad_reset();
+    for (int i = 0; i < 9; i++) {
+        assert(vad_process(noise, AUDIO_CHUNK_SAMPLES, SAMPLE_RATE) == VAD_SILENCE);
+    }
+    assert(vad_process(noise, AUDIO_CHUNK_SAMPLES, SAMPLE_RATE) == VAD_END);
+    vad_get_stats(&stats);
+    assert(!stats.speech_detected && stats.frames_suppressed == 10);
+    
+    config.end_silence_ms = 0;
+    assert(vad_init(&config) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    printf("✅ Voice activity detection test passed\n");
+}
+
+void test_wake_word_standby() {
+    // Keyword stand-in: three 96 ms tones rising in pitch
+    static const int periods[3] = { 16, 8, 4 }; // 500, 1000 and 2000 Hz at 8 kHz
+    static int16_t keyword[3 * 768];
+    static int16_t reversed[3 * 768];
+    static int16_t enroll[512 + 3 * 768 + 512];
+    static int16_t noise[AUDIO_CHUNK_SAMPLES];
+    for (int i = 0; i < 3 * 768; i++) {
+        int period = periods[i / 768];
+        int back = periods[2 - i / 768];
+        keyword[i] = (i % period) < period / 2 ? 8000 : -8000;
+        reversed[i] = (i % back) < back / 2 ? 8000 : -8000;
+    }
+    memset(enroll, 0, sizeof(enroll));
+    memcpy(enroll + 512, keyword, sizeof(keyword));
+    uint32_t seed = 777;
+    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; i++) {
+        seed = seed * 1103515245 + 12345;
+        noise[i] = (int16_t)((int32_t)(seed >> 16 & 0xFFF) - 2048);
+    }
+    
+    assert(wakeword_init(KWS_THRESHOLD_Q4_DEFAULT) == ARUNIKA_OK);
+    assert(wakeword_arm() == ARUNIKA_ERROR_INVALID_PARAM); // Nothing enrolled
+    assert(wakeword_enroll(noise, 256) == ARUNIKA_ERROR_INVALID_PARAM);
+    assert(wakeword_enroll(enroll, sizeof(enroll) / 2) == ARUNIKA_OK);
+    assert(wakeword_has_template());
+    
+    // Noise and the keyword backwards never match
+    assert(wakeword_arm() == ARUNIKA_OK);
+    for (int i = 0; i < 8; i++) {
+        assert(wakeword_capture(noise, AUDIO_CHUNK_SAMPLES));
+    }
+    for (int i = 0; i < 3 * 768; i += AUDIO_CHUNK_SAMPLES / 2) {
+        assert(wakeword_capture(reversed + i, AUDIO_CHUNK_SAMPLES / 2));
+    }
+    assert(wakeword_capture(noise, AUDIO_CHUNK_SAMPLES));
+    assert(wakeword_get_mode() == WAKEWORD_ARMED);
+    
+    // The rolling pre-roll is trimmed to the lead when the keyword matches;
+    // a slightly rushed ending still counts
+    for (int i = 0; i < 3 * 768 && wakeword_get_mode() == WAKEWORD_ARMED; i += AUDIO_CHUNK_SAMPLES / 2) {
+        assert(wakeword_capture(keyword + i, AUDIO_CHUNK_SAMPLES / 2));
+    }
+    assert(wakeword_get_mode() == WAKEWORD_TRIGGERED);
+    wakeword_stats_t stats;
+    wakeword_get_stats(&stats);
+    assert(stats.detections == 1 && stats.best_score_q4 <= KWS_THRESHOLD_Q4_DEFAULT);
+    // In whole frames, so the uplink can drain it to exactly empty
+    size_t lead = (WAKEWORD_LEAD_MS * SAMPLE_RATE / 1000 + AUDIO_CHUNK_SAMPLES - 1) / AUDIO_CHUNK_SAMPLES *
+                  AUDIO_CHUNK_SAMPLES;
+    assert(wakeword_preroll_available() == lead);
+    
+    // Audio captured while the radio comes up queues behind the lead
+    for (int i = 0; i < 4; i++) {
+        assert(wakeword_capture(noise, AUDIO_CHUNK_SAMPLES));
+    }
+    size_t queued = lead + 4 * AUDIO_CHUNK_SAMPLES;
+    assert(wakeword_preroll_available() == queued);
+    
+    size_t sent = 0;
+    audio_buffer_t *frame;
+    while ((frame = wakeword_preroll_peek(AUDIO_CHUNK_SAMPLES, false)) != NULL) {
+        assert(frame->format == AUDIO_FORMAT_PCM && frame->size == AUDIO_CHUNK_SAMPLES * 2);
+        assert(frame->headroom >= AUDIO_FRAME_HEADROOM);
+        assert(wakeword_preroll_release() == ARUNIKA_OK);
+        sent += AUDIO_CHUNK_SAMPLES;
+    }
+    assert(sent == queued && wakeword_preroll_available() == 0);
+    
+    // Caught up: the next live frame goes to the ring and the pre-roll
+    // retires without a padded frame in the middle of the utterance
+    assert(wakeword_get_mode() == WAKEWORD_HANDOFF);
+    assert(!wakeword_capture(noise, AUDIO_CHUNK_SAMPLES));
+    assert(wakeword_get_mode() == WAKEWORD_PASSTHROUGH);
+    assert(wakeword_preroll_peek(AUDIO_CHUNK_SAMPLES, false) == NULL);
+    assert(wakeword_get_mode() == WAKEWORD_OFF && !wakeword_preroll_active());
+    
+    // Only the end of an utterance is padded
+    assert(wakeword_hold() == ARUNIKA_OK);
+    assert(wakeword_capture(noise, AUDIO_CHUNK_SAMPLES / 2));
+    frame = wakeword_preroll_peek(AUDIO_CHUNK_SAMPLES, true);
+    assert(frame && frame->size == AUDIO_CHUNK_SAMPLES * 2);
+    assert(((int16_t *)frame->data)[AUDIO_CHUNK_SAMPLES - 1] == 0);
+    assert(wakeword_preroll_release() == ARUNIKA_OK);
+    assert(wakeword_preroll_peek(AUDIO_CHUNK_SAMPLES, true) == NULL);
+    assert(wakeword_get_mode() == WAKEWORD_OFF);
+    
+    // The button wakes standby through the same path
+    assert(wakeword_arm() == ARUNIKA_OK);
+    wakeword_request_trigger();
+    assert(wakeword_capture(noise, AUDIO_CHUNK_SAMPLES));
+    assert(wakeword_get_mode() == WAKEWORD_TRIGGERED);
+    assert(wakeword_preroll_available() == AUDIO_CHUNK_SAMPLES); // Less than the lead so far
+    wakeword_disarm();
+    assert(!wakeword_capture(noise, AUDIO_CHUNK_SAMPLES));
+    
+    printf("✅ Wake word standby test passed\n");
+}
+
+void test_websocket_reconnect() {
+    assert(network_init() == ARUNIKA_OK);
+    assert(network_connect_wifi("TestSSID", "TestPassword") == ARUNIKA_OK);
+    websocket_disconnect();
+    
+    websocket_conn_stats_t before, after;
+    websocket_get_conn_stats(&before);
+    
+    // First connect pays for DNS and a full TLS handshake
+    assert(websocket_connect("wss://resume.example.com", 443, "/ws") == ARUNIKA_OK);
+    assert(websocket_get_conn_state() == WS_CONN_OPEN);
+    websocket_get_conn_stats(&after);
+    assert(after.full_handshakes == before.full_handshakes + 1);
+    assert(after.dns_cache_hits == before.dns_cache_hits);
+    uint32_t first_ms = after.last_connect_ms;
+    websocket_disconnect();
+    assert(websocket_get_conn_state() == WS_CONN_IDLE);
+    
+    // Reconnect reuses the cached address and resumes the TLS session
+    assert(websocket_connect("wss://resume.example.com", 443, "/ws") == ARUNIKA_OK);
+    websocket_get_conn_stats(&after);
+    assert(after.resumed_handshakes == before.resumed_handshakes + 1);
+    assert(after.dns_cache_hits == before.dns_cache_hits + 1);
+    assert(after.last_connect_ms < first_ms && after.consecutive_failures == 0);
+    websocket_disconnect();
+    
+    // The session belongs to its server
+    assert(websocket_connect("wss://resume.example.com", 8443, "/ws") == ARUNIKA_OK);
+    websocket_get_conn_stats(&after);
+    assert(after.full_handshakes == before.full_handshakes + 2);
+    websocket_disconnect();
+    assert(websocket_connect("http://resume.example.com", 443, "/ws") == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    network_addr_t addr;
+    bool cached = false;
+    assert(network_resolve("resume.example.com", &addr, &cached) == ARUNIKA_OK && cached);
+    network_forget_host("resume.example.com");
+    assert(network_resolve("resume.example.com", &addr, &cached) == ARUNIKA_OK && !cached);
+    
+    // Backoff doubles up to the cap and never drops below half its ceiling
+    for (uint32_t failures = 0; failures < 24; failures++) {
+        uint32_t doublings = failures > 0 ? failures - 1 : 0;
+        uint32_t ceiling = doublings < 6 ? WS_BACKOFF_BASE_MS << doublings : WS_BACKOFF_MAX_MS;
+        if (ceiling > WS_BACKOFF_MAX_MS) {
+            ceiling = WS_BACKOFF_MAX_MS;
+        }
+        for (int i = 0; i < 8; i++) {
+            uint32_t delay = websocket_backoff_delay_ms(failures);
+            assert(delay >= ceiling / 2 && delay <= ceiling);
+        }
+    }
+    
+    // One failed attempt: the first retry waits at most the base delay
+    network_disconnect_wifi();
+    assert(websocket_connect("wss://backoff.example.com", 443, "/ws") == ARUNIKA_ERROR_NETWORK);
+    websocket_get_conn_stats(&after);
+    assert(after.consecutive_failures == 1);
+    for (int i = 0; i < 8; i++) {
+        uint32_t delay = websocket_reconnect_delay_ms();
+        assert(delay >= WS_BACKOFF_BASE_MS / 2 && delay <= WS_BACKOFF_BASE_MS);
+    }
+    assert(network_connect_wifi("TestSSID", "TestPassword") == ARUNIKA_OK);
+    assert(websocket_connect("wss://backoff.example.com", 443, "/ws") == ARUNIKA_OK);
+    websocket_disconnect();
+    
+    printf("✅ WebSocket reconnect test passed\n");
+}
+
+void test_wifi_fast_connect() {
+    assert(network_init() == ARUNIKA_OK);
+    network_disconnect_wifi();
+    wifi_cache_t cache;
+    memset(&cache, 0, sizeof(cache));
+    network_set_wifi_cache(&cache);
+    
+    wifi_connect_stats_t before, after;
+    network_get_wifi_stats(&before);
+    
+    // Cold: full scan, then the association is remembered
+    assert(network_connect_wifi("TestSSID", "TestPassword") == ARUNIKA_OK);
+    network_get_wifi_stats(&after);
+    assert(after.full_connects == before.full_connects + 1);
+    uint32_t cold_ms = after.last_connect_ms;
+    network_get_wifi_cache(&cache);
+    assert(cache.valid && cache.channel != 0);
+    network_disconnect_wifi();
+    
+    // Warm: no scan, DHCP still runs
+    assert(network_connect_wifi("TestSSID", "TestPassword") == ARUNIKA_OK);
+    network_get_wifi_stats(&after);
+    assert(after.fast_connects == before.fast_connects + 1);
+    assert(after.last_connect_ms < cold_ms / 2);
+    network_disconnect_wifi();
+    
+    // A static IP skips DHCP as well
+    cache.use_static_ip = true;
+    network_addr_t ip = { { 192, 168, 1, 50 } };
+    cache.ip = ip;
+    network_set_wifi_cache(&cache);
+    uint32_t warm_ms = after.last_connect_ms;
+    assert(network_connect_wifi("TestSSID", "TestPassword") == ARUNIKA_OK);
+    network_get_wifi_stats(&after);
+    assert(after.dhcp_skipped == before.dhcp_skipped + 1 && after.last_connect_ms < warm_ms);
+    network_disconnect_wifi();
+    
+    // The AP moved channel: fall back to a scan and learn the new one
+    cache.channel = (uint8_t)(cache.channel % 11 + 1);
+    cache.use_static_ip = false;
+    network_set_wifi_cache(&cache);
+    assert(network_connect_wifi("TestSSID", "TestPassword") == ARUNIKA_OK);
+    network_get_wifi_stats(&after);
+    assert(after.fast_fallbacks == before.fast_fallbacks + 1);
+    assert(after.full_connects == before.full_connects + 2);
+    wifi_cache_t learned;
+    network_get_wifi_cache(&learned);
+    assert(learned.valid && learned.channel != cache.channel);
+    
+    printf("✅ WiFi fast connect test passed\n");
+}
+
+void test_config_store() {
+    assert(config_reset() == ARUNIKA_OK);
+    config_store_stats_t stats;
+    config_store_get_stats(&stats);
+    assert(stats.active_slot == -1);
+    
+    device_config_t config;
+    assert(config_load(&config) == ARUNIKA_OK);
+    char default_id[sizeof(config.device_id)];
+    strcpy(default_id, config.device_id);
+    
+    // Writes alternate between the two slots
+    strcpy(config.device_id, "doll-store-1");
+    assert(config_save(&config) == ARUNIKA_OK);
+    config_store_get_stats(&stats);
+    assert(stats.active_slot == 0 && stats.writes == 1);
+    
+    config_runtime_t runtime;
+    memset(&runtime, 0, sizeof(runtime));
+    runtime.playback_prebuffer_ms = 240;
+    strcpy(runtime.tls_session.host, "example.com");
+    runtime.tls_session.port = 443;
+    runtime.tls_session.ticket_len = 4;
+    memcpy(runtime.tls_session.ticket, "tkt1", 4);
+    assert(config_save_runtime(&runtime) == ARUNIKA_OK);
+    config_store_get_stats(&stats);
+    assert(stats.active_slot == 1 && stats.writes == 2);
+    
+    // Saving the same record again costs no erase
+    assert(config_save(&config) == ARUNIKA_OK);
+    config_store_get_stats(&stats);
+    assert(stats.writes == 2 && stats.writes_skipped == 1);
+    
+    // Lazy field reads come straight from the mapped record
+    assert(strcmp(config_get()->device_id, "doll-store-1") == 0);
+    config_runtime_t loaded;
+    assert(config_load_runtime(&loaded) == ARUNIKA_OK);
+    assert(loaded.playback_prebuffer_ms == 240 && loaded.tls_session.ticket_len == 4);
+    assert(memcmp(loaded.tls_session.ticket, "tkt1", 4) == 0);
+    
+    // A torn or corrupted write falls back to the previous record
+    uint8_t zero = 0;
+    assert(flash_write(FLASH_SECTOR_SIZE + sizeof(config_header_t) + 8, &zero, 1) == ARUNIKA_OK);
+    assert(config_store_mount() == ARUNIKA_OK);
+    config_store_get_stats(&stats);
+    assert(stats.active_slot == 0);
+    assert(config_load_runtime(&loaded) == ARUNIKA_OK && loaded.playback_prebuffer_ms == 0);
+    assert(strcmp(config_get()->device_id, "doll-store-1") == 0);
+    
+    // The next write replaces the damaged slot
+    strcpy(config.device_id, "doll-store-2");
+    assert(config_save(&config) == ARUNIKA_OK);
+    config_store_get_stats(&stats);
+    assert(stats.active_slot == 1);
+    
+    // Housekeeping persists a fresh TLS session once; its expiry is a fixed
+    // stamp, so the next tick a second later has nothing to write
+    assert(network_connect_wifi("TestSSID", "TestPassword") == ARUNIKA_OK);
+    assert(websocket_connect("wss://store.example.com", 443, "/ws") == ARUNIKA_OK);
+    websocket_disconnect();
+    config_store_get_stats(&stats);
+    uint32_t writes = stats.writes;
+    app_handle_events(EVENT_HOUSEKEEPING);
+    delay_ms(1000);
+    app_handle_events(EVENT_HOUSEKEEPING);
+    config_store_get_stats(&stats);
+    assert(stats.writes == writes + 1);
+    assert(config_load_runtime(&loaded) == ARUNIKA_OK);
+    assert(strcmp(loaded.tls_session.host, "store.example.com") == 0);
+    
+    // Later tests expect the defaults
+    assert(config_reset() == ARUNIKA_OK);
+    assert(strcmp(config_get()->device_id, default_id) == 0);
+    
+    printf("✅ Config store test passed\n");
+}
+
+void test_deep_sleep_resume() {
+    // Cold boot: nothing in RTC memory yet
+    resume_snapshot_t snapshot;
+    assert(power_take_snapshot(&snapshot) != ARUNIKA_OK);
+    assert(device_init() == ARUNIKA_OK);
+    assert(device_get_session_id()[0] == '\0');
+    
+    // A saved config, e.g. a learned WiFi cache, puts the store past sequence 0
+    device_config_t config;
+    config_load(&config);
+    config.wifi_cache.channel = 6;
+    assert(config_save(&config) == ARUNIKA_OK);
+    
+    // The server negotiates A-law and opens a conversation
+    assert(device_process_incoming_message("{\"type\":\"device_hello\",\"encoding\":\"ALAW\","
+                                           "\"session_id\":\"conv-7f3a\"}") == ARUNIKA_OK);
+    assert(audio_get_format() == AUDIO_FORMAT_ALAW);
+    assert(strcmp(device_get_session_id(), "conv-7f3a") == 0);
+    vad_set_noise_floor(150);
+    
+    // Only an idle device sleeps
+    device_set_state(DEVICE_STATE_PLAYING);
+    assert(device_enter_sleep() == ARUNIKA_ERROR_INVALID_PARAM);
+    device_set_state(DEVICE_STATE_IDLE);
+    assert(device_enter_sleep() == ARUNIKA_OK);
+    
+    // Wake: the reset lost the store mount, but settings come back from the
+    // snapshot, not the defaults
+    config_store_unmount();
+    audio_set_format(AUDIO_FORMAT_MULAW);
+    vad_set_noise_floor(-1);
+    assert(device_init() == ARUNIKA_OK);
+    assert(device_get_state() == DEVICE_STATE_IDLE);
+    assert(audio_get_format() == AUDIO_FORMAT_ALAW);
+    assert(strcmp(device_get_session_id(), "conv-7f3a") == 0);
+    assert(vad_get_noise_floor() == 150);
+    
+    // The snapshot is single use
+    assert(power_take_snapshot(&snapshot) != ARUNIKA_OK);
+    
+    // A config saved after the snapshot forces the full path
+    assert(device_enter_sleep() == ARUNIKA_OK);
+    config_load(&config);
+    config.server_port = 8443;
+    assert(config_save(&config) == ARUNIKA_OK);
+    config_store_unmount();
+    assert(device_init() == ARUNIKA_OK);
+    assert(audio_get_format() == AUDIO_FORMAT_MULAW);
+    assert(device_get_session_id()[0] == '\0');
+    
+    assert(config_reset() == ARUNIKA_OK);
+    printf("✅ Deep sleep resume test passed\n");
+}
+
+void test_battery_policy() {
+    assert(power_init() == ARUNIKA_OK);
+    battery_status_t status;
+    
+    // A full cell settles and stays in normal mode
+    power_sim_set_battery_mv(4150);
+    for (int i = 0; i < 24; i++) {
+        assert(power_sample_battery() == ARUNIKA_OK);
+    }
+    power_get_battery_status(&status);
+    assert(status.percent >= 95 && status.mode == POWER_MODE_NORMAL);
+    assert(power_get_battery_level() == status.percent);
+    
+    // One sample after a step only moves the estimate part of the way
+    power_sim_set_battery_mv(3700);
+    power_sample_battery();
+    power_get_battery_status(&status);
+    assert(status.voltage_mv > 3950 && status.voltage_mv < 4100);
+    for (int i = 0; i < 24; i++) {
+        power_sample_battery();
+    }
+    power_get_battery_status(&status);
+    assert(status.percent <= BATTERY_SAVER_PERCENT && status.mode == POWER_MODE_SAVER);
+    
+    power_sim_set_battery_mv(3600);
+    for (int i = 0; i < 24; i++) {
+        power_sample_battery();
+    }
+    assert(power_get_mode() == POWER_MODE_CRITICAL);
+    
+    // Recovering just past a threshold is not enough to leave a mode
+    power_sim_set_battery_mv(3680);
+    for (int i = 0; i < 24; i++) {
+        power_sample_battery();
+    }
+    power_get_battery_status(&status);
+    assert(status.percent > BATTERY_CRITICAL_PERCENT && status.mode == POWER_MODE_CRITICAL);
+    power_sim_set_battery_mv(3710);
+    for (int i = 0; i < 24; i++) {
+        power_sample_battery();
+    }
+    power_get_battery_status(&status);
+    assert(status.percent <= BATTERY_SAVER_PERCENT + BATTERY_HYSTERESIS_PERCENT);
+    assert(status.mode == POWER_MODE_SAVER);
+    
+    // Lower modes ping less and sleep sooner
+    const power_profile_t *normal = power_get_profile(POWER_MODE_NORMAL);
+    const power_profile_t *critical = power_get_profile(POWER_MODE_CRITICAL);
+    assert(critical->keepalive_ms > normal->keepalive_ms);
+    assert(critical->idle_timeout_ms > 0 && critical->vad_margin_q4_extra > 0);
+    assert(device_apply_power_mode(POWER_MODE_CRITICAL) == ARUNIKA_OK);
+    assert(device_apply_power_mode(POWER_MODE_NORMAL) == ARUNIKA_OK);
+    
+    power_sim_set_battery_mv(3870);
+    for (int i = 0; i < 24; i++) {
+        power_sample_battery();
+    }
+    assert(power_get_mode() == POWER_MODE_NORMAL);
+    
+    printf("✅ Battery policy test passed\n");
+}
+
+void test_memory_pools() {
+    // Everything the earlier tests acquired has been given back
+    pool_stats_t stats;
+    for (int i = 0; i < POOL_COUNT; i++) {
+        assert(pool_get_stats((pool_id_t)i, &stats) == ARUNIKA_OK);
+        assert(stats.in_use == 0);
+    }
+    
+    // Pooled frames have the capture ring layout
+    audio_buffer_t *frames[POOL_AUDIO_FRAMES];
+    for (int i = 0; i < POOL_AUDIO_FRAMES; i++) {
+        frames[i] = audio_buffer_acquire(SAMPLE_RATE, AUDIO_FORMAT_PCM);
+        assert(frames[i] && frames[i]->capacity == AUDIO_BUFFER_SIZE);
+        assert(frames[i]->headroom == AUDIO_FRAME_HEADROOM && frames[i]->size == 0);
+        memset(frames[i]->data - frames[i]->headroom, i, frames[i]->headroom + frames[i]->capacity);
+    }
+    assert(frames[0]->data[AUDIO_BUFFER_SIZE - 1] == 0);
+    
+    // Exhaustion fails the acquire and is counted
+    pool_stats_t before;
+    pool_get_stats(POOL_AUDIO_FRAME, &before);
+    assert(audio_buffer_acquire(SAMPLE_RATE, AUDIO_FORMAT_PCM) == NULL);
+    pool_get_stats(POOL_AUDIO_FRAME, &stats);
+    assert(stats.exhausted == before.exhausted + 1 && stats.in_use == POOL_AUDIO_FRAMES);
+    assert(stats.high_watermark == POOL_AUDIO_FRAMES);
+    
+    // Released blocks are reused; double and foreign releases are rejected
+    assert(audio_buffer_release(frames[1]) == ARUNIKA_OK);
+    assert(audio_buffer_release(frames[1]) == ARUNIKA_ERROR_INVALID_PARAM);
+    audio_buffer_t *again = audio_buffer_acquire(8000, AUDIO_FORMAT_MULAW);
+    assert(again == frames[1] && again->format == AUDIO_FORMAT_MULAW);
+    uint8_t foreign[16];
+    assert(pool_release(POOL_WS_FRAME, foreign) == ARUNIKA_ERROR_INVALID_PARAM);
+    uint8_t *ws = pool_acquire(POOL_WS_FRAME);
+    assert(ws && pool_release(POOL_WS_FRAME, ws + 1) == ARUNIKA_ERROR_INVALID_PARAM);
+    assert(pool_release(POOL_WS_FRAME, ws) == ARUNIKA_OK);
+    
+    for (int i = 0; i < POOL_AUDIO_FRAMES; i++) {
+        assert(audio_buffer_release(frames[i]) == ARUNIKA_OK);
+    }
+    pool_get_stats(POOL_AUDIO_FRAME, &stats);
+    assert(stats.in_use == 0);
+    
+    printf("✅ Memory pools test passed\n");
+}
+
+typedef struct {
+    char type[16];
+    char text[32];
+    long number;
+    json_type_t nested_type;
+    size_t streamed;
+    int chunks;
+    bool stream_ended;
+    bool zero_copy;
+    const char *fragment;
+    size_t fragment_len;
+} json_test_ctx_t;
+
+static int json_test_field(const json_span_t *key, json_type_t type, const json_span_t *value, void *ctx) {
+    json_test_ctx_t *t = (json_test_ctx_t *)ctx;
+    if (json_span_equals(key, "type")) {
+        snprintf(t->type, sizeof(t->type), "%.*s", (int)value->len, value->ptr);
+        t->zero_copy = value->ptr >= t->fragment && value->ptr < t->fragment + t->fragment_len;
+    } else if (json_span_equals(key, "text")) {
+        snprintf(t->text, sizeof(t->text), "%.*s", (int)value->len, value->ptr);
+    } else if (json_span_equals(key, "n") && type == JSON_NUMBER) {
+        t->number = strtol(value->ptr, NULL, 10);
+    } else if (json_span_equals(key, "meta")) {
+        t->nested_type = type;
+    }
+    return ARUNIKA_OK;
+}
+
+static bool json_test_stream(const json_span_t *key, void *ctx) {
+    (void)ctx;
+    return json_span_equals(key, "audio_data");
+}
+
+static int json_test_chunk(const json_span_t *key, const char *data, size_t len, void *ctx) {
+    json_test_ctx_t *t = (json_test_ctx_t *)ctx;
+    (void)key;
+    (void)data;
+    t->streamed += len;
+    t->chunks++;
+    t->stream_ended = len == 0;
+    return ARUNIKA_OK;
+}
+
+void test_json_tokenizer() {
+    const char *doc = "{ \"type\":\"response_text\", \"n\": -42, \"meta\": {\"a\":[1,\"}\"]},"
+                      " \"ok\":true, \"text\":\"say \\\"hi\\\"\", \"audio_data\":\"QUJDRA==\" }";
+    json_test_ctx_t ctx;
+    json_handler_t handler = { json_test_field, json_test_stream, json_test_chunk, &ctx };
+    json_stream_t stream;
+    
+    // Whole message: every value is a span into the input
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.fragment = doc;
+    ctx.fragment_len = strlen(doc);
+    json_stream_init(&stream, &handler);
+    assert(json_stream_feed(&stream, doc, strlen(doc)) == ARUNIKA_OK);
+    assert(json_stream_finish(&stream) == ARUNIKA_OK);
+    assert(strcmp(ctx.type, "response_text") == 0 && ctx.zero_copy);
+    assert(ctx.number == -42 && ctx.nested_type == JSON_OBJECT);
+    assert(strcmp(ctx.text, "say \\\"hi\\\"") == 0);
+    assert(ctx.streamed == 8 && ctx.stream_ended);
+    
+    // One byte at a time gives the same result
+    memset(&ctx, 0, sizeof(ctx));
+    json_stream_init(&stream, &handler);
+    for (size_t i = 0; doc[i]; i++) {
+        assert(json_stream_feed(&stream, doc + i, 1) == ARUNIKA_OK);
+    }
+    assert(json_stream_finish(&stream) == ARUNIKA_OK);
+    assert(strcmp(ctx.type, "response_text") == 0 && !ctx.zero_copy);
+    assert(ctx.number == -42 && strcmp(ctx.text, "say \\\"hi\\\"") == 0);
+    assert(ctx.streamed == 8 && ctx.chunks == 9 && ctx.stream_ended);
+    
+    // Truncated and malformed input is rejected
+    json_stream_init(&stream, &handler);
+    assert(json_stream_feed(&stream, doc, 20) == ARUNIKA_OK);
+    assert(json_stream_finish(&stream) == ARUNIKA_ERROR_INVALID_PARAM);
+    json_stream_init(&stream, &handler);
+    assert(json_stream_feed(&stream, "{\"a\" 1}", 7) == ARUNIKA_ERROR_INVALID_PARAM);
+    assert(json_stream_feed(&stream, "}", 1) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    json_span_t value;
+    assert(json_get_field(doc, strlen(doc), "type", &value) == ARUNIKA_OK);
+    assert(json_span_equals(&value, "response_text") && value.ptr > doc);
+    assert(json_get_field(doc, strlen(doc), "missing", &value) != ARUNIKA_OK);
+    
+    printf("✅ JSON tokenizer test passed\n");
+}
+
+void test_control_messages() {
+    assert(audio_set_format(AUDIO_FORMAT_MULAW) == ARUNIKA_OK);
+    assert(playback_init(PLAYBACK_PREBUFFER_MS_DEFAULT) == ARUNIKA_OK);
+    device_set_state(DEVICE_STATE_IDLE);
+    
+    // speaking_start picks the stream encoding, speaking_end drains it
+    assert(device_process_incoming_message("{\"type\":\"speaking_start\",\"encoding\":\"ALAW\"}") == ARUNIKA_OK);
+    assert(playback_get_state() == PLAYBACK_STATE_BUFFERING && device_get_state() == DEVICE_STATE_PLAYING);
+    assert(device_process_incoming_message("{\"type\":\"speaking_end\"}") == ARUNIKA_OK);
+    assert(playback_get_state() == PLAYBACK_STATE_DRAINING);
+    playback_stop();
+    assert(device_process_incoming_message("{\"type\":\"speaking_start\",\"encoding\":\"FLAC\"}") ==
+           ARUNIKA_ERROR_INVALID_PARAM);
+    
+    // An ai_response far larger than a receive frame, split mid-field;
+    // audio_data goes to the decoder while the message is still arriving
+    static char body[6000];
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t audio_chars = 4800;
+    int len = snprintf(body, sizeof(body), "{\"type\":\"ai_response\",\"audio_data\":\"");
+    for (size_t i = 0; i < audio_chars; i++) {
+        body[len++] = b64[i % 64];
+    }
+    len += snprintf(body + len, sizeof(body) - (size_t)len, "\",\"text\":\"hello\"}");
+    
+    playback_stats_t stats;
+    for (int offset = 0; offset < len; offset += 1000) {
+        size_t n = (size_t)(len - offset < 1000 ? len - offset : 1000);
+        assert(device_process_message_fragment(body + offset, n, offset == 0, offset + 1000 >= len) == ARUNIKA_OK);
+        if (offset == 1000) {
+            // Decoded audio is already queued before the message ends
+            playback_get_stats(&stats);
+            assert(stats.buffered_samples > 0 && playback_get_state() != PLAYBACK_STATE_IDLE);
+        }
+    }
+    playback_get_stats(&stats);
+    assert(stats.buffered_samples == audio_chars / 4 * 3 && stats.overflows == 0);
+    assert(playback_get_state() == PLAYBACK_STATE_DRAINING);
+    playback_stop();
+    
+    // Server-initiated listening, informational messages, and junk
+    assert(device_process_incoming_message("{\"type\":\"response_text\",\"text\":\"Hi there\"}") == ARUNIKA_OK);
+    assert(device_process_incoming_message("{\"type\":\"emotion\",\"emotion\":\"happy\"}") == ARUNIKA_OK);
+    assert(device_process_incoming_message("{\"type\":\"something_new\"}") == ARUNIKA_OK);
+    assert(device_process_incoming_message("ai_response") == ARUNIKA_ERROR_INVALID_PARAM);
+    device_set_state(DEVICE_STATE_IDLE);
+    assert(device_process_incoming_message("{\"type\":\"listening_start\"}") == ARUNIKA_OK);
+    assert(device_get_state() == DEVICE_STATE_RECORDING && audio_is_recording());
+    audio_stop_recording();
+    device_set_state(DEVICE_STATE_IDLE);
+    
+    printf("✅ Control messages test passed\n");
+}
+
+// Unmasked server frame, as the device receives it
+static size_t ws_test_frame(uint8_t *out, bool fin, uint8_t opcode, const void *payload, size_t len) {
+    size_t n = 0;
+    out[n++] = (uint8_t)((fin ? 0x80 : 0) | opcode);
+    if (len < 126) {
+        out[n++] = (uint8_t)len;
+    } else {
+        out[n++] = 126;
+        out[n++] = (uint8_t)(len >> 8);
+        out[n++] = (uint8_t)len;
+    }
+    memcpy(out + n, payload, len);
+    return n + len;
+}
+
+// Reads everything pending through a deliberately small buffer
+static int ws_test_drain(size_t read_size) {
+    uint8_t buffer[64];
+    int result;
+    while ((result = websocket_receive(buffer, read_size, device_process_incoming_fragment, NULL)) > 0) {
+    }
+    return result;
+}
+
+void test_websocket_reassembly() {
+    static uint8_t wire[2048];
+    size_t n = 0;
+    websocket_conn_stats_t before, after;
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    assert(playback_init(PLAYBACK_PREBUFFER_MS_DEFAULT) == ARUNIKA_OK);
+    device_set_state(DEVICE_STATE_IDLE);
+    websocket_get_conn_stats(&before);
+    
+    // A text message in three fragments with a ping between them
+    const char *start = "{\"type\":\"speaking_start\",\"encoding\":\"MULAW\"}";
+    n += ws_test_frame(wire + n, false, WS_OPCODE_TEXT, start, 10);
+    n += ws_test_frame(wire + n, false, WS_OPCODE_CONTINUATION, start + 10, 15);
+    n += ws_test_frame(wire + n, true, WS_OPCODE_PING, "hb", 2);
+    n += ws_test_frame(wire + n, true, WS_OPCODE_CONTINUATION, start + 25, strlen(start) - 25);
+    assert(websocket_sim_receive(wire, n) == ARUNIKA_OK);
+    uint64_t tx_before = websocket_get_tx_bytes();
+    assert(ws_test_drain(7) == 0);
+    assert(device_get_state() == DEVICE_STATE_PLAYING && playback_get_format() == AUDIO_FORMAT_MULAW);
+    assert(websocket_get_tx_bytes() == tx_before + 2 + 4 + 2); // Pong with the ping payload
+    websocket_get_conn_stats(&after);
+    assert(after.rx_messages == before.rx_messages + 1 && after.rx_continuations == before.rx_continuations + 2);
+    
+    // A binary message with an extended length, split across frames and
+    // odd-sized reads; audio is queued before the last fragment arrives
+    static uint8_t codes[800];
+    for (int i = 0; i < 800; i++) {
+        codes[i] = (uint8_t)(i * 37);
+    }
+    n = ws_test_frame(wire, false, WS_OPCODE_BINARY, codes, 300);
+    assert(websocket_sim_receive(wire, n) == ARUNIKA_OK);
+    assert(ws_test_drain(37) == 0);
+    playback_stats_t stats;
+    playback_get_stats(&stats);
+    assert(stats.buffered_samples == 300);
+    n = ws_test_frame(wire, true, WS_OPCODE_CONTINUATION, codes + 300, 500);
+    assert(websocket_sim_receive(wire, n) == ARUNIKA_OK);
+    assert(ws_test_drain(37) == 0);
+    playback_get_stats(&stats);
+    assert(stats.buffered_samples == 800);
+    playback_stop();
+    
+    // A rejected message is skipped; the next one on the link still works
+    n = ws_test_frame(wire, true, WS_OPCODE_TEXT, "{\"type\"", 7);
+    n += ws_test_frame(wire + n, true, WS_OPCODE_TEXT, "{\"type\":\"speaking_end\"}", 23);
+    assert(websocket_sim_receive(wire, n) == ARUNIKA_OK);
+    assert(ws_test_drain(64) == 0 && websocket_is_connected());
+    
+    // Protocol violations fail the connection
+    n = ws_test_frame(wire, true, WS_OPCODE_CONTINUATION, "x", 1);
+    assert(websocket_sim_receive(wire, n) == ARUNIKA_OK);
+    assert(ws_test_drain(64) == ARUNIKA_ERROR_WEBSOCKET && !websocket_is_connected());
+    
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    n = ws_test_frame(wire, false, WS_OPCODE_TEXT, "{", 1);
+    n += ws_test_frame(wire + n, true, WS_OPCODE_TEXT, "{}", 2);
+    assert(websocket_sim_receive(wire, n) == ARUNIKA_OK);
+    assert(ws_test_drain(64) == ARUNIKA_ERROR_WEBSOCKET && !websocket_is_connected());
+    
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    n = ws_test_frame(wire, true, WS_OPCODE_TEXT, "{}", 2);
+    wire[1] |= 0x80; // Servers must not mask
+    assert(websocket_sim_receive(wire, n) == ARUNIKA_OK);
+    assert(ws_test_drain(64) == ARUNIKA_ERROR_WEBSOCKET);
+    websocket_get_conn_stats(&after);
+    assert(after.rx_protocol_errors == before.rx_protocol_errors + 3);
+    
+    // A close from the server ends the connection cleanly
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    n = ws_test_frame(wire, true, WS_OPCODE_CLOSE, "\x03\xe8", 2);
+    assert(websocket_sim_receive(wire, n) == ARUNIKA_OK);
+    assert(ws_test_drain(64) == ARUNIKA_ERROR_WEBSOCKET && !websocket_is_connected());
+    device_set_state(DEVICE_STATE_IDLE);
+    
+    printf("✅ WebSocket reassembly test passed\n");
+}
+
+// Speaker-to-mic path for the echo canceller test
+static int16_t aec_test_echo(const int16_t *far, size_t j) {
+    return (int16_t)(far[j - 2] / 4 - far[j - 9] / 8 + far[j - 40] / 16);
+}
+
+void test_echo_cancellation() {
+    static int16_t far[AUDIO_CHUNK_SAMPLES * 80];
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < sizeof(far) / sizeof(far[0]); i++) {
+        seed = seed * 1103515245 + 12345;
+        far[i] = (int16_t)((int32_t)(seed >> 16 & 0x3FFF) - 0x2000);
+    }
+    
+    aec_config_t config = { true, false, AEC_DELAY_SAMPLES_DEFAULT, BARGE_IN_FRAMES_DEFAULT };
+    assert(aec_init(&config) == ARUNIKA_OK);
+    aec_config_t bad = { true, true, AEC_REFERENCE_SAMPLES, 0 };
+    assert(aec_init(&bad) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    // Two blocks of history, then the speaker and mic run in step. Each mic
+    // frame lines up with the reference AEC_DELAY_SAMPLES behind the newest
+    const size_t n = AUDIO_CHUNK_SAMPLES;
+    int16_t mic[AUDIO_CHUNK_SAMPLES];
+    aec_reference(far, 2 * n);
+    size_t head = 2 * n;
+    aec_stats_t stats;
+    for (int frame = 0; frame < 60; frame++) {
+        aec_reference(far + head, n);
+        head += n;
+        size_t base = head - n - AEC_DELAY_SAMPLES_DEFAULT;
+        for (size_t i = 0; i < n; i++) {
+            mic[i] = aec_test_echo(far, base + i);
+        }
+        aec_process(mic, n);
+    }
+    aec_get_stats(&stats);
+    assert(stats.frames == 60 && stats.adapted_frames == 60 && stats.reference_resyncs == 0);
+    assert(stats.erle_q4 >= 80); // Over 15 dB of echo removed
+    
+    // The user talks over the doll: the echo is still removed but the
+    // filter stops learning, so it is intact afterwards
+    for (int frame = 0; frame < 5; frame++) {
+        aec_reference(far + head, n);
+        head += n;
+        size_t base = head - n - AEC_DELAY_SAMPLES_DEFAULT;
+        for (size_t i = 0; i < n; i++) {
+            mic[i] = (int16_t)(aec_test_echo(far, base + i) + ((i / 8) % 2 ? 12000 : -12000));
+        }
+        aec_process(mic, n);
+        int32_t peak = 0;
+        for (size_t i = 0; i < n; i++) {
+            int32_t a = mic[i] < 0 ? -mic[i] : mic[i];
+            peak = a > peak ? a : peak;
+        }
+        assert(peak > 9000 && peak < 15000); // Near-end speech survives
+    }
+    aec_get_stats(&stats);
+    assert(stats.double_talk_frames == 5);
+    aec_reference(far + head, n);
+    head += n;
+    for (size_t i = 0; i < n; i++) {
+        mic[i] = aec_test_echo(far, head - n - AEC_DELAY_SAMPLES_DEFAULT + i);
+    }
+    aec_process(mic, n);
+    aec_get_stats(&stats);
+    assert(stats.erle_q4 >= 80);
+    
+    // A silent speaker leaves the mic untouched
+    for (size_t i = 0; i < n; i++) {
+        mic[i] = (int16_t)(i * 10);
+    }
+    aec_process(mic, n);
+    assert(mic[100] == 1000);
+    
+    assert(aec_init(&config_get()->aec) == ARUNIKA_OK);
+    printf("✅ Echo cancellation test passed\n");
+}
+
+void test_barge_in() {
+    int16_t pcm[AUDIO_CHUNK_SAMPLES];
+    int16_t quiet[AUDIO_CHUNK_SAMPLES];
+    memset(quiet, 0, sizeof(quiet));
+    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; i++) {
+        pcm[i] = (int16_t)((i / 10) % 2 ? 6000 : -6000); // Voiced, low crossing rate
+    }
+    
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    assert(playback_init(PLAYBACK_PREBUFFER_MS_DEFAULT) == ARUNIKA_OK);
+    audio_stop_recording();
+    assert(device_process_uplink() == ARUNIKA_OK); // Close what earlier tests left open
+    device_set_state(DEVICE_STATE_IDLE);
+    
+    // The mic stays open behind the echo canceller while the doll talks
+    assert(device_process_incoming_message("{\"type\":\"speaking_start\",\"encoding\":\"MULAW\"}") == ARUNIKA_OK);
+    assert(device_get_state() == DEVICE_STATE_PLAYING && audio_is_recording());
+    
+    // Silence and a single loud frame do not interrupt
+    audio_ring_stats_t ring;
+    assert(audio_i2s_rx_callback((const uint8_t *)quiet, sizeof(quiet)) == ARUNIKA_OK);
+    assert(audio_i2s_rx_callback((const uint8_t *)pcm, sizeof(pcm)) == ARUNIKA_OK);
+    assert(audio_i2s_rx_callback((const uint8_t *)quiet, sizeof(quiet)) == ARUNIKA_OK);
+    assert(device_process_uplink() == ARUNIKA_OK);
+    audio_capture_get_stats(&ring);
+    assert(device_get_state() == DEVICE_STATE_PLAYING && ring.occupancy == 0);
+    
+    // Sustained speech stops playback, cancels the response, and becomes
+    // the start of the next utterance
+    for (int i = 0; i < BARGE_IN_FRAMES_DEFAULT - 1; i++) {
+        assert(audio_i2s_rx_callback((const uint8_t *)pcm, sizeof(pcm)) == ARUNIKA_OK);
+    }
+    assert(device_process_uplink() == ARUNIKA_OK);
+    assert(device_get_state() == DEVICE_STATE_PLAYING);
+    uint64_t tx_before = websocket_get_tx_bytes();
+    assert(audio_i2s_rx_callback((const uint8_t *)pcm, sizeof(pcm)) == ARUNIKA_OK);
+    assert(device_process_uplink() == ARUNIKA_OK);
+    assert(device_get_state() == DEVICE_STATE_RECORDING && playback_get_state() == PLAYBACK_STATE_IDLE);
+    assert(websocket_get_tx_bytes() > tx_before);
+    audio_capture_get_stats(&ring);
+    assert(ring.occupancy == BARGE_IN_FRAMES_DEFAULT);
+    
+    assert(device_process_uplink() == ARUNIKA_OK);
+    audio_capture_get_stats(&ring);
+    assert(ring.occupancy == 0);
+    
+    // The button interrupts as well
+    device_handle_button_press();
+    assert(device_get_state() == DEVICE_STATE_PROCESSING);
+    device_process_uplink();
+    device_set_state(DEVICE_STATE_IDLE);
+    assert(device_process_incoming_message("{\"type\":\"speaking_start\",\"encoding\":\"MULAW\"}") == ARUNIKA_OK);
+    assert(device_handle_button_press() == ARUNIKA_OK);
+    assert(device_get_state() == DEVICE_STATE_RECORDING && playback_get_state() == PLAYBACK_STATE_IDLE);
+    audio_stop_recording();
+    device_process_uplink();
+    device_set_state(DEVICE_STATE_IDLE);
+    websocket_disconnect();
+    
+    printf("✅ Barge-in test passed\n");
+}
+
+void test_latency_trace() {
+    trace_reset();
+    trace_histogram_t h;
+    assert(trace_get_histogram(TRACE_STAGE_COUNT, &h) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    // Fixed log2 buckets; percentiles report the bucket's upper edge
+    for (uint32_t us = 1; us <= 100; us++) {
+        trace_record(TRACE_STAGE_ENCODE, us);
+    }
+    trace_record(TRACE_STAGE_ENCODE, 5000);
+    assert(trace_get_histogram(TRACE_STAGE_ENCODE, &h) == ARUNIKA_OK);
+    assert(h.count == 101 && h.min_us == 1 && h.max_us == 5000 && h.total_us == 5050 + 5000);
+    assert(h.buckets[0] == 1 && h.buckets[5] == 32 && h.buckets[6] == 37 && h.buckets[12] == 1);
+    assert(trace_percentile_us(&h, 50) == 63);
+    assert(trace_percentile_us(&h, 99) == 127);
+    assert(trace_percentile_us(&h, 100) == 5000);
+
+#ifdef ARUNIKA_TRACE
+    // One turn end to end: the final frame goes out, the response starts,
+    // and its first sample reaches the DMA
+    assert(playback_init(PLAYBACK_PREBUFFER_MS_DEFAULT) == ARUNIKA_OK);
+    device_set_state(DEVICE_STATE_IDLE);
+    uint32_t captured = trace_now();
+    delay_ms(2);
+    trace_utterance_sent(captured);
+    delay_ms(3);
+    assert(device_process_incoming_message("{\"type\":\"speaking_start\",\"encoding\":\"MULAW\"}") == ARUNIKA_OK);
+    uint8_t codes[AUDIO_CHUNK_SAMPLES];
+    memset(codes, 0xFF, sizeof(codes));
+    assert(playback_feed(codes, sizeof(codes)) == ARUNIKA_OK);
+    playback_end();
+    int16_t out[PLAYBACK_DMA_SAMPLES];
+    playback_i2s_tx_callback(out, PLAYBACK_DMA_SAMPLES);
+    playback_i2s_tx_callback(out, PLAYBACK_DMA_SAMPLES);
+    
+    trace_get_histogram(TRACE_STAGE_SERVER, &h);
+    assert(h.count == 1 && h.min_us >= 3000);
+    trace_get_histogram(TRACE_STAGE_DECODE, &h);
+    assert(h.count == 1);
+    trace_get_histogram(TRACE_STAGE_PLAYOUT, &h);
+    assert(h.count == 1);
+    trace_get_histogram(TRACE_STAGE_MOUTH_TO_EAR, &h);
+    assert(h.count == 1 && h.min_us >= 5000);
+    trace_print();
+    
+    audio_stop_recording();
+    playback_stop();
+    device_set_state(DEVICE_STATE_IDLE);
+#endif
+    trace_reset();
+    
+    printf("✅ Latency trace test passed\n");
+}
+
+void test_telemetry_report() {
+    uint8_t report[TELEMETRY_REPORT_SIZE];
+    assert(telemetry_build_report(NULL, sizeof(report)) == ARUNIKA_ERROR_INVALID_PARAM);
+    assert(telemetry_build_report(report, sizeof(report) - 1) == ARUNIKA_ERROR_MEMORY);
+    
+    trace_reset();
+    trace_record(TRACE_STAGE_ENCODE, 300);
+    trace_record(TRACE_STAGE_ENCODE, 700);
+    
+    audio_ring_stats_t ring;
+    playback_stats_t playback;
+    websocket_conn_stats_t conn;
+    battery_status_t battery;
+    audio_capture_get_stats(&ring);
+    playback_get_stats(&playback);
+    websocket_get_conn_stats(&conn);
+    power_get_battery_status(&battery);
+    
+    assert(telemetry_build_report(report, sizeof(report)) == TELEMETRY_REPORT_SIZE);
+    assert(report[0] == TELEMETRY_MAGIC && report[1] == TELEMETRY_VERSION);
+    assert(report[2] == FIRMWARE_VERSION_MAJOR && report[3] == FIRMWARE_VERSION_MINOR);
+    assert(report[7] == (uint8_t)battery.mode);
+    assert((report[6] & TELEMETRY_FLAG_CHARGING) == (battery.charging ? TELEMETRY_FLAG_CHARGING : 0));
+    
+    uint32_t ring_overruns = report[12] | report[13] << 8 | report[14] << 16 | (uint32_t)report[15] << 24;
+    uint32_t underruns = report[16] | report[17] << 8 | report[18] << 16 | (uint32_t)report[19] << 24;
+    uint32_t attempts = report[24] | report[25] << 8 | report[26] << 16 | (uint32_t)report[27] << 24;
+    assert(ring_overruns == ring.overruns && underruns == playback.underruns && attempts == conn.attempts);
+    assert((report[36] | report[37] << 8) == battery.voltage_mv);
+    assert(report[48] <= POOL_AUDIO_FRAMES && report[49] <= POOL_WS_FRAMES);
+    
+    // p50 of {300, 700} sits in [256, 512) and p95 in [512, 1024); the
+    // other stages have no samples yet
+    const uint8_t *latency = &report[48 + POOL_COUNT];
+    assert(latency[0] == 8 && latency[1] == 9 && latency[2] == 9);
+    for (int i = 3; i < TRACE_STAGE_COUNT * 3; i++) {
+        assert(latency[i] == TELEMETRY_LATENCY_NONE);
+    }
+    trace_reset();
+    
+    // The report fits a single control frame
+    assert(websocket_send_ping(NULL, 1) == ARUNIKA_ERROR_INVALID_PARAM);
+    uint8_t oversized[WS_MAX_CONTROL_PAYLOAD + 1] = { 0 };
+    assert(websocket_send_ping(oversized, sizeof(oversized)) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    printf("✅ Telemetry report test passed\n");
+}
+
+void test_uplink_batching() {
+    // The target grows with RTT, jitter and write stalls, up to the limit
+    assert(websocket_uplink_batch_target_ms(40, 5, 0) == 25);
+    assert(websocket_uplink_batch_target_ms(120, 20, 30) == 110);
+    assert(websocket_uplink_batch_target_ms(400, 100, 0) == WS_UPLINK_BATCH_MAX_MS);
+    assert(websocket_set_uplink_batch_ms(WS_UPLINK_BATCH_MAX_MS + 1) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    // A pong answering the probe ping gives an RTT sample
+    static uint8_t wire[64];
+    websocket_link_stats_t before, after;
+    assert(audio_set_format(AUDIO_FORMAT_MULAW) == ARUNIKA_OK);
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    websocket_get_link_stats(&before);
+    assert(websocket_send_ping(NULL, 0) == ARUNIKA_OK);
+    assert(websocket_sim_receive(wire, ws_test_frame(wire, true, WS_OPCODE_PONG, "", 0)) == ARUNIKA_OK);
+    assert(ws_test_drain(sizeof(wire)) == 0);
+    websocket_get_link_stats(&after);
+    assert(after.rtt_samples == before.rtt_samples + 1);
+    
+    // On the fast simulated link every frame is its own write
+    static uint8_t payload[AUDIO_CHUNK_SIZE];
+    audio_buffer_t frame = { payload, sizeof(payload), 0, sizeof(payload), SAMPLE_RATE, AUDIO_FORMAT_MULAW, 0 };
+    const uint64_t frame_bytes = 8 + AUDIO_FRAME_HEADER_SIZE + AUDIO_CHUNK_SIZE;
+    websocket_get_link_stats(&before);
+    assert(websocket_send_audio_chunk(&frame, 0, false) == ARUNIKA_OK);
+    assert(websocket_send_audio_chunk(&frame, 1, false) == ARUNIKA_OK);
+    websocket_get_link_stats(&after);
+    assert(after.batch_ms < audio_capture_frame_ms());
+    assert(after.frames_sent == before.frames_sent + 2 && after.flushes == before.flushes + 2);
+    
+    // A 200 ms target holds 64 ms frames back until four are queued, or
+    // fewer when the board's batch buffer fills up first
+    const uint64_t batch_frames = WS_UPLINK_BATCH_SIZE /
+                                  (WS_MAX_HEADER_SIZE + AUDIO_FRAME_HEADER_SIZE + AUDIO_CHUNK_SIZE);
+    assert(websocket_set_uplink_batch_ms(WS_UPLINK_BATCH_MAX_MS) == ARUNIKA_OK);
+    uint64_t tx_before = websocket_get_tx_bytes();
+    websocket_get_link_stats(&before);
+    for (int i = 0; i < 3; i++) {
+        assert(websocket_send_audio_chunk(&frame, 2 + i, false) == ARUNIKA_OK);
+        assert(websocket_flush_audio(false) == ARUNIKA_OK);
+    }
+    assert(websocket_get_tx_bytes() == tx_before);
+    assert(websocket_send_audio_chunk(&frame, 5, false) == ARUNIKA_OK);
+    assert(websocket_get_tx_bytes() == tx_before + (batch_frames < 4 ? batch_frames : 4) * frame_bytes);
+    websocket_get_link_stats(&after);
+    assert(after.frames_sent == before.frames_sent + 4 && after.flushes == before.flushes + 1);
+    
+    // Text messages never overtake queued audio, and is_final ends a batch
+    tx_before = websocket_get_tx_bytes();
+    assert(websocket_send_audio_chunk(&frame, 6, false) == ARUNIKA_OK);
+    assert(websocket_send_listening_end() == ARUNIKA_OK);
+    assert(websocket_get_tx_bytes() > tx_before + frame_bytes);
+    tx_before = websocket_get_tx_bytes();
+    assert(websocket_send_audio_chunk(&frame, 7, false) == ARUNIKA_OK);
+    assert(websocket_send_audio_chunk(&frame, 8, true) == ARUNIKA_OK);
+    assert(websocket_get_tx_bytes() == tx_before + 2 * frame_bytes);
+    
+    // Batched frames stay in the capture ring until they are written, so a
+    // failed flush loses nothing and the next connection sends them again.
+    // At half the ring the batch goes out anyway
+    const uint32_t held = AUDIO_RING_SLOTS / 2 - 1;
+    int16_t pcm[AUDIO_CHUNK_SAMPLES];
+    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; i++) {
+        pcm[i] = (int16_t)((i / 10) % 2 ? 6000 : -6000);
+    }
+    audio_stop_recording();
+    device_process_uplink();
+    device_set_state(DEVICE_STATE_IDLE);
+    assert(device_handle_button_press() == ARUNIKA_OK && device_get_state() == DEVICE_STATE_RECORDING);
+    for (uint32_t i = 0; i < held; i++) {
+        assert(audio_i2s_rx_callback((const uint8_t *)pcm, sizeof(pcm)) == ARUNIKA_OK);
+    }
+    uint32_t written = websocket_uplink_frames_written();
+    assert(device_process_uplink() == ARUNIKA_OK);
+    assert(websocket_uplink_frames_written() == written);
+    audio_ring_stats_t ring;
+    audio_capture_get_stats(&ring);
+    assert(ring.occupancy == held);
+    
+    websocket_sim_fail_write();
+    device_handle_button_press();
+    assert(device_process_uplink() == ARUNIKA_ERROR_WEBSOCKET && !websocket_is_connected());
+    audio_capture_get_stats(&ring);
+    assert(ring.occupancy == held && websocket_uplink_frames_written() == written);
+    
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    assert(device_process_uplink() == ARUNIKA_OK);
+    assert(websocket_uplink_frames_written() == written + held);
+    audio_capture_get_stats(&ring);
+    assert(ring.occupancy == 0);
+    device_set_state(DEVICE_STATE_IDLE);
+    
+    assert(websocket_set_uplink_batch_ms(WS_UPLINK_BATCH_ADAPTIVE) == ARUNIKA_OK);
+    websocket_disconnect();
+    
+    printf("✅ Uplink batching test passed\n");
+}
+
+// Peak of out[from..count)
+static int rs_test_peak(const int16_t *out, int count, int from) {
+    int peak = 0;
+    for (int i = from; i < count; i++) {
+        int v = out[i] < 0 ? -out[i] : out[i];
+        peak = v > peak ? v : peak;
+    }
+    return peak;
+}
+
+void test_resampler() {
+    static int16_t in[2400];
+    static int16_t out[2400];
+    static int16_t split[2400];
+    resampler_t rs;
+    assert(resampler_init(&rs, 8000, 44100) == ARUNIKA_ERROR_INVALID_PARAM);
+    assert(resampler_init(&rs, 8000, 8000) == ARUNIKA_OK && !resampler_active(&rs));
+    
+    // A 1 kHz tone at 24 kHz (recursive oscillator) keeps its level at 8 kHz
+    const double k = 2 * 0.9659258262890683; // 2 cos(2 pi / 24)
+    double y1 = -10000 * 0.25881904510252074, y2 = -10000 * 0.5; // Samples -1 and -2
+    for (int i = 0; i < 2400; i++) {
+        double y = k * y1 - y2;
+        in[i] = (int16_t)y;
+        y2 = y1;
+        y1 = y;
+    }
+    assert(resampler_init(&rs, 24000, 8000) == ARUNIKA_OK && resampler_active(&rs));
+    assert(resampler_output_samples(&rs, 2400) == 800);
+    assert(resampler_process(&rs, in, 2400, out, 799) == ARUNIKA_ERROR_MEMORY);
+    assert(resampler_process(&rs, in, 2400, out, 800) == 800);
+    int peak = rs_test_peak(out, 800, 100);
+    assert(peak > 9000 && peak < 11000);
+    
+    // Frame boundaries do not show in the output
+    resampler_reset(&rs);
+    int produced = 0;
+    for (int done = 0, n = 1; done < 2400; done += n, n = n * 3 % 509 + 1) {
+        n = n < 2400 - done ? n : 2400 - done;
+        produced += resampler_process(&rs, in + done, (size_t)n, split + produced, 800 - produced);
+    }
+    assert(produced == 800 && memcmp(out, split, 800 * sizeof(int16_t)) == 0);
+    
+    // 6 kHz would alias to 2 kHz at 8 kHz; the filter keeps it 40 dB down
+    for (int i = 0; i < 2400; i++) {
+        in[i] = (int16_t)(i % 2 == 0 ? 0 : (i % 4 == 1 ? 10000 : -10000));
+    }
+    resampler_reset(&rs);
+    assert(resampler_process(&rs, in, 2400, out, 800) == 800);
+    assert(rs_test_peak(out, 800, 100) < 100);
+    
+    // Upsampling passes DC unchanged once the history has filled
+    for (int i = 0; i < 400; i++) {
+        in[i] = 10000;
+    }
+    assert(resampler_init(&rs, 8000, 24000) == ARUNIKA_OK);
+    assert(resampler_process(&rs, in, 400, out, 1200) == 1200);
+    for (int i = 100; i < 1200; i++) {
+        assert(out[i] >= 9999 && out[i] <= 10001);
+    }
+    
+    // A 24 kHz response fills the jitter buffer at SAMPLE_RATE
+    playback_stats_t stats;
+    static uint8_t codes[1200];
+    memset(codes, 0x80, sizeof(codes));
+    assert(playback_init(PLAYBACK_PREBUFFER_MS_DEFAULT) == ARUNIKA_OK);
+    assert(playback_start(AUDIO_FORMAT_MULAW, 44100) == ARUNIKA_ERROR_INVALID_PARAM);
+    assert(playback_start(AUDIO_FORMAT_MULAW, 24000) == ARUNIKA_OK);
+    assert(playback_feed(codes, sizeof(codes)) == ARUNIKA_OK);
+    playback_get_stats(&stats);
+    assert(stats.buffered_samples == 400);
+    playback_stop();
+    
+    // The server's device_hello picks the uplink rate; frames get shorter
+    // so a resampled one still fits its slot
+    device_set_state(DEVICE_STATE_IDLE);
+    assert(device_process_incoming_message("{\"type\":\"device_hello\",\"encoding\":\"ALAW\","
+                                           "\"sample_rate\":16000}") == ARUNIKA_OK);
+    assert(audio_get_wire_rate() == 16000 && audio_capture_frame_samples() == AUDIO_CHUNK_SAMPLES / 2);
+    static audio_ring_t ring;
+    audio_ring_init(&ring, SAMPLE_RATE, AUDIO_FORMAT_PCM);
+    audio_buffer_t *frame = audio_ring_acquire(&ring);
+    frame->size = audio_capture_frame_samples() * 2;
+    assert(resampler_init(&rs, SAMPLE_RATE, audio_get_wire_rate()) == ARUNIKA_OK);
+    assert(audio_resample_frame(&rs, frame) == ARUNIKA_OK);
+    assert(frame->size == AUDIO_BUFFER_SIZE && frame->sample_rate == 16000);
+    assert(audio_resample_frame(&rs, frame) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    assert(device_process_incoming_message("{\"type\":\"device_hello\",\"encoding\":\"MULAW\","
+                                           "\"sample_rate\":11025}") == ARUNIKA_OK);
+    assert(audio_get_wire_rate() == SAMPLE_RATE && audio_capture_frame_samples() == AUDIO_CHUNK_SAMPLES);
+    
+    printf("✅ Resampler test passed\n");
+}
+
+void test_board_profile() {
+    // Optional paths are refused, not half-run, on boards that leave them out
+    assert(websocket_get_uplink_mode() == WEBSOCKET_UPLINK_BINARY);
+#ifdef ARUNIKA_JSON_UPLINK
+    assert(websocket_set_uplink_mode(WEBSOCKET_UPLINK_JSON) == ARUNIKA_OK);
+#else
+    assert(websocket_set_uplink_mode(WEBSOCKET_UPLINK_JSON) == ARUNIKA_ERROR_INVALID_PARAM);
+#endif
+    assert(websocket_set_uplink_mode(WEBSOCKET_UPLINK_BINARY) == ARUNIKA_OK);
+    
+    audio_format_t format = audio_get_format();
+#ifdef ARUNIKA_PCM16
+    assert(audio_set_format(AUDIO_FORMAT_PCM) == ARUNIKA_OK);
+    assert(playback_start(AUDIO_FORMAT_PCM, SAMPLE_RATE) == ARUNIKA_OK);
+#else
+    assert(audio_set_format(AUDIO_FORMAT_PCM) == ARUNIKA_ERROR_INVALID_PARAM);
+    assert(playback_start(AUDIO_FORMAT_PCM, SAMPLE_RATE) == ARUNIKA_ERROR_INVALID_PARAM);
+#endif
+    playback_stop();
+    assert(audio_set_format(format) == ARUNIKA_OK);
+    
+    // Sizes the profile picks still meet what the pipeline relies on
+    assert(PLAYBACK_DMA_SAMPLES == I2S_DMA_FRAME_NUM);
+    assert(PLAYBACK_JITTER_SAMPLES > PLAYBACK_PREBUFFER_MAX_MS * SAMPLE_RATE / 1000);
+    assert(WAKEWORD_PREROLL_SAMPLES >= WAKEWORD_LEAD_MS * SAMPLE_RATE / 1000 + AUDIO_CHUNK_SAMPLES);
+    assert(WS_UPLINK_BATCH_SIZE >= WS_MAX_HEADER_SIZE + AUDIO_FRAME_HEADER_SIZE + AUDIO_BUFFER_SIZE);
+    
+    printf("✅ Board profile test passed\n");
+}
+
+// Stores a clip of count mu-law codes straight through the cache API
+static void audio_cache_test_store(const char *key, const char *tag, size_t count) {
+    static uint8_t codes[AUDIO_CHUNK_SAMPLES];
+    for (size_t i = 0; i < sizeof(codes); i++) {
+        codes[i] = (uint8_t)(0x20 + i % 0x5F);
+    }
+    assert(audio_cache_store_begin(key, strlen(key), tag, tag ? strlen(tag) : 0) == ARUNIKA_OK);
+    for (size_t done = 0; done < count; done += AUDIO_CHUNK_SAMPLES) {
+        size_t n = count - done < AUDIO_CHUNK_SAMPLES ? count - done : AUDIO_CHUNK_SAMPLES;
+        audio_cache_store_g711(codes, n, AUDIO_FORMAT_MULAW);
+    }
+    assert(audio_cache_store_commit(NULL, 0) == ARUNIKA_OK);
+}
+
+void test_audio_cache() {
+    // Start from a blank cache region
+    for (uint32_t sector = 0; sector < AUDIO_CACHE_SECTORS; sector++) {
+        assert(flash_erase_sector(AUDIO_CACHE_FIRST_SECTOR + sector) == ARUNIKA_OK);
+    }
+    assert(audio_cache_init() == ARUNIKA_OK);
+    audio_cache_stats_t stats;
+    audio_cache_get_stats(&stats);
+    assert(stats.entries == 0 && stats.sectors_used == 0);
+    
+    // PCM is kept as mu-law and comes back mapped, not copied
+    int16_t pcm[AUDIO_CHUNK_SAMPLES];
+    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; i++) {
+        pcm[i] = (int16_t)((i % 16 - 8) * 1000);
+    }
+    char key[AUDIO_CACHE_KEY_MAX + 1];
+    assert(audio_cache_store_begin("greeting-01", 11, AUDIO_CACHE_TAG_RECONNECTING,
+                                   strlen(AUDIO_CACHE_TAG_RECONNECTING)) == ARUNIKA_OK);
+    assert(audio_cache_storing());
+    audio_cache_store_pcm(pcm, AUDIO_CHUNK_SAMPLES);
+    audio_cache_store_pcm(pcm, AUDIO_CHUNK_SAMPLES);
+    assert(audio_cache_store_commit(key, sizeof(key)) == ARUNIKA_OK);
+    assert(strcmp(key, "greeting-01") == 0 && !audio_cache_storing());
+    
+    audio_buffer_t clip;
+    assert(audio_cache_lookup("greeting-01", 11, &clip) == ARUNIKA_OK);
+    assert(clip.size == 2 * AUDIO_CHUNK_SAMPLES && clip.format == AUDIO_FORMAT_MULAW && clip.sample_rate == SAMPLE_RATE);
+    assert(clip.data[5] == g711_mulaw_encode(pcm[5]) && clip.data[AUDIO_CHUNK_SAMPLES] == g711_mulaw_encode(pcm[0]));
+    assert(audio_cache_lookup("greeting-02", 11, &clip) == ARUNIKA_ERROR_AUDIO);
+    assert(audio_cache_lookup("no spaces", 9, &clip) == ARUNIKA_ERROR_INVALID_PARAM);
+    assert(audio_cache_store_begin("\"quoted\"", 8, NULL, 0) == ARUNIKA_ERROR_INVALID_PARAM);
+    
+    // A store that never commits leaves nothing behind, even after a remount
+    assert(audio_cache_store_begin("torn", 4, NULL, 0) == ARUNIKA_OK);
+    audio_cache_store_pcm(pcm, AUDIO_CHUNK_SAMPLES);
+    audio_cache_store_abort();
+    assert(audio_cache_init() == ARUNIKA_OK);
+    assert(audio_cache_lookup("torn", 4, &clip) == ARUNIKA_ERROR_AUDIO);
+    assert(audio_cache_lookup("greeting-01", 11, &clip) == ARUNIKA_OK);
+    assert(audio_cache_lookup_tag(AUDIO_CACHE_TAG_RECONNECTING, &clip) == ARUNIKA_OK);
+    assert(audio_cache_lookup_tag(AUDIO_CACHE_TAG_LOW_BATTERY, &clip) == ARUNIKA_ERROR_AUDIO);
+    
+    // Least recently used clips make room; a clip played meanwhile stays
+    size_t clip_codes = 3 * FLASH_SECTOR_SIZE;
+    char fill[16];
+    uint32_t stored = 0;
+    do {
+        snprintf(fill, sizeof(fill), "fill-%u", (unsigned)stored++);
+        audio_cache_test_store(fill, NULL, clip_codes);
+        assert(audio_cache_lookup("greeting-01", 11, &clip) == ARUNIKA_OK);
+        audio_cache_get_stats(&stats);
+    } while (stats.evictions == 0 && stored < AUDIO_CACHE_SECTORS);
+    assert(stats.evictions > 0 && stats.sectors_used <= AUDIO_CACHE_SECTORS);
+    assert(audio_cache_lookup("fill-0", 6, &clip) == ARUNIKA_ERROR_AUDIO);
+    assert(audio_cache_lookup("greeting-01", 11, &clip) == ARUNIKA_OK);
+    assert(audio_cache_lookup(fill, strlen(fill), &clip) == ARUNIKA_OK && clip.size == clip_codes);
+    
+    // The hello list carries the most recently used key first
+    char list[64];
+    char expected[64];
+    snprintf(expected, sizeof(expected), "\"%s\",\"greeting-01\"", fill);
+    assert(audio_cache_list_keys(list, sizeof(list)) > 0 && strncmp(list, expected, strlen(expected)) == 0);
+    
+    // speaking_start with a key not cached: play it and store it, then
+    // report it with audio_cached at speaking_end
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    assert(playback_init(PLAYBACK_PREBUFFER_MS_DEFAULT) == ARUNIKA_OK);
+    device_set_state(DEVICE_STATE_IDLE);
+    uint8_t codes[1600];
+    for (size_t i = 0; i < sizeof(codes); i++) {
+        codes[i] = (uint8_t)(0x30 + i % 0x40);
+    }
+    assert(device_process_incoming_message("{\"type\":\"speaking_start\",\"encoding\":\"MULAW\","
+                                           "\"audio_key\":\"ab12\"}") == ARUNIKA_OK);
+    assert(audio_cache_storing() && device_get_state() == DEVICE_STATE_PLAYING);
+    assert(device_process_incoming_audio(codes, sizeof(codes)) == ARUNIKA_OK);
+    uint64_t tx_before = websocket_get_tx_bytes();
+    assert(device_process_incoming_message("{\"type\":\"speaking_end\"}") == ARUNIKA_OK);
+    assert(!audio_cache_storing() && websocket_get_tx_bytes() > tx_before);
+    assert(audio_cache_lookup("ab12", 4, &clip) == ARUNIKA_OK && clip.size == sizeof(codes));
+    playback_stop();
+    audio_stop_recording();
+    device_set_state(DEVICE_STATE_IDLE);
+    
+    // Only the key: the clip plays from flash and ends itself
+    playback_stats_t playback;
+    assert(device_process_incoming_message("{\"type\":\"speaking_start\",\"audio_key\":\"ab12\","
+                                           "\"cached\":true}") == ARUNIKA_OK);
+    playback_get_stats(&playback);
+    assert(device_get_state() == DEVICE_STATE_PLAYING && playback.buffered_samples == sizeof(codes));
+    assert(playback_get_state() == PLAYBACK_STATE_DRAINING);
+    assert(device_process_incoming_audio(codes, sizeof(codes)) == ARUNIKA_OK); // Ignored
+    assert(device_process_incoming_message("{\"type\":\"speaking_end\"}") == ARUNIKA_OK);
+    playback_get_stats(&playback);
+    assert(playback.buffered_samples == sizeof(codes));
+    playback_stop();
+    audio_stop_recording();
+    device_set_state(DEVICE_STATE_IDLE);
+    
+    // A key this doll no longer has is asked for with audio_cache_miss
+    tx_before = websocket_get_tx_bytes();
+    assert(device_process_incoming_message("{\"type\":\"speaking_start\",\"audio_key\":\"gone\","
+                                           "\"cached\":true}") == ARUNIKA_OK);
+    assert(websocket_get_tx_bytes() > tx_before && playback_get_state() == PLAYBACK_STATE_IDLE);
+    assert(device_get_state() == DEVICE_STATE_IDLE);
+    websocket_disconnect();
+    
+    // Tagged clips play without the link
+    assert(device_play_notice(AUDIO_CACHE_TAG_RECONNECTING) == ARUNIKA_OK);
+    assert(device_get_state() == DEVICE_STATE_PLAYING && playback_get_state() != PLAYBACK_STATE_IDLE);
+    playback_stop();
+    audio_stop_recording();
+    device_set_state(DEVICE_STATE_IDLE);
+    assert(device_play_notice(AUDIO_CACHE_TAG_LOW_BATTERY) == ARUNIKA_ERROR_AUDIO);
+    
+    // A clip damaged in flash fails its CRC at the next mount
+    assert(audio_cache_lookup("ab12", 4, &clip) == ARUNIKA_OK);
+    uint8_t zero = 0;
+    assert(clip.data[0] != 0);
+    assert(flash_write((uint32_t)(clip.data - flash_map(0, 1)), &zero, 1) == ARUNIKA_OK);
+    assert(audio_cache_init() == ARUNIKA_OK);
+    assert(audio_cache_lookup("ab12", 4, &clip) == ARUNIKA_ERROR_AUDIO);
+    assert(audio_cache_lookup("greeting-01", 11, &clip) == ARUNIKA_OK);
+    
+    printf("✅ Audio cache test passed\n");
+}
+
+void test_button_early_uplink() {
+    int16_t pcm[AUDIO_CHUNK_SAMPLES];
+    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; i++) {
+        pcm[i] = (int16_t)((i / 10) % 2 ? 6000 : -6000);
+    }
+    
+    // Connected, the button streams through the capture ring as before
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    audio_stop_recording();
+    device_process_uplink();
+    device_set_state(DEVICE_STATE_IDLE);
+    assert(device_handle_button_press() == ARUNIKA_OK);
+    assert(device_get_state() == DEVICE_STATE_RECORDING && !wakeword_preroll_active());
+    device_handle_button_press();
+    device_process_uplink();
+    device_set_state(DEVICE_STATE_IDLE);
+    
+    // With the link down the utterance outgrows the ring and waits in the
+    // pre-roll for the reconnect
+    websocket_disconnect();
+    assert(device_handle_button_press() == ARUNIKA_OK);
+    assert(device_get_state() == DEVICE_STATE_RECORDING && wakeword_get_mode() == WAKEWORD_TRIGGERED);
+    int frames = AUDIO_RING_SLOTS + 4;
+    for (int i = 0; i < frames; i++) {
+        assert(audio_i2s_rx_callback((const uint8_t *)pcm, sizeof(pcm)) == ARUNIKA_OK);
+    }
+    assert(device_process_uplink() == ARUNIKA_OK);
+    audio_ring_stats_t ring;
+    audio_capture_get_stats(&ring);
+    assert(ring.occupancy == 0);
+    assert(wakeword_preroll_available() == (size_t)frames * AUDIO_CHUNK_SAMPLES);
+    
+    // Once connected, everything captured so far goes out with the
+    // listening_start, and capture moves back to the ring
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    uint64_t tx_before = websocket_get_tx_bytes();
+    assert(device_process_uplink() == ARUNIKA_OK);
+    assert(websocket_get_tx_bytes() > tx_before + (uint64_t)frames * AUDIO_CHUNK_SAMPLES / 2);
+    assert(wakeword_preroll_available() < AUDIO_CHUNK_SAMPLES);
+    
+    device_handle_button_press();
+    assert(device_get_state() == DEVICE_STATE_PROCESSING);
+    device_process_uplink();
+    assert(!wakeword_preroll_active());
+    device_set_state(DEVICE_STATE_IDLE);
+    websocket_disconnect();
+    
+    printf("✅ Button early uplink test passed\n");
+}
+
+void test_uplink_link_loss() {
+    int16_t pcm[AUDIO_CHUNK_SAMPLES];
+    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; i++) {
+        pcm[i] = (int16_t)((i / 10) % 2 ? 6000 : -6000);
+    }
+    
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    audio_stop_recording();
+    device_process_uplink();
+    device_set_state(DEVICE_STATE_IDLE);
+    assert(device_handle_button_press() == ARUNIKA_OK && device_get_state() == DEVICE_STATE_RECORDING);
+    assert(audio_i2s_rx_callback((const uint8_t *)pcm, sizeof(pcm)) == ARUNIKA_OK);
+    assert(device_process_uplink() == ARUNIKA_OK);
+    
+    // The server goes away while the rest of the question is queued
+    uint8_t wire[16];
+    assert(websocket_sim_receive(wire, ws_test_frame(wire, true, WS_OPCODE_CLOSE, "", 0)) == ARUNIKA_OK);
+    assert(ws_test_drain(sizeof(wire)) == ARUNIKA_ERROR_WEBSOCKET && !websocket_is_connected());
+    for (int i = 0; i < 3; i++) {
+        assert(audio_i2s_rx_callback((const uint8_t *)pcm, sizeof(pcm)) == ARUNIKA_OK);
+    }
+    device_handle_button_press();
+    assert(device_get_state() == DEVICE_STATE_PROCESSING);
+    assert(device_process_uplink() == ARUNIKA_ERROR_WEBSOCKET);
+    audio_ring_stats_t ring;
+    audio_capture_get_stats(&ring);
+    assert(ring.occupancy == 3);
+    
+    // The reconnect reopens the stream for what is left and closes it; the
+    // new listening_start comes with a probe ping
+    websocket_link_stats_t before, after;
+    assert(websocket_connect("ws://localhost", 8080, "/ws") == ARUNIKA_OK);
+    websocket_get_link_stats(&before);
+    uint64_t tx_before = websocket_get_tx_bytes();
+    assert(device_process_uplink() == ARUNIKA_OK);
+    assert(websocket_get_tx_bytes() > tx_before + 3 * AUDIO_CHUNK_SAMPLES / 2);
+    assert(websocket_sim_receive(wire, ws_test_frame(wire, true, WS_OPCODE_PONG, "", 0)) == ARUNIKA_OK);
+    assert(ws_test_drain(sizeof(wire)) == 0);
+    websocket_get_link_stats(&after);
+    assert(after.rtt_samples == before.rtt_samples + 1);
+    audio_capture_get_stats(&ring);
+    assert(ring.occupancy == 0);
+    tx_before = websocket_get_tx_bytes();
+    assert(device_process_uplink() == ARUNIKA_OK && websocket_get_tx_bytes() == tx_before);
+    
+    device_set_state(DEVICE_STATE_IDLE);
+    websocket_disconnect();
+    
+    printf("✅ Uplink link loss test passed\n");
+}
+
 int main() {
     printf("🧪 Running Arunika firmware tests...\n\n");
     
@@ -86,6 +1929,36 @@ int main() {
     test_power_management();
     test_utility_functions();
     test_base64_encoding();
+    test_base64_decoding();
+    test_audio_ring_buffer();
+    test_websocket_binary_framing();
+    test_websocket_zero_copy_send();
+    test_g711_codec();
+    test_opus_negotiation();
+    test_playback_jitter_buffer();
+    test_event_loop();
+    test_pipeline_tasks();
+    test_voice_activity_detection();
+    test_wake_word_standby();
+    test_websocket_reconnect();
+    test_wifi_fast_connect();
+    test_config_store();
+    test_deep_sleep_resume();
+    test_battery_policy();
+    test_memory_pools();
+    test_json_tokenizer();
+    test_control_messages();
+    test_websocket_reassembly();
+    test_echo_cancellation();
+    test_barge_in();
+    test_latency_trace();
+    test_telemetry_report();
+    test_uplink_batching();
+    test_resampler();
+    test_board_profile();
+    test_audio_cache();
+    test_button_early_uplink();
+    test_uplink_link_loss();
     
     printf("\n🎉 All tests passed!\n");
     return 0;
@@ -330,6 +330,35 @@ func (e *ElevenLabsTTS) SetOutputFormat(format string) {
 	e.logger.Info("Updated output format", zap.String("outputFormat", format))
 }
 
+// AudioFormat names the streamed audio in device protocol terms, so the
+// hub can announce it in speaking_start. Formats a device cannot play
+// raw, such as MP3, report an empty encoding.
+func (e *ElevenLabsTTS) AudioFormat() (encoding string, sampleRate int) {
+	name, rate, found := strings.Cut(e.outputFormat, "_")
+	if !found {
+		return "", 0
+	}
+	sampleRate, err := strconv.Atoi(rate)
+	if err != nil {
+		return "", 0
+	}
+
+	switch name {
+	case "pcm":
+		return "LINEAR16", sampleRate
+	case "ulaw":
+		return "MULAW", sampleRate
+	}
+	return "", 0
+}
+
+// AudioCacheScope names everything besides the text that shapes the
+// audio, so devices never play a clip cached under another voice, model,
+// format or voice settings.
+func (e *ElevenLabsTTS) AudioCacheScope() string {
+	return fmt.Sprintf("elevenlabs/%s/%s/%s/%.2f/%.2f", e.voiceID, e.modelID, e.outputFormat, e.stability, e.clarity)
+}
+
 // NewElevenLabsConfigFromEnv creates a new ElevenLabsConfig from environment variables
 // This is a helper function to simplify the creation of a properly configured ElevenLabsConfig
 func NewElevenLabsConfigFromEnv() ElevenLabsConfig {
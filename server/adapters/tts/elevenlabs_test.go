@@ -152,3 +152,25 @@ func TestElevenLabsTTS_ConvertTextToSpeech_Integration(t *testing.T) {
 
 	t.Logf("Integration test completed: received %d chunks, %d total bytes", chunkCount, totalBytes)
 }
+
+func TestAudioFormat(t *testing.T) {
+	tests := []struct {
+		outputFormat string
+		encoding     string
+		sampleRate   int
+	}{
+		{"pcm_24000", "LINEAR16", 24000},
+		{"ulaw_8000", "MULAW", 8000},
+		{"mp3_44100_128", "", 0},
+		{"pcm", "", 0},
+	}
+
+	for _, tt := range tests {
+		tts := &ElevenLabsTTS{outputFormat: tt.outputFormat}
+		encoding, sampleRate := tts.AudioFormat()
+		if encoding != tt.encoding || sampleRate != tt.sampleRate {
+			t.Errorf("AudioFormat() for %q = %q, %d; want %q, %d",
+				tt.outputFormat, encoding, sampleRate, tt.encoding, tt.sampleRate)
+		}
+	}
+}
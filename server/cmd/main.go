@@ -2,9 +2,11 @@ package main
 
 import (
 	"context"
+	"fmt"
 	"net/http"
 	"os"
 	"os/signal"
+	"strconv"
 	"syscall"
 	"time"
 
@@ -68,6 +70,13 @@ func main() {
 		logger.Warn("Failed to bootstrap demo devices", zap.Error(err))
 	}
 
+	// Devices for the doll fleet simulator (doll-m2 bench_fleet), e.g. SIM_DEVICES=500
+	if count, err := strconv.Atoi(os.Getenv("SIM_DEVICES")); err == nil && count > 0 {
+		if err := bootstrapSimDevices(deviceRepo, count, logger); err != nil {
+			logger.Warn("Failed to bootstrap simulated devices", zap.Error(err))
+		}
+	}
+
 	// Initialize WebSocket hub with conversation service
 	hub := websocket.NewHub(geminiLLMRepo, ttsRepo, sttRepo, sessionRepo, logger)
 	go hub.Run()
@@ -149,3 +158,26 @@ func bootstrapDemoDevices(deviceRepo *adapters.MemoryDeviceRepository, logger *z
 
 	return nil
 }
+
+// bootstrapSimDevices registers the devices the fleet simulator logs in as:
+// SIM00001, SIM00002, ... each with the secret "<serial>-secret"
+func bootstrapSimDevices(deviceRepo *adapters.MemoryDeviceRepository, count int, logger *zap.Logger) error {
+	ctx := context.Background()
+
+	for i := 1; i <= count; i++ {
+		serialNumber := fmt.Sprintf("SIM%05d", i)
+		device := &entities.Device{
+			SerialNumber: serialNumber,
+			Model:        "doll-sim",
+		}
+		if err := deviceRepo.Create(ctx, device); err != nil {
+			return err
+		}
+		if err := deviceRepo.RegisterDeviceSecret(serialNumber, serialNumber+"-secret"); err != nil {
+			return err
+		}
+	}
+
+	logger.Info("Bootstrapped simulated devices", zap.Int("count", count))
+	return nil
+}
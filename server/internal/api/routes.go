@@ -42,6 +42,21 @@ func InitRoutes(e *echo.Echo, hub *websocket.Hub, deviceRepo repositories.Device
 	// Conversation History APIs
 	v1.GET("/conversations", getConversations)
 
+	// Fleet telemetry from device keepalive pings
+	v1.GET("/telemetry", func(c echo.Context) error {
+		return c.JSON(http.StatusOK, hub.FleetTelemetry())
+	})
+	v1.GET("/telemetry/:device_id", func(c echo.Context) error {
+		device, ok := hub.DeviceTelemetry(c.Param("device_id"))
+		if !ok {
+			return c.JSON(http.StatusNotFound, ErrorResponse{
+				Error:   "not_found",
+				Message: "No telemetry for this device",
+			})
+		}
+		return c.JSON(http.StatusOK, device)
+	})
+
 	// WebSocket endpoint with JWT validation
 	e.GET("/ws", func(c echo.Context) error {
 		return websocketWithAuth(hub, c, logger)
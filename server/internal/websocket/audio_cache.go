@@ -0,0 +1,124 @@
+package websocket
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"strings"
+	"sync"
+
+	"github.com/satriahrh/arunika/server/domain/entities"
+)
+
+// Devices keep repeated responses in a flash cache. The server names each
+// response by a hash of its text and of everything else that shapes the
+// audio, offers that key in speaking_start, and once the device reports
+// the clip as cached sends only the key the next time the phrase comes up.
+
+// audioKeyLength is the hex prefix of the hash that is sent; it must stay
+// within the firmware's AUDIO_CACHE_KEY_MAX.
+const audioKeyLength = 32
+
+// audioCacheRepeats is how often a phrase has to be spoken, across all
+// devices, before devices are asked to keep it. One-off answers would only
+// evict clips that are worth keeping.
+const audioCacheRepeats = 2
+
+// audioCacheTrackedPhrases bounds the phrase counts; they start over once
+// it is reached.
+const audioCacheTrackedPhrases = 4096
+
+// audioCacheScoper is implemented by TTS adapters whose audio depends on
+// more than the text, such as the voice, model or output format. The scope
+// goes into every key, so changing any of them invalidates cached clips.
+type audioCacheScoper interface {
+	AudioCacheScope() string
+}
+
+// audioCacheKey derives the device cache key of a spoken text.
+func audioCacheKey(scope, text string) string {
+	sum := sha256.Sum256([]byte(scope + "\x00" + strings.TrimSpace(text)))
+	return hex.EncodeToString(sum[:])[:audioKeyLength]
+}
+
+// phraseCounter counts how often each response key has been spoken.
+type phraseCounter struct {
+	mu     sync.Mutex
+	counts map[string]int
+}
+
+func newPhraseCounter() *phraseCounter {
+	return &phraseCounter{counts: make(map[string]int)}
+}
+
+// spoken records one more use of key and reports whether it is now worth
+// caching on devices.
+func (p *phraseCounter) spoken(key string) bool {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+
+	if _, ok := p.counts[key]; !ok && len(p.counts) >= audioCacheTrackedPhrases {
+		p.counts = make(map[string]int)
+	}
+	p.counts[key]++
+	return p.counts[key] >= audioCacheRepeats
+}
+
+// deviceAudioCache is the server's view of one device's cached clips,
+// learned from device_hello and audio_cached. The response behind each
+// key sent without audio is kept until the device misses it or says hello
+// again, so at most one per cached key.
+type deviceAudioCache struct {
+	mu      sync.Mutex
+	keys    map[string]struct{}
+	pending map[string]entities.Message
+}
+
+func newDeviceAudioCache() *deviceAudioCache {
+	return &deviceAudioCache{
+		keys:    make(map[string]struct{}),
+		pending: make(map[string]entities.Message),
+	}
+}
+
+// reset replaces the known keys with the device_hello list.
+func (d *deviceAudioCache) reset(keys []string) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+
+	d.keys = make(map[string]struct{}, len(keys))
+	for _, key := range keys {
+		d.keys[key] = struct{}{}
+	}
+	d.pending = make(map[string]entities.Message)
+}
+
+func (d *deviceAudioCache) add(key string) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	d.keys[key] = struct{}{}
+}
+
+// sendKeyOnly reports whether the device has key, remembering the response
+// so its audio can still be streamed if the device turns out not to.
+func (d *deviceAudioCache) sendKeyOnly(key string, response entities.Message) bool {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+
+	if _, ok := d.keys[key]; !ok {
+		return false
+	}
+	d.pending[key] = response
+	return true
+}
+
+// miss forgets a key the device no longer has and returns the response
+// it was sent for, if any.
+func (d *deviceAudioCache) miss(key string) (entities.Message, bool) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+
+	delete(d.keys, key)
+	response, ok := d.pending[key]
+	delete(d.pending, key)
+	return response, ok
+}
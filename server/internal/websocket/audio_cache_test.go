@@ -0,0 +1,88 @@
+package websocket
+
+import (
+	"testing"
+
+	"github.com/satriahrh/arunika/server/domain/entities"
+)
+
+func TestAudioCacheKey(t *testing.T) {
+	base := audioCacheKey("voice-a", "Hello there!")
+
+	tests := []struct {
+		name  string
+		scope string
+		text  string
+		same  bool
+	}{
+		{"same phrase", "voice-a", "Hello there!", true},
+		{"surrounding space ignored", "voice-a", "  Hello there!\n", true},
+		{"other text", "voice-a", "Hello there?", false},
+		{"other voice", "voice-b", "Hello there!", false},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			key := audioCacheKey(tt.scope, tt.text)
+			if len(key) != audioKeyLength {
+				t.Errorf("audioCacheKey(%q, %q) has length %d, want %d", tt.scope, tt.text, len(key), audioKeyLength)
+			}
+			if (key == base) != tt.same {
+				t.Errorf("audioCacheKey(%q, %q) = %q, base %q, want same=%v", tt.scope, tt.text, key, base, tt.same)
+			}
+		})
+	}
+}
+
+func TestPhraseCounter(t *testing.T) {
+	p := newPhraseCounter()
+	for i := 1; i < audioCacheRepeats; i++ {
+		if p.spoken("greeting") {
+			t.Fatalf("spoken %d times, want not worth caching before %d", i, audioCacheRepeats)
+		}
+	}
+	if !p.spoken("greeting") {
+		t.Errorf("spoken %d times, want worth caching", audioCacheRepeats)
+	}
+	if p.spoken("answer") {
+		t.Errorf("new phrase worth caching on first use")
+	}
+}
+
+func TestDeviceAudioCache(t *testing.T) {
+	response := entities.Message{Role: entities.DollRole, Content: "Hi!"}
+
+	tests := []struct {
+		name     string
+		hello    []string
+		cached   []string
+		key      string
+		keyOnly  bool
+		restream bool
+	}{
+		{"listed in device_hello", []string{"k1", "k2"}, nil, "k2", true, true},
+		{"reported with audio_cached", nil, []string{"k3"}, "k3", true, true},
+		{"unknown key is streamed", []string{"k1"}, nil, "k9", false, false},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			d := newDeviceAudioCache()
+			d.reset(tt.hello)
+			for _, key := range tt.cached {
+				d.add(key)
+			}
+
+			if got := d.sendKeyOnly(tt.key, response); got != tt.keyOnly {
+				t.Fatalf("sendKeyOnly(%q) = %v, want %v", tt.key, got, tt.keyOnly)
+			}
+			got, ok := d.miss(tt.key)
+			if ok != tt.restream || (ok && got.Content != response.Content) {
+				t.Errorf("miss(%q) = %q, %v, want restream=%v", tt.key, got.Content, ok, tt.restream)
+			}
+			if d.sendKeyOnly(tt.key, response) {
+				t.Errorf("sendKeyOnly(%q) after a miss = true, want false", tt.key)
+			}
+		})
+	}
+}
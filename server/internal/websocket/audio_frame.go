@@ -0,0 +1,53 @@
+package websocket
+
+import "encoding/binary"
+
+// Binary audio frames sent by the doll firmware carry a fixed header
+// followed by the raw codec payload:
+//
+//	magic(1) version(1) codec(1) flags(1) sequence(4 LE) timestamp_ms(4 LE)
+//
+// Frames without the magic byte are treated as raw audio for older clients.
+const (
+	audioFrameMagic      = 0xA5
+	audioFrameVersion    = 1
+	audioFrameHeaderSize = 12
+
+	audioFrameFlagFinal = 0x01
+)
+
+// Codec identifiers, matching audio_format_t in the firmware
+const (
+	audioCodecPCM   = 0
+	audioCodecMulaw = 1
+	audioCodecAlaw  = 2
+	audioCodecOpus  = 3
+)
+
+type audioFrameHeader struct {
+	Codec       uint8
+	Flags       uint8
+	Sequence    uint32
+	TimestampMs uint32
+}
+
+// IsFinal reports whether this is the last frame of the utterance
+func (h audioFrameHeader) IsFinal() bool {
+	return h.Flags&audioFrameFlagFinal != 0
+}
+
+// parseAudioFrame splits a binary message into its header and payload.
+// ok is false when the message does not start with a known header.
+func parseAudioFrame(data []byte) (header audioFrameHeader, payload []byte, ok bool) {
+	if len(data) < audioFrameHeaderSize || data[0] != audioFrameMagic || data[1] != audioFrameVersion {
+		return audioFrameHeader{}, data, false
+	}
+
+	header = audioFrameHeader{
+		Codec:       data[2],
+		Flags:       data[3],
+		Sequence:    binary.LittleEndian.Uint32(data[4:8]),
+		TimestampMs: binary.LittleEndian.Uint32(data[8:12]),
+	}
+	return header, data[audioFrameHeaderSize:], true
+}
@@ -0,0 +1,47 @@
+package websocket
+
+import (
+	"bytes"
+	"testing"
+)
+
+func TestParseAudioFrame(t *testing.T) {
+	payload := []byte{0xFF, 0x7F, 0x00}
+	data := append([]byte{
+		audioFrameMagic, audioFrameVersion, audioCodecMulaw, audioFrameFlagFinal,
+		0x04, 0x03, 0x02, 0x01,
+		0xD0, 0xC0, 0xB0, 0xA0,
+	}, payload...)
+
+	header, got, ok := parseAudioFrame(data)
+	if !ok {
+		t.Fatal("expected header to be parsed")
+	}
+	if header.Codec != audioCodecMulaw {
+		t.Errorf("codec = %d, want %d", header.Codec, audioCodecMulaw)
+	}
+	if header.Sequence != 0x01020304 {
+		t.Errorf("sequence = %#x, want 0x01020304", header.Sequence)
+	}
+	if header.TimestampMs != 0xA0B0C0D0 {
+		t.Errorf("timestamp = %#x, want 0xa0b0c0d0", header.TimestampMs)
+	}
+	if !header.IsFinal() {
+		t.Error("expected final flag")
+	}
+	if !bytes.Equal(got, payload) {
+		t.Errorf("payload = %v, want %v", got, payload)
+	}
+}
+
+func TestParseAudioFrameRawAudio(t *testing.T) {
+	raw := []byte{0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D}
+
+	_, got, ok := parseAudioFrame(raw)
+	if ok {
+		t.Fatal("raw audio must not be parsed as a framed chunk")
+	}
+	if !bytes.Equal(got, raw) {
+		t.Error("raw audio must be passed through unchanged")
+	}
+}
@@ -3,7 +3,7 @@ package websocket
 import (
 	"context"
 	"encoding/json"
-	"fmt"
+	"net"
 	"net/http"
 	"os"
 	"path/filepath"
@@ -60,6 +60,12 @@ type Hub struct {
 	sttRepo     repositories.SpeechToText
 	sessionRepo repositories.SessionRepository
 
+	// Latest stats pushed by each device in its keepalive pings
+	telemetry *telemetryStore
+
+	// How often each response has been spoken, to pick what devices cache
+	phrases *phraseCounter
+
 	logger *zap.Logger
 }
 
@@ -79,10 +85,22 @@ func NewHub(
 		ttsRepo:     ttsRepo,
 		sttRepo:     sttRepo,
 		sessionRepo: sessionRepo,
+		telemetry:   newTelemetryStore(),
+		phrases:     newPhraseCounter(),
 		logger:      logger,
 	}
 }
 
+// DeviceTelemetry returns the aggregated stats of one device
+func (h *Hub) DeviceTelemetry(deviceID string) (DeviceTelemetry, bool) {
+	return h.telemetry.device(deviceID)
+}
+
+// FleetTelemetry summarizes device stats per firmware release
+func (h *Hub) FleetTelemetry() []FirmwareTelemetry {
+	return h.telemetry.fleet()
+}
+
 // Run starts the hub's main loop
 func (h *Hub) Run() {
 	for {
@@ -131,11 +149,21 @@ type Client struct {
 	// Audio streaming session management
 	session      *entities.Session
 	sttStreaming repositories.SpeechToTextStreaming
+	uplink       uplinkConverter // nil when STT takes the wire encoding
 	chatSession  repositories.ChatSession
 
 	chunkCount     int
+	nextSequence   uint32
 	listeningStart time.Time
 
+	// Response audio clips the device keeps in flash
+	audioCache *deviceAudioCache
+
+	// The response being generated or spoken, cancelled on barge-in or
+	// when the next one starts
+	responseCtx    context.Context
+	responseCancel context.CancelFunc
+
 	mutex sync.Mutex
 }
 
@@ -154,11 +182,12 @@ func HandleWebSocket(hub *Hub, c echo.Context, logger *zap.Logger) error {
 	}
 
 	client := &Client{
-		hub:      hub,
-		conn:     conn,
-		send:     make(chan WriteData, 256),
-		deviceID: deviceID,
-		logger:   logger,
+		hub:        hub,
+		conn:       conn,
+		send:       make(chan WriteData, 256),
+		deviceID:   deviceID,
+		logger:     logger,
+		audioCache: newDeviceAudioCache(),
 	}
 
 	client.hub.register <- client
@@ -180,11 +209,12 @@ func HandleWebSocketWithAuth(hub *Hub, c echo.Context, deviceID string, logger *
 	}
 
 	client := &Client{
-		hub:      hub,
-		conn:     conn,
-		send:     make(chan WriteData, 256),
-		deviceID: deviceID,
-		logger:   logger,
+		hub:        hub,
+		conn:       conn,
+		send:       make(chan WriteData, 256),
+		deviceID:   deviceID,
+		logger:     logger,
+		audioCache: newDeviceAudioCache(),
 	}
 
 	client.hub.register <- client
@@ -210,6 +240,7 @@ func (c *Client) readPump() {
 		c.conn.SetReadDeadline(time.Now().Add(pongWait))
 		return nil
 	})
+	c.conn.SetPingHandler(c.handlePing)
 
 	for {
 		messageType, message, err := c.conn.ReadMessage()
@@ -234,6 +265,28 @@ func (c *Client) readPump() {
 	}
 }
 
+// handlePing records the telemetry report the device sends as ping data,
+// then answers like the default handler: a pong echoing the data.
+func (c *Client) handlePing(appData string) error {
+	c.conn.SetReadDeadline(time.Now().Add(pongWait))
+	if report, ok := parseTelemetry([]byte(appData)); ok {
+		c.hub.telemetry.record(c.deviceID, report, time.Now())
+		c.logger.Debug("Device telemetry",
+			zap.String("deviceID", c.deviceID),
+			zap.String("firmware", report.Firmware),
+			zap.Uint32("uptimeS", report.UptimeS),
+			zap.Uint32("jitterUnderruns", report.JitterUnderruns))
+	}
+
+	err := c.conn.WriteControl(websocket.PongMessage, []byte(appData), time.Now().Add(writeWait))
+	if err == websocket.ErrCloseSent {
+		return nil
+	} else if _, ok := err.(net.Error); ok {
+		return nil
+	}
+	return err
+}
+
 // writePump pumps messages from the hub to the websocket connection.
 func (c *Client) writePump() {
 	ticker := time.NewTicker(pingPeriod)
@@ -285,6 +338,16 @@ func (c *Client) processMessage(message []byte) {
 		c.handleListeningStart(msg)
 	case "listening_end":
 		c.handleListeningEnd(msg)
+	case "device_hello":
+		c.handleDeviceHello(msg)
+	case "audio_cached":
+		if key, ok := msg["audio_key"].(string); ok {
+			c.audioCache.add(key)
+		}
+	case "audio_cache_miss":
+		c.handleAudioCacheMiss(msg)
+	case "response_cancel":
+		c.cancelResponse()
 	default:
 		c.logger.Warn("Unknown message type", zap.String("type", msgType))
 	}
@@ -296,6 +359,8 @@ func (c *Client) processBinaryAudioChunk(data []byte) {
 	// In a full implementation, you'd extract session ID from binary headers
 	// or track the current active session per device
 
+	header, payload, framed := parseAudioFrame(data)
+
 	c.mutex.Lock()
 	defer c.mutex.Unlock()
 
@@ -314,9 +379,21 @@ func (c *Client) processBinaryAudioChunk(data []byte) {
 
 	// Update session counters
 	c.chunkCount++
+	if framed {
+		if header.Sequence != c.nextSequence {
+			c.logger.Warn("Audio chunk sequence gap",
+				zap.String("deviceID", c.deviceID),
+				zap.Uint32("expected", c.nextSequence),
+				zap.Uint32("received", header.Sequence))
+		}
+		c.nextSequence = header.Sequence + 1
+	}
 
 	// Stream audio data to the speech-to-text service
-	if err := c.sttStreaming.Stream(data); err != nil {
+	if c.uplink != nil {
+		payload = c.uplink.convert(payload, framed && header.IsFinal())
+	}
+	if err := c.sttStreaming.Stream(payload); err != nil {
 		c.logger.Error("Failed to stream audio data",
 			zap.String("sessionID", c.session.ID),
 			zap.Error(err))
@@ -327,36 +404,81 @@ func (c *Client) processBinaryAudioChunk(data []byte) {
 	c.logger.Debug("Received binary audio chunk and processed",
 		zap.String("deviceID", c.deviceID),
 		zap.Int("chunkCount", c.chunkCount),
-		zap.Int("size", len(data)))
+		zap.Int("size", len(payload)),
+		zap.Bool("final", framed && header.IsFinal()))
+
+	// The device flags the last frame of an utterance, so transcription can
+	// be closed without waiting for its listening_end
+	if framed && header.IsFinal() {
+		c.endUtterance()
+	}
 }
 
-// handleListeningStart handles the start of an audio streaming session
-func (c *Client) handleListeningStart(msg map[string]interface{}) {
+// handleDeviceHello answers the device's connect-time codec offer with the
+// encoding it should use for uplink audio
+func (c *Client) handleDeviceHello(msg map[string]interface{}) {
+	var offered []string
+	if encodings, ok := msg["encodings"].([]interface{}); ok {
+		for _, encoding := range encodings {
+			if name, ok := encoding.(string); ok {
+				offered = append(offered, name)
+			}
+		}
+	}
+
+	encoding := negotiateAudioEncoding(offered)
+
+	// A new connection starts from what is in the device's flash
+	var cached []string
+	if keys, ok := msg["cached_audio"].([]interface{}); ok {
+		for _, key := range keys {
+			if name, ok := key.(string); ok {
+				cached = append(cached, name)
+			}
+		}
+	}
+	c.audioCache.reset(cached)
+
+	c.logger.Info("Negotiated audio encoding",
+		zap.String("deviceID", c.deviceID),
+		zap.Strings("offered", offered),
+		zap.String("encoding", encoding))
+
+	response := map[string]interface{}{
+		"type":     "device_hello",
+		"encoding": encoding,
+	}
+	if sampleRate, ok := msg["sample_rate"].(float64); ok {
+		response["sample_rate"] = int(sampleRate)
+	}
+
+	// Look the conversation up now rather than at listening_start, which is
+	// on the path of the first audio frame. A failure here is retried there
 	ctx, cancel := context.WithTimeout(context.Background(), 5*time.Minute)
 	defer cancel()
-
 	c.mutex.Lock()
-	defer c.mutex.Unlock()
-	c.chunkCount = 0
-	c.listeningStart = time.Now()
-
-	var response map[string]interface{} = map[string]interface{}{
-		"type":      "listening_start",
-		"timestamp": c.listeningStart.Unix(),
+	if c.prepareSession(ctx) == "" {
+		response["session_id"] = c.session.ID
 	}
+	c.mutex.Unlock()
 
-	defer func() {
-		responseBytes, _ := json.Marshal(response)
-		select {
-		case c.send <- WriteData{
-			Type:    websocket.TextMessage,
-			Payload: responseBytes,
-		}:
-		default:
-			close(c.send)
-		}
-	}()
+	responseBytes, _ := json.Marshal(response)
+	select {
+	case c.send <- WriteData{
+		Type:    websocket.TextMessage,
+		Payload: responseBytes,
+	}:
+	default:
+		close(c.send)
+	}
+}
 
+// prepareSession loads or creates the device's conversation and its chat
+// session. device_hello runs it at connect, so a listening_start only has
+// to open the STT stream before the first audio frame can be used. It
+// returns "" on success, otherwise the error for the reply. Called with
+// c.mutex held.
+func (c *Client) prepareSession(ctx context.Context) string {
 	var err error
 	if c.session == nil {
 		c.session, err = c.hub.sessionRepo.GetLastByDeviceID(ctx, c.deviceID)
@@ -364,8 +486,7 @@ func (c *Client) handleListeningStart(msg map[string]interface{}) {
 			c.logger.Error("Failed to get last session by device ID",
 				zap.String("deviceID", c.deviceID),
 				zap.Error(err))
-			response["error"] = "failed to get last session"
-			return
+			return "failed to get last session"
 		}
 	}
 	if c.session == nil || !c.session.CanContinueThisSession() {
@@ -377,23 +498,56 @@ func (c *Client) handleListeningStart(msg map[string]interface{}) {
 			c.logger.Error("Failed to create new session",
 				zap.String("deviceID", c.deviceID),
 				zap.Error(err))
-			response["error"] = "failed to create new session"
-			return
+			return "failed to create new session"
 		}
 	}
 
-	response["session_id"] = c.session.ID
-
 	if c.chatSession == nil {
 		c.chatSession, err = c.hub.llm.GenerateChat(ctx, c.session.Messages)
 		if err != nil {
 			c.logger.Error("Failed to create chat session",
 				zap.String("deviceID", c.deviceID),
 				zap.Error(err))
-			response["error"] = "failed to create chat session"
-			return
+			return "failed to create chat session"
 		}
 	}
+	return ""
+}
+
+// handleListeningStart handles the start of an audio streaming session
+func (c *Client) handleListeningStart(msg map[string]interface{}) {
+	ctx, cancel := context.WithTimeout(context.Background(), 5*time.Minute)
+	defer cancel()
+
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	c.chunkCount = 0
+	c.nextSequence = 0
+	c.listeningStart = time.Now()
+
+	var response map[string]interface{} = map[string]interface{}{
+		"type":      "listening_start",
+		"timestamp": c.listeningStart.Unix(),
+	}
+
+	defer func() {
+		responseBytes, _ := json.Marshal(response)
+		select {
+		case c.send <- WriteData{
+			Type:    websocket.TextMessage,
+			Payload: responseBytes,
+		}:
+		default:
+			close(c.send)
+		}
+	}()
+
+	// Normally done at device_hello already
+	if reason := c.prepareSession(ctx); reason != "" {
+		response["error"] = reason
+		return
+	}
+	response["session_id"] = c.session.ID
 
 	audioConfig := repositories.AudioConfig{
 		SampleRate: 48000,
@@ -409,7 +563,9 @@ func (c *Client) handleListeningStart(msg map[string]interface{}) {
 	if v, ok := msg["encoding"].(string); ok && v != "" {
 		audioConfig.Encoding = v
 	}
+	c.uplink, audioConfig.Encoding = newUplinkConverter(audioConfig.Encoding, audioConfig.SampleRate)
 
+	var err error
 	c.sttStreaming, err = c.hub.sttRepo.InitTranscribeStreaming(context.Background(), audioConfig)
 	if err != nil {
 		c.logger.Error("Failed to initialize streaming transcription",
@@ -426,11 +582,21 @@ func (c *Client) handleListeningStart(msg map[string]interface{}) {
 	response["message"] = "listening started"
 }
 
-// handleListeningEnd handles the end of an audio streaming session
+// handleListeningEnd handles the end of an audio streaming session. The
+// frame flagged is_final usually ended it already
 func (c *Client) handleListeningEnd(msg map[string]interface{}) {
 	c.mutex.Lock()
 	defer c.mutex.Unlock()
 
+	if c.sttStreaming == nil {
+		return
+	}
+	c.endUtterance()
+}
+
+// endUtterance closes the STT stream and starts the response while the
+// device is still sending listening_end. Called with c.mutex held.
+func (c *Client) endUtterance() {
 	var response map[string]interface{} = map[string]interface{}{
 		"type":       "listening_end",
 		"session_id": c.session.ID,
@@ -451,6 +617,7 @@ func (c *Client) handleListeningEnd(msg map[string]interface{}) {
 	var finalTranscription string
 	var err error
 	finalTranscription, err = c.sttStreaming.End()
+	c.sttStreaming = nil
 	if err != nil {
 		c.logger.Error("Failed to end transcription stream",
 			zap.String("deviceID", c.deviceID),
@@ -478,13 +645,46 @@ func (c *Client) handleListeningEnd(msg map[string]interface{}) {
 	c.logger.Info("Starting audio response goroutine",
 		zap.String("deviceID", c.deviceID),
 		zap.String("sessionID", c.session.ID))
+}
+
+// beginResponse gives a new response its context, cancelling the one
+// still running, if any
+func (c *Client) beginResponse(timeout time.Duration) (context.Context, context.CancelFunc) {
+	ctx, cancel := context.WithTimeout(context.Background(), timeout)
+
+	c.mutex.Lock()
+	if c.responseCancel != nil {
+		c.responseCancel()
+	}
+	c.responseCtx, c.responseCancel = ctx, cancel
+	c.mutex.Unlock()
+
+	return ctx, func() {
+		cancel()
+		c.mutex.Lock()
+		if c.responseCtx == ctx {
+			c.responseCtx, c.responseCancel = nil, nil
+		}
+		c.mutex.Unlock()
+	}
+}
+
+// cancelResponse stops the current response: the device barged in and
+// dropped what it was playing
+func (c *Client) cancelResponse() {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
 
-	fmt.Println("Adding user message to session:", msg)
+	if c.responseCancel != nil {
+		c.logger.Info("Response cancelled by device", zap.String("deviceID", c.deviceID))
+		c.responseCancel()
+		c.responseCtx, c.responseCancel = nil, nil
+	}
 }
 
 func (c *Client) responseAudio(message entities.Message) {
-	ctx, cancel := context.WithTimeout(context.Background(), 60*time.Second)
-	defer cancel()
+	ctx, done := c.beginResponse(60 * time.Second)
+	defer done()
 
 	chatResponse, err := c.chatSession.SendMessage(ctx, message)
 	if err != nil {
@@ -500,6 +700,65 @@ func (c *Client) responseAudio(message entities.Message) {
 		zap.String("sessionID", c.session.ID),
 		zap.String("response", chatResponse.Content))
 
+	c.speak(ctx, chatResponse)
+
+	// The device only heard part of it, if anything
+	if ctx.Err() == context.Canceled {
+		return
+	}
+
+	c.session.AddMessage(func(s *entities.Session) error {
+		ctx, cancel := context.WithTimeout(context.Background(), 5*time.Second)
+		defer cancel()
+		err := c.hub.sessionRepo.Update(ctx, s)
+		if err != nil {
+			c.logger.Error("Failed to update session with new messages",
+				zap.String("deviceID", c.deviceID),
+				zap.String("sessionID", c.session.ID),
+				zap.Error(err))
+			return err
+		}
+		return nil
+	}, message, chatResponse)
+}
+
+// audioKey returns the cache key to offer with a response, or "" while
+// the phrase is not common enough to be worth a device's flash
+func (c *Client) audioKey(text string) string {
+	scope := ""
+	if tts, ok := c.hub.ttsRepo.(audioCacheScoper); ok {
+		scope = tts.AudioCacheScope()
+	}
+	key := audioCacheKey(scope, text)
+	if !c.hub.phrases.spoken(key) {
+		return ""
+	}
+	return key
+}
+
+// speak sends a response to the device: just its key when the device has
+// the clip cached, otherwise the TTS audio between speaking_start and
+// speaking_end
+func (c *Client) speak(ctx context.Context, chatResponse entities.Message) {
+	key := c.audioKey(chatResponse.Content)
+	if key != "" && c.audioCache.sendKeyOnly(key, chatResponse) {
+		c.logger.Info("Response audio cached on device",
+			zap.String("deviceID", c.deviceID),
+			zap.String("audioKey", key))
+		c.sendSpeaking(map[string]interface{}{
+			"type":       "speaking_start",
+			"session_id": c.session.ID,
+			"chat":       chatResponse,
+			"audio_key":  key,
+			"cached":     true,
+		})
+		c.sendSpeakingEnd()
+		return
+	}
+	c.streamSpeech(ctx, chatResponse, key)
+}
+
+func (c *Client) streamSpeech(ctx context.Context, chatResponse entities.Message, key string) {
 	audioDataChan, err := c.hub.ttsRepo.ConvertTextToSpeech(ctx, chatResponse.Content)
 	if err != nil {
 		c.logger.Error("Failed to convert text to speech",
@@ -509,49 +768,84 @@ func (c *Client) responseAudio(message entities.Message) {
 		return
 	}
 
-	c.send <- WriteData{
-		Type: websocket.TextMessage,
-		Payload: func() []byte {
-			responseBytes, _ := json.Marshal(map[string]interface{}{
-				"type":       "speaking_start",
-				"session_id": c.session.ID,
-				"chat":       chatResponse,
-			})
-			return responseBytes
-		}(),
-	}
-	for audioData := range audioDataChan {
-		c.send <- WriteData{
+	start := map[string]interface{}{
+		"type":       "speaking_start",
+		"session_id": c.session.ID,
+		"chat":       chatResponse,
+	}
+	// The device resamples the stream itself, so no transcode here
+	if tts, ok := c.hub.ttsRepo.(audioFormatter); ok {
+		if encoding, sampleRate := tts.AudioFormat(); encoding != "" {
+			start["encoding"] = encoding
+			start["sample_rate"] = sampleRate
+		}
+	}
+	// The device stores a keyed response and reports it with audio_cached
+	if key != "" {
+		start["audio_key"] = key
+	}
+	c.sendSpeaking(start)
+	for {
+		var audioData []byte
+		ok := false
+		select {
+		case audioData, ok = <-audioDataChan:
+		case <-ctx.Done():
+		}
+		if !ok || ctx.Err() != nil {
+			break
+		}
+		select {
+		case c.send <- WriteData{
 			Type:    websocket.BinaryMessage,
 			Payload: audioData,
+		}:
+		case <-ctx.Done():
 		}
 	}
 
+	// A cancelled response ends on the device already; a speaking_end now
+	// would land in its next turn
+	if ctx.Err() == context.Canceled {
+		return
+	}
+	c.sendSpeakingEnd()
+}
+
+func (c *Client) sendSpeaking(message map[string]interface{}) {
+	responseBytes, _ := json.Marshal(message)
 	c.send <- WriteData{
-		Type: websocket.TextMessage,
-		Payload: func() []byte {
-			responseBytes, _ := json.Marshal(map[string]interface{}{
-				"type":       "speaking_end",
-				"session_id": c.session.ID,
-				"timestamp":  time.Now().Unix(),
-			})
-			return responseBytes
-		}(),
+		Type:    websocket.TextMessage,
+		Payload: responseBytes,
 	}
+}
 
-	c.session.AddMessage(func(s *entities.Session) error {
-		ctx, cancel := context.WithTimeout(context.Background(), 5*time.Second)
-		defer cancel()
-		err := c.hub.sessionRepo.Update(ctx, s)
-		if err != nil {
-			c.logger.Error("Failed to update session with new messages",
-				zap.String("deviceID", c.deviceID),
-				zap.String("sessionID", c.session.ID),
-				zap.Error(err))
-			return err
-		}
-		return nil
-	}, message, chatResponse)
+func (c *Client) sendSpeakingEnd() {
+	c.sendSpeaking(map[string]interface{}{
+		"type":       "speaking_end",
+		"session_id": c.session.ID,
+		"timestamp":  time.Now().Unix(),
+	})
+}
+
+// handleAudioCacheMiss streams the audio of a response sent by key to a
+// device that no longer has the clip
+func (c *Client) handleAudioCacheMiss(msg map[string]interface{}) {
+	key, _ := msg["audio_key"].(string)
+	response, ok := c.audioCache.miss(key)
+	c.logger.Info("Response audio missing on device",
+		zap.String("deviceID", c.deviceID),
+		zap.String("audioKey", key),
+		zap.Bool("known", ok))
+	if !ok || c.session == nil {
+		return
+	}
+
+	go func() {
+		ctx, done := c.beginResponse(60 * time.Second)
+		defer done()
+		c.streamSpeech(ctx, response, key)
+	}()
 }
 
 // responseWithSampleAlso deprecated
@@ -0,0 +1,85 @@
+package websocket
+
+import (
+	"context"
+	"encoding/json"
+	"testing"
+	"time"
+
+	"github.com/gorilla/websocket"
+	"go.uber.org/zap"
+
+	"github.com/satriahrh/arunika/server/domain/entities"
+)
+
+// fakeTTS hands out a stream the test feeds by hand
+type fakeTTS struct {
+	audio chan []byte
+}
+
+func (f *fakeTTS) ConvertTextToSpeech(ctx context.Context, text string) (<-chan []byte, error) {
+	return f.audio, nil
+}
+
+func nextWrite(t *testing.T, send <-chan WriteData) WriteData {
+	t.Helper()
+	select {
+	case message := <-send:
+		return message
+	case <-time.After(time.Second):
+		t.Fatal("timed out waiting for a message to the device")
+		return WriteData{}
+	}
+}
+
+func TestResponseCancel(t *testing.T) {
+	tts := &fakeTTS{audio: make(chan []byte)}
+	c := &Client{
+		hub:        &Hub{ttsRepo: tts, phrases: newPhraseCounter()},
+		send:       make(chan WriteData, 16),
+		deviceID:   "doll-1",
+		logger:     zap.NewNop(),
+		session:    &entities.Session{ID: "s1"},
+		audioCache: newDeviceAudioCache(),
+	}
+
+	finished := make(chan struct{})
+	go func() {
+		defer close(finished)
+		ctx, done := c.beginResponse(time.Minute)
+		defer done()
+		c.streamSpeech(ctx, entities.Message{Role: entities.DollRole, Content: "Once upon a time"}, "")
+	}()
+
+	if start := nextWrite(t, c.send); start.Type != websocket.TextMessage {
+		t.Fatalf("first message type %d, want speaking_start text", start.Type)
+	}
+	tts.audio <- []byte{1, 2, 3}
+	if audio := nextWrite(t, c.send); audio.Type != websocket.BinaryMessage {
+		t.Fatalf("second message type %d, want audio", audio.Type)
+	}
+
+	// Barge-in: the stream stops and no speaking_end follows
+	c.processMessage([]byte(`{"type":"response_cancel"}`))
+	select {
+	case tts.audio <- []byte{4, 5, 6}:
+	case <-finished:
+	}
+	select {
+	case <-finished:
+	case <-time.After(time.Second):
+		t.Fatal("response still streaming after response_cancel")
+	}
+
+	close(c.send)
+	for message := range c.send {
+		if message.Type == websocket.BinaryMessage {
+			t.Errorf("audio frame of %d bytes sent after response_cancel", len(message.Payload))
+			continue
+		}
+		var msg map[string]interface{}
+		if json.Unmarshal(message.Payload, &msg) == nil && msg["type"] == "speaking_end" {
+			t.Error("speaking_end sent for a cancelled response")
+		}
+	}
+}
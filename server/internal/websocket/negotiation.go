@@ -0,0 +1,28 @@
+package websocket
+
+// supportedAudioEncodings lists the uplink encodings the STT pipeline accepts,
+// in order of preference. A-law and Opus are converted on the way in (see
+// newUplinkConverter).
+var supportedAudioEncodings = []string{"OPUS", "MULAW", "ALAW", "LINEAR16"}
+
+// fallbackAudioEncoding is what every firmware build can produce.
+const fallbackAudioEncoding = "MULAW"
+
+// negotiateAudioEncoding picks the first encoding offered by the device that
+// the server supports, honouring the device's order of preference.
+func negotiateAudioEncoding(offered []string) string {
+	for _, encoding := range offered {
+		for _, supported := range supportedAudioEncodings {
+			if encoding == supported {
+				return encoding
+			}
+		}
+	}
+	return fallbackAudioEncoding
+}
+
+// audioFormatter is implemented by TTS adapters that know the encoding and
+// sample rate of the audio they stream.
+type audioFormatter interface {
+	AudioFormat() (encoding string, sampleRate int)
+}
@@ -0,0 +1,26 @@
+package websocket
+
+import "testing"
+
+func TestNegotiateAudioEncoding(t *testing.T) {
+	tests := []struct {
+		name    string
+		offered []string
+		want    string
+	}{
+		{"opus", []string{"OPUS", "MULAW"}, "OPUS"},
+		{"alaw", []string{"ALAW", "MULAW"}, "ALAW"},
+		{"device preference wins", []string{"LINEAR16", "MULAW"}, "LINEAR16"},
+		{"unknown skipped", []string{"AMR", "MULAW"}, "MULAW"},
+		{"nothing supported", []string{"AMR"}, fallbackAudioEncoding},
+		{"empty offer", nil, fallbackAudioEncoding},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			if got := negotiateAudioEncoding(tt.offered); got != tt.want {
+				t.Errorf("negotiateAudioEncoding(%v) = %q, want %q", tt.offered, got, tt.want)
+			}
+		})
+	}
+}
@@ -0,0 +1,310 @@
+package websocket
+
+import (
+	"encoding/binary"
+	"fmt"
+	"sort"
+	"sync"
+	"time"
+)
+
+// Telemetry reports ride as the application data of the keepalive pings the
+// doll firmware sends, so they cost the device no extra frame. Counters are
+// cumulative since boot. Little-endian, fixed layout (see telemetry.c):
+//
+//	 0  magic(1) version(1) fw_major(1) fw_minor(1) fw_patch(2) flags(1) power_mode(1)
+//	 8  uptime_s(4) ring_overruns(4) jitter_underruns(4) jitter_overflows(4)
+//	24  connect_attempts(4) connect_failures(4) last_connect_ms(4)
+//	36  battery_mv(2) drain_mv_per_hour(2, signed) pool_exhausted(4) heap_min_free(4)
+//	48  pool_min_free(1 per pool) latency(p50, p95, p99 per trace stage)
+//
+// Latencies are log2 bucket indexes; code c means at most 2^(c+1)-1 us.
+const (
+	telemetryMagic      = 0xA7
+	telemetryVersion    = 1
+	telemetryPools      = 2
+	telemetryReportSize = 48 + telemetryPools + len(telemetryStages)*3
+
+	telemetryFlagCharging = 0x01
+	telemetryFlagTrace    = 0x02
+
+	telemetryLatencyNone = 0xFF
+)
+
+// Trace stages in firmware order
+var telemetryStages = [...]string{"encode", "send", "uplink", "server", "decode", "playout", "mouth_to_ear"}
+
+// LatencyPercentiles holds upper bounds of the histogram buckets that
+// contain each percentile
+type LatencyPercentiles struct {
+	P50Us uint32 `json:"p50_us"`
+	P95Us uint32 `json:"p95_us"`
+	P99Us uint32 `json:"p99_us"`
+}
+
+// TelemetryReport is one decoded stats message from a device
+type TelemetryReport struct {
+	Firmware        string                        `json:"firmware"`
+	Charging        bool                          `json:"charging"`
+	Traced          bool                          `json:"traced"`
+	PowerMode       uint8                         `json:"power_mode"`
+	UptimeS         uint32                        `json:"uptime_s"`
+	RingOverruns    uint32                        `json:"ring_overruns"`
+	JitterUnderruns uint32                        `json:"jitter_underruns"`
+	JitterOverflows uint32                        `json:"jitter_overflows"`
+	ConnectAttempts uint32                        `json:"connect_attempts"`
+	ConnectFailures uint32                        `json:"connect_failures"`
+	LastConnectMs   uint32                        `json:"last_connect_ms"`
+	BatteryMv       uint16                        `json:"battery_mv"`
+	DrainMvPerHour  int16                         `json:"drain_mv_per_hour"`
+	PoolExhausted   uint32                        `json:"pool_exhausted"`
+	HeapMinFree     uint32                        `json:"heap_min_free"`
+	PoolMinFree     [telemetryPools]uint8         `json:"pool_min_free"`
+	Latency         map[string]LatencyPercentiles `json:"latency"`
+}
+
+func telemetryLatencyUs(code uint8) uint32 {
+	if code == telemetryLatencyNone || code >= 31 {
+		return 0
+	}
+	return (2 << code) - 1
+}
+
+// parseTelemetry decodes a ping payload. ok is false for pings that carry
+// no report, such as those from older firmware.
+func parseTelemetry(data []byte) (report TelemetryReport, ok bool) {
+	if len(data) < telemetryReportSize || data[0] != telemetryMagic || data[1] != telemetryVersion {
+		return TelemetryReport{}, false
+	}
+
+	le := binary.LittleEndian
+	report = TelemetryReport{
+		Firmware:        fmt.Sprintf("%d.%d.%d", data[2], data[3], le.Uint16(data[4:6])),
+		Charging:        data[6]&telemetryFlagCharging != 0,
+		Traced:          data[6]&telemetryFlagTrace != 0,
+		PowerMode:       data[7],
+		UptimeS:         le.Uint32(data[8:12]),
+		RingOverruns:    le.Uint32(data[12:16]),
+		JitterUnderruns: le.Uint32(data[16:20]),
+		JitterOverflows: le.Uint32(data[20:24]),
+		ConnectAttempts: le.Uint32(data[24:28]),
+		ConnectFailures: le.Uint32(data[28:32]),
+		LastConnectMs:   le.Uint32(data[32:36]),
+		BatteryMv:       le.Uint16(data[36:38]),
+		DrainMvPerHour:  int16(le.Uint16(data[38:40])),
+		PoolExhausted:   le.Uint32(data[40:44]),
+		HeapMinFree:     le.Uint32(data[44:48]),
+		Latency:         make(map[string]LatencyPercentiles),
+	}
+	copy(report.PoolMinFree[:], data[48:48+telemetryPools])
+
+	latency := data[48+telemetryPools:]
+	for i, stage := range telemetryStages {
+		codes := latency[i*3 : i*3+3]
+		if codes[0] == telemetryLatencyNone {
+			continue
+		}
+		report.Latency[stage] = LatencyPercentiles{
+			P50Us: telemetryLatencyUs(codes[0]),
+			P95Us: telemetryLatencyUs(codes[1]),
+			P99Us: telemetryLatencyUs(codes[2]),
+		}
+	}
+	return report, true
+}
+
+// DeviceTelemetry is the running view of one device. Totals add up the
+// counter deltas between reports, across reboots, since the device last
+// changed firmware.
+type DeviceTelemetry struct {
+	Latest     TelemetryReport `json:"latest"`
+	ReceivedAt time.Time       `json:"received_at"`
+	Reports    int             `json:"reports"`
+	Reboots    int             `json:"reboots"`
+
+	RingOverruns    uint64 `json:"ring_overruns"`
+	JitterUnderruns uint64 `json:"jitter_underruns"`
+	JitterOverflows uint64 `json:"jitter_overflows"`
+	ConnectFailures uint64 `json:"connect_failures"`
+	PoolExhausted   uint64 `json:"pool_exhausted"`
+}
+
+// counterDelta is the growth of a cumulative counter; after a reboot the
+// counter restarted from zero
+func counterDelta(previous, current uint32, rebooted bool) uint64 {
+	if rebooted || current < previous {
+		return uint64(current)
+	}
+	return uint64(current - previous)
+}
+
+func (d *DeviceTelemetry) update(report TelemetryReport, now time.Time) {
+	if d.Reports > 0 && report.Firmware != d.Latest.Firmware {
+		*d = DeviceTelemetry{}
+	}
+
+	previous := d.Latest
+	first := d.Reports == 0
+	rebooted := !first && report.UptimeS < previous.UptimeS
+	if rebooted {
+		d.Reboots++
+	}
+	if first {
+		// The first report is counted whole; it covers the current boot
+		previous = TelemetryReport{}
+	}
+
+	d.RingOverruns += counterDelta(previous.RingOverruns, report.RingOverruns, rebooted)
+	d.JitterUnderruns += counterDelta(previous.JitterUnderruns, report.JitterUnderruns, rebooted)
+	d.JitterOverflows += counterDelta(previous.JitterOverflows, report.JitterOverflows, rebooted)
+	d.ConnectFailures += counterDelta(previous.ConnectFailures, report.ConnectFailures, rebooted)
+	d.PoolExhausted += counterDelta(previous.PoolExhausted, report.PoolExhausted, rebooted)
+
+	d.Latest = report
+	d.ReceivedAt = now
+	d.Reports++
+}
+
+// FleetLatency compares one stage across the devices of a firmware
+type FleetLatency struct {
+	Devices     int    `json:"devices"`
+	MedianP95Us uint32 `json:"median_p95_us"`
+	WorstP95Us  uint32 `json:"worst_p95_us"`
+	WorstP99Us  uint32 `json:"worst_p99_us"`
+}
+
+// FirmwareTelemetry aggregates every device running one firmware, so a
+// rollout can be compared against the release before it
+type FirmwareTelemetry struct {
+	Firmware             string                  `json:"firmware"`
+	Devices              int                     `json:"devices"`
+	Reboots              int                     `json:"reboots"`
+	RingOverruns         uint64                  `json:"ring_overruns"`
+	JitterUnderruns      uint64                  `json:"jitter_underruns"`
+	JitterOverflows      uint64                  `json:"jitter_overflows"`
+	ConnectFailures      uint64                  `json:"connect_failures"`
+	PoolExhausted        uint64                  `json:"pool_exhausted"`
+	MedianConnectMs      uint32                  `json:"median_connect_ms"`
+	MedianDrainMvPerHour int16                   `json:"median_drain_mv_per_hour"`
+	MinHeapFree          uint32                  `json:"min_heap_free"`
+	Latency              map[string]FleetLatency `json:"latency"`
+}
+
+// telemetryStore keeps the latest view of every device that has reported,
+// connected or not
+type telemetryStore struct {
+	mu      sync.Mutex
+	devices map[string]*DeviceTelemetry
+}
+
+func newTelemetryStore() *telemetryStore {
+	return &telemetryStore{devices: make(map[string]*DeviceTelemetry)}
+}
+
+func (s *telemetryStore) record(deviceID string, report TelemetryReport, now time.Time) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	device, ok := s.devices[deviceID]
+	if !ok {
+		device = &DeviceTelemetry{}
+		s.devices[deviceID] = device
+	}
+	device.update(report, now)
+}
+
+func (s *telemetryStore) device(deviceID string) (DeviceTelemetry, bool) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	device, ok := s.devices[deviceID]
+	if !ok {
+		return DeviceTelemetry{}, false
+	}
+	return *device, true
+}
+
+func medianUint32(values []uint32) uint32 {
+	if len(values) == 0 {
+		return 0
+	}
+	sort.Slice(values, func(i, j int) bool { return values[i] < values[j] })
+	return values[len(values)/2]
+}
+
+// fleet groups devices by the firmware of their latest report, sorted by
+// version string
+func (s *telemetryStore) fleet() []FirmwareTelemetry {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	type group struct {
+		summary     FirmwareTelemetry
+		connectMs   []uint32
+		drain       []int
+		latencyP95  map[string][]uint32
+		heapSampled bool
+	}
+	groups := make(map[string]*group)
+
+	for _, device := range s.devices {
+		report := device.Latest
+		g, ok := groups[report.Firmware]
+		if !ok {
+			g = &group{
+				summary:    FirmwareTelemetry{Firmware: report.Firmware, Latency: make(map[string]FleetLatency)},
+				latencyP95: make(map[string][]uint32),
+			}
+			groups[report.Firmware] = g
+		}
+
+		sum := &g.summary
+		sum.Devices++
+		sum.Reboots += device.Reboots
+		sum.RingOverruns += device.RingOverruns
+		sum.JitterUnderruns += device.JitterUnderruns
+		sum.JitterOverflows += device.JitterOverflows
+		sum.ConnectFailures += device.ConnectFailures
+		sum.PoolExhausted += device.PoolExhausted
+		g.connectMs = append(g.connectMs, report.LastConnectMs)
+		if !report.Charging && report.DrainMvPerHour != 0 {
+			g.drain = append(g.drain, int(report.DrainMvPerHour))
+		}
+		// Host builds report 0: nothing measured
+		if report.HeapMinFree > 0 && (!g.heapSampled || report.HeapMinFree < sum.MinHeapFree) {
+			sum.MinHeapFree = report.HeapMinFree
+			g.heapSampled = true
+		}
+
+		for stage, latency := range report.Latency {
+			fleet := sum.Latency[stage]
+			fleet.Devices++
+			if latency.P95Us > fleet.WorstP95Us {
+				fleet.WorstP95Us = latency.P95Us
+			}
+			if latency.P99Us > fleet.WorstP99Us {
+				fleet.WorstP99Us = latency.P99Us
+			}
+			sum.Latency[stage] = fleet
+			g.latencyP95[stage] = append(g.latencyP95[stage], latency.P95Us)
+		}
+	}
+
+	summaries := make([]FirmwareTelemetry, 0, len(groups))
+	for _, g := range groups {
+		sum := g.summary
+		sum.MedianConnectMs = medianUint32(g.connectMs)
+		if len(g.drain) > 0 {
+			sort.Ints(g.drain)
+			sum.MedianDrainMvPerHour = int16(g.drain[len(g.drain)/2])
+		}
+		for stage, values := range g.latencyP95 {
+			fleet := sum.Latency[stage]
+			fleet.MedianP95Us = medianUint32(values)
+			sum.Latency[stage] = fleet
+		}
+		summaries = append(summaries, sum)
+	}
+	sort.Slice(summaries, func(i, j int) bool { return summaries[i].Firmware < summaries[j].Firmware })
+	return summaries
+}
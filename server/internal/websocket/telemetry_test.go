@@ -0,0 +1,127 @@
+package websocket
+
+import (
+	"encoding/binary"
+	"testing"
+	"time"
+)
+
+type testReport struct {
+	uptimeS, underruns, failures uint32
+	drain                        int16
+	encode                       [3]uint8
+}
+
+func buildTelemetry(r testReport) []byte {
+	data := make([]byte, telemetryReportSize)
+	data[0] = telemetryMagic
+	data[1] = telemetryVersion
+	data[2], data[3] = 0, 2
+	binary.LittleEndian.PutUint16(data[4:6], 1)
+	data[6] = telemetryFlagTrace
+	binary.LittleEndian.PutUint32(data[8:12], r.uptimeS)
+	binary.LittleEndian.PutUint32(data[16:20], r.underruns)
+	binary.LittleEndian.PutUint32(data[28:32], r.failures)
+	binary.LittleEndian.PutUint32(data[32:36], 420)
+	binary.LittleEndian.PutUint16(data[36:38], 3870)
+	binary.LittleEndian.PutUint16(data[38:40], uint16(r.drain))
+	data[48], data[49] = 1, 2
+	for i := 48 + telemetryPools; i < len(data); i++ {
+		data[i] = telemetryLatencyNone
+	}
+	copy(data[48+telemetryPools:], r.encode[:])
+	return data
+}
+
+func TestParseTelemetry(t *testing.T) {
+	report, ok := parseTelemetry(buildTelemetry(testReport{uptimeS: 90, underruns: 3, drain: -12, encode: [3]uint8{8, 9, 10}}))
+	if !ok {
+		t.Fatal("expected report to be parsed")
+	}
+	if report.Firmware != "0.2.1" {
+		t.Errorf("firmware = %q, want 0.2.1", report.Firmware)
+	}
+	if !report.Traced || report.Charging {
+		t.Errorf("flags: traced=%v charging=%v", report.Traced, report.Charging)
+	}
+	if report.UptimeS != 90 || report.JitterUnderruns != 3 || report.LastConnectMs != 420 {
+		t.Errorf("counters: %+v", report)
+	}
+	if report.BatteryMv != 3870 || report.DrainMvPerHour != -12 {
+		t.Errorf("battery = %d mV, drain %d mV/h", report.BatteryMv, report.DrainMvPerHour)
+	}
+	if report.PoolMinFree != [telemetryPools]uint8{1, 2} {
+		t.Errorf("pool min free = %v", report.PoolMinFree)
+	}
+
+	want := LatencyPercentiles{P50Us: 511, P95Us: 1023, P99Us: 2047}
+	if got := report.Latency["encode"]; got != want {
+		t.Errorf("encode latency = %+v, want %+v", got, want)
+	}
+	if _, ok := report.Latency["mouth_to_ear"]; ok {
+		t.Error("stage without samples must be left out")
+	}
+}
+
+func TestParseTelemetryPlainPing(t *testing.T) {
+	for _, data := range [][]byte{nil, []byte("hb"), buildTelemetry(testReport{})[:telemetryReportSize-1]} {
+		if _, ok := parseTelemetry(data); ok {
+			t.Errorf("ping data %v must not parse as a report", data)
+		}
+	}
+}
+
+func TestTelemetryDeltasAcrossReboot(t *testing.T) {
+	store := newTelemetryStore()
+	now := time.Now()
+	for _, r := range []testReport{
+		{uptimeS: 60, underruns: 2, failures: 1},
+		{uptimeS: 120, underruns: 5, failures: 1},
+		{uptimeS: 10, underruns: 1}, // Rebooted: counters started over
+	} {
+		report, _ := parseTelemetry(buildTelemetry(r))
+		store.record("doll-1", report, now)
+	}
+
+	device, ok := store.device("doll-1")
+	if !ok {
+		t.Fatal("expected device telemetry")
+	}
+	if device.Reports != 3 || device.Reboots != 1 {
+		t.Errorf("reports = %d, reboots = %d", device.Reports, device.Reboots)
+	}
+	if device.JitterUnderruns != 6 || device.ConnectFailures != 1 {
+		t.Errorf("underruns = %d, failures = %d, want 6 and 1", device.JitterUnderruns, device.ConnectFailures)
+	}
+}
+
+func TestFleetTelemetryByFirmware(t *testing.T) {
+	store := newTelemetryStore()
+	now := time.Now()
+	for i, r := range []testReport{
+		{uptimeS: 60, underruns: 1, drain: 10, encode: [3]uint8{6, 7, 7}},
+		{uptimeS: 60, underruns: 4, drain: 30, encode: [3]uint8{6, 9, 12}},
+		{uptimeS: 60, drain: 20, encode: [3]uint8{6, 8, 8}},
+	} {
+		report, _ := parseTelemetry(buildTelemetry(r))
+		store.record(string(rune('a'+i)), report, now)
+	}
+	older := buildTelemetry(testReport{uptimeS: 60})
+	older[3] = 1
+	report, _ := parseTelemetry(older)
+	store.record("d", report, now)
+
+	fleet := store.fleet()
+	if len(fleet) != 2 || fleet[0].Firmware != "0.1.1" || fleet[1].Firmware != "0.2.1" {
+		t.Fatalf("fleet = %+v", fleet)
+	}
+
+	current := fleet[1]
+	if current.Devices != 3 || current.JitterUnderruns != 5 || current.MedianDrainMvPerHour != 20 {
+		t.Errorf("summary = %+v", current)
+	}
+	encode := current.Latency["encode"]
+	if encode.Devices != 3 || encode.MedianP95Us != 511 || encode.WorstP95Us != 1023 || encode.WorstP99Us != 8191 {
+		t.Errorf("encode = %+v", encode)
+	}
+}
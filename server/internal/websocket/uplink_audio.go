@@ -0,0 +1,173 @@
+package websocket
+
+import "encoding/binary"
+
+// The STT stream takes LINEAR16, MULAW or an Ogg Opus stream. Devices may
+// send A-law, which is widened to LINEAR16 here, and bare Opus packets,
+// one per frame, which are wrapped into Ogg pages as they arrive.
+
+// uplinkConverter turns one frame's payload into what the STT stream
+// expects; final marks the last frame of the utterance.
+type uplinkConverter interface {
+	convert(payload []byte, final bool) []byte
+}
+
+// newUplinkConverter returns the converter for a device encoding and the
+// encoding to open the STT stream with. Encodings STT takes as they are
+// get a nil converter.
+func newUplinkConverter(encoding string, sampleRate int) (uplinkConverter, string) {
+	switch encoding {
+	case "ALAW":
+		return alawConverter{}, "LINEAR16"
+	case "OPUS":
+		return newOggOpusWriter(sampleRate), "OGG_OPUS"
+	}
+	return nil, encoding
+}
+
+type alawConverter struct{}
+
+func (alawConverter) convert(payload []byte, final bool) []byte {
+	out := make([]byte, 2*len(payload))
+	for i, code := range payload {
+		binary.LittleEndian.PutUint16(out[2*i:], uint16(alawDecode(code)))
+	}
+	return out
+}
+
+// alawDecode expands one G.711 A-law code, as in the firmware's table
+func alawDecode(code byte) int16 {
+	code ^= 0x55
+	t := int16(code&0x0F) << 4
+	switch seg := (code & 0x70) >> 4; seg {
+	case 0:
+		t += 8
+	case 1:
+		t += 0x108
+	default:
+		t += 0x108
+		t <<= seg - 1
+	}
+	if code&0x80 != 0 {
+		return t
+	}
+	return -t
+}
+
+// oggOpusWriter frames an utterance's Opus packets as an Ogg Opus stream
+// (RFC 7845), one packet per page, so they reach STT as soon as they come.
+type oggOpusWriter struct {
+	sampleRate int
+	sequence   uint32
+	granule    uint64
+	started    bool
+}
+
+func newOggOpusWriter(sampleRate int) *oggOpusWriter {
+	return &oggOpusWriter{sampleRate: sampleRate}
+}
+
+func (w *oggOpusWriter) convert(packet []byte, final bool) []byte {
+	var out []byte
+	if !w.started {
+		head := make([]byte, 19)
+		copy(head, "OpusHead")
+		head[8] = 1 // Version
+		head[9] = 1 // Mono
+		binary.LittleEndian.PutUint32(head[12:], uint32(w.sampleRate))
+		out = w.page(out, head, 0x02)
+
+		tags := make([]byte, 16)
+		copy(tags, "OpusTags")
+		out = w.page(out, tags, 0)
+		w.started = true
+	}
+
+	w.granule += uint64(opusPacketSamples(packet))
+	var headerType byte
+	if final {
+		headerType = 0x04
+	}
+	return w.page(out, packet, headerType)
+}
+
+// page appends one Ogg page holding a single packet
+func (w *oggOpusWriter) page(out, packet []byte, headerType byte) []byte {
+	granule := w.granule
+	if w.sequence < 2 {
+		granule = 0 // Header pages
+	}
+
+	segments := len(packet)/255 + 1
+	start := len(out)
+	out = append(out, "OggS"...)
+	out = append(out, 0, headerType)
+	out = binary.LittleEndian.AppendUint64(out, granule)
+	out = binary.LittleEndian.AppendUint32(out, 1) // Stream serial
+	out = binary.LittleEndian.AppendUint32(out, w.sequence)
+	out = binary.LittleEndian.AppendUint32(out, 0) // CRC, set below
+	out = append(out, byte(segments))
+	for i := 1; i < segments; i++ {
+		out = append(out, 255)
+	}
+	out = append(out, byte(len(packet)%255))
+	out = append(out, packet...)
+
+	binary.LittleEndian.PutUint32(out[start+22:], oggCRC(out[start:]))
+	w.sequence++
+	return out
+}
+
+// opusPacketSamples is the duration of an Opus packet at 48 kHz, from its
+// TOC byte (RFC 6716, section 3.1)
+func opusPacketSamples(packet []byte) int {
+	if len(packet) == 0 {
+		return 0
+	}
+
+	config := packet[0] >> 3
+	var frame int
+	switch {
+	case config < 12:
+		frame = []int{480, 960, 1920, 2880}[config%4]
+	case config < 16:
+		frame = []int{480, 960}[config%2]
+	default:
+		frame = []int{120, 240, 480, 960}[config%4]
+	}
+
+	switch packet[0] & 0x03 {
+	case 0:
+		return frame
+	case 1, 2:
+		return 2 * frame
+	}
+	if len(packet) < 2 {
+		return 0
+	}
+	return int(packet[1]&0x3F) * frame
+}
+
+// Ogg uses the unreflected CRC-32 with polynomial 0x04C11DB7
+var oggCRCTable = func() (table [256]uint32) {
+	for i := range table {
+		r := uint32(i) << 24
+		for j := 0; j < 8; j++ {
+			if r&0x80000000 != 0 {
+				r = r<<1 ^ 0x04C11DB7
+			} else {
+				r <<= 1
+			}
+		}
+		table[i] = r
+	}
+	return table
+}()
+
+func oggCRC(data []byte) uint32 {
+	var crc uint32
+	for _, b := range data {
+		crc = crc<<8 ^ oggCRCTable[byte(crc>>24)^b]
+	}
+	return crc
+}
@@ -0,0 +1,121 @@
+package websocket
+
+import (
+	"bytes"
+	"encoding/binary"
+	"testing"
+)
+
+func TestNewUplinkConverter(t *testing.T) {
+	tests := []struct {
+		encoding  string
+		stt       string
+		converted bool
+	}{
+		{"MULAW", "MULAW", false},
+		{"LINEAR16", "LINEAR16", false},
+		{"ALAW", "LINEAR16", true},
+		{"OPUS", "OGG_OPUS", true},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.encoding, func(t *testing.T) {
+			converter, stt := newUplinkConverter(tt.encoding, 8000)
+			if stt != tt.stt || (converter != nil) != tt.converted {
+				t.Errorf("newUplinkConverter(%q) = %v, %q, want converted=%v, %q", tt.encoding, converter, stt, tt.converted, tt.stt)
+			}
+		})
+	}
+}
+
+func TestAlawDecode(t *testing.T) {
+	tests := []struct {
+		code byte
+		want int16
+	}{
+		{0x00, -5504},
+		{0x55, -8},
+		{0xD5, 8},
+		{0x2A, -32256},
+		{0xAA, 32256},
+	}
+
+	for _, tt := range tests {
+		if got := alawDecode(tt.code); got != tt.want {
+			t.Errorf("alawDecode(0x%02X) = %d, want %d", tt.code, got, tt.want)
+		}
+	}
+}
+
+func TestOpusPacketSamples(t *testing.T) {
+	tests := []struct {
+		name   string
+		packet []byte
+		want   int
+	}{
+		{"silk 20 ms", []byte{1<<3 | 0}, 960},
+		{"hybrid 10 ms", []byte{12<<3 | 0}, 480},
+		{"celt 2.5 ms", []byte{16<<3 | 0}, 120},
+		{"two frames", []byte{1<<3 | 1}, 1920},
+		{"counted frames", []byte{0<<3 | 3, 3}, 1440},
+		{"empty", nil, 0},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			if got := opusPacketSamples(tt.packet); got != tt.want {
+				t.Errorf("opusPacketSamples(%v) = %d, want %d", tt.packet, got, tt.want)
+			}
+		})
+	}
+}
+
+func TestOggOpusWriter(t *testing.T) {
+	if got := oggCRC([]byte("123456789")); got != 0x89A1897F {
+		t.Fatalf("oggCRC check value = 0x%08X, want 0x89A1897F", got)
+	}
+
+	w := newOggOpusWriter(8000)
+	packet := append([]byte{1 << 3}, bytes.Repeat([]byte{0x11}, 300)...)
+	first := w.convert(packet, false)
+	last := w.convert(packet[:40], true)
+
+	// Both header pages come before the first audio page
+	var pages [][]byte
+	for data := append(first, last...); len(data) > 0; {
+		if !bytes.HasPrefix(data, []byte("OggS")) || len(data) < 27 {
+			t.Fatalf("page %d does not start with a page header", len(pages))
+		}
+		segments := int(data[26])
+		size := 27 + segments
+		for _, lace := range data[27 : 27+segments] {
+			size += int(lace)
+		}
+		page := data[:size]
+		check := append([]byte(nil), page...)
+		binary.LittleEndian.PutUint32(check[22:], 0)
+		if binary.LittleEndian.Uint32(page[22:]) != oggCRC(check) {
+			t.Errorf("page %d has a bad CRC", len(pages))
+		}
+		pages = append(pages, page)
+		data = data[size:]
+	}
+
+	if len(pages) != 4 {
+		t.Fatalf("got %d pages, want 4", len(pages))
+	}
+	if pages[0][5] != 0x02 || !bytes.Contains(pages[0], []byte("OpusHead")) || !bytes.Contains(pages[1], []byte("OpusTags")) {
+		t.Errorf("stream does not open with the OpusHead and OpusTags pages")
+	}
+	if pages[3][5] != 0x04 {
+		t.Errorf("final packet page has header type 0x%02X, want end of stream", pages[3][5])
+	}
+	for i, want := range []uint64{0, 0, 960, 1920} {
+		if got := binary.LittleEndian.Uint64(pages[i][6:]); got != want {
+			t.Errorf("page %d granule = %d, want %d", i, got, want)
+		}
+	}
+	if !bytes.HasSuffix(pages[2], packet) || pages[2][26] != 2 {
+		t.Errorf("300 byte packet not laced over two segments")
+	}
+}